@@ -0,0 +1,262 @@
+/*
+* Vulkan descriptor set allocator and layout cache
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorAllocator.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace vks
+{
+	/*
+		Descriptor allocator
+	*/
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		destroy();
+	}
+
+	void DescriptorAllocator::create(VkDevice device, const std::vector<PoolSizeRatio>& poolSizeRatios, uint32_t setsPerPool, const DescriptorLayoutCache* layoutCache)
+	{
+		destroy();
+		this->device = device;
+		this->layoutCache = layoutCache;
+		this->setsPerPool = std::max(setsPerPool, 1u);
+		this->poolSizeRatios = poolSizeRatios;
+		if (this->poolSizeRatios.empty()) {
+			this->poolSizeRatios = {
+				{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+				{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+				{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+				{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+				{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+				{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f }
+			};
+		}
+	}
+
+	void DescriptorAllocator::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto pool : usedPools) {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		for (auto pool : freePools) {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		usedPools.clear();
+		freePools.clear();
+		currentPool = VK_NULL_HANDLE;
+		device = VK_NULL_HANDLE;
+	}
+
+	VkDescriptorPool DescriptorAllocator::grabPool()
+	{
+		if (!freePools.empty()) {
+			VkDescriptorPool pool = freePools.back();
+			freePools.pop_back();
+			return pool;
+		}
+		return createPool({});
+	}
+
+	// Sizes a new pool from the ratios, if the descriptor counts of a set are passed the pool is also large enough to hold a number of such sets
+	VkDescriptorPool DescriptorAllocator::createPool(const std::vector<VkDescriptorPoolSize>& setSizes)
+	{
+		// Each new pool is larger than the previous one, so the number of pools stays small for large scenes
+		const uint32_t maxSetsPerPool = 4096;
+		const uint32_t maxSets = std::min(setsPerPool << std::min<size_t>(usedPools.size(), 16), maxSetsPerPool);
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto& poolSizeRatio : poolSizeRatios) {
+			poolSizes.push_back({ poolSizeRatio.type, std::max(static_cast<uint32_t>(poolSizeRatio.ratio * maxSets), 1u) });
+		}
+		if (!setSizes.empty()) {
+			// Large sets (e.g. descriptor arrays) limit the number of sets the pool is sized for, so the pool doesn't grow beyond a descriptor budget
+			const uint32_t maxDescriptorsPerPool = 65536;
+			uint32_t descriptorsPerSet = 0;
+			for (auto& setSize : setSizes) {
+				descriptorsPerSet += setSize.descriptorCount;
+			}
+			const uint32_t setCount = std::max(std::min(maxSets, maxDescriptorsPerPool / std::max(descriptorsPerSet, 1u)), 1u);
+			for (auto& setSize : setSizes) {
+				auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(), [&](const VkDescriptorPoolSize& size) { return size.type == setSize.type; });
+				if (poolSize == poolSizes.end()) {
+					poolSizes.push_back({ setSize.type, 0 });
+					poolSize = poolSizes.end() - 1;
+				}
+				poolSize->descriptorCount = std::max(poolSize->descriptorCount, setSize.descriptorCount * setCount);
+			}
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		descriptorPoolCI.pPoolSizes = poolSizes.data();
+		descriptorPoolCI.maxSets = maxSets;
+		VkDescriptorPool pool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &pool));
+		return pool;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* pNext)
+	{
+		assert(device != VK_NULL_HANDLE);
+		if (currentPool == VK_NULL_HANDLE) {
+			currentPool = grabPool();
+			usedPools.push_back(currentPool);
+		}
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptorSetAllocInfo.pNext = pNext;
+		descriptorSetAllocInfo.descriptorPool = currentPool;
+		descriptorSetAllocInfo.pSetLayouts = &layout;
+		descriptorSetAllocInfo.descriptorSetCount = 1;
+		VkDescriptorSet descriptorSet;
+		VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet);
+		// Pool exhaustion is reported differently depending on the implementation, so any failure moves on to a new pool
+		// The set may not fit into a pool sized by the ratios at all, so the new pool is sized from the layout's descriptor counts if they are known
+		if (result != VK_SUCCESS) {
+			currentPool = createPool(layoutCache ? layoutCache->getDescriptorCounts(layout) : std::vector<VkDescriptorPoolSize>());
+			usedPools.push_back(currentPool);
+			descriptorSetAllocInfo.descriptorPool = currentPool;
+			result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet);
+		}
+		VK_CHECK_RESULT(result);
+		return descriptorSet;
+	}
+
+	void DescriptorAllocator::reset()
+	{
+		for (auto pool : usedPools) {
+			vkResetDescriptorPool(device, pool, 0);
+			freePools.push_back(pool);
+		}
+		usedPools.clear();
+		currentPool = VK_NULL_HANDLE;
+	}
+
+	/*
+		Descriptor layout cache
+	*/
+
+	DescriptorLayoutCache::~DescriptorLayoutCache()
+	{
+		destroy();
+	}
+
+	void DescriptorLayoutCache::create(VkDevice device)
+	{
+		destroy();
+		this->device = device;
+	}
+
+	void DescriptorLayoutCache::destroy()
+	{
+		for (auto& layout : layouts) {
+			vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+		}
+		layouts.clear();
+		descriptorCounts.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	bool DescriptorLayoutCache::LayoutInfo::operator==(const LayoutInfo& other) const
+	{
+		if ((flags != other.flags) || (bindings.size() != other.bindings.size()) || (bindingFlags != other.bindingFlags)) {
+			return false;
+		}
+		for (size_t i = 0; i < bindings.size(); i++) {
+			const VkDescriptorSetLayoutBinding& a = bindings[i];
+			const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+			if ((a.binding != b.binding) || (a.descriptorType != b.descriptorType) || (a.descriptorCount != b.descriptorCount) || (a.stageFlags != b.stageFlags) || (a.pImmutableSamplers != b.pImmutableSamplers)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t DescriptorLayoutCache::LayoutInfo::hash() const
+	{
+		auto combine = [](size_t& seed, size_t value) {
+			seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+		size_t seed = std::hash<uint32_t>()(flags);
+		for (auto& binding : bindings) {
+			combine(seed, binding.binding);
+			combine(seed, binding.descriptorType);
+			combine(seed, binding.descriptorCount);
+			combine(seed, binding.stageFlags);
+		}
+		for (auto bindingFlag : bindingFlags) {
+			combine(seed, bindingFlag);
+		}
+		return seed;
+	}
+
+	VkDescriptorSetLayout DescriptorLayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags, const std::vector<VkDescriptorBindingFlags>& bindingFlags)
+	{
+		assert(device != VK_NULL_HANDLE);
+		assert(bindingFlags.empty() || (bindingFlags.size() == bindings.size()));
+
+		// Bindings are sorted, so the same set of bindings passed in a different order maps to the same layout
+		std::vector<size_t> order(bindings.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+		LayoutInfo info;
+		info.flags = flags;
+		for (size_t index : order) {
+			info.bindings.push_back(bindings[index]);
+			if (!bindingFlags.empty()) {
+				info.bindingFlags.push_back(bindingFlags[index]);
+			}
+		}
+
+		auto it = layouts.find(info);
+		if (it != layouts.end()) {
+			return it->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+		descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorLayoutCI.flags = flags;
+		descriptorLayoutCI.bindingCount = static_cast<uint32_t>(info.bindings.size());
+		descriptorLayoutCI.pBindings = info.bindings.data();
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
+		if (!info.bindingFlags.empty()) {
+			setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+			setLayoutBindingFlags.bindingCount = static_cast<uint32_t>(info.bindingFlags.size());
+			setLayoutBindingFlags.pBindingFlags = info.bindingFlags.data();
+			descriptorLayoutCI.pNext = &setLayoutBindingFlags;
+		}
+		VkDescriptorSetLayout layout;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &layout));
+		layouts[info] = layout;
+
+		std::vector<VkDescriptorPoolSize>& counts = descriptorCounts[layout];
+		for (auto& binding : info.bindings) {
+			auto count = std::find_if(counts.begin(), counts.end(), [&](const VkDescriptorPoolSize& size) { return size.type == binding.descriptorType; });
+			if (count == counts.end()) {
+				counts.push_back({ binding.descriptorType, 0 });
+				count = counts.end() - 1;
+			}
+			count->descriptorCount += binding.descriptorCount;
+		}
+		return layout;
+	}
+
+	std::vector<VkDescriptorPoolSize> DescriptorLayoutCache::getDescriptorCounts(VkDescriptorSetLayout layout) const
+	{
+		auto it = descriptorCounts.find(layout);
+		return (it != descriptorCounts.end()) ? it->second : std::vector<VkDescriptorPoolSize>();
+	}
+}
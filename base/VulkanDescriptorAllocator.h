@@ -0,0 +1,104 @@
+/*
+* Vulkan descriptor set allocator and layout cache
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class DescriptorLayoutCache;
+
+	/**
+	* @brief Allocates descriptor sets from a chain of descriptor pools that grows on demand
+	* @note Pools are never sized for a known number of sets, if the current pool is exhausted a new (larger) pool is added to the chain
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Number of descriptors of a type per descriptor set a pool is sized for */
+		struct PoolSizeRatio {
+			VkDescriptorType type;
+			float ratio;
+		};
+
+		DescriptorAllocator() {};
+		~DescriptorAllocator();
+
+		/**
+		* @brief Prepares the allocator for use, pools are only created once sets are allocated
+		* @param device Logical device the pools are created for
+		* @param poolSizeRatios Descriptor counts per set used to size the pools (defaults cover common descriptor types)
+		* @param setsPerPool Number of sets the first pool is sized for, each additional pool doubles this up to a limit
+		* @param layoutCache Optional cache the allocated layouts were created with, used to size a new pool for the descriptors of a layout that doesn't fit into the ratio based pools
+		*/
+		void create(VkDevice device, const std::vector<PoolSizeRatio>& poolSizeRatios = {}, uint32_t setsPerPool = 64, const DescriptorLayoutCache* layoutCache = nullptr);
+		/** @brief Destroys all pools, which also frees all sets allocated from this allocator */
+		void destroy();
+
+		/**
+		* @brief Allocates a descriptor set with the given layout
+		* @param pNext Optional extension structure for the allocation (e.g. variable descriptor counts)
+		*/
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* pNext = nullptr);
+		/** @brief Resets all pools, invalidating all sets allocated since the last reset (e.g. transient per-frame sets) */
+		void reset();
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<PoolSizeRatio> poolSizeRatios;
+		uint32_t setsPerPool = 64;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> usedPools;
+		std::vector<VkDescriptorPool> freePools;
+		const DescriptorLayoutCache* layoutCache = nullptr;
+		VkDescriptorPool grabPool();
+		VkDescriptorPool createPool(const std::vector<VkDescriptorPoolSize>& setSizes);
+	};
+
+	/**
+	* @brief Creates descriptor set layouts and returns the same layout for identical binding descriptions
+	* @note Layouts are owned by the cache and destroyed along with it
+	*/
+	class DescriptorLayoutCache
+	{
+	public:
+		DescriptorLayoutCache() {};
+		~DescriptorLayoutCache();
+
+		void create(VkDevice device);
+		void destroy();
+
+		/**
+		* @brief Returns a layout for the given bindings, creating it if no layout with the same bindings exists yet
+		* @param bindings Layout bindings, the order doesn't matter
+		* @param flags Layout create flags
+		* @param bindingFlags Optional per binding flags (in the order of the bindings passed in), e.g. for descriptor indexing
+		*/
+		VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0, const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
+		/** @brief Returns the number of descriptors of each type in a single set of a layout created by this cache, empty for unknown layouts */
+		std::vector<VkDescriptorPoolSize> getDescriptorCounts(VkDescriptorSetLayout layout) const;
+	private:
+		struct LayoutInfo {
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+			std::vector<VkDescriptorBindingFlags> bindingFlags;
+			VkDescriptorSetLayoutCreateFlags flags;
+			bool operator==(const LayoutInfo& other) const;
+			size_t hash() const;
+		};
+		struct LayoutHash {
+			size_t operator()(const LayoutInfo& info) const { return info.hash(); }
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutHash> layouts;
+		std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>> descriptorCounts;
+	};
+}
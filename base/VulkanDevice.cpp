@@ -68,6 +68,8 @@ namespace vks
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 		}
+		descriptorLayoutCache.destroy();
+		samplerCache.destroy();
 		if (logicalDevice)
 		{
 			vkDestroyDevice(logicalDevice, nullptr);
@@ -298,6 +300,14 @@ namespace vks
 		}
 
 		this->enabledFeatures = enabledFeatures;
+		// Extension features can only be enabled via the pNext chain, so they're looked up there
+		enabledDescriptorIndexingFeatures = {};
+		for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(pNextChain); next != nullptr; next = next->pNext) {
+			if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT) {
+				enabledDescriptorIndexingFeatures = *reinterpret_cast<const VkPhysicalDeviceDescriptorIndexingFeaturesEXT*>(next);
+			}
+		}
+		enabledDescriptorIndexingFeatures.pNext = nullptr;
 
 		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
 		if (result != VK_SUCCESS) 
@@ -308,6 +318,9 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		descriptorLayoutCache.create(logicalDevice);
+		samplerCache.create(logicalDevice);
+
 		return result;
 	}
 
@@ -11,6 +11,8 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanSamplerCache.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
@@ -31,6 +33,8 @@ struct VulkanDevice
 	VkPhysicalDeviceFeatures features;
 	/** @brief Features that have been enabled for use on the physical device */
 	VkPhysicalDeviceFeatures enabledFeatures;
+	/** @brief Descriptor indexing features that have been enabled with a VkPhysicalDeviceDescriptorIndexingFeaturesEXT structure in the device creation pNext chain */
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures{};
 	/** @brief Memory types and heaps of the physical device */
 	VkPhysicalDeviceMemoryProperties memoryProperties;
 	/** @brief Queue family properties of the physical device */
@@ -39,6 +43,10 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Descriptor set layouts shared by everything created on this device, identical bindings map to the same layout */
+	vks::DescriptorLayoutCache descriptorLayoutCache;
+	/** @brief Samplers shared by everything created on this device, textures acquire their samplers from here and release them when destroyed */
+	vks::SamplerCache samplerCache;
 	/** @brief Set to true when the debug marker extension is detected */
 	bool enableDebugMarkers = false;
 	/** @brief Contains queue family indices */
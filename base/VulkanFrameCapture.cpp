@@ -0,0 +1,468 @@
+/*
+* Vulkan frame capture
+*
+* Asynchronous readback of rendered images for screenshots and image sequences
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameCapture.h"
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_CAPTURE_SSE2
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Converts a range of pixels to RGBA with opaque alpha (swap chain alpha is usually undefined)
+		void convertPixels(const uint32_t* src, uint32_t* dst, size_t count, bool swizzle)
+		{
+			size_t i = 0;
+#if defined(VKS_CAPTURE_SSE2)
+			const __m128i maskGA = _mm_set1_epi32(0xFF00FF00);
+			const __m128i maskLow = _mm_set1_epi32(0x000000FF);
+			const __m128i alpha = _mm_set1_epi32(0xFF000000);
+			for (; i + 4 <= count; i += 4) {
+				__m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+				if (swizzle) {
+					// Swap the first and third byte of each pixel (BGRA -> RGBA)
+					const __m128i r = _mm_slli_epi32(_mm_and_si128(pixels, maskLow), 16);
+					const __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), maskLow);
+					pixels = _mm_or_si128(_mm_and_si128(pixels, maskGA), _mm_or_si128(r, b));
+				}
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(pixels, alpha));
+			}
+#endif
+			for (; i < count; i++) {
+				const uint32_t pixel = src[i];
+				dst[i] = swizzle ? ((pixel & 0xFF00FF00) | ((pixel & 0xFF) << 16) | ((pixel >> 16) & 0xFF)) | 0xFF000000 : pixel | 0xFF000000;
+			}
+		}
+
+		void appendBigEndian(std::vector<uint8_t>& data, uint32_t value)
+		{
+			data.push_back((uint8_t)(value >> 24));
+			data.push_back((uint8_t)(value >> 16));
+			data.push_back((uint8_t)(value >> 8));
+			data.push_back((uint8_t)value);
+		}
+
+		std::array<uint32_t, 256> createCrcTable()
+		{
+			std::array<uint32_t, 256> table;
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (uint32_t k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				table[i] = c;
+			}
+			return table;
+		}
+
+		uint32_t crc32(const uint8_t* data, size_t size)
+		{
+			static const std::array<uint32_t, 256> table = createCrcTable();
+			uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = 0; i < size; i++) {
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return crc ^ 0xFFFFFFFFu;
+		}
+
+		void appendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& chunkData)
+		{
+			appendBigEndian(png, static_cast<uint32_t>(chunkData.size()));
+			const size_t start = png.size();
+			png.insert(png.end(), type, type + 4);
+			png.insert(png.end(), chunkData.begin(), chunkData.end());
+			appendBigEndian(png, crc32(png.data() + start, png.size() - start));
+		}
+
+		// Writes the image data as stored (uncompressed) deflate blocks, trading file size for encoding speed
+		std::vector<uint8_t> encodePNG(const uint8_t* rgba, uint32_t width, uint32_t height)
+		{
+			std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			std::vector<uint8_t> header;
+			appendBigEndian(header, width);
+			appendBigEndian(header, height);
+			// 8 bit RGBA, default compression, filter and no interlacing
+			header.insert(header.end(), { 8, 6, 0, 0, 0 });
+			appendPngChunk(png, "IHDR", header);
+
+			// Every scanline starts with its filter type (none)
+			const size_t rowSize = (size_t)width * 4;
+			std::vector<uint8_t> scanlines((rowSize + 1) * height);
+			for (uint32_t y = 0; y < height; y++) {
+				scanlines[y * (rowSize + 1)] = 0;
+				memcpy(&scanlines[y * (rowSize + 1) + 1], rgba + y * rowSize, rowSize);
+			}
+			uint32_t a = 1, b = 0;
+			for (size_t i = 0; i < scanlines.size(); i++) {
+				a = (a + scanlines[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			std::vector<uint8_t> zlib = { 0x78, 0x01 };
+			zlib.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+			size_t offset = 0;
+			do {
+				const uint16_t blockSize = (uint16_t)std::min<size_t>(scanlines.size() - offset, 65535);
+				const bool lastBlock = (offset + blockSize == scanlines.size());
+				zlib.insert(zlib.end(), { (uint8_t)(lastBlock ? 1 : 0), (uint8_t)(blockSize & 0xFF), (uint8_t)(blockSize >> 8), (uint8_t)(~blockSize & 0xFF), (uint8_t)((~blockSize >> 8) & 0xFF) });
+				zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+				offset += blockSize;
+			} while (offset < scanlines.size());
+			appendBigEndian(zlib, (b << 16) | a);
+			appendPngChunk(png, "IDAT", zlib);
+			appendPngChunk(png, "IEND", {});
+			return png;
+		}
+
+		// Quite OK Image format (https://qoiformat.org), lossless and much faster to encode than PNG
+		std::vector<uint8_t> encodeQOI(const uint8_t* rgba, uint32_t width, uint32_t height)
+		{
+			std::vector<uint8_t> qoi = { 'q', 'o', 'i', 'f' };
+			appendBigEndian(qoi, width);
+			appendBigEndian(qoi, height);
+			qoi.push_back(4);
+			qoi.push_back(0);
+			qoi.reserve(qoi.size() + (size_t)width * height * 5 / 4);
+
+			uint8_t index[64][4] = {};
+			uint8_t prev[4] = { 0, 0, 0, 255 };
+			uint32_t run = 0;
+			const size_t pixelCount = (size_t)width * height;
+			for (size_t i = 0; i < pixelCount; i++) {
+				const uint8_t* px = rgba + i * 4;
+				if (memcmp(px, prev, 4) == 0) {
+					run++;
+					if ((run == 62) || (i == pixelCount - 1)) {
+						qoi.push_back(0xC0 | (uint8_t)(run - 1));
+						run = 0;
+					}
+					continue;
+				}
+				if (run > 0) {
+					qoi.push_back(0xC0 | (uint8_t)(run - 1));
+					run = 0;
+				}
+				const uint32_t hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+				if (memcmp(index[hash], px, 4) == 0) {
+					qoi.push_back((uint8_t)hash);
+				} else {
+					memcpy(index[hash], px, 4);
+					if (px[3] == prev[3]) {
+						const int8_t dr = (int8_t)(px[0] - prev[0]);
+						const int8_t dg = (int8_t)(px[1] - prev[1]);
+						const int8_t db = (int8_t)(px[2] - prev[2]);
+						const int8_t drdg = (int8_t)(dr - dg);
+						const int8_t dbdg = (int8_t)(db - dg);
+						if ((dr > -3) && (dr < 2) && (dg > -3) && (dg < 2) && (db > -3) && (db < 2)) {
+							qoi.push_back(0x40 | (uint8_t)((dr + 2) << 4) | (uint8_t)((dg + 2) << 2) | (uint8_t)(db + 2));
+						} else if ((dg > -33) && (dg < 32) && (drdg > -9) && (drdg < 8) && (dbdg > -9) && (dbdg < 8)) {
+							qoi.push_back(0x80 | (uint8_t)(dg + 32));
+							qoi.push_back((uint8_t)((drdg + 8) << 4) | (uint8_t)(dbdg + 8));
+						} else {
+							qoi.insert(qoi.end(), { 0xFE, px[0], px[1], px[2] });
+						}
+					} else {
+						qoi.insert(qoi.end(), { 0xFF, px[0], px[1], px[2], px[3] });
+					}
+				}
+				memcpy(prev, px, 4);
+			}
+			qoi.insert(qoi.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+			return qoi;
+		}
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		destroy();
+	}
+
+	void FrameCapture::create(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t ringSize)
+	{
+		destroy();
+		device = vulkanDevice;
+		this->queue = queue;
+		// Reading from uncached memory is very slow, so prefer cached memory (which may require invalidating)
+		VkBool32 cachedAvailable = VK_FALSE;
+		vulkanDevice->getMemoryType(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cachedAvailable);
+		memoryPropertyFlags = cachedAvailable ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		this->ringSize = ringSize;
+		nextSlot = 0;
+	}
+
+	void FrameCapture::prepareSlots()
+	{
+		// The ring and the writer threads are only set up once something is captured, so applications that never capture don't pay for them
+		if (!slots.empty()) {
+			return;
+		}
+		VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+		for (uint32_t i = 0; i < ringSize; i++) {
+			std::unique_ptr<Slot> slot(new Slot());
+			slot->commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCI, nullptr, &slot->fence));
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &slot->semaphore));
+			slots.push_back(std::move(slot));
+		}
+		nextSlot = 0;
+		// Leave some cores for rendering, the calling thread only helps out while waiting
+		threadPool.setThreadCount(std::max(2u, std::thread::hardware_concurrency() / 2));
+	}
+
+	void FrameCapture::destroy()
+	{
+		if (device == nullptr) {
+			return;
+		}
+		flush();
+		for (auto& slot : slots) {
+			slot->buffer.destroy();
+			vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &slot->commandBuffer);
+			vkDestroyFence(device->logicalDevice, slot->fence, nullptr);
+			vkDestroySemaphore(device->logicalDevice, slot->semaphore, nullptr);
+		}
+		slots.clear();
+		device = nullptr;
+	}
+
+	FrameCapture::Format FrameCapture::getFormat(const std::string& filename)
+	{
+		std::string extension = filename.substr(filename.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "png") {
+			return Format::PNG;
+		}
+		if (extension == "qoi") {
+			return Format::QOI;
+		}
+		if (extension == "ppm") {
+			return Format::PPM;
+		}
+		return Format::Raw;
+	}
+
+	void FrameCapture::startSequence(const std::string& directory, const std::string& extension)
+	{
+		capturingSequence = true;
+		sequenceDirectory = directory;
+		sequenceExtension = extension;
+		sequenceFrame = 0;
+	}
+
+	void FrameCapture::stopSequence()
+	{
+		capturingSequence = false;
+	}
+
+	void FrameCapture::update()
+	{
+		for (auto& slot : slots) {
+			if ((slot->state.load(std::memory_order_acquire) == Copying) && (vkGetFenceStatus(device->logicalDevice, slot->fence) == VK_SUCCESS)) {
+				slot->state.store(Encoding, std::memory_order_release);
+				Slot* slotPtr = slot.get();
+				threadPool.schedule([this, slotPtr] { encode(*slotPtr); });
+			}
+		}
+	}
+
+	void FrameCapture::waitForSlot(Slot& slot)
+	{
+		if (slot.state.load(std::memory_order_acquire) == Copying) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			update();
+		}
+		while (slot.state.load(std::memory_order_acquire) != Free) {
+			if (!threadPool.runPendingJob()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void FrameCapture::flush()
+	{
+		for (auto& slot : slots) {
+			waitForSlot(*slot);
+		}
+		threadPool.wait();
+	}
+
+	VkSemaphore FrameCapture::capture(VkImage image, VkFormat format, VkExtent2D extent, VkSemaphore waitSemaphore, const std::string& filename)
+	{
+		VKS_PROFILE_ZONE("FrameCapture::capture");
+		assert(device);
+		prepareSlots();
+		update();
+
+		bool swizzle;
+		switch (format) {
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			swizzle = true;
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			swizzle = false;
+			break;
+		default:
+			std::cerr << "Capturing images with format " << format << " is not supported" << std::endl;
+			return VK_NULL_HANDLE;
+		}
+
+		std::string targetFile = filename;
+		if (targetFile.empty()) {
+			if (!capturingSequence) {
+				return VK_NULL_HANDLE;
+			}
+			char sequenceFile[32];
+			snprintf(sequenceFile, sizeof(sequenceFile), "frame%06u.", sequenceFrame++);
+			targetFile = sequenceDirectory + "/" + sequenceFile + sequenceExtension;
+		}
+
+		// Reuse the oldest slot, this only blocks if the ring is too small to keep up
+		Slot& slot = *slots[nextSlot];
+		nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+		waitForSlot(slot);
+
+		const VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+		if (slot.buffer.size < size) {
+			slot.buffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot.buffer, size));
+			VK_CHECK_RESULT(slot.buffer.map());
+		}
+		slot.filename = targetFile;
+		slot.extent = extent;
+		slot.swizzle = swizzle;
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(
+			slot.commandBuffer,
+			image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &copyRegion);
+		vks::tools::insertImageMemoryBarrier(
+			slot.commandBuffer,
+			image,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			0,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			subresourceRange);
+		// Make the copied data visible to the host once the fence has signaled
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = slot.buffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+
+		// The copy is chained between rendering and presentation via semaphores, so presentation doesn't access the image while it's being copied
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+		if (waitSemaphore != VK_NULL_HANDLE) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &slot.semaphore;
+		}
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &slot.fence));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+		slot.state.store(Copying, std::memory_order_release);
+
+		return (waitSemaphore != VK_NULL_HANDLE) ? slot.semaphore : VK_NULL_HANDLE;
+	}
+
+	void FrameCapture::encode(Slot& slot)
+	{
+		VKS_PROFILE_ZONE("FrameCapture::encode");
+		if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+			VK_CHECK_RESULT(slot.buffer.invalidate());
+		}
+		const uint32_t width = slot.extent.width;
+		const uint32_t height = slot.extent.height;
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		const uint32_t* src = (const uint32_t*)slot.buffer.mapped;
+		uint32_t* dst = (uint32_t*)rgba.data();
+		const bool swizzle = slot.swizzle;
+		threadPool.parallelFor(height, [&](uint32_t begin, uint32_t end) {
+			convertPixels(src + (size_t)begin * width, dst + (size_t)begin * width, (size_t)(end - begin) * width, swizzle);
+		}, 16);
+		// The buffer's content has been converted, so the slot can already be reused while encoding
+		const std::string filename = slot.filename;
+		slot.state.store(Free, std::memory_order_release);
+
+		std::vector<uint8_t> encoded;
+		switch (getFormat(filename)) {
+		case Format::PNG:
+			encoded = encodePNG(rgba.data(), width, height);
+			break;
+		case Format::QOI:
+			encoded = encodeQOI(rgba.data(), width, height);
+			break;
+		case Format::PPM:
+		{
+			const std::string header = "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+			encoded.assign(header.begin(), header.end());
+			encoded.resize(header.size() + (size_t)width * height * 3);
+			uint8_t* rgb = encoded.data() + header.size();
+			for (size_t i = 0; i < (size_t)width * height; i++) {
+				rgb[i * 3 + 0] = rgba[i * 4 + 0];
+				rgb[i * 3 + 1] = rgba[i * 4 + 1];
+				rgb[i * 3 + 2] = rgba[i * 4 + 2];
+			}
+			break;
+		}
+		case Format::Raw:
+			encoded.swap(rgba);
+			break;
+		}
+
+		std::ofstream file(filename, std::ios::out | std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Could not write captured image \"" << filename << "\"" << std::endl;
+			return;
+		}
+		file.write((const char*)encoded.data(), encoded.size());
+		file.close();
+		if (onSaved) {
+			onSaved(filename);
+		}
+	}
+}
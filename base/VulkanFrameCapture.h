@@ -0,0 +1,101 @@
+/*
+* Vulkan frame capture
+*
+* Asynchronous readback of rendered images for screenshots and image sequences
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Copies images to a ring of persistently mapped host buffers and converts and writes them on worker threads
+	* @note The copy is submitted right after the frame's rendering and only read back once its fence has signaled, which usually is a few frames later, so capturing doesn't stall rendering
+	*/
+	class FrameCapture
+	{
+	public:
+		/** @brief File formats, chosen by the file name's extension (.png, .qoi, .ppm, anything else is written as raw RGBA) */
+		enum class Format { PNG, QOI, PPM, Raw };
+
+		/** @brief Called from a worker thread each time an image has been written to disk */
+		std::function<void(const std::string& filename)> onSaved;
+
+		~FrameCapture();
+
+		/**
+		* @brief Prepares capturing, the readback ring and the writer threads are created on the first capture
+		* @param queue Queue the copies are submitted to, must be the queue the captured images are rendered on
+		* @param ringSize Number of captures that can be in flight at the same time, capturing waits for the oldest one if all are in use
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t ringSize = 4);
+		/** @brief Waits for all captures to be written to disk and releases all resources */
+		void destroy();
+
+		/**
+		* @brief Records and submits the copy of a rendered image, only 8 bit RGBA and BGRA formats are supported
+		* @param image Image to capture, must be in the present layout and have been created with transfer source usage
+		* @param waitSemaphore Semaphore signaled once rendering to the image has finished (may be VK_NULL_HANDLE)
+		* @param filename Target file, if empty the next file name of the running image sequence is used
+		* @return Semaphore that has to be waited on instead of waitSemaphore before presenting the image (VK_NULL_HANDLE if waitSemaphore was VK_NULL_HANDLE or nothing was captured)
+		*/
+		VkSemaphore capture(VkImage image, VkFormat format, VkExtent2D extent, VkSemaphore waitSemaphore, const std::string& filename = "");
+		/** @brief Hands finished copies over to the worker threads, called by capture() but can be called once per frame to reduce latency */
+		void update();
+		/** @brief Waits until all submitted captures have been written to disk */
+		void flush();
+
+		/** @brief Starts capturing every frame to <directory>/frameXXXXXX.<extension> */
+		void startSequence(const std::string& directory, const std::string& extension = "qoi");
+		void stopSequence();
+		bool isCapturingSequence() const { return capturingSequence; }
+		bool isCreated() const { return device != nullptr; }
+
+		static Format getFormat(const std::string& filename);
+	private:
+		enum SlotState : uint32_t { Free, Copying, Encoding };
+		struct Slot {
+			vks::Buffer buffer;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			std::string filename;
+			VkExtent2D extent = { 0, 0 };
+			bool swizzle = false;
+			std::atomic<uint32_t> state{ Free };
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkMemoryPropertyFlags memoryPropertyFlags = 0;
+		std::vector<std::unique_ptr<Slot>> slots;
+		uint32_t ringSize = 0;
+		uint32_t nextSlot = 0;
+		vks::ThreadPool threadPool;
+
+		bool capturingSequence = false;
+		std::string sequenceDirectory;
+		std::string sequenceExtension;
+		uint32_t sequenceFrame = 0;
+
+		void prepareSlots();
+		void waitForSlot(Slot& slot);
+		void encode(Slot& slot);
+	};
+}
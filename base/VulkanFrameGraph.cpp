@@ -0,0 +1,839 @@
+/*
+* Vulkan frame graph
+*
+* Passes declare the attachments and images they read and write, the graph derives render passes, framebuffers
+* and pipeline barriers from these declarations, removes passes that don't contribute to the output and lets
+* transient attachments with non-overlapping lifetimes share the same device memory
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace vks
+{
+	namespace
+	{
+		bool isDepthStencilFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_S8_UINT:
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool isAttachmentAccess(FrameGraph::Access access)
+		{
+			return (access == FrameGraph::Access::ColorAttachment) || (access == FrameGraph::Access::DepthStencilAttachment) || (access == FrameGraph::Access::DepthStencilReadOnly);
+		}
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Only writes need to be made available to later accesses
+		VkAccessFlags writeAccessMask(VkAccessFlags accessMask)
+		{
+			return accessMask & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+		}
+	}
+
+	/*
+		Pass builder
+	*/
+
+	FrameGraph::Resource FrameGraph::PassBuilder::create(const std::string& name, const ImageDescription& description)
+	{
+		ResourceNode resource;
+		resource.name = name;
+		resource.description = description;
+		graph.resources.push_back(resource);
+		return static_cast<Resource>(graph.resources.size() - 1);
+	}
+
+	void FrameGraph::PassBuilder::writeColor(Resource resource, const VkClearColorValue* clearValue)
+	{
+		VkClearValue value{};
+		if (clearValue) {
+			value.color = *clearValue;
+		}
+		graph.addUse(pass, resource, Access::ColorAttachment, 0, clearValue ? &value : nullptr);
+	}
+
+	void FrameGraph::PassBuilder::writeDepthStencil(Resource resource, const VkClearDepthStencilValue* clearValue)
+	{
+		VkClearValue value{};
+		if (clearValue) {
+			value.depthStencil = *clearValue;
+		}
+		graph.addUse(pass, resource, Access::DepthStencilAttachment, 0, clearValue ? &value : nullptr);
+	}
+
+	void FrameGraph::PassBuilder::readDepthStencil(Resource resource)
+	{
+		graph.addUse(pass, resource, Access::DepthStencilReadOnly, 0, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::readTexture(Resource resource, VkPipelineStageFlags stages)
+	{
+		graph.addUse(pass, resource, Access::Sampled, stages, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::readStorage(Resource resource, VkPipelineStageFlags stages)
+	{
+		graph.addUse(pass, resource, Access::StorageRead, stages, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::writeStorage(Resource resource, VkPipelineStageFlags stages)
+	{
+		graph.addUse(pass, resource, Access::StorageWrite, stages, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::readTransfer(Resource resource)
+	{
+		graph.addUse(pass, resource, Access::TransferSrc, 0, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::writeTransfer(Resource resource)
+	{
+		graph.addUse(pass, resource, Access::TransferDst, 0, nullptr);
+	}
+
+	void FrameGraph::PassBuilder::setSideEffects()
+	{
+		graph.passes[pass].sideEffects = true;
+	}
+
+	/*
+		Frame graph
+	*/
+
+	FrameGraph::FrameGraph(vks::VulkanDevice* vulkanDevice) : vulkanDevice(vulkanDevice)
+	{
+		assert(vulkanDevice);
+	}
+
+	FrameGraph::~FrameGraph()
+	{
+		destroyVulkanObjects();
+	}
+
+	FrameGraph::AccessInfo FrameGraph::getAccessInfo(Access access, VkPipelineStageFlags stages)
+	{
+		AccessInfo info{};
+		switch (access) {
+		case Access::ColorAttachment:
+			info = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true };
+			break;
+		case Access::DepthStencilAttachment:
+			info = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true };
+			break;
+		case Access::DepthStencilReadOnly:
+			info = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, false };
+			break;
+		case Access::Sampled:
+			info = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stages, VK_ACCESS_SHADER_READ_BIT, false };
+			break;
+		case Access::StorageRead:
+			info = { VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT, false };
+			break;
+		case Access::StorageWrite:
+			info = { VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true };
+			break;
+		case Access::TransferSrc:
+			info = { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false };
+			break;
+		case Access::TransferDst:
+			info = { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true };
+			break;
+		}
+		return info;
+	}
+
+	void FrameGraph::addUse(Pass pass, Resource resource, Access access, VkPipelineStageFlags stages, const VkClearValue* clearValue)
+	{
+		assert(resource < resources.size());
+		assert(!compiled);
+		PassNode& passNode = passes[pass];
+		for (auto& use : passNode.uses) {
+			if (use.resource == resource) {
+				vks::tools::exitFatal("Frame graph pass \"" + passNode.name + "\" uses resource \"" + resources[resource].name + "\" more than once", -1);
+			}
+		}
+		ResourceUse use{};
+		use.resource = resource;
+		use.access = access;
+		use.stages = stages;
+		use.clear = (clearValue != nullptr);
+		if (clearValue) {
+			use.clearValue = *clearValue;
+		}
+		passNode.uses.push_back(use);
+		if (getAccessInfo(access, stages).write) {
+			resources[resource].writers.push_back(pass);
+		}
+	}
+
+	FrameGraph::Resource FrameGraph::importImage(const std::string& name, const ImageDescription& description, VkImage image, VkImageView view, VkImageLayout initialLayout, VkImageLayout finalLayout)
+	{
+		assert(!compiled);
+		ResourceNode resource;
+		resource.name = name;
+		resource.description = description;
+		resource.imported = true;
+		resource.image = image;
+		resource.view = view;
+		resource.initialLayout = initialLayout;
+		resource.finalLayout = finalLayout;
+		resources.push_back(resource);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	void FrameGraph::updateImport(Resource resource, VkImage image, VkImageView view)
+	{
+		assert(resources[resource].imported);
+		resources[resource].image = image;
+		resources[resource].view = view;
+	}
+
+	FrameGraph::Pass FrameGraph::addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const ExecuteFunction& execute)
+	{
+		assert(!compiled);
+		PassNode pass;
+		pass.name = name;
+		pass.execute = execute;
+		passes.push_back(pass);
+		const Pass handle = static_cast<Pass>(passes.size() - 1);
+		PassBuilder builder(*this, handle);
+		setup(builder);
+		return handle;
+	}
+
+	// Reference counting: a pass is culled if none of the resources it writes is read by another pass (or imported),
+	// which in turn can leave resources read by that pass without readers
+	// Resources are not versioned, so a resource that is read keeps all of its writers alive
+	void FrameGraph::cullPasses()
+	{
+		for (auto& resource : resources) {
+			resource.refCount = resource.imported ? 1 : 0;
+		}
+		for (auto& pass : passes) {
+			pass.culled = false;
+			pass.refCount = 0;
+			for (auto& use : pass.uses) {
+				if (getAccessInfo(use.access, use.stages).write) {
+					pass.refCount++;
+				} else {
+					resources[use.resource].refCount++;
+				}
+			}
+		}
+
+		std::vector<Pass> unreferencedPasses;
+		for (Pass i = 0; i < passes.size(); i++) {
+			if ((passes[i].refCount == 0) && !passes[i].sideEffects) {
+				unreferencedPasses.push_back(i);
+			}
+		}
+		std::vector<Resource> unreferencedResources;
+		for (Resource i = 0; i < resources.size(); i++) {
+			if (resources[i].refCount == 0) {
+				unreferencedResources.push_back(i);
+			}
+		}
+
+		while (!unreferencedPasses.empty() || !unreferencedResources.empty()) {
+			if (!unreferencedResources.empty()) {
+				const Resource resource = unreferencedResources.back();
+				unreferencedResources.pop_back();
+				for (Pass writer : resources[resource].writers) {
+					PassNode& pass = passes[writer];
+					if (pass.culled || (pass.refCount == 0)) {
+						continue;
+					}
+					if ((--pass.refCount == 0) && !pass.sideEffects) {
+						unreferencedPasses.push_back(writer);
+					}
+				}
+				continue;
+			}
+			const Pass passIndex = unreferencedPasses.back();
+			unreferencedPasses.pop_back();
+			PassNode& pass = passes[passIndex];
+			if (pass.culled) {
+				continue;
+			}
+			pass.culled = true;
+			for (auto& use : pass.uses) {
+				if (!getAccessInfo(use.access, use.stages).write && (--resources[use.resource].refCount == 0)) {
+					unreferencedResources.push_back(use.resource);
+				}
+			}
+		}
+	}
+
+	void FrameGraph::computeLifetimes()
+	{
+		for (auto& resource : resources) {
+			resource.firstPass = UINT32_MAX;
+			resource.lastPass = 0;
+		}
+		for (Pass i = 0; i < passes.size(); i++) {
+			if (passes[i].culled) {
+				continue;
+			}
+			for (auto& use : passes[i].uses) {
+				ResourceNode& resource = resources[use.resource];
+				resource.firstPass = std::min(resource.firstPass, i);
+				resource.lastPass = std::max(resource.lastPass, i);
+				resource.usage |= [](Access access) -> VkImageUsageFlags {
+					switch (access) {
+					case Access::ColorAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+					case Access::DepthStencilAttachment:
+					case Access::DepthStencilReadOnly: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+					case Access::Sampled: return VK_IMAGE_USAGE_SAMPLED_BIT;
+					case Access::StorageRead:
+					case Access::StorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+					case Access::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+					case Access::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+					}
+					return 0;
+				}(use.access);
+			}
+		}
+		for (auto& resource : resources) {
+			resource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			if (isDepthStencilFormat(resource.description.format)) {
+				resource.aspectMask = (resource.description.format == VK_FORMAT_S8_UINT) ? 0 : VK_IMAGE_ASPECT_DEPTH_BIT;
+				if (vks::tools::formatHasStencil(resource.description.format)) {
+					resource.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+				}
+			}
+		}
+	}
+
+	void FrameGraph::createImages()
+	{
+		for (auto& resource : resources) {
+			if (resource.imported || (resource.firstPass == UINT32_MAX)) {
+				continue;
+			}
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = resource.description.format;
+			imageCI.extent = { resource.description.width, resource.description.height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = resource.description.layerCount;
+			imageCI.samples = resource.description.samples;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = resource.usage | resource.description.usage;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCI, nullptr, &resource.image));
+			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, resource.image, &resource.memoryRequirements);
+			statistics.transientImageCount++;
+			statistics.requiredMemory += resource.memoryRequirements.size;
+		}
+	}
+
+	// Places transient images into shared memory blocks, images may overlap in memory if their lifetimes don't overlap
+	void FrameGraph::aliasMemory()
+	{
+		std::vector<Resource> order;
+		for (Resource i = 0; i < resources.size(); i++) {
+			if (!resources[i].imported && (resources[i].image != VK_NULL_HANDLE)) {
+				order.push_back(i);
+			}
+		}
+		// Placing large images first gives smaller images the chance to fill gaps
+		std::stable_sort(order.begin(), order.end(), [&](Resource a, Resource b) {
+			return resources[a].memoryRequirements.size > resources[b].memoryRequirements.size;
+		});
+
+		auto lifetimesOverlap = [&](const ResourceNode& a, const ResourceNode& b) {
+			return (a.firstPass <= b.lastPass) && (b.firstPass <= a.lastPass);
+		};
+		auto rangesOverlap = [](VkDeviceSize offsetA, VkDeviceSize sizeA, VkDeviceSize offsetB, VkDeviceSize sizeB) {
+			return (offsetA < offsetB + sizeB) && (offsetB < offsetA + sizeA);
+		};
+
+		for (Resource index : order) {
+			ResourceNode& resource = resources[index];
+			const VkMemoryRequirements& memReqs = resource.memoryRequirements;
+			uint32_t blockIndex = UINT32_MAX;
+			for (uint32_t i = 0; i < memoryBlocks.size(); i++) {
+				if (memoryBlocks[i].memoryTypeBits & memReqs.memoryTypeBits) {
+					blockIndex = i;
+					break;
+				}
+			}
+			if (blockIndex == UINT32_MAX) {
+				memoryBlocks.push_back(MemoryBlock());
+				blockIndex = static_cast<uint32_t>(memoryBlocks.size() - 1);
+			}
+			MemoryBlock& block = memoryBlocks[blockIndex];
+
+			// Candidate offsets are the start of the block and the end of every image already placed in it
+			std::vector<VkDeviceSize> candidates = { 0 };
+			for (Resource placed : block.resources) {
+				candidates.push_back(alignUp(resources[placed].memoryOffset + resources[placed].memoryRequirements.size, memReqs.alignment));
+			}
+			std::sort(candidates.begin(), candidates.end());
+			VkDeviceSize offset = 0;
+			for (VkDeviceSize candidate : candidates) {
+				bool fits = true;
+				for (Resource placed : block.resources) {
+					const ResourceNode& other = resources[placed];
+					if (lifetimesOverlap(resource, other) && rangesOverlap(candidate, memReqs.size, other.memoryOffset, other.memoryRequirements.size)) {
+						fits = false;
+						break;
+					}
+				}
+				if (fits) {
+					offset = candidate;
+					break;
+				}
+			}
+
+			resource.memoryBlock = blockIndex;
+			resource.memoryOffset = offset;
+			for (Resource placed : block.resources) {
+				const ResourceNode& other = resources[placed];
+				if (!lifetimesOverlap(resource, other) && rangesOverlap(offset, memReqs.size, other.memoryOffset, other.memoryRequirements.size)) {
+					if (other.lastPass < resource.firstPass) {
+						resource.aliasPredecessors.push_back(placed);
+						resources[placed].aliasSuccessors.push_back(index);
+					} else {
+						resources[placed].aliasPredecessors.push_back(index);
+						resource.aliasSuccessors.push_back(placed);
+					}
+				}
+			}
+			block.resources.push_back(index);
+			block.memoryTypeBits &= memReqs.memoryTypeBits;
+			block.size = std::max(block.size, offset + memReqs.size);
+		}
+
+		for (auto& block : memoryBlocks) {
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = block.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &block.memory));
+			statistics.allocatedMemory += block.size;
+		}
+
+		for (Resource index : order) {
+			ResourceNode& resource = resources[index];
+			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, resource.image, memoryBlocks[resource.memoryBlock].memory, resource.memoryOffset));
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = (resource.description.layerCount > 1) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = resource.description.format;
+			viewCI.subresourceRange = { resource.aspectMask, 0, 1, 0, resource.description.layerCount };
+			viewCI.image = resource.image;
+			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &viewCI, nullptr, &resource.view));
+		}
+
+		// Peak memory is the largest sum of transient image sizes alive during a single pass
+		for (Pass i = 0; i < passes.size(); i++) {
+			if (passes[i].culled) {
+				continue;
+			}
+			VkDeviceSize alive = 0;
+			for (Resource index : order) {
+				if ((resources[index].firstPass <= i) && (resources[index].lastPass >= i)) {
+					alive += resources[index].memoryRequirements.size;
+				}
+			}
+			statistics.peakMemory = std::max(statistics.peakMemory, alive);
+		}
+	}
+
+	void FrameGraph::createRenderPasses()
+	{
+		for (Pass p = 0; p < passes.size(); p++) {
+			PassNode& pass = passes[p];
+			if (pass.culled) {
+				continue;
+			}
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference{};
+			bool hasDepth = false;
+			// Color attachments come first, followed by an optional depth/stencil attachment
+			for (uint32_t depthPass = 0; depthPass < 2; depthPass++) {
+				for (auto& use : pass.uses) {
+					if (!isAttachmentAccess(use.access) || ((use.access == Access::ColorAttachment) == (depthPass == 1))) {
+						continue;
+					}
+					const ResourceNode& resource = resources[use.resource];
+					const AccessInfo info = getAccessInfo(use.access, 0);
+
+					// Contents need to be loaded if an earlier pass wrote them (or the imported image has defined contents)
+					bool hasContents = resource.imported && (resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+					for (Pass writer : resource.writers) {
+						hasContents |= (writer < p) && !passes[writer].culled;
+					}
+					bool usedLater = resource.imported || (resource.lastPass > p);
+
+					VkAttachmentDescription description{};
+					description.format = resource.description.format;
+					description.samples = resource.description.samples;
+					description.loadOp = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+					description.storeOp = usedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					const bool hasStencil = (resource.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+					description.stencilLoadOp = hasStencil ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+					description.stencilStoreOp = hasStencil ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					// Layout transitions are done by the barriers in front of the pass
+					description.initialLayout = info.layout;
+					description.finalLayout = info.layout;
+
+					const VkAttachmentReference reference = { static_cast<uint32_t>(attachmentDescriptions.size()), info.layout };
+					if (use.access == Access::ColorAttachment) {
+						colorReferences.push_back(reference);
+					} else {
+						assert(!hasDepth);
+						depthReference = reference;
+						hasDepth = true;
+					}
+					attachmentDescriptions.push_back(description);
+					pass.attachments.push_back(use.resource);
+					pass.clearValues.push_back(use.clearValue);
+					pass.extent = { resource.description.width, resource.description.height };
+				}
+			}
+			if (attachmentDescriptions.empty()) {
+				continue;
+			}
+
+			VkSubpassDescription subpassDescription{};
+			subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpassDescription.pColorAttachments = colorReferences.data();
+			subpassDescription.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+			renderPassCI.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+			renderPassCI.pAttachments = attachmentDescriptions.data();
+			renderPassCI.subpassCount = 1;
+			renderPassCI.pSubpasses = &subpassDescription;
+			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassCI, nullptr, &pass.renderPass));
+		}
+	}
+
+	// Tracks the layout, the last write and the stages that have read since then for every image through the pass order
+	// and inserts barriers only where needed: layout changes, writes, reads after a write and reads from stages that
+	// haven't been synchronized with the last write yet (e.g. a vertex shader read following a fragment shader read)
+	void FrameGraph::computeBarriers()
+	{
+		struct State {
+			VkImageLayout layout;
+			// Stages and accesses of the last write (or layout transition)
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccessMask;
+			// Stages that read the image since the last write, these are already synchronized with it
+			VkPipelineStageFlags readStages;
+			bool used;
+		};
+		std::vector<State> states(resources.size());
+		for (Resource i = 0; i < resources.size(); i++) {
+			const ResourceNode& resource = resources[i];
+			// Imported images may have been written by earlier work, e.g. before being handed to the graph
+			if (resource.imported) {
+				states[i] = { resource.initialLayout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT, 0, false };
+			} else {
+				states[i] = { VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, false };
+			}
+		}
+		// Barriers for the first use of each transient image, completed once the last use of all images is known
+		std::vector<std::pair<Pass, size_t>> firstUseBarriers(resources.size(), std::make_pair(UINT32_MAX, size_t(0)));
+
+		for (Pass p = 0; p < passes.size(); p++) {
+			PassNode& pass = passes[p];
+			if (pass.culled) {
+				continue;
+			}
+			for (auto& use : pass.uses) {
+				ResourceNode& resource = resources[use.resource];
+				State& state = states[use.resource];
+				const AccessInfo info = getAccessInfo(use.access, use.stages);
+				Barrier barrier{};
+				barrier.resource = use.resource;
+				barrier.newLayout = info.layout;
+				barrier.dstAccessMask = info.accessMask;
+				bool needsBarrier = false;
+				VkPipelineStageFlags srcStages = 0;
+				if (!state.used && !resource.imported) {
+					// First use of a transient image, contents are undefined but the memory may still be in use by an aliased image
+					needsBarrier = true;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					for (Resource predecessor : resource.aliasPredecessors) {
+						srcStages |= resources[predecessor].lastStages;
+						barrier.srcAccessMask |= writeAccessMask(resources[predecessor].lastAccessMask);
+					}
+					firstUseBarriers[use.resource] = std::make_pair(p, pass.barriers.size());
+				} else {
+					const bool layoutChange = (state.layout != info.layout) || !state.used;
+					// Reads in the same layout only need a barrier if they happen in stages that haven't waited for the last write yet
+					needsBarrier = layoutChange || info.write || ((info.stages & ~state.readStages) != 0);
+					barrier.oldLayout = state.layout;
+					// Writes and layout transitions also have to wait for all reads since the last write
+					srcStages = state.writeStages | state.readStages;
+					barrier.srcAccessMask = state.writeAccessMask;
+				}
+				if (needsBarrier) {
+					pass.barriers.push_back(barrier);
+					pass.srcStageMask |= srcStages;
+					pass.dstStageMask |= info.stages;
+					if (info.write) {
+						state.writeStages = info.stages;
+						state.writeAccessMask = writeAccessMask(info.accessMask);
+						state.readStages = 0;
+					} else if (barrier.oldLayout != barrier.newLayout) {
+						// The layout transition happens before the stages of this barrier, later barriers need to wait for those
+						state.readStages = info.stages;
+					} else {
+						state.readStages |= info.stages;
+					}
+					state.layout = info.layout;
+					state.used = true;
+				} else {
+					state.readStages |= info.stages;
+				}
+				resource.lastStages = state.writeStages | state.readStages;
+				resource.lastAccessMask = state.writeAccessMask;
+			}
+			statistics.barrierCount += static_cast<uint32_t>(pass.barriers.size());
+		}
+
+		// Transient images are reused by the next execution of the graph, so their first use also has to wait for the
+		// last use of the image itself and of images aliasing its memory later on in the previous execution
+		for (Resource i = 0; i < resources.size(); i++) {
+			const Pass p = firstUseBarriers[i].first;
+			if (p == UINT32_MAX) {
+				continue;
+			}
+			PassNode& pass = passes[p];
+			Barrier& barrier = pass.barriers[firstUseBarriers[i].second];
+			std::vector<Resource> previousUses = resources[i].aliasSuccessors;
+			previousUses.push_back(i);
+			for (Resource previous : previousUses) {
+				pass.srcStageMask |= resources[previous].lastStages;
+				barrier.srcAccessMask |= writeAccessMask(resources[previous].lastAccessMask);
+			}
+		}
+
+		// Transition imported images into the layout expected by the application
+		for (Resource i = 0; i < resources.size(); i++) {
+			const ResourceNode& resource = resources[i];
+			const State& state = states[i];
+			if (!resource.imported || !state.used || (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) || (resource.finalLayout == state.layout)) {
+				continue;
+			}
+			Barrier barrier{};
+			barrier.resource = i;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.finalLayout;
+			barrier.srcAccessMask = state.writeAccessMask;
+			barrier.dstAccessMask = 0;
+			finalBarriers.push_back(barrier);
+			finalSrcStageMask |= state.writeStages | state.readStages;
+		}
+		statistics.barrierCount += static_cast<uint32_t>(finalBarriers.size());
+	}
+
+	void FrameGraph::compile()
+	{
+		if (compiled) {
+			destroyVulkanObjects();
+		}
+		statistics = Statistics();
+		statistics.passCount = static_cast<uint32_t>(passes.size());
+		cullPasses();
+		for (auto& pass : passes) {
+			statistics.culledPassCount += pass.culled ? 1 : 0;
+		}
+		computeLifetimes();
+		createImages();
+		aliasMemory();
+		createRenderPasses();
+		computeBarriers();
+		compiled = true;
+	}
+
+	VkFramebuffer FrameGraph::getFramebuffer(PassNode& pass)
+	{
+		std::vector<VkImageView> views(pass.attachments.size());
+		for (size_t i = 0; i < pass.attachments.size(); i++) {
+			views[i] = resources[pass.attachments[i]].view;
+		}
+		// Imported attachments (e.g. swap chain images) change between frames, so framebuffers are cached per set of views
+		for (auto& cached : pass.framebuffers) {
+			if (cached.views == views) {
+				return cached.framebuffer;
+			}
+		}
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = pass.renderPass;
+		framebufferCI.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferCI.pAttachments = views.data();
+		framebufferCI.width = pass.extent.width;
+		framebufferCI.height = pass.extent.height;
+		framebufferCI.layers = 1;
+		CachedFramebuffer cached;
+		cached.views = views;
+		VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferCI, nullptr, &cached.framebuffer));
+		pass.framebuffers.push_back(cached);
+		return cached.framebuffer;
+	}
+
+	void FrameGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		assert(compiled);
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		auto recordBarriers = [&](const std::vector<Barrier>& barriers, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+			if (barriers.empty()) {
+				return;
+			}
+			imageBarriers.clear();
+			for (auto& barrier : barriers) {
+				const ResourceNode& resource = resources[barrier.resource];
+				VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+				imageBarrier.srcAccessMask = barrier.srcAccessMask;
+				imageBarrier.dstAccessMask = barrier.dstAccessMask;
+				imageBarrier.oldLayout = barrier.oldLayout;
+				imageBarrier.newLayout = barrier.newLayout;
+				imageBarrier.image = resource.image;
+				imageBarrier.subresourceRange = { resource.aspectMask, 0, 1, 0, resource.description.layerCount };
+				imageBarriers.push_back(imageBarrier);
+			}
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				srcStageMask ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				dstStageMask ? dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		};
+
+		for (auto& pass : passes) {
+			if (pass.culled) {
+				continue;
+			}
+			recordBarriers(pass.barriers, pass.srcStageMask, pass.dstStageMask);
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+				renderPassBeginInfo.renderPass = pass.renderPass;
+				renderPassBeginInfo.framebuffer = getFramebuffer(pass);
+				renderPassBeginInfo.renderArea.extent = pass.extent;
+				renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+				renderPassBeginInfo.pClearValues = pass.clearValues.data();
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				pass.execute(commandBuffer);
+				vkCmdEndRenderPass(commandBuffer);
+			} else {
+				pass.execute(commandBuffer);
+			}
+		}
+		recordBarriers(finalBarriers, finalSrcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	}
+
+	void FrameGraph::destroyVulkanObjects()
+	{
+		VkDevice device = vulkanDevice->logicalDevice;
+		for (auto& pass : passes) {
+			for (auto& cached : pass.framebuffers) {
+				vkDestroyFramebuffer(device, cached.framebuffer, nullptr);
+			}
+			pass.framebuffers.clear();
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				vkDestroyRenderPass(device, pass.renderPass, nullptr);
+				pass.renderPass = VK_NULL_HANDLE;
+			}
+			pass.attachments.clear();
+			pass.clearValues.clear();
+			pass.barriers.clear();
+			pass.srcStageMask = 0;
+			pass.dstStageMask = 0;
+		}
+		for (auto& resource : resources) {
+			if (resource.imported) {
+				continue;
+			}
+			if (resource.view != VK_NULL_HANDLE) {
+				vkDestroyImageView(device, resource.view, nullptr);
+				resource.view = VK_NULL_HANDLE;
+			}
+			if (resource.image != VK_NULL_HANDLE) {
+				vkDestroyImage(device, resource.image, nullptr);
+				resource.image = VK_NULL_HANDLE;
+			}
+			resource.aliasPredecessors.clear();
+			resource.aliasSuccessors.clear();
+			resource.usage = 0;
+		}
+		for (auto& block : memoryBlocks) {
+			vkFreeMemory(device, block.memory, nullptr);
+		}
+		memoryBlocks.clear();
+		finalBarriers.clear();
+		finalSrcStageMask = 0;
+		compiled = false;
+	}
+
+	void FrameGraph::reset()
+	{
+		destroyVulkanObjects();
+		passes.clear();
+		resources.clear();
+		statistics = Statistics();
+	}
+
+	VkRenderPass FrameGraph::getRenderPass(Pass pass) const
+	{
+		assert(compiled);
+		return passes[pass].renderPass;
+	}
+
+	bool FrameGraph::isCulled(Pass pass) const
+	{
+		return passes[pass].culled;
+	}
+
+	VkImage FrameGraph::getImage(Resource resource) const
+	{
+		return resources[resource].image;
+	}
+
+	VkImageView FrameGraph::getImageView(Resource resource) const
+	{
+		return resources[resource].view;
+	}
+
+	void FrameGraph::printStatistics() const
+	{
+		const double toMB = 1.0 / (1024.0 * 1024.0);
+		std::cout << "Frame graph: " << statistics.passCount << " passes (" << statistics.culledPassCount << " culled), " << statistics.barrierCount << " barriers\n";
+		for (auto& pass : passes) {
+			std::cout << "\t" << pass.name << (pass.culled ? " (culled)" : "") << "\n";
+		}
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Transient images: " << statistics.transientImageCount << "\n";
+		std::cout << "Memory required without aliasing: " << statistics.requiredMemory * toMB << " MB\n";
+		std::cout << "Memory allocated with aliasing: " << statistics.allocatedMemory * toMB << " MB\n";
+		std::cout << "Peak memory alive in a single pass: " << statistics.peakMemory * toMB << " MB" << std::endl;
+	}
+}
@@ -0,0 +1,237 @@
+/*
+* Vulkan frame graph
+*
+* Passes declare the attachments and images they read and write, the graph derives render passes, framebuffers
+* and pipeline barriers from these declarations, removes passes that don't contribute to the output and lets
+* transient attachments with non-overlapping lifetimes share the same device memory
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <iostream>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class FrameGraph
+	{
+	public:
+		/** @brief Handle of an image resource of the graph */
+		typedef uint32_t Resource;
+		/** @brief Handle of a pass of the graph */
+		typedef uint32_t Pass;
+
+		/** @brief Ways a pass can access an image, each maps to an image layout, pipeline stages and access flags */
+		enum class Access {
+			ColorAttachment,
+			DepthStencilAttachment,
+			DepthStencilReadOnly,
+			Sampled,
+			StorageRead,
+			StorageWrite,
+			TransferSrc,
+			TransferDst
+		};
+
+		/** @brief Describes an image created (or imported) by the graph */
+		struct ImageDescription {
+			uint32_t width;
+			uint32_t height;
+			VkFormat format;
+			/** @brief Additional usage flags, flags required by the declared accesses are added automatically */
+			VkImageUsageFlags usage = 0;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			uint32_t layerCount = 1;
+		};
+
+		/** @brief Statistics gathered during compilation */
+		struct Statistics {
+			uint32_t passCount = 0;
+			uint32_t culledPassCount = 0;
+			uint32_t transientImageCount = 0;
+			uint32_t barrierCount = 0;
+			/** @brief Memory required if every transient image had its own allocation */
+			VkDeviceSize requiredMemory = 0;
+			/** @brief Memory actually allocated for transient images after aliasing */
+			VkDeviceSize allocatedMemory = 0;
+			/** @brief Largest amount of transient image memory alive during any single pass */
+			VkDeviceSize peakMemory = 0;
+		};
+
+		/** @brief Used during pass setup to declare the resources a pass creates, reads and writes */
+		class PassBuilder
+		{
+		private:
+			friend class FrameGraph;
+			FrameGraph& graph;
+			Pass pass;
+			PassBuilder(FrameGraph& graph, Pass pass) : graph(graph), pass(pass) {}
+		public:
+			/** @brief Creates a transient image that only lives for the duration of the passes using it */
+			Resource create(const std::string& name, const ImageDescription& description);
+			/** @brief Writes a color attachment, optionally clearing it at the start of the pass */
+			void writeColor(Resource resource, const VkClearColorValue* clearValue = nullptr);
+			/** @brief Writes a depth/stencil attachment, optionally clearing it at the start of the pass */
+			void writeDepthStencil(Resource resource, const VkClearDepthStencilValue* clearValue = nullptr);
+			/** @brief Uses a depth/stencil attachment for depth testing without writing to it */
+			void readDepthStencil(Resource resource);
+			/** @brief Samples an image in the given shader stages */
+			void readTexture(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			/** @brief Reads a storage image in the given shader stages */
+			void readStorage(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			/** @brief Writes a storage image in the given shader stages */
+			void writeStorage(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			/** @brief Uses an image as the source of transfer commands */
+			void readTransfer(Resource resource);
+			/** @brief Uses an image as the destination of transfer commands */
+			void writeTransfer(Resource resource);
+			/** @brief Marks the pass as having side effects that are not visible to the graph, so it's never culled */
+			void setSideEffects();
+		};
+
+		/** @brief Called when the pass is executed, graphics passes are called inside their render pass */
+		typedef std::function<void(VkCommandBuffer)> ExecuteFunction;
+
+		FrameGraph(vks::VulkanDevice* vulkanDevice);
+		~FrameGraph();
+
+		/**
+		* @brief Imports an image owned by the application (e.g. a swap chain image)
+		* @param initialLayout Layout of the image before the graph is executed
+		* @param finalLayout Layout the image is transitioned to at the end of the graph
+		* @note Passes writing to imported images are never culled
+		*/
+		Resource importImage(const std::string& name, const ImageDescription& description, VkImage image, VkImageView view, VkImageLayout initialLayout, VkImageLayout finalLayout);
+		/** @brief Replaces the image of an imported resource, e.g. with the swap chain image of the current frame */
+		void updateImport(Resource resource, VkImage image, VkImageView view);
+
+		/**
+		* @brief Adds a pass to the graph, passes are executed in the order they have been added
+		* @param setup Called immediately to declare the resources of the pass
+		* @param execute Called when recording the graph, graphics passes (writing attachments) are executed inside their render pass
+		*/
+		Pass addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const ExecuteFunction& execute);
+
+		/** @brief Culls unused passes, creates and aliases transient images, and derives render passes, framebuffers and barriers */
+		void compile();
+		/** @brief Records all non-culled passes including their barriers into the given command buffer */
+		void execute(VkCommandBuffer commandBuffer);
+		/** @brief Destroys all Vulkan resources and removes all passes and resources, so the graph can be rebuilt (e.g. after a resize) */
+		void reset();
+
+		/** @brief Returns the render pass of a graphics pass, can be used for pipeline creation after the graph has been compiled */
+		VkRenderPass getRenderPass(Pass pass) const;
+		/** @brief Returns true if the pass has been removed during compilation */
+		bool isCulled(Pass pass) const;
+		VkImage getImage(Resource resource) const;
+		VkImageView getImageView(Resource resource) const;
+		const Statistics& getStatistics() const { return statistics; }
+		/** @brief Prints the pass order, culled passes and memory statistics to the console */
+		void printStatistics() const;
+
+	private:
+		struct AccessInfo {
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags accessMask;
+			bool write;
+		};
+		struct ResourceUse {
+			Resource resource;
+			Access access;
+			VkPipelineStageFlags stages;
+			bool clear;
+			VkClearValue clearValue;
+		};
+		struct Barrier {
+			Resource resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccessMask;
+			VkAccessFlags dstAccessMask;
+		};
+		struct CachedFramebuffer {
+			std::vector<VkImageView> views;
+			VkFramebuffer framebuffer;
+		};
+		struct PassNode {
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<ResourceUse> uses;
+			bool sideEffects = false;
+			bool culled = false;
+			uint32_t refCount = 0;
+			// Attachments in render pass order (color attachments first)
+			std::vector<Resource> attachments;
+			std::vector<VkClearValue> clearValues;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			std::vector<CachedFramebuffer> framebuffers;
+			VkExtent2D extent = {};
+			std::vector<Barrier> barriers;
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+		};
+		struct ResourceNode {
+			std::string name;
+			ImageDescription description;
+			bool imported = false;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageUsageFlags usage = 0;
+			VkImageAspectFlags aspectMask = 0;
+			std::vector<Pass> writers;
+			uint32_t refCount = 0;
+			// First and last non-culled pass using this resource
+			Pass firstPass = UINT32_MAX;
+			Pass lastPass = 0;
+			VkMemoryRequirements memoryRequirements = {};
+			uint32_t memoryBlock = UINT32_MAX;
+			VkDeviceSize memoryOffset = 0;
+			// Transient images that occupied overlapping memory before this one
+			std::vector<Resource> aliasPredecessors;
+			// Transient images that occupy overlapping memory after this one, their last use in the previous frame has to finish before this one is reused
+			std::vector<Resource> aliasSuccessors;
+			// State after the last use, used to synchronize with aliasing images
+			VkPipelineStageFlags lastStages = 0;
+			VkAccessFlags lastAccessMask = 0;
+		};
+		struct MemoryBlock {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = ~0u;
+			std::vector<Resource> resources;
+		};
+
+		vks::VulkanDevice* vulkanDevice;
+		std::vector<PassNode> passes;
+		std::vector<ResourceNode> resources;
+		std::vector<MemoryBlock> memoryBlocks;
+		std::vector<Barrier> finalBarriers;
+		VkPipelineStageFlags finalSrcStageMask = 0;
+		Statistics statistics;
+		bool compiled = false;
+
+		static AccessInfo getAccessInfo(Access access, VkPipelineStageFlags stages);
+		void addUse(Pass pass, Resource resource, Access access, VkPipelineStageFlags stages, const VkClearValue* clearValue);
+		void cullPasses();
+		void computeLifetimes();
+		void createImages();
+		void aliasMemory();
+		void createRenderPasses();
+		void computeBarriers();
+		VkFramebuffer getFramebuffer(PassNode& pass);
+		void destroyVulkanObjects();
+	};
+}
@@ -0,0 +1,178 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures the GPU time of named command buffer regions with timestamp queries
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanGpuProfiler.h"
+#include "VulkanDebug.h"
+
+namespace vks
+{
+	GpuProfiler::Scope::Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name) : profiler(&profiler), commandBuffer(commandBuffer)
+	{
+		query = profiler.beginScope(commandBuffer, name);
+	}
+
+	GpuProfiler::Scope::~Scope()
+	{
+		profiler->endScope(commandBuffer, query);
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+		destroy();
+	}
+
+	void GpuProfiler::create(vks::VulkanDevice* vulkanDevice, uint32_t maxScopesPerFrame)
+	{
+		destroy();
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		if ((validBits == 0) || (vulkanDevice->properties.limits.timestampPeriod == 0.0f)) {
+			return;
+		}
+		device = vulkanDevice->logicalDevice;
+		this->maxScopesPerFrame = maxScopesPerFrame;
+		validBitsMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+		timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+	}
+
+	void GpuProfiler::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& frame : frames) {
+			vkDestroyQueryPool(device, frame.queryPool, nullptr);
+		}
+		frames.clear();
+		recordingFrame = nullptr;
+		timings.clear();
+		timingIndices.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		if (frameIndex >= frames.size()) {
+			frames.resize(frameIndex + 1);
+		}
+		Frame& frame = frames[frameIndex];
+		if (frame.queryPool == VK_NULL_HANDLE) {
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = maxScopesPerFrame * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &frame.queryPool));
+		}
+		// Re-recording invalidates the results of the previous recording of this frame
+		frame.scopes.clear();
+		frame.depth = 0;
+		frame.pending = false;
+		vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, maxScopesPerFrame * 2);
+		recordingFrame = &frame;
+	}
+
+	uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+	{
+		if (vks::debugmarker::active) {
+			vks::debugmarker::beginRegion(commandBuffer, name, glm::vec4(1.0f));
+		}
+		if ((device == VK_NULL_HANDLE) || (recordingFrame == nullptr)) {
+			return UINT32_MAX;
+		}
+		// Scopes may be recorded from multiple threads (e.g. into secondary command buffers)
+		std::lock_guard<std::mutex> lock(mutex);
+		if (recordingFrame->scopes.size() >= maxScopesPerFrame) {
+			return UINT32_MAX;
+		}
+		auto it = timingIndices.find(name);
+		if (it == timingIndices.end()) {
+			ScopeTiming timing;
+			timing.name = name;
+			timing.depth = recordingFrame->depth;
+			it = timingIndices.insert({ name, static_cast<uint32_t>(timings.size()) }).first;
+			timings.push_back(timing);
+		}
+		const uint32_t query = static_cast<uint32_t>(recordingFrame->scopes.size()) * 2;
+		recordingFrame->scopes.push_back({ it->second, recordingFrame->depth });
+		recordingFrame->depth++;
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, recordingFrame->queryPool, query);
+		return query;
+	}
+
+	void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t query)
+	{
+		if (query != UINT32_MAX) {
+			std::lock_guard<std::mutex> lock(mutex);
+			recordingFrame->depth--;
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, recordingFrame->queryPool, query + 1);
+		}
+		if (vks::debugmarker::active) {
+			vks::debugmarker::endRegion(commandBuffer);
+		}
+	}
+
+	void GpuProfiler::submitted(uint32_t frameIndex)
+	{
+		if ((device == VK_NULL_HANDLE) || (frameIndex >= frames.size())) {
+			return;
+		}
+		frames[frameIndex].pending = !frames[frameIndex].scopes.empty();
+	}
+
+	void GpuProfiler::resolve()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		// Each query is returned as a pair of value and availability
+		std::vector<uint64_t> results;
+		std::vector<double> frameTimes(timings.size());
+		for (auto& frame : frames) {
+			if (!frame.pending) {
+				continue;
+			}
+			const uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+			results.resize(queryCount * 2);
+			VkResult result = vkGetQueryPoolResults(device, frame.queryPool, 0, queryCount, results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if (result == VK_NOT_READY) {
+				continue;
+			}
+			VK_CHECK_RESULT(result);
+			bool available = true;
+			for (uint32_t i = 0; i < queryCount; i++) {
+				available &= (results[i * 2 + 1] != 0);
+			}
+			if (!available) {
+				continue;
+			}
+			frame.pending = false;
+			std::fill(frameTimes.begin(), frameTimes.end(), -1.0);
+			for (size_t i = 0; i < frame.scopes.size(); i++) {
+				const uint64_t start = results[i * 4] & validBitsMask;
+				const uint64_t end = results[i * 4 + 2] & validBitsMask;
+				const double time = (double)((end - start) & validBitsMask) * timestampPeriod / 1000000.0;
+				double& frameTime = frameTimes[frame.scopes[i].timing];
+				frameTime = std::max(frameTime, 0.0) + time;
+			}
+			for (size_t i = 0; i < timings.size(); i++) {
+				if (frameTimes[i] < 0.0) {
+					continue;
+				}
+				timings[i].last = frameTimes[i];
+				timings[i].average = (timings[i].average == 0.0) ? frameTimes[i] : timings[i].average * 0.95 + frameTimes[i] * 0.05;
+				if (onResolved) {
+					onResolved(timings[i].name, frameTimes[i]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures the GPU time of named command buffer regions with timestamp queries
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Measures the GPU time of named scopes recorded into command buffers
+	* @note Each frame (e.g. each swap chain image's command buffer) owns its own query pool, results are read back once they are available without waiting on the GPU
+	*/
+	class GpuProfiler
+	{
+	public:
+		/** @brief Timing of all scopes with the same name, multiple scopes with the same name in a frame are summed up */
+		struct ScopeTiming {
+			std::string name;
+			/** @brief Nesting depth of the scope when it was first recorded */
+			uint32_t depth = 0;
+			/** @brief Time of the last resolved frame in ms */
+			double last = 0.0;
+			/** @brief Moving average in ms */
+			double average = 0.0;
+		};
+
+		/**
+		* @brief Writes timestamps at the start and end of its lifetime and marks the region for debugging tools
+		* @note Scopes must be recorded between GpuProfiler::beginFrame and the end of the command buffer
+		*/
+		class Scope
+		{
+		private:
+			GpuProfiler* profiler;
+			VkCommandBuffer commandBuffer;
+			uint32_t query;
+		public:
+			Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name);
+			~Scope();
+		};
+
+		/** @brief Called for every scope name with its summed GPU time in ms each time a frame has been resolved */
+		std::function<void(const std::string& name, double time)> onResolved;
+
+		~GpuProfiler();
+
+		/**
+		* @brief Prepares the profiler for use, does nothing if the graphics queue doesn't support timestamps
+		* @param maxScopesPerFrame Maximum number of scopes that can be recorded for a single frame
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t maxScopesPerFrame = 64);
+		void destroy();
+		/** @brief Returns true if timestamps are supported and scopes will be measured */
+		bool isEnabled() const { return device != VK_NULL_HANDLE; }
+
+		/**
+		* @brief Starts recording the scopes of a frame, resets the queries of the frame
+		* @param commandBuffer Command buffer the frame is recorded to, must be outside of a render pass
+		* @param frameIndex Index of the frame, the same index has to be passed to submitted() once the command buffer has been submitted
+		*/
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		/** @brief Marks the command buffer of a frame as submitted, so its results are resolved once available */
+		void submitted(uint32_t frameIndex);
+		/** @brief Reads back the results of all submitted frames whose queries are available, never waits for the GPU */
+		void resolve();
+
+		/** @brief Returns the timings of all scopes in the order they were first recorded */
+		const std::vector<ScopeTiming>& getTimings() const { return timings; }
+	private:
+		struct RecordedScope {
+			uint32_t timing;
+			uint32_t depth;
+		};
+		struct Frame {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::vector<RecordedScope> scopes;
+			uint32_t depth = 0;
+			bool pending = false;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t maxScopesPerFrame = 64;
+		uint64_t validBitsMask = 0;
+		float timestampPeriod = 1.0f;
+		std::vector<Frame> frames;
+		Frame* recordingFrame = nullptr;
+		std::vector<ScopeTiming> timings;
+		std::unordered_map<std::string, uint32_t> timingIndices;
+		std::mutex mutex;
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t query);
+	};
+}
@@ -12,6 +12,7 @@
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "VulkanBuffer.h"
+#include "VulkanKTXFile.h"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -76,29 +77,16 @@ namespace vks
 			assert(device);
 			assert(copyQueue != VK_NULL_HANDLE);
 
-			ktxResult result;
-			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-			free(textureData);
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
-			assert(result == KTX_SUCCESS);
-			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
-			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
-			dim = ktxTexture->baseWidth;
+			// Only the first level is used, so the file is mapped instead of loading all of its images
+			vks::KTXFile ktxFile;
+			bool fileMapped = ktxFile.open(filename);
+			assert(fileMapped);
+			ktx_size_t ktxSize = ktxFile.getImageSize(0);
+			dim = ktxFile.texture->baseWidth;
 			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, ktxImage, ktxSize);
+			memcpy(heightdata, ktxFile.getImageData(0), std::min((size_t)ktxSize, dim * dim * sizeof(uint16_t)));
 			this->scale = dim / patchsize;
-			ktxTexture_Destroy(ktxTexture);
+			ktxFile.close();
 
 			// Generate vertices
 			Vertex * vertices = new Vertex[patchsize * patchsize * 4];
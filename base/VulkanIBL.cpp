@@ -0,0 +1,820 @@
+/*
+* Vulkan image based lighting
+*
+* Generates the BRDF look-up table, irradiance and pre-filtered environment cube maps used for PBR and caches them on disk
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanIBL.h"
+
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		// Bump to invalidate all cached maps if the generation code changes
+		const uint64_t cacheVersion = 1;
+
+		// OpenGL enums for the KTX header of the formats used by the generator
+		struct GLFormat {
+			uint32_t type;
+			uint32_t typeSize;
+			uint32_t format;
+			uint32_t internalFormat;
+			uint32_t texelSize;
+		};
+
+		bool getGLFormat(VkFormat format, GLFormat& glFormat)
+		{
+			switch (format) {
+			case VK_FORMAT_R16G16_SFLOAT:
+				glFormat = { 0x140B /* GL_HALF_FLOAT */, 2, 0x8227 /* GL_RG */, 0x822F /* GL_RG16F */, 4 };
+				return true;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+				glFormat = { 0x140B /* GL_HALF_FLOAT */, 2, 0x1908 /* GL_RGBA */, 0x881A /* GL_RGBA16F */, 8 };
+				return true;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				glFormat = { 0x1406 /* GL_FLOAT */, 4, 0x1908 /* GL_RGBA */, 0x8814 /* GL_RGBA32F */, 16 };
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// View matrices for rendering the six cube map faces
+		const std::array<glm::mat4, 6>& getCubeFaceMatrices()
+		{
+			static const std::array<glm::mat4, 6> matrices = { {
+				// POSITIVE_X
+				glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+				// NEGATIVE_X
+				glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+				// POSITIVE_Y
+				glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+				// NEGATIVE_Y
+				glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+				// POSITIVE_Z
+				glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+				// NEGATIVE_Z
+				glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+			} };
+			return matrices;
+		}
+
+		// Render pass with a single color attachment that is transitioned to the given final layout
+		VkRenderPass createRenderPass(VkDevice device, VkFormat format, VkImageLayout finalLayout)
+		{
+			VkAttachmentDescription attDesc = {};
+			attDesc.format = format;
+			attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+			attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attDesc.finalLayout = finalLayout;
+			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpassDescription = {};
+			subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpassDescription.colorAttachmentCount = 1;
+			subpassDescription.pColorAttachments = &colorReference;
+
+			// Use subpass dependencies for layout transitions
+			std::array<VkSubpassDependency, 2> dependencies;
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+			renderPassCI.attachmentCount = 1;
+			renderPassCI.pAttachments = &attDesc;
+			renderPassCI.subpassCount = 1;
+			renderPassCI.pSubpasses = &subpassDescription;
+			renderPassCI.dependencyCount = 2;
+			renderPassCI.pDependencies = dependencies.data();
+			VkRenderPass renderPass;
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderPass));
+			return renderPass;
+		}
+
+		// Default state shared by all pipelines of the generator
+		VkPipeline createPipeline(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages, const VkPipelineVertexInputStateCreateInfo* vertexInputState)
+		{
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+			VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+			VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+			VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+			VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+			VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1);
+			VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+			std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+			VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
+			pipelineCI.pInputAssemblyState = &inputAssemblyState;
+			pipelineCI.pRasterizationState = &rasterizationState;
+			pipelineCI.pColorBlendState = &colorBlendState;
+			pipelineCI.pMultisampleState = &multisampleState;
+			pipelineCI.pViewportState = &viewportState;
+			pipelineCI.pDepthStencilState = &depthStencilState;
+			pipelineCI.pDynamicState = &dynamicState;
+			pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+			pipelineCI.pStages = shaderStages.data();
+			pipelineCI.pVertexInputState = vertexInputState;
+			VkPipeline pipeline;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+			return pipeline;
+		}
+
+		struct IrradiancePushBlock {
+			glm::mat4 mvp;
+			float deltaPhi;
+			float deltaTheta;
+		};
+
+		struct PrefilterPushBlock {
+			glm::mat4 mvp;
+			float roughness;
+			uint32_t numSamples;
+		};
+	}
+
+	IBLGenerator::IBLGenerator(vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath)
+		: vulkanDevice(device), device(device->logicalDevice), queue(queue), pipelineCache(pipelineCache), shadersPath(shadersPath)
+	{
+		cacheDirectory = getDefaultCacheDirectory();
+	}
+
+	std::string IBLGenerator::getDefaultCacheDirectory()
+	{
+#if defined(__ANDROID__)
+		return std::string(androidApp->activity->internalDataPath) + "/ibl_cache";
+#else
+		return "ibl_cache";
+#endif
+	}
+
+	uint64_t IBLGenerator::hashFile(const std::string& filename)
+	{
+		auto it = fileHashes.find(filename);
+		if (it != fileHashes.end()) {
+			return it->second;
+		}
+		std::vector<char> data;
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (asset) {
+			data.resize(AAsset_getLength(asset));
+			AAsset_read(asset, data.data(), data.size());
+			AAsset_close(asset);
+		}
+#else
+		std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+		if (is.is_open()) {
+			data.resize(static_cast<size_t>(is.tellg()));
+			is.seekg(0, std::ios::beg);
+			is.read(data.data(), data.size());
+		}
+#endif
+		const uint64_t result = tools::hash(data.data(), data.size());
+		fileHashes[filename] = result;
+		return result;
+	}
+
+	std::string IBLGenerator::getCacheFilename(const std::string& name, uint64_t key) const
+	{
+		char hex[17];
+		snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+		return cacheDirectory + "/" + name + "_" + hex + ".ktx";
+	}
+
+	VkPipelineShaderStageCreateInfo IBLGenerator::loadShader(const std::string& filename, VkShaderStageFlagBits stage)
+	{
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = stage;
+#if defined(__ANDROID__)
+		shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + filename).c_str(), device);
+#else
+		shaderStage.module = vks::tools::loadShader((shadersPath + filename).c_str(), device);
+#endif
+		shaderStage.pName = "main";
+		assert(shaderStage.module != VK_NULL_HANDLE);
+		return shaderStage;
+	}
+
+	void IBLGenerator::createTarget(vks::Texture& target, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers, VkImageUsageFlags usage)
+	{
+		// Image
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent.width = dim;
+		imageCI.extent.height = dim;
+		imageCI.extent.depth = 1;
+		imageCI.mipLevels = mipLevels;
+		imageCI.arrayLayers = layers;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer source is required for storing the image in the cache, transfer destination for loading it
+		imageCI.usage = usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.flags = (layers == 6) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &target.image));
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, target.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &target.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, target.image, target.deviceMemory, 0));
+		// Image view
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = (layers == 6) ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = {};
+		viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCI.subresourceRange.levelCount = mipLevels;
+		viewCI.subresourceRange.layerCount = layers;
+		viewCI.image = target.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &target.view));
+		// Sampler
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		target.sampler = vulkanDevice->samplerCache.acquire(samplerCI);
+
+		target.width = dim;
+		target.height = dim;
+		target.mipLevels = mipLevels;
+		target.layerCount = layers;
+		target.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		target.device = vulkanDevice;
+		target.updateDescriptor();
+	}
+
+	bool IBLGenerator::loadFromCache(vks::Texture& target, const std::string& filename, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers)
+	{
+		if (cacheDirectory.empty() || !vks::tools::fileExists(filename)) {
+			return false;
+		}
+		ktxTexture* ktxTexture;
+		if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+			return false;
+		}
+		// Files that don't match the expected layout (e.g. partially written ones) are regenerated
+		GLFormat glFormat;
+		getGLFormat(format, glFormat);
+		VkDeviceSize expectedSize = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			const VkDeviceSize mipDim = std::max(dim >> i, 1u);
+			expectedSize += mipDim * mipDim * glFormat.texelSize * layers;
+		}
+		if ((ktxTexture->baseWidth != dim) || (ktxTexture->baseHeight != dim) || (ktxTexture->numLevels != mipLevels) || (ktxTexture->numFaces * ktxTexture->numLayers != layers) || (ktxTexture_GetSize(ktxTexture) != expectedSize)) {
+			ktxTexture_Destroy(ktxTexture);
+			return false;
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			ktxTexture_GetSize(ktxTexture),
+			ktxTexture_GetData(ktxTexture)));
+
+		// Setup buffer copy regions for each face including all of its mip levels
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t layer = 0; layer < layers; layer++) {
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				ktx_size_t offset;
+				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, 0, layer, &offset);
+				assert(result == KTX_SUCCESS);
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(dim >> level, 1u);
+				bufferCopyRegion.imageExtent.height = std::max(dim >> level, 1u);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = offset;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+			}
+		}
+		ktxTexture_Destroy(ktxTexture);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = layers;
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, target.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+		return true;
+	}
+
+	void IBLGenerator::storeToCache(vks::Texture& target, const std::string& filename, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers)
+	{
+		if (cacheDirectory.empty()) {
+			return;
+		}
+		GLFormat glFormat;
+		if (!getGLFormat(format, glFormat)) {
+			std::cerr << "IBL cache: Unsupported format " << format << std::endl;
+			return;
+		}
+		if (!tools::createDirectory(cacheDirectory)) {
+			std::cerr << "IBL cache: Could not create " << cacheDirectory << ", maps won't be cached" << std::endl;
+			cacheDirectory.clear();
+			return;
+		}
+
+		// Read back all mip levels and faces in KTX order (faces of a mip level are stored consecutively)
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t mipDim = std::max(dim >> level, 1u);
+			for (uint32_t layer = 0; layer < layers; layer++) {
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent = { mipDim, mipDim, 1 };
+				bufferCopyRegion.bufferOffset = size;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+				size += (VkDeviceSize)mipDim * mipDim * glFormat.texelSize;
+			}
+		}
+
+		vks::Buffer readbackBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&readbackBuffer,
+			size));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = layers;
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, target.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		vkCmdCopyImageToBuffer(copyCmd, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		// Make the transfer writes visible to the host
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = readbackBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		vks::KTXFile::ImageInfo info;
+		info.glType = glFormat.type;
+		info.glTypeSize = glFormat.typeSize;
+		info.glFormat = glFormat.format;
+		info.glInternalFormat = glFormat.internalFormat;
+		info.glBaseInternalFormat = glFormat.format;
+		info.width = dim;
+		info.height = dim;
+		info.faces = layers;
+		info.mipLevels = mipLevels;
+		std::vector<size_t> imageSizes;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t mipDim = std::max(dim >> level, 1u);
+			imageSizes.push_back((size_t)mipDim * mipDim * glFormat.texelSize);
+		}
+
+		VK_CHECK_RESULT(readbackBuffer.map());
+		if (!vks::KTXFile::write(filename, info, imageSizes, static_cast<const uint8_t*>(readbackBuffer.mapped))) {
+			std::cerr << "IBL cache: Could not write " << filename << std::endl;
+		}
+		readbackBuffer.unmap();
+		readbackBuffer.destroy();
+	}
+
+	void IBLGenerator::generateBRDFLUT(vks::Texture2D& target)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
+		const uint32_t dim = settings.lutDim;
+
+		createTarget(target, format, dim, 1, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		uint64_t key = tools::hashValue(cacheVersion, format);
+		key = tools::hashValue(key, dim);
+		key = tools::hashValue(key, hashFile(shadersPath + "genbrdflut.frag.spv"));
+		const std::string cacheFilename = getCacheFilename("brdflut", key);
+		if (loadFromCache(target, cacheFilename, format, dim, 1, 1)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading BRDF LUT from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
+		VkRenderPass renderpass = createRenderPass(device, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = renderpass;
+		framebufferCI.attachmentCount = 1;
+		framebufferCI.pAttachments = &target.view;
+		framebufferCI.width = dim;
+		framebufferCI.height = dim;
+		framebufferCI.layers = 1;
+		VkFramebuffer framebuffer;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &framebuffer));
+
+		// Pipeline layout
+		VkPipelineLayout pipelinelayout;
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(nullptr, 0);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
+
+		// Look-up-table (from BRDF) pipeline
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+			loadShader("genbrdflut.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader("genbrdflut.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		VkPipeline pipeline = createPipeline(device, pipelineCache, pipelinelayout, renderpass, shaderStages, &emptyInputState);
+
+		// Render
+		VkClearValue clearValues[1];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderpass;
+		renderPassBeginInfo.renderArea.extent.width = dim;
+		renderPassBeginInfo.renderArea.extent.height = dim;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = framebuffer;
+
+		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)dim, (float)dim, 0.0f, 1.0f);
+		VkRect2D scissor = vks::initializers::rect2D(dim, dim, 0, 0);
+		vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+		vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+		vkCmdEndRenderPass(cmdBuf);
+		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
+
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+		vkDestroyRenderPass(device, renderpass, nullptr);
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+		for (auto& shaderStage : shaderStages) {
+			vkDestroyShaderModule(device, shaderStage.module, nullptr);
+		}
+
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+
+		storeToCache(target, cacheFilename, format, dim, 1, 1);
+	}
+
+	// Renders the environment cube with the given fragment shader into each face and mip level of the target
+	template<typename PushBlock>
+	void IBLGenerator::renderCube(vks::TextureCubeMap& target, VkFormat format, uint32_t dim, vks::TextureCubeMap& environmentCube, vkglTF::Model& skybox, const std::string& fragmentShader, PushBlock& pushBlock, std::function<void(uint32_t mipLevel, uint32_t mipLevels)> onMipLevel)
+	{
+		const uint32_t numMips = target.mipLevels;
+
+		VkRenderPass renderpass = createRenderPass(device, format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		struct {
+			VkImage image;
+			VkImageView view;
+			VkDeviceMemory memory;
+			VkFramebuffer framebuffer;
+		} offscreen;
+
+		// Offscreen framebuffer
+		{
+			// Color attachment
+			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = format;
+			imageCreateInfo.extent.width = dim;
+			imageCreateInfo.extent.height = dim;
+			imageCreateInfo.extent.depth = 1;
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen.image));
+
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.memory, 0));
+
+			VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
+			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			colorImageView.format = format;
+			colorImageView.flags = 0;
+			colorImageView.subresourceRange = {};
+			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			colorImageView.subresourceRange.baseMipLevel = 0;
+			colorImageView.subresourceRange.levelCount = 1;
+			colorImageView.subresourceRange.baseArrayLayer = 0;
+			colorImageView.subresourceRange.layerCount = 1;
+			colorImageView.image = offscreen.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreen.view));
+
+			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+			fbufCreateInfo.renderPass = renderpass;
+			fbufCreateInfo.attachmentCount = 1;
+			fbufCreateInfo.pAttachments = &offscreen.view;
+			fbufCreateInfo.width = dim;
+			fbufCreateInfo.height = dim;
+			fbufCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreen.framebuffer));
+
+			VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vks::tools::setImageLayout(
+				layoutCmd,
+				offscreen.image,
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+		}
+
+		// Descriptors
+		VkDescriptorSetLayout descriptorsetlayout;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorsetlayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorsetlayoutCI, nullptr, &descriptorsetlayout));
+
+		// Descriptor Pool
+		std::vector<VkDescriptorPoolSize> poolSizes = { vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1) };
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPool descriptorpool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorpool));
+
+		// Descriptor sets
+		VkDescriptorSet descriptorset;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorpool, &descriptorsetlayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorset));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorset, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &environmentCube.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		// Pipeline layout
+		VkPipelineLayout pipelinelayout;
+		std::vector<VkPushConstantRange> pushConstantRanges = {
+			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
+		};
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorsetlayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
+
+		// Pipeline
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+			loadShader("filtercube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(fragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		VkPipeline pipeline = createPipeline(device, pipelineCache, pipelinelayout, renderpass, shaderStages, vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV }));
+
+		// Render
+		VkClearValue clearValues[1];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderpass;
+		renderPassBeginInfo.framebuffer = offscreen.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = dim;
+		renderPassBeginInfo.renderArea.extent.height = dim;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		const std::array<glm::mat4, 6>& matrices = getCubeFaceMatrices();
+
+		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkViewport viewport = vks::initializers::viewport((float)dim, (float)dim, 0.0f, 1.0f);
+		VkRect2D scissor = vks::initializers::rect2D(dim, dim, 0, 0);
+
+		vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+		vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = numMips;
+		subresourceRange.layerCount = 6;
+
+		// Change image layout for all cubemap faces to transfer destination
+		vks::tools::setImageLayout(
+			cmdBuf,
+			target.image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
+
+		for (uint32_t m = 0; m < numMips; m++) {
+			onMipLevel(m, numMips);
+			for (uint32_t f = 0; f < 6; f++) {
+				viewport.width = static_cast<float>(dim * std::pow(0.5f, m));
+				viewport.height = static_cast<float>(dim * std::pow(0.5f, m));
+				vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+
+				// Render scene from cube face's point of view
+				vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+				// Update shader push constant block
+				pushBlock.mvp = glm::perspective((float)(M_PI / 2.0), 1.0f, 0.1f, 512.0f) * matrices[f];
+
+				vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushBlock), &pushBlock);
+
+				vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelinelayout, 0, 1, &descriptorset, 0, NULL);
+
+				skybox.draw(cmdBuf);
+
+				vkCmdEndRenderPass(cmdBuf);
+
+				vks::tools::setImageLayout(
+					cmdBuf,
+					offscreen.image,
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+				// Copy region for transfer from framebuffer to cube face
+				VkImageCopy copyRegion = {};
+
+				copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				copyRegion.srcSubresource.baseArrayLayer = 0;
+				copyRegion.srcSubresource.mipLevel = 0;
+				copyRegion.srcSubresource.layerCount = 1;
+				copyRegion.srcOffset = { 0, 0, 0 };
+
+				copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				copyRegion.dstSubresource.baseArrayLayer = f;
+				copyRegion.dstSubresource.mipLevel = m;
+				copyRegion.dstSubresource.layerCount = 1;
+				copyRegion.dstOffset = { 0, 0, 0 };
+
+				copyRegion.extent.width = static_cast<uint32_t>(viewport.width);
+				copyRegion.extent.height = static_cast<uint32_t>(viewport.height);
+				copyRegion.extent.depth = 1;
+
+				vkCmdCopyImage(
+					cmdBuf,
+					offscreen.image,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					target.image,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1,
+					&copyRegion);
+
+				// Transform framebuffer color attachment back
+				vks::tools::setImageLayout(
+					cmdBuf,
+					offscreen.image,
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			}
+		}
+
+		vks::tools::setImageLayout(
+			cmdBuf,
+			target.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			subresourceRange);
+
+		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
+
+		vkDestroyRenderPass(device, renderpass, nullptr);
+		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
+		vkFreeMemory(device, offscreen.memory, nullptr);
+		vkDestroyImageView(device, offscreen.view, nullptr);
+		vkDestroyImage(device, offscreen.image, nullptr);
+		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+		for (auto& shaderStage : shaderStages) {
+			vkDestroyShaderModule(device, shaderStage.module, nullptr);
+		}
+	}
+
+	void IBLGenerator::generateIrradianceCube(vks::TextureCubeMap& target, vks::TextureCubeMap& environmentCube, const std::string& environmentFile, vkglTF::Model& skybox)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		const uint32_t dim = settings.irradianceDim;
+		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
+
+		createTarget(target, format, dim, numMips, 6, VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		uint64_t key = tools::hashValue(cacheVersion, format);
+		key = tools::hashValue(key, dim);
+		key = tools::hashValue(key, settings.irradianceDeltaPhi);
+		key = tools::hashValue(key, settings.irradianceDeltaTheta);
+		key = tools::hashValue(key, hashFile(environmentFile));
+		key = tools::hashValue(key, hashFile(shadersPath + "irradiancecube.frag.spv"));
+		const std::string cacheFilename = getCacheFilename("irradiance", key);
+		if (loadFromCache(target, cacheFilename, format, dim, numMips, 6)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading irradiance cube from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
+		IrradiancePushBlock pushBlock;
+		pushBlock.deltaPhi = settings.irradianceDeltaPhi;
+		pushBlock.deltaTheta = settings.irradianceDeltaTheta;
+		renderCube(target, format, dim, environmentCube, skybox, "irradiancecube.frag.spv", pushBlock, [](uint32_t, uint32_t) {});
+
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+
+		storeToCache(target, cacheFilename, format, dim, numMips, 6);
+	}
+
+	// See https://placeholderart.wordpress.com/2015/07/28/implementation-notes-runtime-environment-map-filtering-for-image-based-lighting/
+	void IBLGenerator::generatePrefilteredCube(vks::TextureCubeMap& target, vks::TextureCubeMap& environmentCube, const std::string& environmentFile, vkglTF::Model& skybox)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		const uint32_t dim = settings.prefilteredDim;
+		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
+
+		createTarget(target, format, dim, numMips, 6, VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		uint64_t key = tools::hashValue(cacheVersion, format);
+		key = tools::hashValue(key, dim);
+		key = tools::hashValue(key, settings.prefilterSamples);
+		key = tools::hashValue(key, hashFile(environmentFile));
+		key = tools::hashValue(key, hashFile(shadersPath + "prefilterenvmap.frag.spv"));
+		const std::string cacheFilename = getCacheFilename("prefiltered", key);
+		if (loadFromCache(target, cacheFilename, format, dim, numMips, 6)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading pre-filtered environment cube from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
+		PrefilterPushBlock pushBlock;
+		pushBlock.numSamples = settings.prefilterSamples;
+		renderCube(target, format, dim, environmentCube, skybox, "prefilterenvmap.frag.spv", pushBlock, [&pushBlock](uint32_t mipLevel, uint32_t mipLevels) {
+			pushBlock.roughness = (float)mipLevel / (float)(mipLevels - 1);
+		});
+
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+
+		storeToCache(target, cacheFilename, format, dim, numMips, 6);
+	}
+}
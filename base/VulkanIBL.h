@@ -0,0 +1,83 @@
+/*
+* Vulkan image based lighting
+*
+* Generates the BRDF look-up table, irradiance and pre-filtered environment cube maps used for PBR and caches them on disk
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+#include "VulkanglTFModel.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Precomputes the image based lighting maps and stores them as KTX files so they only need to be generated once
+	* @note Cached files are keyed by a hash of the environment map's file, the generation parameters and the shaders, so changing any of them regenerates the maps
+	*/
+	class IBLGenerator
+	{
+	public:
+		struct Settings {
+			uint32_t lutDim = 512;
+			uint32_t irradianceDim = 64;
+			uint32_t prefilteredDim = 512;
+			/** @brief Sampling deltas of the irradiance convolution */
+			float irradianceDeltaPhi = (2.0f * float(M_PI)) / 180.0f;
+			float irradianceDeltaTheta = (0.5f * float(M_PI)) / 64.0f;
+			/** @brief Number of samples per pixel for the pre-filtered cube */
+			uint32_t prefilterSamples = 32;
+		} settings;
+
+		/** @brief Directory the generated maps are stored in, caching is disabled if empty */
+		std::string cacheDirectory;
+
+		/**
+		* @param shadersPath Directory containing the filtercube, irradiancecube, prefilterenvmap and genbrdflut shaders (including the trailing slash)
+		*/
+		IBLGenerator(vks::VulkanDevice* device, VkQueue queue, VkPipelineCache pipelineCache, const std::string& shadersPath);
+
+		/** @brief Generates (or loads) the 2D BRDF look-up table */
+		void generateBRDFLUT(vks::Texture2D& target);
+		/**
+		* @brief Generates (or loads) the irradiance cube map by convoluting the environment cube map
+		* @param environmentFile File the environment cube was loaded from, used to identify cached maps
+		* @param skybox Cube model the environment is rendered with
+		*/
+		void generateIrradianceCube(vks::TextureCubeMap& target, vks::TextureCubeMap& environmentCube, const std::string& environmentFile, vkglTF::Model& skybox);
+		/** @brief Generates (or loads) the pre-filtered environment cube map with increasing roughness per mip level */
+		void generatePrefilteredCube(vks::TextureCubeMap& target, vks::TextureCubeMap& environmentCube, const std::string& environmentFile, vkglTF::Model& skybox);
+
+		/** @brief Returns the default cache directory of the platform */
+		static std::string getDefaultCacheDirectory();
+	private:
+		vks::VulkanDevice* vulkanDevice;
+		VkDevice device;
+		VkQueue queue;
+		VkPipelineCache pipelineCache;
+		std::string shadersPath;
+		// Hashes of already hashed files
+		std::unordered_map<std::string, uint64_t> fileHashes;
+
+		uint64_t hashFile(const std::string& filename);
+		std::string getCacheFilename(const std::string& name, uint64_t key) const;
+		VkPipelineShaderStageCreateInfo loadShader(const std::string& filename, VkShaderStageFlagBits stage);
+		void createTarget(vks::Texture& target, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers, VkImageUsageFlags usage);
+		bool loadFromCache(vks::Texture& target, const std::string& filename, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers);
+		void storeToCache(vks::Texture& target, const std::string& filename, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t layers);
+		template<typename PushBlock>
+		void renderCube(vks::TextureCubeMap& target, VkFormat format, uint32_t dim, vks::TextureCubeMap& environmentCube, vkglTF::Model& skybox, const std::string& fragmentShader, PushBlock& pushBlock, std::function<void(uint32_t mipLevel, uint32_t mipLevels)> onMipLevel);
+	};
+}
@@ -66,6 +66,19 @@ namespace vks
 			return cmdBufferInheritanceInfo;
 		}
 
+		inline VkCommandBufferInheritanceInfo commandBufferInheritanceInfo(
+			VkRenderPass renderPass,
+			uint32_t subpass,
+			VkFramebuffer framebuffer = VK_NULL_HANDLE)
+		{
+			VkCommandBufferInheritanceInfo cmdBufferInheritanceInfo {};
+			cmdBufferInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			cmdBufferInheritanceInfo.renderPass = renderPass;
+			cmdBufferInheritanceInfo.subpass = subpass;
+			cmdBufferInheritanceInfo.framebuffer = framebuffer;
+			return cmdBufferInheritanceInfo;
+		}
+
 		inline VkRenderPassBeginInfo renderPassBeginInfo()
 		{
 			VkRenderPassBeginInfo renderPassBeginInfo {};
@@ -0,0 +1,274 @@
+/*
+* Memory mapped KTX file
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanKTXFile.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__ANDROID__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Images larger than this are split into multiple chunks when copying in parallel
+		const size_t copyChunkSize = 4 * 1024 * 1024;
+
+		struct CopyRange {
+			uint8_t* dst;
+			const uint8_t* src;
+			size_t size;
+		};
+
+		size_t align4(size_t value)
+		{
+			return (value + 3) & ~(size_t)3;
+		}
+	}
+
+	KTXFile::~KTXFile()
+	{
+		close();
+	}
+
+	bool KTXFile::open(const std::string& filename)
+	{
+		close();
+#if defined(__ANDROID__)
+		// Uncompressed assets are mapped directly, compressed ones are decompressed into memory owned by the asset
+		asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+		if (!asset) {
+			return false;
+		}
+		data = (const uint8_t*)AAsset_getBuffer(asset);
+		size = (size_t)AAsset_getLength(asset);
+#elif defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		fileHandle = file;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+		size = (size_t)fileSize.QuadPart;
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mappingHandle) {
+			close();
+			return false;
+		}
+		data = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		size = (size_t)fileStat.st_size;
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps the file referenced
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			size = 0;
+			return false;
+		}
+		// Images are read front to back, so let the kernel read ahead
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		data = (const uint8_t*)mapping;
+#endif
+		if (!data) {
+			close();
+			return false;
+		}
+
+		// Without the load image data flag, libktx only reads the header and the key/value data
+		if (ktxTexture_CreateFromMemory(data, size, KTX_TEXTURE_CREATE_NO_FLAGS, &texture) != KTX_SUCCESS) {
+			texture = nullptr;
+			close();
+			return false;
+		}
+
+		// Each level starts with its image size, non-array cube map faces are padded to four bytes and each level is padded to four bytes
+		uint32_t bytesOfKeyValueData;
+		memcpy(&bytesOfKeyValueData, data + 60, sizeof(uint32_t));
+		size_t offset = 64 + (size_t)bytesOfKeyValueData;
+		const bool paddedFaces = texture->isCubemap && !texture->isArray;
+		for (uint32_t level = 0; level < texture->numLevels; level++) {
+			const size_t imageSize = ktxTexture_GetImageSize(texture, level);
+			const size_t imageStride = paddedFaces ? align4(imageSize) : imageSize;
+			levelOffsets.push_back(offset + sizeof(uint32_t));
+			imageStrides.push_back(imageStride);
+			offset += sizeof(uint32_t) + align4(imageStride * texture->numLayers * getFaceSliceCount(level));
+			if (offset > size) {
+				close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void KTXFile::close()
+	{
+		if (texture) {
+			ktxTexture_Destroy(texture);
+			texture = nullptr;
+		}
+		levelOffsets.clear();
+		imageStrides.clear();
+#if defined(__ANDROID__)
+		if (asset) {
+			AAsset_close(asset);
+			asset = nullptr;
+		}
+#elif defined(_WIN32)
+		if (data) {
+			UnmapViewOfFile(data);
+		}
+		if (mappingHandle) {
+			CloseHandle(mappingHandle);
+			mappingHandle = nullptr;
+		}
+		if (fileHandle) {
+			CloseHandle(fileHandle);
+			fileHandle = nullptr;
+		}
+#else
+		if (data) {
+			munmap((void*)data, size);
+		}
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	uint32_t KTXFile::getFaceSliceCount(uint32_t level) const
+	{
+		return texture->isCubemap ? texture->numFaces : std::max(1u, texture->baseDepth >> level);
+	}
+
+	const uint8_t* KTXFile::getImageData(uint32_t level, uint32_t layer, uint32_t faceSlice) const
+	{
+		assert(texture && level < texture->numLevels && layer < texture->numLayers && faceSlice < getFaceSliceCount(level));
+		return data + levelOffsets[level] + (layer * getFaceSliceCount(level) + faceSlice) * imageStrides[level];
+	}
+
+	size_t KTXFile::getImageSize(uint32_t level) const
+	{
+		return ktxTexture_GetImageSize(texture, level);
+	}
+
+	size_t KTXFile::getDataSize() const
+	{
+		return ktxTexture_GetSize(texture);
+	}
+
+	void KTXFile::copyImages(void* dst, vks::ThreadPool* threadPool) const
+	{
+		assert(texture);
+		std::vector<CopyRange> ranges;
+		for (uint32_t level = 0; level < texture->numLevels; level++) {
+			const size_t imageSize = getImageSize(level);
+			for (uint32_t layer = 0; layer < texture->numLayers; layer++) {
+				for (uint32_t faceSlice = 0; faceSlice < getFaceSliceCount(level); faceSlice++) {
+					ktx_size_t dstOffset;
+					ktxTexture_GetImageOffset(texture, level, layer, faceSlice, &dstOffset);
+					const uint8_t* src = getImageData(level, layer, faceSlice);
+					for (size_t offset = 0; offset < imageSize; offset += copyChunkSize) {
+						ranges.push_back({ (uint8_t*)dst + dstOffset + offset, src + offset, std::min(copyChunkSize, imageSize - offset) });
+					}
+				}
+			}
+		}
+		auto copyRanges = [&ranges](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				memcpy(ranges[i].dst, ranges[i].src, ranges[i].size);
+			}
+		};
+		if (threadPool && threadPool->getThreadCount() > 1) {
+			threadPool->parallelFor(static_cast<uint32_t>(ranges.size()), copyRanges);
+		} else {
+			copyRanges(0, static_cast<uint32_t>(ranges.size()));
+		}
+	}
+
+	bool KTXFile::write(const std::string& filename, const ImageInfo& info, const std::vector<size_t>& imageSizes, const uint8_t* data)
+	{
+		assert(imageSizes.size() == info.mipLevels);
+		struct {
+			uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+			uint32_t endianness = 0x04030201;
+			uint32_t glType;
+			uint32_t glTypeSize;
+			uint32_t glFormat;
+			uint32_t glInternalFormat;
+			uint32_t glBaseInternalFormat;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth = 0;
+			uint32_t numberOfArrayElements = 0;
+			uint32_t numberOfFaces;
+			uint32_t numberOfMipmapLevels;
+			uint32_t bytesOfKeyValueData = 0;
+		} header;
+		header.glType = info.glType;
+		header.glTypeSize = info.glTypeSize;
+		header.glFormat = info.glFormat;
+		header.glInternalFormat = info.glInternalFormat;
+		header.glBaseInternalFormat = info.glBaseInternalFormat;
+		header.pixelWidth = info.width;
+		header.pixelHeight = info.height;
+		header.numberOfFaces = info.faces;
+		header.numberOfMipmapLevels = info.mipLevels;
+
+		const std::string tempFilename = filename + ".tmp";
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		const uint8_t padding[4] = {};
+		size_t offset = 0;
+		for (uint32_t level = 0; level < info.mipLevels; level++) {
+			// For cube maps the image size is the size of a single face, faces and levels are padded to four bytes
+			const uint32_t imageSize = static_cast<uint32_t>(imageSizes[level]);
+			file.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+			for (uint32_t face = 0; face < info.faces; face++) {
+				file.write(reinterpret_cast<const char*>(data + offset), imageSize);
+				file.write(reinterpret_cast<const char*>(padding), align4(imageSize) - imageSize);
+				offset += imageSize;
+			}
+		}
+		const bool success = file.good();
+		file.close();
+
+		std::remove(filename.c_str());
+		if (!success || (std::rename(tempFilename.c_str(), filename.c_str()) != 0)) {
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+		return true;
+	}
+}
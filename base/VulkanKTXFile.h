@@ -0,0 +1,90 @@
+/*
+* Memory mapped KTX file
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <ktx.h>
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vks
+{
+	class ThreadPool;
+
+	/**
+	* @brief Read-only memory mapping of a KTX (1.1) file
+	* @note The header is parsed with libktx but the image data is not loaded, images are read straight from the mapping (e.g. into a staging buffer), so loading doesn't need a heap copy of the file
+	*/
+	class KTXFile
+	{
+	public:
+		/** @brief OpenGL enums and dimensions of the images written with write(), type and format are zero for compressed formats */
+		struct ImageInfo {
+			uint32_t glType = 0;
+			uint32_t glTypeSize = 1;
+			uint32_t glFormat = 0;
+			uint32_t glInternalFormat = 0;
+			uint32_t glBaseInternalFormat = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t faces = 1;
+			uint32_t mipLevels = 1;
+		};
+
+		/** @brief Header information of the file, created without image data (don't call ktxTexture_GetData on it) */
+		ktxTexture* texture = nullptr;
+
+		KTXFile() {};
+		KTXFile(const KTXFile&) = delete;
+		KTXFile& operator=(const KTXFile&) = delete;
+		~KTXFile();
+
+		/** @brief Maps the file and reads its header, returns false if the file can't be opened or isn't a valid KTX file */
+		bool open(const std::string& filename);
+		void close();
+
+		/** @brief Returns the image of a level, layer and face (or depth slice) in the mapping */
+		const uint8_t* getImageData(uint32_t level, uint32_t layer = 0, uint32_t faceSlice = 0) const;
+		/** @brief Size of a single image of a level */
+		size_t getImageSize(uint32_t level) const;
+		/** @brief Size of all images, laid out as reported by ktxTexture_GetImageOffset */
+		size_t getDataSize() const;
+		/**
+		* @brief Copies all images to the destination (e.g. a mapped staging buffer), using the layout of ktxTexture_GetImageOffset
+		* @param threadPool If set (and it has worker threads), the images are split into chunks that are copied in parallel
+		*/
+		void copyImages(void* dst, vks::ThreadPool* threadPool = nullptr) const;
+
+		/**
+		* @brief Writes a KTX (1.1) file
+		* @param imageSizes Size of a single image (face) of each level
+		* @param data Images of all levels, the faces of a level are stored consecutively
+		* @note The file is written to a temporary file first and renamed on success, so an interrupted write never leaves a broken file behind
+		*/
+		static bool write(const std::string& filename, const ImageInfo& info, const std::vector<size_t>& imageSizes, const uint8_t* data);
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		// File offset of the first image of each level and the distance between the images of a level
+		std::vector<size_t> levelOffsets;
+		std::vector<size_t> imageStrides;
+#if defined(__ANDROID__)
+		AAsset* asset = nullptr;
+#elif defined(_WIN32)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+		uint32_t getFaceSliceCount(uint32_t level) const;
+	};
+}
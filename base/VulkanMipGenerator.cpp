@@ -0,0 +1,370 @@
+/*
+* CPU mip map generation
+*
+* Generates the mip chain of RGBA8 images on the CPU as an alternative to blit chains, so levels can be uploaded with the base level in a single copy
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VKS_MIPGEN_AVX2
+#define VKS_MIPGEN_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#define VKS_MIPGEN_AVX2
+#define VKS_MIPGEN_AVX2_TARGET
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Kaiser windowed sinc for halving the resolution, the taps sit at -2.5 to 2.5 source texels around the destination texel's center
+		const uint32_t kaiserTaps = 6;
+		// Rows are only split into jobs that process at least this many texels
+		const uint32_t minTexelsPerJob = 16 * 1024;
+
+		struct Tables {
+			float srgbToLinear[256];
+			// Indexed with linear values scaled to 16 bits, fine enough to round trip all 8 bit sRGB values
+			uint8_t linearToSRGB[65536];
+			float kaiserWeights[kaiserTaps];
+			bool hasAVX2 = false;
+
+			Tables()
+			{
+				for (uint32_t i = 0; i < 256; i++) {
+					const float c = (float)i / 255.0f;
+					srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				for (uint32_t i = 0; i < 65536; i++) {
+					const float l = (float)i / 65535.0f;
+					const float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+					linearToSRGB[i] = (uint8_t)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+				}
+
+				// Zeroth order modified Bessel function of the first kind
+				auto bessel = [](float x) {
+					float sum = 1.0f, term = 1.0f;
+					for (uint32_t k = 1; k < 16; k++) {
+						term *= (x / (2.0f * k)) * (x / (2.0f * k));
+						sum += term;
+					}
+					return sum;
+				};
+				const float pi = 3.14159265358979f;
+				const float alpha = 4.0f;
+				const float halfWidth = 1.5f;
+				float sum = 0.0f;
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					// Distance in destination texels
+					const float x = ((float)k - 2.5f) * 0.5f;
+					const float sinc = std::sin(pi * x) / (pi * x);
+					const float ratio = x / halfWidth;
+					kaiserWeights[k] = sinc * bessel(alpha * std::sqrt(1.0f - ratio * ratio)) / bessel(alpha);
+					sum += kaiserWeights[k];
+				}
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					kaiserWeights[k] /= sum;
+				}
+
+#if defined(VKS_MIPGEN_AVX2)
+#if defined(_MSC_VER)
+				// AVX2 requires CPU support and the OS saving the YMM registers
+				int info[4];
+				__cpuid(info, 1);
+				const bool osSavesYMM = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 6) == 6);
+				__cpuidex(info, 7, 0);
+				hasAVX2 = osSavesYMM && ((info[1] & (1 << 5)) != 0);
+#else
+				hasAVX2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+			}
+		};
+
+		const Tables& getTables()
+		{
+			static const Tables tables;
+			return tables;
+		}
+
+		void decodeRow(const uint8_t* src, uint32_t width, MipGenerator::Content content, float* dst)
+		{
+			const Tables& tables = getTables();
+			for (uint32_t i = 0; i < width * 4; i += 4) {
+				for (uint32_t c = 0; c < 3; c++) {
+					switch (content) {
+					case MipGenerator::Content::SRGB:
+						dst[i + c] = tables.srgbToLinear[src[i + c]];
+						break;
+					case MipGenerator::Content::NormalMap:
+						dst[i + c] = (float)src[i + c] * (2.0f / 255.0f) - 1.0f;
+						break;
+					default:
+						dst[i + c] = (float)src[i + c] * (1.0f / 255.0f);
+						break;
+					}
+				}
+				dst[i + 3] = (float)src[i + 3] * (1.0f / 255.0f);
+			}
+		}
+
+		void encodeRow(const float* src, uint32_t width, MipGenerator::Content content, uint8_t* dst)
+		{
+			const Tables& tables = getTables();
+			auto toUnorm = [](float value) {
+				return (uint8_t)std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f);
+			};
+			for (uint32_t i = 0; i < width * 4; i += 4) {
+				switch (content) {
+				case MipGenerator::Content::SRGB:
+					for (uint32_t c = 0; c < 3; c++) {
+						dst[i + c] = tables.linearToSRGB[(uint32_t)(std::min(std::max(src[i + c], 0.0f), 1.0f) * 65535.0f + 0.5f)];
+					}
+					break;
+				case MipGenerator::Content::NormalMap: {
+					float length = std::sqrt(src[i] * src[i] + src[i + 1] * src[i + 1] + src[i + 2] * src[i + 2]);
+					const float scale = (length > 1e-6f) ? 1.0f / length : 0.0f;
+					for (uint32_t c = 0; c < 3; c++) {
+						dst[i + c] = toUnorm(src[i + c] * scale * 0.5f + 0.5f);
+					}
+					// Averaged normals that cancel out point straight up
+					if (length <= 1e-6f) {
+						dst[i + 2] = 255;
+					}
+					break;
+				}
+				default:
+					for (uint32_t c = 0; c < 3; c++) {
+						dst[i + c] = toUnorm(src[i + c]);
+					}
+					break;
+				}
+				dst[i + 3] = toUnorm(src[i + 3]);
+			}
+		}
+
+		// Level filtered from, the base level is decoded one row at a time so it never has to be converted to floats as a whole
+		struct SourceLevel {
+			const uint8_t* rgba = nullptr;
+			const float* texels = nullptr;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			MipGenerator::Content content = MipGenerator::Content::Linear;
+
+			const float* getRow(uint32_t y, std::vector<float>& scratch) const
+			{
+				if (texels) {
+					return texels + (size_t)y * width * 4;
+				}
+				scratch.resize((size_t)width * 4);
+				decodeRow(rgba + (size_t)y * width * 4, width, content, scratch.data());
+				return scratch.data();
+			}
+		};
+
+		// Averages 2x2 texels of two source rows, odd dimensions drop the last row or column (like a blit)
+		void boxRow(const float* row0, const float* row1, uint32_t srcWidth, float* dst, uint32_t dstWidth, uint32_t x = 0)
+		{
+			for (; x < dstWidth; x++) {
+				const uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+				const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++) {
+					dst[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+				}
+			}
+		}
+
+		// Horizontal pass of the Kaiser filter, texels beyond the edges are clamped
+		void kaiserRowH(const float* src, uint32_t srcWidth, float* dst, uint32_t dstWidth, uint32_t x = 0)
+		{
+			const float* weights = getTables().kaiserWeights;
+			for (; x < dstWidth; x++) {
+				float sum[4] = {};
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					const int32_t srcX = std::min(std::max((int32_t)(x * 2 + k) - 2, 0), (int32_t)srcWidth - 1);
+					for (uint32_t c = 0; c < 4; c++) {
+						sum[c] += weights[k] * src[srcX * 4 + c];
+					}
+				}
+				memcpy(dst + x * 4, sum, sizeof(sum));
+			}
+		}
+
+		// Vertical pass of the Kaiser filter over the six source rows of a destination row
+		void kaiserRowV(const float* const rows[kaiserTaps], uint32_t floatCount, float* dst, uint32_t i = 0)
+		{
+			const float* weights = getTables().kaiserWeights;
+			for (; i < floatCount; i++) {
+				float sum = 0.0f;
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					sum += weights[k] * rows[k][i];
+				}
+				dst[i] = sum;
+			}
+		}
+
+#if defined(VKS_MIPGEN_AVX2)
+		// Two destination texels per iteration
+		VKS_MIPGEN_AVX2_TARGET void boxRowAVX2(const float* row0, const float* row1, uint32_t srcWidth, float* dst, uint32_t dstWidth)
+		{
+			const __m256 quarter = _mm256_set1_ps(0.25f);
+			uint32_t x = 0;
+			for (; (x + 1 < dstWidth) && (x * 2 + 3 < srcWidth); x += 2) {
+				const __m256 sum0 = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+				const __m256 sum1 = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+				// Pair the even and odd source texels of both destination texels
+				const __m256 even = _mm256_permute2f128_ps(sum0, sum1, 0x20);
+				const __m256 odd = _mm256_permute2f128_ps(sum0, sum1, 0x31);
+				_mm256_storeu_ps(dst + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter));
+			}
+			boxRow(row0, row1, srcWidth, dst, dstWidth, x);
+		}
+
+		VKS_MIPGEN_AVX2_TARGET void kaiserRowHAVX2(const float* src, uint32_t srcWidth, float* dst, uint32_t dstWidth)
+		{
+			const float* weights = getTables().kaiserWeights;
+			// The first texel reads beyond the left edge
+			kaiserRowH(src, srcWidth, dst, std::min(dstWidth, 1u));
+			uint32_t x = 1;
+			for (; (x + 1 < dstWidth) && (x * 2 + 5 < srcWidth); x += 2) {
+				__m256 sum = _mm256_setzero_ps();
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					const float* texel = src + (x * 2 + k - 2) * 4;
+					const __m256 pair = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(texel)), _mm_loadu_ps(texel + 8), 1);
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), pair));
+				}
+				_mm256_storeu_ps(dst + x * 4, sum);
+			}
+			kaiserRowH(src, srcWidth, dst, dstWidth, x);
+		}
+
+		VKS_MIPGEN_AVX2_TARGET void kaiserRowVAVX2(const float* const rows[kaiserTaps], uint32_t floatCount, float* dst)
+		{
+			const float* weights = getTables().kaiserWeights;
+			uint32_t i = 0;
+			for (; i + 8 <= floatCount; i += 8) {
+				__m256 sum = _mm256_setzero_ps();
+				for (uint32_t k = 0; k < kaiserTaps; k++) {
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+				}
+				_mm256_storeu_ps(dst + i, sum);
+			}
+			kaiserRowV(rows, floatCount, dst, i);
+		}
+#endif
+	}
+
+	uint32_t MipGenerator::getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	}
+
+	template<typename F>
+	void MipGenerator::forEachRow(uint32_t rowCount, uint32_t rowWidth, const F& function) const
+	{
+		if (threadPool && (threadPool->getThreadCount() > 1)) {
+			threadPool->parallelFor(rowCount, function, std::max(1u, minTexelsPerJob / std::max(rowWidth, 1u)));
+		} else {
+			function(0u, rowCount);
+		}
+	}
+
+	void MipGenerator::generate(const uint8_t* rgba, uint32_t width, uint32_t height, Content content, std::vector<std::vector<uint8_t>>& levels) const
+	{
+#if defined(VKS_MIPGEN_AVX2)
+		const bool useAVX2 = getTables().hasAVX2;
+#endif
+		levels.resize(getMipLevelCount(width, height));
+		levels[0].assign(rgba, rgba + (size_t)width * height * 4);
+
+		SourceLevel src;
+		src.rgba = rgba;
+		src.width = width;
+		src.height = height;
+		src.content = content;
+		std::vector<float> current, next, horizontal;
+		for (uint32_t level = 1; level < levels.size(); level++) {
+			const uint32_t dstWidth = std::max(1u, src.width >> 1);
+			const uint32_t dstHeight = std::max(1u, src.height >> 1);
+			next.resize((size_t)dstWidth * dstHeight * 4);
+
+			if (settings.filter == Filter::Box) {
+				forEachRow(dstHeight, dstWidth * 2, [&](uint32_t begin, uint32_t end) {
+					std::vector<float> scratch0, scratch1;
+					for (uint32_t y = begin; y < end; y++) {
+						const float* row0 = src.getRow(std::min(y * 2, src.height - 1), scratch0);
+						const float* row1 = src.getRow(std::min(y * 2 + 1, src.height - 1), scratch1);
+						float* dst = next.data() + (size_t)y * dstWidth * 4;
+#if defined(VKS_MIPGEN_AVX2)
+						if (useAVX2) {
+							boxRowAVX2(row0, row1, src.width, dst, dstWidth);
+							continue;
+						}
+#endif
+						boxRow(row0, row1, src.width, dst, dstWidth);
+					}
+				});
+			} else {
+				// Filter all source rows horizontally, then the resulting columns vertically
+				horizontal.resize((size_t)dstWidth * src.height * 4);
+				forEachRow(src.height, src.width, [&](uint32_t begin, uint32_t end) {
+					std::vector<float> scratch;
+					for (uint32_t y = begin; y < end; y++) {
+						const float* row = src.getRow(y, scratch);
+						float* dst = horizontal.data() + (size_t)y * dstWidth * 4;
+#if defined(VKS_MIPGEN_AVX2)
+						if (useAVX2) {
+							kaiserRowHAVX2(row, src.width, dst, dstWidth);
+							continue;
+						}
+#endif
+						kaiserRowH(row, src.width, dst, dstWidth);
+					}
+				});
+				forEachRow(dstHeight, dstWidth * kaiserTaps, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t y = begin; y < end; y++) {
+						const float* rows[kaiserTaps];
+						for (uint32_t k = 0; k < kaiserTaps; k++) {
+							const int32_t srcY = std::min(std::max((int32_t)(y * 2 + k) - 2, 0), (int32_t)src.height - 1);
+							rows[k] = horizontal.data() + (size_t)srcY * dstWidth * 4;
+						}
+						float* dst = next.data() + (size_t)y * dstWidth * 4;
+#if defined(VKS_MIPGEN_AVX2)
+						if (useAVX2) {
+							kaiserRowVAVX2(rows, dstWidth * 4, dst);
+							continue;
+						}
+#endif
+						kaiserRowV(rows, dstWidth * 4, dst);
+					}
+				});
+			}
+
+			levels[level].resize((size_t)dstWidth * dstHeight * 4);
+			forEachRow(dstHeight, dstWidth, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t y = begin; y < end; y++) {
+					encodeRow(next.data() + (size_t)y * dstWidth * 4, dstWidth, content, levels[level].data() + (size_t)y * dstWidth * 4);
+				}
+			});
+
+			// The next level is filtered from the unquantized (and for normal maps not yet renormalized) values
+			current.swap(next);
+			src.rgba = nullptr;
+			src.texels = current.data();
+			src.width = dstWidth;
+			src.height = dstHeight;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+/*
+* CPU mip map generation
+*
+* Generates the mip chain of RGBA8 images on the CPU as an alternative to blit chains, so levels can be uploaded with the base level in a single copy
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Downsamples RGBA8 images to a full mip chain
+	* @note Filtering happens in floating point, in linear space for sRGB encoded colors. Unlike blits this doesn't depend on format features and takes the work off the GPU queue.
+	* Rows are filtered with AVX2 kernels if the CPU supports them and spread over the thread pool (if set).
+	*/
+	class MipGenerator
+	{
+	public:
+		enum class Filter {
+			/** @brief Averages 2x2 texels, same as a linear blit */
+			Box,
+			/** @brief Separable Kaiser windowed sinc over 6x6 texels, keeps smaller levels sharper */
+			Kaiser
+		};
+
+		/** @brief How the texel values are interpreted while filtering */
+		enum class Content {
+			/** @brief Data stored linearly (e.g. roughness, metallic, occlusion) */
+			Linear,
+			/** @brief Colors encoded with the sRGB transfer function (alpha is linear), filtered in linear space */
+			SRGB,
+			/** @brief Tangent space normals mapped to [0, 1], the filtered normals are renormalized */
+			NormalMap
+		};
+
+		struct Settings {
+			Filter filter = Filter::Box;
+		} settings;
+
+		/** @param threadPool Rows are filtered in parallel on this pool if set, it must be owned by the thread calling generate() */
+		MipGenerator(vks::ThreadPool* threadPool = nullptr) : threadPool(threadPool) {};
+
+		/**
+		* @brief Generates all mip levels of an image
+		* @param levels Receives the tightly packed RGBA8 data of all levels, starting with a copy of the base level
+		*/
+		void generate(const uint8_t* rgba, uint32_t width, uint32_t height, Content content, std::vector<std::vector<uint8_t>>& levels) const;
+
+		static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+	private:
+		vks::ThreadPool* threadPool = nullptr;
+
+		template<typename F>
+		void forEachRow(uint32_t rowCount, uint32_t rowWidth, const F& function) const;
+	};
+}
@@ -0,0 +1,126 @@
+/*
+* Vulkan parallel command recorder
+*
+* Records the contents of a render pass into secondary command buffers across all threads of a thread pool
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanParallelCommandRecorder.h"
+
+namespace vks
+{
+	ParallelCommandRecorder::~ParallelCommandRecorder()
+	{
+		destroy();
+	}
+
+	void ParallelCommandRecorder::create(VkDevice device, uint32_t queueFamilyIndex, ThreadPool* threadPool)
+	{
+		assert(threadPool);
+		destroy();
+		this->device = device;
+		this->queueFamilyIndex = queueFamilyIndex;
+		this->threadPool = threadPool;
+	}
+
+	void ParallelCommandRecorder::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& frame : frames) {
+			for (auto& pool : frame.threadPools) {
+				// Destroying the pool also frees all command buffers allocated from it
+				vkDestroyCommandPool(device, pool.commandPool, nullptr);
+			}
+		}
+		frames.clear();
+		currentFrame = nullptr;
+		device = VK_NULL_HANDLE;
+	}
+
+	void ParallelCommandRecorder::beginFrame(uint32_t frameIndex)
+	{
+		assert(device != VK_NULL_HANDLE);
+		if (frameIndex >= frames.size()) {
+			frames.resize(frameIndex + 1);
+		}
+		currentFrame = &frames[frameIndex];
+		// The thread count of the pool may have changed since this frame was last used
+		if (currentFrame->threadPools.size() != threadPool->getThreadCount()) {
+			for (auto& pool : currentFrame->threadPools) {
+				vkDestroyCommandPool(device, pool.commandPool, nullptr);
+			}
+			currentFrame->threadPools.clear();
+			currentFrame->threadPools.resize(threadPool->getThreadCount());
+			for (auto& pool : currentFrame->threadPools) {
+				VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+				cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+				cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &pool.commandPool));
+			}
+		}
+		// Resetting whole pools is cheaper than resetting individual command buffers
+		for (auto& pool : currentFrame->threadPools) {
+			if (pool.usedCommandBuffers > 0) {
+				VK_CHECK_RESULT(vkResetCommandPool(device, pool.commandPool, 0));
+				pool.usedCommandBuffers = 0;
+			}
+		}
+	}
+
+	VkCommandBuffer ParallelCommandRecorder::getCommandBuffer()
+	{
+		assert(currentFrame);
+		// Command pools are per pool thread, recording from other threads isn't supported
+		const uint32_t threadIndex = threadPool->getThreadIndex();
+		assert(threadIndex != ThreadPool::ExternalThread);
+		ThreadCommandPool& pool = currentFrame->threadPools[threadIndex];
+		if (pool.usedCommandBuffers == pool.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(pool.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			pool.commandBuffers.push_back(commandBuffer);
+		}
+		return pool.commandBuffers[pool.usedCommandBuffers++];
+	}
+
+	VkCommandBuffer ParallelCommandRecorder::beginSecondary()
+	{
+		VkCommandBuffer commandBuffer = getCommandBuffer();
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+		return commandBuffer;
+	}
+
+	void ParallelCommandRecorder::beginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo& renderPassBeginInfo, uint32_t subpass)
+	{
+		assert(primaryCommandBuffer == VK_NULL_HANDLE);
+		primaryCommandBuffer = commandBuffer;
+		inheritanceInfo = vks::initializers::commandBufferInheritanceInfo(renderPassBeginInfo.renderPass, subpass, renderPassBeginInfo.framebuffer);
+		secondaryCommandBuffers.clear();
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	}
+
+	void ParallelCommandRecorder::executeSecondary(VkCommandBuffer commandBuffer)
+	{
+		assert(primaryCommandBuffer != VK_NULL_HANDLE);
+		secondaryCommandBuffers.push_back(commandBuffer);
+	}
+
+	void ParallelCommandRecorder::endRenderPass()
+	{
+		assert(primaryCommandBuffer != VK_NULL_HANDLE);
+		if (!secondaryCommandBuffers.empty()) {
+			vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+		}
+		vkCmdEndRenderPass(primaryCommandBuffer);
+		secondaryCommandBuffers.clear();
+		primaryCommandBuffer = VK_NULL_HANDLE;
+	}
+}
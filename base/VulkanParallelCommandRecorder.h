@@ -0,0 +1,133 @@
+/*
+* Vulkan parallel command recorder
+*
+* Records the contents of a render pass into secondary command buffers across all threads of a thread pool
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Records secondary command buffers for a render pass in parallel and stitches them into a primary command buffer
+	* @note Each frame owns one command pool per thread, command buffers are taken from the pool of the thread that records them and the pools of a frame are reset as a whole once that frame is started again
+	*/
+	class ParallelCommandRecorder
+	{
+	private:
+		struct ThreadCommandPool {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCommandBuffers = 0;
+		};
+		struct Frame {
+			std::vector<ThreadCommandPool> threadPools;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t queueFamilyIndex = 0;
+		ThreadPool* threadPool = nullptr;
+		std::vector<Frame> frames;
+		Frame* currentFrame = nullptr;
+		VkCommandBuffer primaryCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		// Secondary command buffers of the current render pass in execution order
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		VkCommandBuffer getCommandBuffer();
+		VkCommandBuffer beginSecondary();
+	public:
+		/** @brief Number of ranges per thread a parallel draw list is split into, more ranges balance uneven draw costs better */
+		uint32_t rangesPerThread = 2;
+
+		~ParallelCommandRecorder();
+
+		/**
+		* @brief Prepares the recorder for use
+		* @param device Logical device the command pools are created for
+		* @param queueFamilyIndex Queue family the recorded command buffers will be submitted to
+		* @param threadPool Thread pool used for recording
+		*/
+		void create(VkDevice device, uint32_t queueFamilyIndex, ThreadPool* threadPool);
+		/** @brief Destroys all command pools and command buffers */
+		void destroy();
+		/** @brief Returns true if the recorder has been created */
+		bool isCreated() const { return device != VK_NULL_HANDLE; }
+
+		/**
+		* @brief Starts recording for the given frame, resetting all command buffers previously recorded for it
+		* @param frameIndex Index of the frame (e.g. swap chain image or frame in flight), the GPU must no longer use its command buffers
+		*/
+		void beginFrame(uint32_t frameIndex);
+
+		/**
+		* @brief Begins a render pass on the primary command buffer whose contents will be provided by secondary command buffers
+		* @param commandBuffer Primary command buffer in recording state
+		* @param renderPassBeginInfo Render pass begin info, render pass and framebuffer are also used for the inheritance info
+		* @param subpass Subpass the secondary command buffers are recorded for
+		*/
+		void beginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo& renderPassBeginInfo, uint32_t subpass = 0);
+
+		/**
+		* @brief Records a single secondary command buffer on the calling thread and appends it to the current render pass
+		* @param function Called as function(commandBuffer) with a secondary command buffer in recording state
+		*/
+		template<typename F>
+		void recordSecondary(const F& function)
+		{
+			VkCommandBuffer commandBuffer = beginSecondary();
+			function(commandBuffer);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			secondaryCommandBuffers.push_back(commandBuffer);
+		}
+
+		/**
+		* @brief Splits a draw list into contiguous ranges that are recorded into secondary command buffers by all threads of the pool
+		* @param drawCount Number of entries in the draw list
+		* @param function Called as function(commandBuffer, begin, end) from the worker threads, the command buffer is in recording state
+		* @note Secondary command buffers are executed in draw list order, so the result matches recording the list on a single thread
+		*/
+		template<typename F>
+		void recordParallel(uint32_t drawCount, const F& function)
+		{
+			if (drawCount == 0) {
+				return;
+			}
+			const uint32_t rangeCount = std::min(drawCount, std::max(threadPool->getThreadCount() * rangesPerThread, 1u));
+			const size_t offset = secondaryCommandBuffers.size();
+			secondaryCommandBuffers.resize(offset + rangeCount);
+			threadPool->parallelFor(rangeCount, [&](uint32_t firstRange, uint32_t lastRange) {
+				for (uint32_t range = firstRange; range < lastRange; range++) {
+					const uint32_t begin = static_cast<uint32_t>((uint64_t)drawCount * range / rangeCount);
+					const uint32_t end = static_cast<uint32_t>((uint64_t)drawCount * (range + 1) / rangeCount);
+					VkCommandBuffer commandBuffer = beginSecondary();
+					function(commandBuffer, begin, end);
+					VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+					secondaryCommandBuffers[offset + range] = commandBuffer;
+				}
+			});
+		}
+
+		/**
+		* @brief Appends a secondary command buffer recorded outside of the recorder (e.g. one that is reused across frames) to the current render pass
+		* @note The command buffer must have been recorded for the render pass and subpass of the current render pass
+		*/
+		void executeSecondary(VkCommandBuffer commandBuffer);
+
+		/** @brief Executes all secondary command buffers of the current render pass in order and ends the render pass */
+		void endRenderPass();
+
+		/** @brief Returns the inheritance info of the current render pass */
+		const VkCommandBufferInheritanceInfo& getInheritanceInfo() const { return inheritanceInfo; }
+	};
+}
@@ -0,0 +1,128 @@
+/*
+* Vulkan sampler cache
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSamplerCache.h"
+
+namespace vks
+{
+	SamplerCache::~SamplerCache()
+	{
+		destroy();
+	}
+
+	void SamplerCache::create(VkDevice device)
+	{
+		destroy();
+		this->device = device;
+	}
+
+	void SamplerCache::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& sampler : samplers) {
+			vkDestroySampler(device, sampler.second.sampler, nullptr);
+		}
+		samplers.clear();
+		samplerInfos.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	bool SamplerCache::SamplerInfo::operator==(const SamplerInfo& other) const
+	{
+		const VkSamplerCreateInfo& a = createInfo;
+		const VkSamplerCreateInfo& b = other.createInfo;
+		return (a.flags == b.flags) && (a.magFilter == b.magFilter) && (a.minFilter == b.minFilter) && (a.mipmapMode == b.mipmapMode)
+			&& (a.addressModeU == b.addressModeU) && (a.addressModeV == b.addressModeV) && (a.addressModeW == b.addressModeW)
+			&& (a.mipLodBias == b.mipLodBias) && (a.anisotropyEnable == b.anisotropyEnable) && (a.maxAnisotropy == b.maxAnisotropy)
+			&& (a.compareEnable == b.compareEnable) && (a.compareOp == b.compareOp) && (a.minLod == b.minLod) && (a.maxLod == b.maxLod)
+			&& (a.borderColor == b.borderColor) && (a.unnormalizedCoordinates == b.unnormalizedCoordinates);
+	}
+
+	size_t SamplerCache::SamplerInfo::hash() const
+	{
+		auto combine = [](size_t& seed, size_t value) {
+			seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+		size_t seed = std::hash<uint32_t>()(createInfo.flags);
+		combine(seed, createInfo.magFilter);
+		combine(seed, createInfo.minFilter);
+		combine(seed, createInfo.mipmapMode);
+		combine(seed, createInfo.addressModeU);
+		combine(seed, createInfo.addressModeV);
+		combine(seed, createInfo.addressModeW);
+		combine(seed, std::hash<float>()(createInfo.mipLodBias));
+		combine(seed, createInfo.anisotropyEnable);
+		combine(seed, std::hash<float>()(createInfo.maxAnisotropy));
+		combine(seed, createInfo.compareEnable);
+		combine(seed, createInfo.compareOp);
+		combine(seed, std::hash<float>()(createInfo.minLod));
+		combine(seed, std::hash<float>()(createInfo.maxLod));
+		combine(seed, createInfo.borderColor);
+		combine(seed, createInfo.unnormalizedCoordinates);
+		return seed;
+	}
+
+	VkSampler SamplerCache::acquire(const VkSamplerCreateInfo& createInfo)
+	{
+		assert(device != VK_NULL_HANDLE);
+		assert(createInfo.pNext == nullptr);
+
+		// Parameters Vulkan ignores are reset, so they don't split otherwise identical samplers
+		SamplerInfo info;
+		info.createInfo = createInfo;
+		if (!info.createInfo.anisotropyEnable) {
+			info.createInfo.maxAnisotropy = 1.0f;
+		}
+		if (!info.createInfo.compareEnable) {
+			info.createInfo.compareOp = VK_COMPARE_OP_NEVER;
+		}
+		const bool usesBorder = (createInfo.addressModeU == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER) || (createInfo.addressModeV == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER) || (createInfo.addressModeW == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
+		if (!usesBorder) {
+			info.createInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = samplers.find(info);
+		if (it != samplers.end()) {
+			it->second.references++;
+			return it->second.sampler;
+		}
+
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(device, &info.createInfo, nullptr, &sampler));
+		samplers[info] = { sampler, 1 };
+		samplerInfos[sampler] = info;
+		return sampler;
+	}
+
+	void SamplerCache::release(VkSampler sampler)
+	{
+		if (sampler == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		auto info = samplerInfos.find(sampler);
+		if (info == samplerInfos.end()) {
+			vkDestroySampler(device, sampler, nullptr);
+			return;
+		}
+		auto it = samplers.find(info->second);
+		assert(it != samplers.end() && it->second.references > 0);
+		if (--it->second.references == 0) {
+			vkDestroySampler(device, sampler, nullptr);
+			samplers.erase(it);
+			samplerInfos.erase(info);
+		}
+	}
+
+	size_t SamplerCache::getSamplerCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return samplers.size();
+	}
+}
@@ -0,0 +1,63 @@
+/*
+* Vulkan sampler cache
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Shares samplers between everything created on a device, identical create infos map to the same reference counted sampler
+	* @note Implementations limit the number of samplers (maxSamplerAllocationCount), while most textures only need a handful of distinct samplers.
+	* Parameters that are ignored by Vulkan (e.g. maxAnisotropy with anisotropy disabled) don't create additional samplers.
+	*/
+	class SamplerCache
+	{
+	public:
+		SamplerCache() {};
+		~SamplerCache();
+
+		void create(VkDevice device);
+		/** @brief Destroys all samplers, including those that are still referenced */
+		void destroy();
+
+		/**
+		* @brief Returns a sampler for the given create info, creating it if no matching sampler exists yet
+		* @note Each call adds a reference that has to be released with release(). Extension structures (pNext) are not supported.
+		*/
+		VkSampler acquire(const VkSamplerCreateInfo& createInfo);
+		/** @brief Removes a reference from a sampler returned by acquire(), the sampler is destroyed once it's no longer referenced. Samplers not created by the cache are destroyed directly. */
+		void release(VkSampler sampler);
+
+		/** @brief Number of distinct samplers currently alive */
+		size_t getSamplerCount();
+	private:
+		struct SamplerInfo {
+			VkSamplerCreateInfo createInfo;
+			bool operator==(const SamplerInfo& other) const;
+			size_t hash() const;
+		};
+		struct SamplerHash {
+			size_t operator()(const SamplerInfo& info) const { return info.hash(); }
+		};
+		struct Entry {
+			VkSampler sampler;
+			uint32_t references;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		// Textures may be loaded from multiple threads
+		std::mutex mutex;
+		std::unordered_map<SamplerInfo, Entry, SamplerHash> samplers;
+		std::unordered_map<VkSampler, SamplerInfo> samplerInfos;
+	};
+}
@@ -231,6 +231,12 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 */
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
 {
+	if (offscreen)
+	{
+		createOffscreen(*width, *height);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -423,6 +429,21 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+	if (offscreen)
+	{
+		// Images are used round robin, the semaphore is signaled by an empty submission so the example's submission can wait on it as usual
+		offscreenImageIndex = (offscreenImageIndex + 1) % imageCount;
+		*imageIndex = offscreenImageIndex;
+		if (presentCompleteSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		return vkQueueSubmit(offscreenQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -439,6 +460,21 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (offscreen)
+	{
+		// Nothing is presented, but the semaphore still has to be waited on so it can be signaled again
+		if (waitSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStageMask;
+		return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -460,6 +496,11 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		destroyOffscreen();
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
@@ -476,6 +517,125 @@ void VulkanSwapChain::cleanup()
 	swapChain = VK_NULL_HANDLE;
 }
 
+/**
+* Switch to offscreen mode, must be called after connect() and instead of initSurface()
+*
+* @note Rendering to the offscreen images uses the same render passes as for a swap chain, so the device still needs the swap chain extension for the present layout
+*/
+void VulkanSwapChain::initOffscreen()
+{
+	offscreen = true;
+	// Use the first graphics queue, there is nothing to present to
+	uint32_t queueCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
+	std::vector<VkQueueFamilyProperties> queueProps(queueCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queueProps.data());
+	for (uint32_t i = 0; i < queueCount; i++)
+	{
+		if (queueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			queueNodeIndex = i;
+			break;
+		}
+	}
+	if (queueNodeIndex == UINT32_MAX)
+	{
+		vks::tools::exitFatal("Could not find a graphics queue for offscreen rendering!", -1);
+	}
+	vkGetDeviceQueue(device, queueNodeIndex, 0, &offscreenQueue);
+
+	// Prefer the format most swap chains use, so examples behave the same as with a window
+	colorFormat = VK_FORMAT_UNDEFINED;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	const std::vector<VkFormat> formats = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+	for (auto& format : formats)
+	{
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		if ((formatProps.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+		{
+			colorFormat = format;
+			break;
+		}
+	}
+	if (colorFormat == VK_FORMAT_UNDEFINED)
+	{
+		vks::tools::exitFatal("Could not find a suitable color format for offscreen rendering!", -1);
+	}
+}
+
+void VulkanSwapChain::createOffscreen(uint32_t width, uint32_t height)
+{
+	destroyOffscreen();
+
+	// Same number of images as a typical swap chain
+	imageCount = 3;
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+	offscreenImageIndex = imageCount - 1;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Same usage as requested for swap chain images
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if ((memReqs.memoryTypeBits & (1 << j)) && (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memAlloc.memoryTypeIndex = j;
+				break;
+			}
+		}
+		assert(memAlloc.memoryTypeIndex != UINT32_MAX);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = vks::initializers::imageViewCreateInfo();
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorAttachmentView.subresourceRange.levelCount = 1;
+		colorAttachmentView.subresourceRange.layerCount = 1;
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+	}
+}
+
+void VulkanSwapChain::destroyOffscreen()
+{
+	for (uint32_t i = 0; i < offscreenMemory.size(); i++)
+	{
+		vkDestroyImageView(device, buffers[i].view, nullptr);
+		vkDestroyImage(device, images[i], nullptr);
+		vkFreeMemory(device, offscreenMemory[i], nullptr);
+	}
+	offscreenMemory.clear();
+	images.clear();
+	buffers.clear();
+}
+
 #if defined(_DIRECT2DISPLAY)
 /**
 * Create direct to display surface
@@ -38,7 +38,7 @@ private:
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR; 
@@ -49,6 +49,13 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	// Offscreen mode replaces the swap chain with plain images
+	bool offscreen = false;
+	VkQueue offscreenQueue = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> offscreenMemory;
+	uint32_t offscreenImageIndex = 0;
+	void createOffscreen(uint32_t width, uint32_t height);
+	void destroyOffscreen();
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
@@ -76,6 +83,9 @@ public:
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height);
 #endif
 #endif
+	/** @brief Uses plain images instead of a surface and swap chain, the rest of the interface stays the same so rendering code doesn't need to be changed */
+	void initOffscreen();
+	bool isOffscreen() const { return offscreen; }
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
@@ -7,6 +7,7 @@
 */
 
 #include <VulkanTexture.h>
+#include <VulkanTextureStreamer.h>
 
 namespace vks
 {
@@ -19,15 +20,25 @@ namespace vks
 
 	void Texture::destroy()
 	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		if (sampler)
+		if (streamer)
 		{
-			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+			streamer->remove(image);
+			streamer = nullptr;
 		}
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		vkDestroyImage(device->logicalDevice, image, nullptr);
+		// Samplers are shared with other textures
+		device->samplerCache.release(sampler);
 		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
 	}
 
+	void Texture::mapKTXFile(std::string filename, vks::KTXFile &file)
+	{
+		if (!file.open(filename)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+		}
+	}
+
 	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target)
 	{
 		ktxResult result = KTX_SUCCESS;
@@ -62,21 +73,22 @@ namespace vks
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
+	* @param (Optional) threadPool If set, the images are copied to the staging buffer on the pool's threads
 	*
 	*/
-	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
+	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear, vks::ThreadPool *threadPool)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		// The file is mapped and its images are copied straight into the staging buffer
+		vks::KTXFile ktxFile;
+		mapKTXFile(filename, ktxFile);
+		ktxTexture* ktxTexture = ktxFile.texture;
 
 		this->device = device;
 		width = ktxTexture->baseWidth;
 		height = ktxTexture->baseHeight;
 		mipLevels = ktxTexture->numLevels;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		ktx_size_t ktxTextureSize = ktxFile.getDataSize();
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
@@ -122,7 +134,7 @@ namespace vks
 			// Copy texture data into staging buffer
 			uint8_t *data;
 			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
+			ktxFile.copyImages(data, threadPool);
 			vkUnmapMemory(device->logicalDevice, stagingMemory);
 
 			// Setup buffer copy regions for each mip level
@@ -273,7 +285,7 @@ namespace vks
 			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
 
 			// Copy image data into memory
-			memcpy(data, ktxTextureData, memReqs.size);
+			memcpy(data, ktxFile.getImageData(0), std::min((size_t)memReqs.size, ktxFile.getImageSize(0)));
 
 			vkUnmapMemory(device->logicalDevice, mappableMemory);
 
@@ -289,8 +301,6 @@ namespace vks
 			device->flushCommandBuffer(copyCmd, copyQueue);
 		}
 
-		ktxTexture_Destroy(ktxTexture);
-
 		// Create a default sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -303,13 +313,13 @@ namespace vks
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		// Max level-of-detail should match mip level count
-		samplerCreateInfo.maxLod = (useStaging) ? (float)mipLevels : 0.0f;
+		// The view limits the level-of-detail to its mip levels, so the sampler doesn't depend on the mip level count and can be shared with other textures
+		samplerCreateInfo.maxLod = (useStaging) ? VK_LOD_CLAMP_NONE : 0.0f;
 		// Only enable anisotropic filtering if enabled on the device
 		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->samplerCache.acquire(samplerCreateInfo);
 
 		// Create image view
 		// Textures are not directly accessed by the shaders and
@@ -330,6 +340,48 @@ namespace vks
 		updateDescriptor();
 	}
 
+	/**
+	* Load a 2D texture and stream its mip levels, only the mip tail is uploaded before returning
+	*
+	* @param filename File to load (supports .ktx)
+	* @param format Vulkan format of the image data stored in the file
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used if the file can't be streamed (e.g. it doesn't contain a 2D texture) and is loaded with loadFromFile instead
+	* @param streamer Streamer the remaining mip levels are uploaded by
+	* @param (Optional) onUpdated Called each time the texture's view and descriptor have been replaced, descriptor sets using the texture need to be updated
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	*/
+	void Texture2D::loadFromFileStreamed(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, vks::TextureStreamer &streamer, std::function<void()> onUpdated, VkImageUsageFlags imageUsageFlags)
+	{
+		std::unique_ptr<TextureStreamer::Source> source = TextureStreamer::createKTXSource(filename);
+		if (!source || !streamer.isCreated())
+		{
+			loadFromFile(filename, format, device, copyQueue, imageUsageFlags);
+			return;
+		}
+
+		this->device = device;
+		TextureStreamer::Texture streamedTexture = streamer.add(std::move(source), format, imageUsageFlags, [this, onUpdated](VkImageView newView) {
+			view = newView;
+			updateDescriptor();
+			if (onUpdated)
+			{
+				onUpdated();
+			}
+		});
+		image = streamedTexture.image;
+		deviceMemory = streamedTexture.deviceMemory;
+		view = streamedTexture.view;
+		sampler = streamedTexture.sampler;
+		width = streamedTexture.width;
+		height = streamedTexture.height;
+		mipLevels = streamedTexture.mipLevels;
+		layerCount = 1;
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		this->streamer = &streamer;
+		updateDescriptor();
+	}
+
 	/**
 	* Creates a 2D texture from a buffer
 	*
@@ -478,7 +530,7 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = 0.0f;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->samplerCache.acquire(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = {};
@@ -504,13 +556,15 @@ namespace vks
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) threadPool If set, the images are copied to the staging buffer on the pool's threads
 	*
 	*/
-	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, vks::ThreadPool *threadPool)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		// The file is mapped and its images are copied straight into the staging buffer
+		vks::KTXFile ktxFile;
+		mapKTXFile(filename, ktxFile);
+		ktxTexture* ktxTexture = ktxFile.texture;
 
 		this->device = device;
 		width = ktxTexture->baseWidth;
@@ -518,8 +572,7 @@ namespace vks
 		layerCount = ktxTexture->numLayers;
 		mipLevels = ktxTexture->numLevels;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		ktx_size_t ktxTextureSize = ktxFile.getDataSize();
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -549,7 +602,7 @@ namespace vks
 		// Copy texture data into staging buffer
 		uint8_t *data;
 		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
+		ktxFile.copyImages(data, threadPool);
 		vkUnmapMemory(device->logicalDevice, stagingMemory);
 
 		// Setup buffer copy regions for each layer including all of its miplevels
@@ -656,9 +709,9 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->samplerCache.acquire(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -671,7 +724,6 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
 		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
@@ -688,21 +740,22 @@ namespace vks
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) threadPool If set, the images are copied to the staging buffer on the pool's threads
 	*
 	*/
-	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, vks::ThreadPool *threadPool)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		// The file is mapped and its images are copied straight into the staging buffer
+		vks::KTXFile ktxFile;
+		mapKTXFile(filename, ktxFile);
+		ktxTexture* ktxTexture = ktxFile.texture;
 
 		this->device = device;
 		width = ktxTexture->baseWidth;
 		height = ktxTexture->baseHeight;
 		mipLevels = ktxTexture->numLevels;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		ktx_size_t ktxTextureSize = ktxFile.getDataSize();
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -732,7 +785,7 @@ namespace vks
 		// Copy texture data into staging buffer
 		uint8_t *data;
 		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
+		ktxFile.copyImages(data, threadPool);
 		vkUnmapMemory(device->logicalDevice, stagingMemory);
 
 		// Setup buffer copy regions for each face including all of its mip levels
@@ -843,9 +896,9 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->samplerCache.acquire(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -858,7 +911,6 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
 		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string>
 #include <vector>
+#include <functional>
 
 #include "vulkan/vulkan.h"
 
@@ -20,6 +21,7 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanKTXFile.h"
 #include "VulkanTools.h"
 
 #if defined(__ANDROID__)
@@ -28,6 +30,9 @@
 
 namespace vks
 {
+class TextureStreamer;
+class ThreadPool;
+
 class Texture
 {
   public:
@@ -41,10 +46,14 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief Set if the texture's mip levels are being streamed, the view is replaced as levels arrive */
+	vks::TextureStreamer *streamer = nullptr;
 
 	void      updateDescriptor();
 	void      destroy();
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	/** @brief Maps a KTX file without loading its image data into memory, exits if the file can't be opened */
+	void      mapKTXFile(std::string filename, vks::KTXFile &file);
 };
 
 class Texture2D : public Texture
@@ -57,7 +66,16 @@ class Texture2D : public Texture
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	    bool               forceLinear     = false);
+	    bool               forceLinear     = false,
+	    vks::ThreadPool *  threadPool      = nullptr);
+	void loadFromFileStreamed(
+	    std::string             filename,
+	    VkFormat                format,
+	    vks::VulkanDevice *     device,
+	    VkQueue                 copyQueue,
+	    vks::TextureStreamer &  streamer,
+	    std::function<void()>   onUpdated       = nullptr,
+	    VkImageUsageFlags       imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT);
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
@@ -80,7 +98,8 @@ class Texture2DArray : public Texture
 	    vks::VulkanDevice *device,
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    vks::ThreadPool *  threadPool      = nullptr);
 };
 
 class TextureCubeMap : public Texture
@@ -92,6 +111,7 @@ class TextureCubeMap : public Texture
 	    vks::VulkanDevice *device,
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    vks::ThreadPool *  threadPool      = nullptr);
 };
 }        // namespace vks
@@ -0,0 +1,617 @@
+/*
+* Vulkan texture block compression
+*
+* Compresses images that are not stored in a GPU format (png, jpg, ...) to BCn on the CPU and caches the results on disk
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureCompressor.h"
+#include "VulkanKTXFile.h"
+#include "VulkanTools.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+
+#include <ktx.h>
+#include "stb_image.h"
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_COMPRESSOR_SSE2
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Bump to invalidate all cached images if the encoders change
+		const uint64_t cacheVersion = 2;
+
+		// Texels of a 4x4 block with one array per channel, so four texels can be processed at once
+		struct Block {
+			float channels[4][16];
+		};
+
+		// Writes bit fields of a 128 bit block from the least significant bit up
+		class BitWriter
+		{
+		public:
+			uint8_t* data;
+			uint32_t position = 0;
+			BitWriter(uint8_t* data) : data(data)
+			{
+				memset(data, 0, 16);
+			}
+			void write(uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; i++, position++) {
+					data[position >> 3] |= ((value >> i) & 1) << (position & 7);
+				}
+			}
+		};
+
+		struct GLFormat {
+			VkFormat format;
+			uint32_t internalFormat;
+			uint32_t baseInternalFormat;
+		};
+
+		const GLFormat glFormats[] = {
+			{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, 0x83F0 /* GL_COMPRESSED_RGB_S3TC_DXT1_EXT */, 0x1907 /* GL_RGB */ },
+			{ VK_FORMAT_BC3_UNORM_BLOCK, 0x83F3 /* GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */, 0x1908 /* GL_RGBA */ },
+			{ VK_FORMAT_BC5_UNORM_BLOCK, 0x8DBD /* GL_COMPRESSED_RG_RGTC2 */, 0x8227 /* GL_RG */ },
+			{ VK_FORMAT_BC7_UNORM_BLOCK, 0x8E8C /* GL_COMPRESSED_RGBA_BPTC_UNORM */, 0x1908 /* GL_RGBA */ },
+		};
+
+		void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+		{
+			// Blocks at the right and bottom edge of images that aren't a multiple of four repeat the last texels
+			for (uint32_t y = 0; y < 4; y++) {
+				const uint32_t srcY = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					const uint32_t srcX = std::min(blockX * 4 + x, width - 1);
+					const uint8_t* texel = rgba + ((size_t)srcY * width + srcX) * 4;
+					for (uint32_t c = 0; c < 4; c++) {
+						block.channels[c][y * 4 + x] = texel[c];
+					}
+				}
+			}
+		}
+
+		// Fits a line along the principal axis of the texels, the endpoints enclose the projections of all texels
+		void fitEndpoints(const Block& block, uint32_t channelCount, float e0[4], float e1[4])
+		{
+			float mean[4] = {};
+			float minValue[4];
+			float maxValue[4];
+			for (uint32_t c = 0; c < channelCount; c++) {
+				minValue[c] = maxValue[c] = block.channels[c][0];
+				for (uint32_t i = 0; i < 16; i++) {
+					mean[c] += block.channels[c][i];
+					minValue[c] = std::min(minValue[c], block.channels[c][i]);
+					maxValue[c] = std::max(maxValue[c], block.channels[c][i]);
+				}
+				mean[c] /= 16.0f;
+			}
+			float covariance[4][4] = {};
+			for (uint32_t i = 0; i < 16; i++) {
+				for (uint32_t a = 0; a < channelCount; a++) {
+					for (uint32_t b = a; b < channelCount; b++) {
+						covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+					}
+				}
+			}
+			for (uint32_t a = 0; a < channelCount; a++) {
+				for (uint32_t b = 0; b < a; b++) {
+					covariance[a][b] = covariance[b][a];
+				}
+			}
+
+			// Power iteration, starting with the diagonal of the bounding box
+			float axis[4];
+			for (uint32_t c = 0; c < channelCount; c++) {
+				axis[c] = maxValue[c] - minValue[c];
+			}
+			for (uint32_t iteration = 0; iteration < 8; iteration++) {
+				float next[4] = {};
+				float largest = 0.0f;
+				for (uint32_t a = 0; a < channelCount; a++) {
+					for (uint32_t b = 0; b < channelCount; b++) {
+						next[a] += covariance[a][b] * axis[b];
+					}
+					largest = std::max(largest, std::abs(next[a]));
+				}
+				if (largest < 1e-6f) {
+					break;
+				}
+				for (uint32_t c = 0; c < channelCount; c++) {
+					axis[c] = next[c] / largest;
+				}
+			}
+			float length = 0.0f;
+			for (uint32_t c = 0; c < channelCount; c++) {
+				length += axis[c] * axis[c];
+			}
+			if (length < 1e-6f) {
+				// All texels are (almost) identical
+				for (uint32_t c = 0; c < channelCount; c++) {
+					e0[c] = e1[c] = mean[c];
+				}
+				return;
+			}
+			length = std::sqrt(length);
+			for (uint32_t c = 0; c < channelCount; c++) {
+				axis[c] /= length;
+			}
+
+			float minT = 0.0f;
+			float maxT = 0.0f;
+			for (uint32_t i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (uint32_t c = 0; c < channelCount; c++) {
+					t += (block.channels[c][i] - mean[c]) * axis[c];
+				}
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+			for (uint32_t c = 0; c < channelCount; c++) {
+				e0[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+				e1[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+			}
+		}
+
+		// Projects the texels onto the line between the endpoints and returns the closest of the evenly spaced steps from e0 (0) to e1 (steps - 1)
+		void projectIndices(const Block& block, uint32_t channelCount, const float e0[4], const float e1[4], uint32_t steps, uint8_t indices[16])
+		{
+			float direction[4];
+			float lengthSquared = 0.0f;
+			for (uint32_t c = 0; c < channelCount; c++) {
+				direction[c] = e1[c] - e0[c];
+				lengthSquared += direction[c] * direction[c];
+			}
+			if (lengthSquared < 1e-6f) {
+				memset(indices, 0, 16);
+				return;
+			}
+			const float scale = (float)(steps - 1) / lengthSquared;
+#if defined(VKS_COMPRESSOR_SSE2)
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 maxStep = _mm_set1_ps((float)(steps - 1));
+			for (uint32_t i = 0; i < 16; i += 4) {
+				__m128 t = zero;
+				for (uint32_t c = 0; c < channelCount; c++) {
+					const __m128 offset = _mm_sub_ps(_mm_loadu_ps(&block.channels[c][i]), _mm_set1_ps(e0[c]));
+					t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c] * scale)));
+				}
+				t = _mm_min_ps(_mm_max_ps(t, zero), maxStep);
+				// Rounds to nearest
+				int32_t rounded[4];
+				_mm_storeu_si128((__m128i*)rounded, _mm_cvtps_epi32(t));
+				for (uint32_t j = 0; j < 4; j++) {
+					indices[i + j] = (uint8_t)rounded[j];
+				}
+			}
+#else
+			for (uint32_t i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (uint32_t c = 0; c < channelCount; c++) {
+					t += (block.channels[c][i] - e0[c]) * direction[c] * scale;
+				}
+				t = std::min(std::max(t, 0.0f), (float)(steps - 1));
+				indices[i] = (uint8_t)(t + 0.5f);
+			}
+#endif
+		}
+
+		// Least squares fit of the endpoints for the given indices, reduces the error of blocks whose texels aren't spread evenly along the line
+		void refineEndpoints(const Block& block, uint32_t channelCount, const uint8_t indices[16], uint32_t steps, float e0[4], float e1[4])
+		{
+			float a = 0.0f, b = 0.0f, c = 0.0f;
+			float x0[4] = {};
+			float x1[4] = {};
+			for (uint32_t i = 0; i < 16; i++) {
+				const float w = (float)indices[i] / (float)(steps - 1);
+				a += (1.0f - w) * (1.0f - w);
+				b += (1.0f - w) * w;
+				c += w * w;
+				for (uint32_t ch = 0; ch < channelCount; ch++) {
+					x0[ch] += (1.0f - w) * block.channels[ch][i];
+					x1[ch] += w * block.channels[ch][i];
+				}
+			}
+			const float determinant = a * c - b * b;
+			if (std::abs(determinant) < 1e-6f) {
+				return;
+			}
+			for (uint32_t ch = 0; ch < channelCount; ch++) {
+				e0[ch] = std::min(std::max((c * x0[ch] - b * x1[ch]) / determinant, 0.0f), 255.0f);
+				e1[ch] = std::min(std::max((a * x1[ch] - b * x0[ch]) / determinant, 0.0f), 255.0f);
+			}
+		}
+
+		uint16_t packRGB565(const float color[4])
+		{
+			const uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+			const uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+			const uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+			return (uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		void unpackRGB565(uint16_t packed, float color[4])
+		{
+			const uint32_t r = (packed >> 11) & 31;
+			const uint32_t g = (packed >> 5) & 63;
+			const uint32_t b = packed & 31;
+			color[0] = (float)((r << 3) | (r >> 2));
+			color[1] = (float)((g << 2) | (g >> 4));
+			color[2] = (float)((b << 3) | (b >> 2));
+		}
+
+		// Four color mode, also used for the color part of BC3
+		void encodeBC1(const Block& block, uint8_t* output)
+		{
+			float e0[4], e1[4];
+			uint8_t steps[16];
+			fitEndpoints(block, 3, e0, e1);
+			projectIndices(block, 3, e0, e1, 4, steps);
+			refineEndpoints(block, 3, steps, 4, e0, e1);
+
+			uint16_t c0 = packRGB565(e0);
+			uint16_t c1 = packRGB565(e1);
+			uint32_t indices = 0;
+			if (c0 != c1) {
+				// Select the indices for the quantized endpoints
+				unpackRGB565(c0, e0);
+				unpackRGB565(c1, e1);
+				projectIndices(block, 3, e0, e1, 4, steps);
+				// The four color mode requires c0 > c1
+				if (c0 < c1) {
+					std::swap(c0, c1);
+					for (uint32_t i = 0; i < 16; i++) {
+						steps[i] = 3 - steps[i];
+					}
+				}
+				// The palette is stored as c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+				const uint32_t stepToIndex[4] = { 0, 2, 3, 1 };
+				for (uint32_t i = 0; i < 16; i++) {
+					indices |= stepToIndex[steps[i]] << (i * 2);
+				}
+			}
+			output[0] = c0 & 0xFF;
+			output[1] = c0 >> 8;
+			output[2] = c1 & 0xFF;
+			output[3] = c1 >> 8;
+			memcpy(output + 4, &indices, sizeof(indices));
+		}
+
+		// Eight value mode, used for the alpha part of BC3 and both channels of BC5
+		void encodeBC4(const float values[16], uint8_t* output)
+		{
+			float minValue = values[0];
+			float maxValue = values[0];
+			for (uint32_t i = 1; i < 16; i++) {
+				minValue = std::min(minValue, values[i]);
+				maxValue = std::max(maxValue, values[i]);
+			}
+			const uint32_t a0 = (uint32_t)(maxValue + 0.5f);
+			const uint32_t a1 = (uint32_t)(minValue + 0.5f);
+			uint64_t indices = 0;
+			if (a0 != a1) {
+				// The palette is stored as a0, a1 and six values interpolated from a0 to a1
+				const float scale = 7.0f / (float)(a0 - a1);
+				for (uint32_t i = 0; i < 16; i++) {
+					const uint32_t step = (uint32_t)std::min(std::max(((float)a0 - values[i]) * scale + 0.5f, 0.0f), 7.0f);
+					const uint64_t index = (step == 0) ? 0 : ((step == 7) ? 1 : step + 1);
+					indices |= index << (i * 3);
+				}
+			}
+			output[0] = (uint8_t)a0;
+			output[1] = (uint8_t)a1;
+			for (uint32_t i = 0; i < 6; i++) {
+				output[2 + i] = (uint8_t)(indices >> (i * 8));
+			}
+		}
+
+		void encodeBC3(const Block& block, uint8_t* output)
+		{
+			encodeBC4(block.channels[3], output);
+			encodeBC1(block, output + 8);
+		}
+
+		void encodeBC5(const Block& block, uint8_t* output)
+		{
+			encodeBC4(block.channels[0], output);
+			encodeBC4(block.channels[1], output + 8);
+		}
+
+		// Mode 6: A single subset with seven bit RGBA endpoints, a shared lowest bit per endpoint and four bit indices
+		void encodeBC7(const Block& block, uint8_t* output)
+		{
+			float e[2][4];
+			uint8_t steps[16];
+			fitEndpoints(block, 4, e[0], e[1]);
+			projectIndices(block, 4, e[0], e[1], 16, steps);
+			refineEndpoints(block, 4, steps, 16, e[0], e[1]);
+
+			// Pick the lowest bit that results in the smallest quantization error for each endpoint
+			uint32_t quantized[2][4];
+			uint32_t pBits[2];
+			for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+				float bestError = FLT_MAX;
+				for (uint32_t p = 0; p < 2; p++) {
+					uint32_t candidate[4];
+					float error = 0.0f;
+					for (uint32_t c = 0; c < 4; c++) {
+						candidate[c] = (uint32_t)std::min(std::max((e[endpoint][c] - (float)p) / 2.0f + 0.5f, 0.0f), 127.0f);
+						const float difference = (float)((candidate[c] << 1) | p) - e[endpoint][c];
+						error += difference * difference;
+					}
+					if (error < bestError) {
+						bestError = error;
+						pBits[endpoint] = p;
+						memcpy(quantized[endpoint], candidate, sizeof(candidate));
+					}
+				}
+				for (uint32_t c = 0; c < 4; c++) {
+					e[endpoint][c] = (float)((quantized[endpoint][c] << 1) | pBits[endpoint]);
+				}
+			}
+			// The weights of four bit indices are close enough to even steps to select them by projection
+			projectIndices(block, 4, e[0], e[1], 16, steps);
+
+			// The highest bit of the first index is implicitly zero
+			if (steps[0] >= 8) {
+				std::swap(quantized[0], quantized[1]);
+				std::swap(pBits[0], pBits[1]);
+				for (uint32_t i = 0; i < 16; i++) {
+					steps[i] = 15 - steps[i];
+				}
+			}
+
+			BitWriter writer(output);
+			writer.write(1 << 6, 7);
+			for (uint32_t c = 0; c < 4; c++) {
+				writer.write(quantized[0][c], 7);
+				writer.write(quantized[1][c], 7);
+			}
+			writer.write(pBits[0], 1);
+			writer.write(pBits[1], 1);
+			writer.write(steps[0], 3);
+			for (uint32_t i = 1; i < 16; i++) {
+				writer.write(steps[i], 4);
+			}
+		}
+	}
+
+	std::string TextureCompressor::getDefaultCacheDirectory()
+	{
+#if defined(__ANDROID__)
+		return std::string(androidApp->activity->internalDataPath) + "/texture_cache";
+#else
+		return "texture_cache";
+#endif
+	}
+
+	MipGenerator::Content TextureCompressor::getMipContent(Usage usage)
+	{
+		switch (usage) {
+		case Usage::Normal:
+			return MipGenerator::Content::NormalMap;
+		case Usage::Data:
+			return MipGenerator::Content::Linear;
+		default:
+			return MipGenerator::Content::SRGB;
+		}
+	}
+
+	void TextureCompressor::create(vks::VulkanDevice* vulkanDevice)
+	{
+		this->vulkanDevice = vulkanDevice;
+		// BCn formats can only be used if the feature has been enabled for the device
+		if (vulkanDevice->enabledFeatures.textureCompressionBC) {
+			auto isSupported = [vulkanDevice](VkFormat format) {
+				VkFormatProperties formatProperties;
+				vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, format, &formatProperties);
+				return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+			};
+			supportsBC1 = isSupported(VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+			supportsBC3 = isSupported(VK_FORMAT_BC3_UNORM_BLOCK);
+			supportsBC5 = isSupported(VK_FORMAT_BC5_UNORM_BLOCK);
+			supportsBC7 = isSupported(VK_FORMAT_BC7_UNORM_BLOCK);
+		}
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+	}
+
+	VkFormat TextureCompressor::getFormat(Usage usage, bool hasAlpha) const
+	{
+		const bool useBC7 = supportsBC7 && settings.preferBC7;
+		if ((usage == Usage::Normal) && settings.twoChannelNormals) {
+			return supportsBC5 ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+		}
+		if (hasAlpha) {
+			if (useBC7) {
+				return VK_FORMAT_BC7_UNORM_BLOCK;
+			}
+			return supportsBC3 ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+		}
+		// BC1 correlates the channels, which suits colors but not independent material parameters
+		if ((usage != Usage::Color) && useBC7) {
+			return VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+		return supportsBC1 ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+	}
+
+	size_t TextureCompressor::getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		const size_t blockSize = (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK) ? 8 : 16;
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+	}
+
+	void TextureCompressor::compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat format, std::vector<uint8_t>& data)
+	{
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+		const size_t blockSize = (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK) ? 8 : 16;
+		data.resize(getLevelSize(format, width, height));
+		threadPool.parallelFor(blocksY, [&](uint32_t begin, uint32_t end) {
+			Block block;
+			for (uint32_t blockY = begin; blockY < end; blockY++) {
+				uint8_t* output = data.data() + (size_t)blockY * blocksX * blockSize;
+				for (uint32_t blockX = 0; blockX < blocksX; blockX++, output += blockSize) {
+					loadBlock(rgba, width, height, blockX, blockY, block);
+					switch (format) {
+					case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+						encodeBC1(block, output);
+						break;
+					case VK_FORMAT_BC3_UNORM_BLOCK:
+						encodeBC3(block, output);
+						break;
+					case VK_FORMAT_BC5_UNORM_BLOCK:
+						encodeBC5(block, output);
+						break;
+					default:
+						encodeBC7(block, output);
+						break;
+					}
+				}
+			}
+		});
+	}
+
+	bool TextureCompressor::compress(const uint8_t* rgba, uint32_t width, uint32_t height, Usage usage, Image& image)
+	{
+		assert(vulkanDevice);
+		bool hasAlpha = false;
+		for (size_t i = 0; i < (size_t)width * height && !hasAlpha; i++) {
+			hasAlpha = rgba[i * 4 + 3] < 255;
+		}
+		const VkFormat format = getFormat(usage, hasAlpha);
+		if (format == VK_FORMAT_UNDEFINED) {
+			return false;
+		}
+
+		image.format = format;
+		image.width = width;
+		image.height = height;
+
+		// Colors are filtered in linear space and normals renormalized before compressing, so the smaller levels keep their brightness and lighting
+		MipGenerator mipGenerator(&threadPool);
+		mipGenerator.settings.filter = settings.mipFilter;
+		std::vector<std::vector<uint8_t>> levels;
+		mipGenerator.generate(rgba, width, height, getMipContent(usage), levels);
+		image.levels.resize(levels.size());
+		for (uint32_t level = 0; level < image.levels.size(); level++) {
+			compressLevel(levels[level].data(), std::max(1u, width >> level), std::max(1u, height >> level), format, image.levels[level]);
+		}
+		return true;
+	}
+
+	bool TextureCompressor::compressEncodedImage(const std::vector<unsigned char>& fileData, Usage usage, Image& image)
+	{
+		assert(vulkanDevice);
+		if (!supportsBC1 && !supportsBC3 && !supportsBC5 && !supportsBC7) {
+			return false;
+		}
+
+		std::string cacheFilename;
+		if (!settings.cacheDirectory.empty()) {
+			// The selected format depends on the settings and the formats supported by the device
+			uint64_t key = tools::hashValue(cacheVersion, usage);
+			key = tools::hashValue(key, settings.preferBC7);
+			key = tools::hashValue(key, settings.twoChannelNormals);
+			key = tools::hashValue(key, settings.mipFilter);
+			key = tools::hashValue(key, (supportsBC1 ? 1 : 0) | (supportsBC3 ? 2 : 0) | (supportsBC5 ? 4 : 0) | (supportsBC7 ? 8 : 0));
+			key = tools::hash(fileData.data(), fileData.size(), key);
+			char hex[17];
+			snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+			cacheFilename = settings.cacheDirectory + "/" + hex + ".ktx";
+			if (loadFromCache(cacheFilename, image)) {
+				return true;
+			}
+		}
+
+		int width, height, components;
+		stbi_uc* pixels = stbi_load_from_memory(fileData.data(), (int)fileData.size(), &width, &height, &components, 4);
+		if (!pixels) {
+			return false;
+		}
+		const bool compressed = compress(pixels, (uint32_t)width, (uint32_t)height, usage, image);
+		stbi_image_free(pixels);
+		if (compressed && !cacheFilename.empty()) {
+			storeToCache(cacheFilename, image);
+		}
+		return compressed;
+	}
+
+	bool TextureCompressor::loadFromCache(const std::string& filename, Image& image)
+	{
+		if (!tools::fileExists(filename)) {
+			return false;
+		}
+		ktxTexture* ktxTexture;
+		if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+			return false;
+		}
+		const GLFormat* glFormat = nullptr;
+		for (const GLFormat& candidate : glFormats) {
+			if (candidate.internalFormat == ktxTexture->glInternalformat) {
+				glFormat = &candidate;
+			}
+		}
+		if (!glFormat || (ktxTexture->numDimensions != 2) || ktxTexture->isArray || ktxTexture->isCubemap) {
+			ktxTexture_Destroy(ktxTexture);
+			return false;
+		}
+		image.format = glFormat->format;
+		image.width = ktxTexture->baseWidth;
+		image.height = ktxTexture->baseHeight;
+		image.levels.resize(ktxTexture->numLevels);
+		for (uint32_t level = 0; level < ktxTexture->numLevels; level++) {
+			ktx_size_t offset;
+			ktxTexture_GetImageOffset(ktxTexture, level, 0, 0, &offset);
+			const uint8_t* data = ktxTexture_GetData(ktxTexture) + offset;
+			image.levels[level].assign(data, data + ktxTexture_GetImageSize(ktxTexture, level));
+		}
+		ktxTexture_Destroy(ktxTexture);
+		return true;
+	}
+
+	void TextureCompressor::storeToCache(const std::string& filename, const Image& image)
+	{
+		if (!tools::createDirectory(settings.cacheDirectory)) {
+			std::cerr << "Texture cache: Could not create " << settings.cacheDirectory << ", compressed images won't be cached" << std::endl;
+			settings.cacheDirectory.clear();
+			return;
+		}
+		vks::KTXFile::ImageInfo info;
+		for (const GLFormat& glFormat : glFormats) {
+			if (glFormat.format == image.format) {
+				info.glInternalFormat = glFormat.internalFormat;
+				info.glBaseInternalFormat = glFormat.baseInternalFormat;
+			}
+		}
+		info.width = image.width;
+		info.height = image.height;
+		info.mipLevels = static_cast<uint32_t>(image.levels.size());
+		std::vector<size_t> imageSizes;
+		std::vector<uint8_t> data;
+		for (const std::vector<uint8_t>& level : image.levels) {
+			imageSizes.push_back(level.size());
+			data.insert(data.end(), level.begin(), level.end());
+		}
+		if (!vks::KTXFile::write(filename, info, imageSizes, data.data())) {
+			std::cerr << "Texture cache: Could not write " << filename << std::endl;
+		}
+	}
+}
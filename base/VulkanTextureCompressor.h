@@ -0,0 +1,94 @@
+/*
+* Vulkan texture block compression
+*
+* Compresses images that are not stored in a GPU format (png, jpg, ...) to BCn on the CPU and caches the results on disk
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "threadpool.hpp"
+#include "VulkanMipGenerator.h"
+
+namespace vks
+{
+	/**
+	* @brief Block compresses RGBA8 images including their full mip chain
+	* @note Blocks are encoded on a thread pool. Encoded image files (png, jpg, ...) are keyed by a hash of their contents, so the compressed result is only generated once and loaded from a KTX file in the cache directory afterwards.
+	* BC7 is limited to mode 6 (single subset with alpha), which is fast to encode and good enough for the materials used in the samples.
+	*/
+	class TextureCompressor
+	{
+	public:
+		/** @brief How an image is sampled, selects the compressed format */
+		enum class Usage {
+			/** @brief Base color and emissive maps, BC1 if opaque, BC7 (or BC3) otherwise */
+			Color,
+			/** @brief Tangent space normal maps, BC5 with z reconstructed in the shader (see Settings::twoChannelNormals) */
+			Normal,
+			/** @brief Packed material parameters like occlusion, roughness and metallic, BC7 (or BC1) */
+			Data
+		};
+
+		struct Settings {
+			/** @brief Use BC7 if supported, otherwise colors with alpha use BC3 and data maps use BC1 */
+			bool preferBC7 = true;
+			/** @brief Store normal maps as BC5 (x and y only). If disabled they're compressed like data maps, for shaders that read z from the texture. */
+			bool twoChannelNormals = true;
+			/** @brief Filter used to generate the mip levels before they are compressed */
+			MipGenerator::Filter mipFilter = MipGenerator::Filter::Kaiser;
+			/** @brief Compressed images are stored in this directory, caching is disabled if empty */
+			std::string cacheDirectory = getDefaultCacheDirectory();
+		} settings;
+
+		/** @brief A compressed image with all of its mip levels */
+		struct Image {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<std::vector<uint8_t>> levels;
+		};
+
+		void create(vks::VulkanDevice* vulkanDevice);
+
+		/** @brief Returns the format an image is compressed to, VK_FORMAT_UNDEFINED if the device doesn't support a matching BCn format */
+		VkFormat getFormat(Usage usage, bool hasAlpha) const;
+		/**
+		* @brief Compresses an RGBA8 image and the mip levels generated from it
+		* @return False if the device doesn't support a matching format
+		*/
+		bool compress(const uint8_t* rgba, uint32_t width, uint32_t height, Usage usage, Image& image);
+		/**
+		* @brief Loads the compressed result of an encoded image file from the cache, or decodes and compresses it and stores the result in the cache
+		* @return False if the device doesn't support a matching format or the file can't be decoded
+		*/
+		bool compressEncodedImage(const std::vector<unsigned char>& fileData, Usage usage, Image& image);
+
+		/** @brief Size of a compressed level in bytes */
+		static size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+		static std::string getDefaultCacheDirectory();
+		/** @brief How the mip levels of an image with the given usage are filtered */
+		static MipGenerator::Content getMipContent(Usage usage);
+	private:
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		vks::ThreadPool threadPool;
+		// Formats the device can sample from with optimal tiling
+		bool supportsBC1 = false;
+		bool supportsBC3 = false;
+		bool supportsBC5 = false;
+		bool supportsBC7 = false;
+
+		void compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat format, std::vector<uint8_t>& data);
+		bool loadFromCache(const std::string& filename, Image& image);
+		void storeToCache(const std::string& filename, const Image& image);
+	};
+}
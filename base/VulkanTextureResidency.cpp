@@ -0,0 +1,481 @@
+/*
+* Vulkan texture residency
+*
+* Keeps the device memory used by textures within a budget by dropping the largest mip levels of the least recently used textures
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureResidency.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace vks
+{
+	TextureResidencyManager::~TextureResidencyManager()
+	{
+		destroy();
+	}
+
+	void TextureResidencyManager::create(vks::VulkanDevice* vulkanDevice, VkQueue queue, VkInstance instance)
+	{
+		destroy();
+		this->vulkanDevice = vulkanDevice;
+		this->device = vulkanDevice->logicalDevice;
+		this->queue = queue;
+		// Textures are allocated from the heap of the first device local memory type, this is updated once the first image has been allocated
+		for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryTypeCount; i++) {
+			if (vulkanDevice->memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+				memoryHeapIndex = vulkanDevice->memoryProperties.memoryTypes[i].heapIndex;
+				break;
+			}
+		}
+		// The budget is a physical device query, so the extension only has to be supported (and VK_KHR_get_physical_device_properties2 enabled on the instance)
+		if ((instance != VK_NULL_HANDLE) && vulkanDevice->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+			vkGetPhysicalDeviceMemoryProperties2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		}
+		budget = queryBudget();
+	}
+
+	void TextureResidencyManager::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& texture : textures) {
+			if (texture) {
+				retire(*texture);
+			}
+		}
+		for (auto& retiredImage : retiredImages) {
+			vkDestroyImageView(device, retiredImage.view, nullptr);
+			vkDestroyImage(device, retiredImage.image, nullptr);
+			vkFreeMemory(device, retiredImage.deviceMemory, nullptr);
+		}
+		retiredImages.clear();
+		textures.clear();
+		freeHandles.clear();
+		residentSize = 0;
+		vkGetPhysicalDeviceMemoryProperties2KHR = nullptr;
+		vulkanDevice = nullptr;
+		device = VK_NULL_HANDLE;
+	}
+
+	uint32_t TextureResidencyManager::getLevelDimension(uint32_t dimension, uint32_t level)
+	{
+		return std::max(1u, dimension >> level);
+	}
+
+	uint64_t TextureResidencyManager::getTexelCount(const ResidentTexture& texture, uint32_t residentLevel)
+	{
+		uint64_t texelCount = 0;
+		for (uint32_t level = residentLevel; level < texture.source->mipLevels; level++) {
+			texelCount += (uint64_t)getLevelDimension(texture.source->width, level) * getLevelDimension(texture.source->height, level);
+		}
+		return texelCount;
+	}
+
+	VkDeviceSize TextureResidencyManager::estimateSize(const ResidentTexture& texture, uint32_t residentLevel)
+	{
+		// Scales the size of the current image by the texel count, which doesn't depend on the format
+		const double scale = (double)getTexelCount(texture, residentLevel) / (double)getTexelCount(texture, texture.residentLevel);
+		return (VkDeviceSize)(texture.size * scale);
+	}
+
+	VkDeviceSize TextureResidencyManager::queryBudget() const
+	{
+		if (settings.budget > 0) {
+			return settings.budget;
+		}
+		if (vkGetPhysicalDeviceMemoryProperties2KHR) {
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memoryProperties2.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2KHR(vulkanDevice->physicalDevice, &memoryProperties2);
+			// The heap usage includes the textures, everything else allocated by this and other processes reduces what's left for them
+			const VkDeviceSize heapUsage = budgetProperties.heapUsage[memoryHeapIndex];
+			const VkDeviceSize heapBudget = budgetProperties.heapBudget[memoryHeapIndex];
+			const VkDeviceSize otherUsage = (heapUsage > residentSize) ? heapUsage - residentSize : 0;
+			return (heapBudget > otherUsage) ? (VkDeviceSize)((heapBudget - otherUsage) * settings.heapBudgetFraction) : 0;
+		}
+		return (VkDeviceSize)(vulkanDevice->memoryProperties.memoryHeaps[memoryHeapIndex].size * settings.heapBudgetFraction);
+	}
+
+	void TextureResidencyManager::createImage(ResidentTexture& texture, uint32_t residentLevel, VkImage& image, VkDeviceMemory& deviceMemory, VkDeviceSize& size)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = texture.format;
+		imageCI.mipLevels = texture.source->mipLevels - residentLevel;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCI.extent = { getLevelDimension(texture.source->width, residentLevel), getLevelDimension(texture.source->height, residentLevel), 1 };
+		// Levels shared with the next image are copied from this one
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, image, deviceMemory, 0));
+		memoryHeapIndex = vulkanDevice->memoryProperties.memoryTypes[memAllocInfo.memoryTypeIndex].heapIndex;
+		size = memReqs.size;
+	}
+
+	VkImageView TextureResidencyManager::createView(const ResidentTexture& texture, VkImage image, uint32_t residentLevel) const
+	{
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = texture.format;
+		viewCI.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.source->mipLevels - residentLevel, 0, 1 };
+		viewCI.image = image;
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+		return view;
+	}
+
+	void TextureResidencyManager::retire(ResidentTexture& texture)
+	{
+		if (texture.image == VK_NULL_HANDLE) {
+			return;
+		}
+		retiredImages.push_back({ texture.image, texture.deviceMemory, texture.view, updateIndex });
+		residentSize -= texture.size;
+		texture.image = VK_NULL_HANDLE;
+		texture.deviceMemory = VK_NULL_HANDLE;
+		texture.view = VK_NULL_HANDLE;
+		texture.size = 0;
+	}
+
+	void TextureResidencyManager::resize(const std::vector<Resize>& resizes)
+	{
+		if (resizes.empty()) {
+			return;
+		}
+
+		// Levels that aren't in the current images are read from the sources into a single staging buffer
+		struct Upload {
+			size_t resize;
+			uint32_t level;
+			std::vector<uint8_t> data;
+			VkDeviceSize offset;
+		};
+		std::vector<Upload> uploads;
+		VkDeviceSize stagingSize = 0;
+		for (size_t i = 0; i < resizes.size(); i++) {
+			const ResidentTexture& texture = *resizes[i].texture;
+			const uint32_t firstCopiedLevel = (texture.image != VK_NULL_HANDLE) ? texture.residentLevel : texture.source->mipLevels;
+			for (uint32_t level = resizes[i].residentLevel; level < firstCopiedLevel; level++) {
+				Upload upload;
+				upload.resize = i;
+				upload.level = level;
+				VkDeviceSize rowPitch;
+				if (!texture.source->readLevel(level, upload.data, rowPitch)) {
+					vks::tools::exitFatal("Could not read mip level " + std::to_string(level) + " of a resident texture", -1);
+				}
+				// Buffer offsets for copies need to be aligned to the texel block size
+				upload.offset = (stagingSize + 15) & ~(VkDeviceSize)15;
+				stagingSize = upload.offset + upload.data.size();
+				uploads.push_back(std::move(upload));
+			}
+		}
+		vks::Buffer stagingBuffer;
+		if (stagingSize > 0) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, stagingSize));
+			VK_CHECK_RESULT(stagingBuffer.map());
+			for (Upload& upload : uploads) {
+				memcpy((uint8_t*)stagingBuffer.mapped + upload.offset, upload.data.data(), upload.data.size());
+				std::vector<uint8_t>().swap(upload.data);
+			}
+		}
+
+		struct NewImage {
+			VkImage image;
+			VkDeviceMemory deviceMemory;
+			VkDeviceSize size;
+		};
+		std::vector<NewImage> newImages(resizes.size());
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (size_t i = 0; i < resizes.size(); i++) {
+			ResidentTexture& texture = *resizes[i].texture;
+			const uint32_t newLevel = resizes[i].residentLevel;
+			NewImage& newImage = newImages[i];
+			createImage(texture, newLevel, newImage.image, newImage.deviceMemory, newImage.size);
+			const VkImageSubresourceRange newRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.source->mipLevels - newLevel, 0, 1 };
+			vks::tools::setImageLayout(copyCmd, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newRange);
+
+			// Levels both images have are copied on the device, levels are addressed relative to each image's first level
+			if (texture.image != VK_NULL_HANDLE) {
+				const uint32_t firstSharedLevel = std::max(newLevel, texture.residentLevel);
+				const VkImageSubresourceRange oldRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstSharedLevel - texture.residentLevel, texture.source->mipLevels - firstSharedLevel, 0, 1 };
+				std::vector<VkImageCopy> imageCopies;
+				for (uint32_t level = firstSharedLevel; level < texture.source->mipLevels; level++) {
+					VkImageCopy imageCopy{};
+					imageCopy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.residentLevel, 0, 1 };
+					imageCopy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - newLevel, 0, 1 };
+					imageCopy.extent = { getLevelDimension(texture.source->width, level), getLevelDimension(texture.source->height, level), 1 };
+					imageCopies.push_back(imageCopy);
+				}
+				vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, oldRange);
+				vkCmdCopyImage(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageCopies.size()), imageCopies.data());
+				// The old image may still be sampled by frames in flight until it's retired
+				vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, oldRange);
+			}
+
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			for (const Upload& upload : uploads) {
+				if (upload.resize != i) {
+					continue;
+				}
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = upload.level - newLevel;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = getLevelDimension(texture.source->width, upload.level);
+				bufferCopyRegion.imageExtent.height = getLevelDimension(texture.source->height, upload.level);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = upload.offset;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+			}
+			if (!bufferCopyRegions.empty()) {
+				vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+			}
+			vks::tools::setImageLayout(copyCmd, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, newRange);
+		}
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+
+		for (size_t i = 0; i < resizes.size(); i++) {
+			ResidentTexture& texture = *resizes[i].texture;
+			retire(texture);
+			texture.image = newImages[i].image;
+			texture.deviceMemory = newImages[i].deviceMemory;
+			texture.size = newImages[i].size;
+			texture.residentLevel = resizes[i].residentLevel;
+			texture.view = createView(texture, texture.image, texture.residentLevel);
+			residentSize += texture.size;
+			if (texture.onUpdated) {
+				texture.onUpdated(texture.view);
+			}
+		}
+	}
+
+	TextureResidencyManager::Texture TextureResidencyManager::add(std::unique_ptr<TextureStreamer::Source> source, VkFormat format, UpdateCallback onUpdated, const VkSamplerCreateInfo* samplerCreateInfo)
+	{
+		assert(vulkanDevice);
+		if (!source->prepare()) {
+			vks::tools::exitFatal("Could not prepare the source of a resident texture", -1);
+		}
+		std::unique_ptr<ResidentTexture> texture(new ResidentTexture());
+		texture->format = format;
+		texture->onUpdated = onUpdated;
+		// The tail starts with the first level that's not larger than the tail size
+		while (texture->tailLevel < source->mipLevels - 1 && std::max(getLevelDimension(source->width, texture->tailLevel), getLevelDimension(source->height, texture->tailLevel)) > settings.tailSize) {
+			texture->tailLevel++;
+		}
+		texture->source = std::move(source);
+		texture->residentLevel = texture->tailLevel;
+		// Added textures count as used, so the next update restores their levels if the budget allows
+		texture->requestedLevel = 0;
+		texture->lastUsed = updateIndex;
+
+		Handle handle;
+		if (!freeHandles.empty()) {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+		} else {
+			handle = static_cast<Handle>(textures.size());
+			textures.emplace_back();
+		}
+		// Only the tail is uploaded, without calling back as the view is returned
+		ResidentTexture& residentTexture = *texture;
+		textures[handle] = std::move(texture);
+		residentTexture.onUpdated = nullptr;
+		resize({ { &residentTexture, residentTexture.tailLevel } });
+		residentTexture.onUpdated = onUpdated;
+
+		Texture result;
+		result.handle = handle;
+		result.view = residentTexture.view;
+		result.width = residentTexture.source->width;
+		result.height = residentTexture.source->height;
+		result.mipLevels = residentTexture.source->mipLevels;
+
+		// LODs are relative to the view's base level, so the sampler can cover the full chain
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCI.maxAnisotropy = vulkanDevice->enabledFeatures.samplerAnisotropy ? vulkanDevice->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCI.anisotropyEnable = vulkanDevice->enabledFeatures.samplerAnisotropy;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		result.sampler = vulkanDevice->samplerCache.acquire(samplerCreateInfo ? *samplerCreateInfo : samplerCI);
+		return result;
+	}
+
+	void TextureResidencyManager::remove(Handle handle)
+	{
+		if ((vulkanDevice == nullptr) || (handle >= textures.size()) || !textures[handle]) {
+			return;
+		}
+		retire(*textures[handle]);
+		textures[handle].reset();
+		freeHandles.push_back(handle);
+	}
+
+	void TextureResidencyManager::touch(Handle handle, uint32_t level)
+	{
+		assert((handle < textures.size()) && textures[handle]);
+		ResidentTexture& texture = *textures[handle];
+		if (texture.lastUsed != updateIndex) {
+			texture.requestedLevel = level;
+			texture.lastUsed = updateIndex;
+		} else {
+			texture.requestedLevel = std::min(texture.requestedLevel, level);
+		}
+	}
+
+	void TextureResidencyManager::applyFeedback(const uint32_t* levels, uint32_t count)
+	{
+		const uint32_t textureCount = std::min(count, static_cast<uint32_t>(textures.size()));
+		for (uint32_t handle = 0; handle < textureCount; handle++) {
+			if ((levels[handle] != ~0u) && textures[handle]) {
+				touch(handle, levels[handle]);
+			}
+		}
+	}
+
+	uint32_t TextureResidencyManager::getScreenSizeLevel(uint32_t width, uint32_t height, float screenSize)
+	{
+		const uint32_t maxLevel = static_cast<uint32_t>(floor(log2(std::max(width, height))));
+		if (screenSize <= 0.0f) {
+			return maxLevel;
+		}
+		const float ratio = (float)std::max(width, height) / screenSize;
+		return (ratio <= 1.0f) ? 0 : std::min(static_cast<uint32_t>(floor(log2(ratio))), maxLevel);
+	}
+
+	VkDeviceSize TextureResidencyManager::getTextureSize(Handle handle) const
+	{
+		return ((handle < textures.size()) && textures[handle]) ? textures[handle]->size : 0;
+	}
+
+	uint32_t TextureResidencyManager::getResidentLevel(Handle handle) const
+	{
+		return ((handle < textures.size()) && textures[handle]) ? textures[handle]->residentLevel : 0;
+	}
+
+	bool TextureResidencyManager::update()
+	{
+		if (vulkanDevice == nullptr) {
+			return false;
+		}
+
+		// Images replaced a few updates ago are no longer referenced by frames in flight
+		for (auto it = retiredImages.begin(); it != retiredImages.end();) {
+			if (it->retireUpdate + settings.retireDelay <= updateIndex) {
+				vkDestroyImageView(device, it->view, nullptr);
+				vkDestroyImage(device, it->image, nullptr);
+				vkFreeMemory(device, it->deviceMemory, nullptr);
+				it = retiredImages.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		if (residentSize == 0) {
+			updateIndex++;
+			return false;
+		}
+		budget = queryBudget();
+
+		struct Candidate {
+			ResidentTexture* texture;
+			uint32_t targetLevel;
+			bool dropped;
+		};
+		std::vector<Candidate> candidates;
+		for (auto& texture : textures) {
+			if (texture && (texture->image != VK_NULL_HANDLE)) {
+				candidates.push_back({ texture.get(), texture->residentLevel, false });
+			}
+		}
+
+		// Drop the largest level of one texture at a time until the textures fit, textures with more levels than they were last used with go first, then the least recently used ones
+		VkDeviceSize projectedSize = residentSize;
+		while (projectedSize > budget) {
+			Candidate* victim = nullptr;
+			for (Candidate& candidate : candidates) {
+				if (candidate.targetLevel >= candidate.texture->tailLevel) {
+					continue;
+				}
+				if (victim == nullptr) {
+					victim = &candidate;
+					continue;
+				}
+				const bool hasExcess = candidate.targetLevel < candidate.texture->requestedLevel;
+				const bool victimHasExcess = victim->targetLevel < victim->texture->requestedLevel;
+				if ((hasExcess && !victimHasExcess) || ((hasExcess == victimHasExcess) && (candidate.texture->lastUsed < victim->texture->lastUsed))) {
+					victim = &candidate;
+				}
+			}
+			if (victim == nullptr) {
+				// Only tails are left
+				break;
+			}
+			projectedSize -= estimateSize(*victim->texture, victim->targetLevel) - estimateSize(*victim->texture, victim->targetLevel + 1);
+			victim->targetLevel++;
+			victim->dropped = true;
+		}
+
+		// Restore levels of textures used since the last update one level at a time, so the budget is spread evenly
+		VkDeviceSize uploadSize = 0;
+		bool restored = true;
+		while (restored) {
+			restored = false;
+			for (Candidate& candidate : candidates) {
+				ResidentTexture& texture = *candidate.texture;
+				if (candidate.dropped || (texture.lastUsed != updateIndex) || (candidate.targetLevel <= texture.requestedLevel)) {
+					continue;
+				}
+				const VkDeviceSize cost = estimateSize(texture, candidate.targetLevel - 1) - estimateSize(texture, candidate.targetLevel);
+				// At least one level is restored per update, even if it exceeds the upload limit on its own
+				if ((projectedSize + cost <= budget) && ((uploadSize == 0) || (uploadSize + cost <= settings.uploadBudget))) {
+					candidate.targetLevel--;
+					projectedSize += cost;
+					uploadSize += cost;
+					restored = true;
+				}
+			}
+		}
+
+		std::vector<Resize> resizes;
+		for (const Candidate& candidate : candidates) {
+			if (candidate.targetLevel != candidate.texture->residentLevel) {
+				resizes.push_back({ candidate.texture, candidate.targetLevel });
+			}
+		}
+		resize(resizes);
+		updateIndex++;
+		return !resizes.empty();
+	}
+}
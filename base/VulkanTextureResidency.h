@@ -0,0 +1,162 @@
+/*
+* Vulkan texture residency
+*
+* Keeps the device memory used by textures within a budget by dropping the largest mip levels of the least recently used textures
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTextureStreamer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Tracks the device memory of 2D textures and moves their resident mip levels up and down the chain to stay within a memory budget
+	* @note The budget is taken from VK_EXT_memory_budget if the physical device supports it, from the size of the device local heap otherwise.
+	* When over budget, the largest level of the least recently used texture is dropped by recreating its image without that level, repeated until the textures fit.
+	* Textures that are used at a finer level than resident get their levels restored from their source within a per update upload limit, as long as the budget allows.
+	* Usage is reported with touch(), either from CPU estimates (getScreenSizeLevel) or with the levels written by shaders to a feedback buffer (applyFeedback).
+	*/
+	class TextureResidencyManager
+	{
+	public:
+		struct Settings {
+			/** @brief Bytes textures may use, 0 derives the budget from the memory heap textures are allocated from */
+			VkDeviceSize budget = 0;
+			/** @brief Share of the heap textures may use if no fixed budget is set, with VK_EXT_memory_budget it's the share of the heap budget left after all other allocations */
+			float heapBudgetFraction = 0.7f;
+			/** @brief Upper limit of bytes uploaded per update when restoring levels */
+			VkDeviceSize uploadBudget = 32 * 1024 * 1024;
+			/** @brief Mip levels whose largest dimension is at most this size are always resident */
+			uint32_t tailSize = 128;
+			/** @brief Replaced images are destroyed after this many updates, has to cover the frames in flight */
+			uint32_t retireDelay = 3;
+		} settings;
+
+		typedef uint32_t Handle;
+		static const Handle invalidHandle = ~0u;
+
+		/**
+		* @brief Called after the texture's image has been replaced with one covering a different range of mip levels
+		* @note The previous view stays valid for settings.retireDelay updates, descriptors and command buffers referencing it have to be updated before that
+		*/
+		typedef std::function<void(VkImageView view)> UpdateCallback;
+
+		/** @brief A texture added to the manager, the image and view are owned by the manager and change as levels are dropped or restored */
+		struct Texture {
+			Handle handle = invalidHandle;
+			VkImageView view = VK_NULL_HANDLE;
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+		};
+
+		~TextureResidencyManager();
+
+		/** @param instance Used to query VK_EXT_memory_budget, if null (or the extension isn't supported) the budget is derived from the heap size */
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue, VkInstance instance = VK_NULL_HANDLE);
+		/** @brief Destroys the images of all textures that haven't been removed yet */
+		void destroy();
+
+		/**
+		* @brief Adds a texture whose levels are read from the source, only the mip tail is uploaded right away
+		* @note Sources have to be able to read the same level more than once
+		* @param samplerCreateInfo Optional sampler parameters, defaults to repeating trilinear filtering. The sampler is acquired from the device's sampler cache and owned by the caller.
+		*/
+		Texture add(std::unique_ptr<TextureStreamer::Source> source, VkFormat format, UpdateCallback onUpdated, const VkSamplerCreateInfo* samplerCreateInfo = nullptr);
+		/** @brief Destroys the texture's image once it's no longer in use */
+		void remove(Handle handle);
+
+		/**
+		* @brief Marks a texture as used in the current frame
+		* @param level Finest mip level the texture is sampled at, levels of all touches between two updates are combined
+		*/
+		void touch(Handle handle, uint32_t level = 0);
+		/**
+		* @brief Touches textures with the levels read back from a feedback buffer
+		* @note The buffer is indexed by handle, shaders write the level they sample at with atomicMin (e.g. from textureQueryLod), entries of untouched textures are ~0u
+		*/
+		void applyFeedback(const uint32_t* levels, uint32_t count);
+		/** @brief Estimates the mip level a texture is sampled at if it covers the given number of pixels along its larger dimension on screen */
+		static uint32_t getScreenSizeLevel(uint32_t width, uint32_t height, float screenSize);
+
+		/**
+		* @brief Drops and restores mip levels to match the budget and the usage reported since the last update
+		* @note Call once per frame from the thread that owns the queue
+		* @return True if views have been replaced (and command buffers referencing them need to be rebuilt)
+		*/
+		bool update();
+
+		/** @brief Device memory currently used by all textures */
+		VkDeviceSize getResidentSize() const { return residentSize; }
+		/** @brief Device memory used by a texture */
+		VkDeviceSize getTextureSize(Handle handle) const;
+		/** @brief First mip level of a texture that's resident */
+		uint32_t getResidentLevel(Handle handle) const;
+		/** @brief Budget used in the last update */
+		VkDeviceSize getBudget() const { return budget; }
+		bool isCreated() const { return device != VK_NULL_HANDLE; }
+	private:
+		struct ResidentTexture {
+			std::unique_ptr<TextureStreamer::Source> source;
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			// Level of the full chain stored in the first level of the image
+			uint32_t residentLevel = 0;
+			// Smallest level that can't be dropped
+			uint32_t tailLevel = 0;
+			// Finest level requested by touches since the texture was last used
+			uint32_t requestedLevel = 0;
+			uint64_t lastUsed = 0;
+			UpdateCallback onUpdated;
+		};
+		// An image replacing the image of a texture, levels it shares with the old image are copied on the device
+		struct Resize {
+			ResidentTexture* texture;
+			uint32_t residentLevel;
+		};
+		struct RetiredImage {
+			VkImage image;
+			VkDeviceMemory deviceMemory;
+			VkImageView view;
+			uint64_t retireUpdate;
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR vkGetPhysicalDeviceMemoryProperties2KHR = nullptr;
+		uint32_t memoryHeapIndex = 0;
+		std::vector<std::unique_ptr<ResidentTexture>> textures;
+		std::vector<Handle> freeHandles;
+		std::vector<RetiredImage> retiredImages;
+		VkDeviceSize residentSize = 0;
+		VkDeviceSize budget = 0;
+		uint64_t updateIndex = 1;
+
+		VkDeviceSize queryBudget() const;
+		void createImage(ResidentTexture& texture, uint32_t residentLevel, VkImage& image, VkDeviceMemory& deviceMemory, VkDeviceSize& size);
+		VkImageView createView(const ResidentTexture& texture, VkImage image, uint32_t residentLevel) const;
+		void resize(const std::vector<Resize>& resizes);
+		void retire(ResidentTexture& texture);
+		static uint64_t getTexelCount(const ResidentTexture& texture, uint32_t residentLevel);
+		static VkDeviceSize estimateSize(const ResidentTexture& texture, uint32_t residentLevel);
+		static uint32_t getLevelDimension(uint32_t dimension, uint32_t level);
+	};
+}
@@ -0,0 +1,695 @@
+/*
+* Vulkan texture streaming
+*
+* Uploads the mip tail of a texture right away and streams the larger mip levels in the background
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureStreamer.h"
+#include "VulkanMipGenerator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+
+#include <ktx.h>
+#include "../external/ktx/lib/vk_format.h"
+#include "stb_image.h"
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Reads a range of bytes from a file (or an asset on Android)
+		bool readFileRange(const std::string& filename, size_t offset, size_t size, uint8_t* data)
+		{
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_RANDOM);
+			if (!asset) {
+				return false;
+			}
+			bool result = (AAsset_seek(asset, (off_t)offset, SEEK_SET) == (off_t)offset) && (AAsset_read(asset, data, size) == (int)size);
+			AAsset_close(asset);
+			return result;
+#else
+			FILE* file = fopen(filename.c_str(), "rb");
+			if (!file) {
+				return false;
+			}
+			bool result = (fseek(file, (long)offset, SEEK_SET) == 0) && (fread(data, 1, size, file) == size);
+			fclose(file);
+			return result;
+#endif
+		}
+
+		/*
+			Streams the levels of a KTX (1.1) file
+			Levels are stored from largest to smallest, each one preceded by its size and padded to four bytes
+		*/
+		class KTXSource : public TextureStreamer::Source
+		{
+		public:
+			std::string filename;
+			std::vector<size_t> levelOffsets;
+			std::vector<size_t> levelSizes;
+			std::vector<size_t> rowPitches;
+			std::vector<size_t> packedRowPitches;
+
+			bool readLevel(uint32_t level, std::vector<uint8_t>& data, VkDeviceSize& rowPitch) override
+			{
+				std::vector<uint8_t> fileData(levelSizes[level]);
+				if (!readFileRange(filename, levelOffsets[level], fileData.size(), fileData.data())) {
+					return false;
+				}
+				rowPitch = packedRowPitches[level];
+				if (rowPitches[level] == packedRowPitches[level]) {
+					data.swap(fileData);
+					return true;
+				}
+				// Rows in KTX files are padded to four bytes, remove the padding so the data can be copied to the image as is
+				const size_t rows = fileData.size() / rowPitches[level];
+				data.resize(rows * packedRowPitches[level]);
+				for (size_t row = 0; row < rows; row++) {
+					memcpy(&data[row * packedRowPitches[level]], &fileData[row * rowPitches[level]], packedRowPitches[level]);
+				}
+				return true;
+			}
+		};
+
+		/*
+			Decodes an image file with stb_image on the loader thread and generates the mip chain with a box filter
+		*/
+		class EncodedImageSource : public TextureStreamer::Source
+		{
+		public:
+			std::vector<unsigned char> fileData;
+			std::vector<std::vector<uint8_t>> levels;
+			bool keepLevels = false;
+			vks::MipGenerator::Content content = vks::MipGenerator::Content::SRGB;
+
+			bool prepare() override
+			{
+				int w, h, components;
+				stbi_uc* pixels = stbi_load_from_memory(fileData.data(), (int)fileData.size(), &w, &h, &components, 4);
+				if (!pixels) {
+					return false;
+				}
+				std::vector<unsigned char>().swap(fileData);
+				// Runs on the streaming thread, so the levels are generated serially
+				vks::MipGenerator().generate(pixels, width, height, content, levels);
+				stbi_image_free(pixels);
+				return levels.size() == mipLevels;
+			}
+
+			bool readLevel(uint32_t level, std::vector<uint8_t>& data, VkDeviceSize& rowPitch) override
+			{
+				// Levels are only read once when streaming, so hand over the data instead of copying it
+				if (keepLevels) {
+					data = levels[level];
+				} else {
+					data.swap(levels[level]);
+				}
+				rowPitch = std::max(1u, width >> level) * 4;
+				return !data.empty();
+			}
+
+			bool hasFastTail() const override
+			{
+				return false;
+			}
+		};
+	}
+
+	VkFormat TextureStreamer::getKTXFormat(ktxTexture* ktxTexture)
+	{
+		// Same mapping as ktxTexture_GetVkFormat, which is part of libktx's Vulkan loader that isn't built
+		VkFormat format = vkGetFormatFromOpenGLInternalFormat(ktxTexture->glInternalformat);
+		if (format == VK_FORMAT_UNDEFINED) {
+			format = vkGetFormatFromOpenGLFormat(ktxTexture->glFormat, ktxTexture->glType);
+		}
+		return format;
+	}
+
+	std::unique_ptr<TextureStreamer::Source> TextureStreamer::createKTXSource(const std::string& filename)
+	{
+		// Only the header and the key/value data are read here, libktx is used to get the size of each level
+		uint8_t header[64];
+		if (!readFileRange(filename, 0, sizeof(header), header)) {
+			return nullptr;
+		}
+		uint32_t endianness, bytesOfKeyValueData;
+		memcpy(&endianness, &header[12], sizeof(uint32_t));
+		memcpy(&bytesOfKeyValueData, &header[60], sizeof(uint32_t));
+		if (endianness != 0x04030201) {
+			return nullptr;
+		}
+		std::vector<uint8_t> headerData(sizeof(header) + bytesOfKeyValueData);
+		if (!readFileRange(filename, 0, headerData.size(), headerData.data())) {
+			return nullptr;
+		}
+		ktxTexture* ktxTexture;
+		if (ktxTexture_CreateFromMemory(headerData.data(), headerData.size(), KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture) != KTX_SUCCESS) {
+			return nullptr;
+		}
+		std::unique_ptr<KTXSource> source;
+		if (ktxTexture->numDimensions == 2 && !ktxTexture->isArray && !ktxTexture->isCubemap && !ktxTexture->generateMipmaps) {
+			source.reset(new KTXSource());
+			source->filename = filename;
+			source->width = ktxTexture->baseWidth;
+			source->height = ktxTexture->baseHeight;
+			source->mipLevels = ktxTexture->numLevels;
+			source->format = getKTXFormat(ktxTexture);
+			size_t offset = headerData.size();
+			for (uint32_t level = 0; level < ktxTexture->numLevels; level++) {
+				const size_t size = ktxTexture_GetImageSize(ktxTexture, level);
+				const size_t rowPitch = ktxTexture_GetRowPitch(ktxTexture, level);
+				const uint32_t levelWidth = std::max(1u, ktxTexture->baseWidth >> level);
+				// Compressed blocks are multiples of four bytes, so only uncompressed rows can be padded
+				source->packedRowPitches.push_back(ktxTexture->isCompressed ? rowPitch : (size_t)ktxTexture_GetElementSize(ktxTexture) * levelWidth);
+				source->rowPitches.push_back(rowPitch);
+				source->levelOffsets.push_back(offset + sizeof(uint32_t));
+				source->levelSizes.push_back(size);
+				offset += sizeof(uint32_t) + ((size + 3) & ~(size_t)3);
+			}
+		}
+		ktxTexture_Destroy(ktxTexture);
+		return std::move(source);
+	}
+
+	std::unique_ptr<TextureStreamer::Source> TextureStreamer::createEncodedImageSource(std::vector<unsigned char>&& fileData, MipGenerator::Content content, bool keepLevels)
+	{
+		int w, h, components;
+		if (!stbi_info_from_memory(fileData.data(), (int)fileData.size(), &w, &h, &components)) {
+			return nullptr;
+		}
+		std::unique_ptr<EncodedImageSource> source(new EncodedImageSource());
+		source->width = (uint32_t)w;
+		source->height = (uint32_t)h;
+		source->mipLevels = static_cast<uint32_t>(floor(log2(std::max(w, h))) + 1.0);
+		source->format = VK_FORMAT_R8G8B8A8_UNORM;
+		source->fileData = std::move(fileData);
+		source->keepLevels = keepLevels;
+		source->content = content;
+		return std::move(source);
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		destroy();
+	}
+
+	void TextureStreamer::create(vks::VulkanDevice* vulkanDevice, VkQueue queue)
+	{
+		destroy();
+		this->vulkanDevice = vulkanDevice;
+		this->device = vulkanDevice->logicalDevice;
+		this->queue = queue;
+		nextSlot = 0;
+	}
+
+	void TextureStreamer::startLoader()
+	{
+		// Staging memory and the loader thread are only set up once a texture actually has levels to stream
+		if (loaderThread.joinable()) {
+			return;
+		}
+		VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo();
+		for (uint32_t i = 0; i < settings.stagingSlots; i++) {
+			std::unique_ptr<StagingSlot> slot(new StagingSlot());
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &slot->buffer, settings.frameBudget));
+			VK_CHECK_RESULT(slot->buffer.map());
+			slot->commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &slot->fence));
+			stagingSlots.push_back(std::move(slot));
+		}
+		nextSlot = 0;
+		stopLoader = false;
+		loaderThread = std::thread(&TextureStreamer::loaderLoop, this);
+	}
+
+	void TextureStreamer::destroy()
+	{
+		if (vulkanDevice == nullptr) {
+			return;
+		}
+		if (loaderThread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopLoader = true;
+			}
+			loaderCondition.notify_all();
+			loaderThread.join();
+		}
+		for (auto& slot : stagingSlots) {
+			if (slot->submitted) {
+				retireSlot(*slot, true);
+			}
+			slot->buffer.destroy();
+			vkFreeCommandBuffers(device, vulkanDevice->commandPool, 1, &slot->commandBuffer);
+			vkDestroyFence(device, slot->fence, nullptr);
+		}
+		stagingSlots.clear();
+		for (auto& retiredView : retiredViews) {
+			vkDestroyImageView(device, retiredView.second, nullptr);
+		}
+		retiredViews.clear();
+		pendingLevels.clear();
+		pendingBytes = 0;
+		textures.clear();
+		vulkanDevice = nullptr;
+		device = VK_NULL_HANDLE;
+	}
+
+	uint32_t TextureStreamer::getLevelDimension(uint32_t dimension, uint32_t level)
+	{
+		return std::max(1u, dimension >> level);
+	}
+
+	void TextureStreamer::recordLevelBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t level, VkImageLayout oldLayout, VkImageLayout newLayout)
+	{
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		vks::tools::setImageLayout(commandBuffer, image, oldLayout, newLayout, subresourceRange, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+
+	VkImageView TextureStreamer::createView(StreamedTexture& texture, uint32_t baseLevel)
+	{
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = texture.format;
+		viewCI.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, texture.mipLevels - baseLevel, 0, 1 };
+		viewCI.image = texture.image;
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+		return view;
+	}
+
+	void TextureStreamer::uploadImmediately(StreamedTexture& texture, uint32_t firstLevel)
+	{
+		std::vector<std::vector<uint8_t>> levelData(texture.mipLevels - firstLevel);
+		VkDeviceSize totalSize = 0;
+		for (uint32_t level = firstLevel; level < texture.mipLevels; level++) {
+			VkDeviceSize rowPitch;
+			if (!texture.source->readLevel(level, levelData[level - firstLevel], rowPitch)) {
+				vks::tools::exitFatal("Could not read mip level " + std::to_string(level) + " of a streamed texture", -1);
+			}
+			// Buffer offsets for copies need to be aligned to the texel block size
+			totalSize = ((totalSize + 15) & ~(VkDeviceSize)15) + levelData[level - firstLevel].size();
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, totalSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize offset = 0;
+		for (uint32_t level = firstLevel; level < texture.mipLevels; level++) {
+			const std::vector<uint8_t>& data = levelData[level - firstLevel];
+			offset = (offset + 15) & ~(VkDeviceSize)15;
+			memcpy((uint8_t*)stagingBuffer.mapped + offset, data.data(), data.size());
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = getLevelDimension(texture.source->width, level);
+			bufferCopyRegion.imageExtent.height = getLevelDimension(texture.source->height, level);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			offset += data.size();
+		}
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, texture.mipLevels - firstLevel, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+	}
+
+	TextureStreamer::Texture TextureStreamer::add(std::unique_ptr<Source> source, VkFormat format, VkImageUsageFlags imageUsageFlags, UpdateCallback onUpdated, const VkSamplerCreateInfo* samplerCreateInfo)
+	{
+		assert(vulkanDevice);
+		std::shared_ptr<StreamedTexture> texture = std::make_shared<StreamedTexture>();
+		texture->format = format;
+		texture->mipLevels = source->mipLevels;
+		texture->onUpdated = onUpdated;
+
+		Texture result;
+		result.width = source->width;
+		result.height = source->height;
+		result.mipLevels = source->mipLevels;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.mipLevels = source->mipLevels;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCI.extent = { source->width, source->height, 1 };
+		imageCI.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &result.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, result.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &result.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, result.image, result.deviceMemory, 0));
+		texture->image = result.image;
+
+		// The tail starts with the first level that's not larger than the tail size
+		uint32_t tailLevel = 0;
+		while (tailLevel < source->mipLevels - 1 && std::max(getLevelDimension(source->width, tailLevel), getLevelDimension(source->height, tailLevel)) > settings.tailSize) {
+			tailLevel++;
+		}
+		texture->source = std::move(source);
+		if (texture->source->hasFastTail()) {
+			texture->prepared = true;
+			uploadImmediately(*texture, tailLevel);
+			texture->residentLevel = tailLevel;
+			texture->nextLevel = tailLevel;
+		} else {
+			// Nothing can be uploaded without stalling, so the smallest level is cleared to a flat normal / neutral color until the loader thread has read the data
+			VkCommandBuffer clearCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels - 1, 1, 0, 1 };
+			vks::tools::setImageLayout(clearCmd, texture->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+			VkClearColorValue clearColor = { { 0.5f, 0.5f, 1.0f, 1.0f } };
+			vkCmdClearColorImage(clearCmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+			vks::tools::setImageLayout(clearCmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+			vulkanDevice->flushCommandBuffer(clearCmd, queue, true);
+			texture->residentLevel = texture->mipLevels - 1;
+			texture->nextLevel = texture->mipLevels;
+		}
+		texture->view = createView(*texture, texture->residentLevel);
+		result.view = texture->view;
+
+		// LODs are relative to the view's base level, so the sampler can cover the full chain
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCI.maxAnisotropy = vulkanDevice->enabledFeatures.samplerAnisotropy ? vulkanDevice->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCI.anisotropyEnable = vulkanDevice->enabledFeatures.samplerAnisotropy;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		result.sampler = vulkanDevice->samplerCache.acquire(samplerCreateInfo ? *samplerCreateInfo : samplerCI);
+
+		if (texture->nextLevel > 0) {
+			startLoader();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				textures.push_back(texture);
+			}
+			loaderCondition.notify_one();
+		}
+		return result;
+	}
+
+	void TextureStreamer::remove(VkImage image)
+	{
+		if (vulkanDevice == nullptr) {
+			return;
+		}
+		std::shared_ptr<StreamedTexture> texture;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = std::find_if(textures.begin(), textures.end(), [image](const std::shared_ptr<StreamedTexture>& t) { return t->image == image; });
+			if (it != textures.end()) {
+				texture = *it;
+				texture->cancelled = true;
+				textures.erase(it);
+				for (auto level = pendingLevels.begin(); level != pendingLevels.end();) {
+					if (level->texture == texture) {
+						pendingBytes -= level->data.size();
+						level = pendingLevels.erase(level);
+					} else {
+						++level;
+					}
+				}
+			}
+		}
+		if (texture) {
+			loaderCondition.notify_one();
+			// Copies to the image may still be in flight
+			for (auto& slot : stagingSlots) {
+				if (slot->submitted) {
+					retireSlot(*slot, true);
+				}
+			}
+		}
+		// Textures that have been streamed completely may still have a replaced view
+		for (auto it = retiredViews.begin(); it != retiredViews.end();) {
+			if (it->first == image) {
+				vkDestroyImageView(device, it->second, nullptr);
+				it = retiredViews.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	std::shared_ptr<TextureStreamer::StreamedTexture> TextureStreamer::getNextLoadJob(uint32_t& level)
+	{
+		// Pick the smallest level of all textures, so every texture gets sharper at about the same pace
+		std::shared_ptr<StreamedTexture> next;
+		uint32_t nextDimension = UINT32_MAX;
+		for (auto& texture : textures) {
+			if (texture->failed || texture->nextLevel == 0) {
+				continue;
+			}
+			const uint32_t dimension = std::max(getLevelDimension(texture->source->width, texture->nextLevel - 1), getLevelDimension(texture->source->height, texture->nextLevel - 1));
+			if (dimension < nextDimension) {
+				nextDimension = dimension;
+				next = texture;
+			}
+		}
+		if (next) {
+			level = --next->nextLevel;
+		}
+		return next;
+	}
+
+	void TextureStreamer::loaderLoop()
+	{
+		while (true) {
+			std::shared_ptr<StreamedTexture> texture;
+			uint32_t level = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				loaderCondition.wait(lock, [&] { return stopLoader || (pendingBytes < settings.readAheadLimit && (texture = getNextLoadJob(level)) != nullptr); });
+				if (stopLoader) {
+					return;
+				}
+			}
+			// The source is only accessed by this thread once the texture has been added
+			if (!texture->prepared) {
+				texture->prepared = true;
+				if (!texture->source->prepare()) {
+					std::cerr << "Could not prepare streamed texture\n";
+					std::lock_guard<std::mutex> lock(mutex);
+					texture->failed = true;
+					continue;
+				}
+			}
+			PendingLevel pendingLevel;
+			pendingLevel.texture = texture;
+			pendingLevel.level = level;
+			if (!texture->source->readLevel(level, pendingLevel.data, pendingLevel.rowPitch) || pendingLevel.rowPitch == 0) {
+				std::cerr << "Could not read mip level " << level << " of streamed texture\n";
+				std::lock_guard<std::mutex> lock(mutex);
+				texture->failed = true;
+				continue;
+			}
+			pendingLevel.rows = static_cast<uint32_t>(pendingLevel.data.size() / pendingLevel.rowPitch);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!texture->cancelled) {
+				pendingBytes += pendingLevel.data.size();
+				pendingLevels.push_back(std::move(pendingLevel));
+			}
+		}
+	}
+
+	bool TextureStreamer::retireSlot(StagingSlot& slot, bool wait)
+	{
+		if (wait) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+		} else if (vkGetFenceStatus(device, slot.fence) != VK_SUCCESS) {
+			return false;
+		}
+		VK_CHECK_RESULT(vkResetFences(device, 1, &slot.fence));
+		for (auto& completedLevel : slot.completedLevels) {
+			StreamedTexture& texture = *completedLevel.first;
+			// Levels are copied from smallest to largest, so a completed level extends the resident range
+			if (!texture.cancelled && completedLevel.second < texture.residentLevel) {
+				texture.residentLevel = completedLevel.second;
+				texture.dirty = true;
+			}
+		}
+		slot.completedLevels.clear();
+		slot.submitted = false;
+		return true;
+	}
+
+	bool TextureStreamer::update()
+	{
+		if (vulkanDevice == nullptr) {
+			return false;
+		}
+
+		// Views replaced in the previous update are no longer used by any frame in flight
+		for (auto& retiredView : retiredViews) {
+			vkDestroyImageView(device, retiredView.second, nullptr);
+		}
+		retiredViews.clear();
+		if (stagingSlots.empty()) {
+			return false;
+		}
+
+		for (auto& slot : stagingSlots) {
+			if (slot->submitted) {
+				retireSlot(*slot, false);
+			}
+		}
+
+		// Replace the views of textures that got new levels
+		bool updated = false;
+		std::vector<std::shared_ptr<StreamedTexture>> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& texture : textures) {
+				if (!texture->dirty) {
+					continue;
+				}
+				texture->dirty = false;
+				retiredViews.push_back(std::make_pair(texture->image, texture->view));
+				texture->view = createView(*texture, texture->residentLevel);
+				if (texture->onUpdated) {
+					texture->onUpdated(texture->view);
+				}
+				updated = true;
+				if (texture->residentLevel == 0) {
+					finished.push_back(texture);
+				}
+			}
+			for (auto& texture : finished) {
+				textures.erase(std::find(textures.begin(), textures.end(), texture));
+			}
+		}
+
+		// Copy as many of the levels read by the loader thread as the budget allows
+		StagingSlot& slot = *stagingSlots[nextSlot];
+		if (slot.submitted) {
+			return updated;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		if (pendingLevels.empty()) {
+			return updated;
+		}
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+		VkDeviceSize offset = 0;
+		while (!pendingLevels.empty()) {
+			PendingLevel& pendingLevel = pendingLevels.front();
+			StreamedTexture& texture = *pendingLevel.texture;
+			const VkDeviceSize levelSize = pendingLevel.data.size();
+			const VkDeviceSize remainingSize = (VkDeviceSize)(pendingLevel.rows - pendingLevel.copiedRows) * pendingLevel.rowPitch;
+			// Levels are only split into chunks of rows if they don't fit into an empty staging buffer
+			uint32_t rowCount = pendingLevel.rows - pendingLevel.copiedRows;
+			if (offset + remainingSize > settings.frameBudget) {
+				if (levelSize <= settings.frameBudget && pendingLevel.copiedRows == 0) {
+					break;
+				}
+				rowCount = static_cast<uint32_t>((settings.frameBudget - offset) / pendingLevel.rowPitch);
+				if (rowCount == 0) {
+					break;
+				}
+			}
+			if (pendingLevel.copiedRows == 0) {
+				recordLevelBarrier(slot.commandBuffer, texture.image, pendingLevel.level, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			}
+			memcpy((uint8_t*)slot.buffer.mapped + offset, &pendingLevel.data[(size_t)pendingLevel.copiedRows * pendingLevel.rowPitch], (size_t)rowCount * pendingLevel.rowPitch);
+
+			// Rows are rows of texel blocks for compressed formats
+			const uint32_t levelHeight = getLevelDimension(texture.source->height, pendingLevel.level);
+			const uint32_t blockHeight = (levelHeight + pendingLevel.rows - 1) / pendingLevel.rows;
+			const uint32_t firstY = pendingLevel.copiedRows * blockHeight;
+			const uint32_t lastY = std::min(levelHeight, (pendingLevel.copiedRows + rowCount) * blockHeight);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = pendingLevel.level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageOffset = { 0, (int32_t)firstY, 0 };
+			bufferCopyRegion.imageExtent = { getLevelDimension(texture.source->width, pendingLevel.level), lastY - firstY, 1 };
+			bufferCopyRegion.bufferOffset = offset;
+			vkCmdCopyBufferToImage(slot.commandBuffer, slot.buffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+			offset = (offset + (VkDeviceSize)rowCount * pendingLevel.rowPitch + 15) & ~(VkDeviceSize)15;
+
+			pendingLevel.copiedRows += rowCount;
+			if (pendingLevel.copiedRows < pendingLevel.rows) {
+				break;
+			}
+			recordLevelBarrier(slot.commandBuffer, texture.image, pendingLevel.level, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			slot.completedLevels.push_back(std::make_pair(pendingLevel.texture, pendingLevel.level));
+			pendingBytes -= levelSize;
+			pendingLevels.pop_front();
+			if (offset >= settings.frameBudget) {
+				break;
+			}
+		}
+		lock.unlock();
+		loaderCondition.notify_one();
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+		slot.submitted = true;
+		nextSlot = (nextSlot + 1) % static_cast<uint32_t>(stagingSlots.size());
+		return updated;
+	}
+
+	void TextureStreamer::flush()
+	{
+		while (getPendingCount() > 0) {
+			if (!update()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		// Views replaced by the last update may still be referenced by recorded command buffers, so they are kept until the next update
+	}
+
+	uint32_t TextureStreamer::getPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t count = 0;
+		for (auto& texture : textures) {
+			if (!texture->failed) {
+				count++;
+			}
+		}
+		return count;
+	}
+}
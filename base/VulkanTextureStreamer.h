@@ -0,0 +1,190 @@
+/*
+* Vulkan texture streaming
+*
+* Uploads the mip tail of a texture right away and streams the larger mip levels in the background
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+#include "vulkan/vulkan.h"
+#include <ktx.h>
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanMipGenerator.h"
+
+namespace vks
+{
+	/**
+	* @brief Streams the mip levels of 2D textures from the smallest to the largest one
+	* @note The mip tail is uploaded when a texture is added, so it can be bound right away. Larger levels are read on a loader thread and copied to the image in update() within a per frame byte budget.
+	* Each time levels have been made resident, the texture's image view is recreated with a lower base mip level and the texture's callback is invoked so descriptors referencing the view can be updated.
+	*/
+	class TextureStreamer
+	{
+	public:
+		struct Settings {
+			/** @brief Upper limit of bytes copied to images per update */
+			VkDeviceSize frameBudget = 16 * 1024 * 1024;
+			/** @brief Upper limit of bytes read ahead by the loader thread but not yet copied */
+			VkDeviceSize readAheadLimit = 64 * 1024 * 1024;
+			/** @brief Mip levels whose largest dimension is at most this size are uploaded when the texture is added */
+			uint32_t tailSize = 128;
+			/** @brief Number of staging buffers, copies can be in flight for this many updates */
+			uint32_t stagingSlots = 3;
+		} settings;
+
+		/** @brief Supplies the mip levels of a streamed texture */
+		class Source
+		{
+		public:
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 1;
+			/** @brief Format of the levels' data, undefined if the file doesn't store a format Vulkan can use */
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			virtual ~Source() {};
+			/** @brief Called once before the first level is read, e.g. to decode the image */
+			virtual bool prepare() { return true; }
+			/**
+			* @brief Reads a mip level
+			* @param data Receives the level's data with tightly packed rows of texels (or blocks for compressed formats)
+			* @param rowPitch Receives the size of one row of texels (or blocks) in bytes
+			*/
+			virtual bool readLevel(uint32_t level, std::vector<uint8_t>& data, VkDeviceSize& rowPitch) = 0;
+			/** @brief False if reading a level requires expensive preparation, the tail of such textures is also loaded in the background */
+			virtual bool hasFastTail() const { return true; }
+		};
+
+		/** @brief Returns the Vulkan format matching the OpenGL format stored in a KTX file (VK_FORMAT_UNDEFINED if there is none) */
+		static VkFormat getKTXFormat(ktxTexture* ktxTexture);
+		/** @brief Reads the levels of a 2D KTX file one at a time, returns nullptr if the file can't be streamed (e.g. cube maps or arrays) */
+		static std::unique_ptr<Source> createKTXSource(const std::string& filename);
+		/**
+		* @brief Decodes an encoded image file (png, jpg, ...) to RGBA8 on the loader thread and generates its mip chain
+		* @param content How the texels are filtered when generating the mip chain
+		* @param keepLevels Keep the decoded levels in memory so they can be read more than once (e.g. by the residency manager)
+		*/
+		static std::unique_ptr<Source> createEncodedImageSource(std::vector<unsigned char>&& fileData, MipGenerator::Content content, bool keepLevels = false);
+
+		/** @brief Resources of a streamed texture, the view only covers the levels resident at the time it was created */
+		struct Texture {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+		};
+
+		/**
+		* @brief Called after the view of a texture has been replaced with one that covers more levels
+		* @note The previous view stays valid until the next call to update(), descriptors and command buffers referencing it have to be updated before that
+		*/
+		typedef std::function<void(VkImageView view)> UpdateCallback;
+
+		~TextureStreamer();
+
+		/** @brief Prepares streaming, the staging buffers and the loader thread are created once the first texture with levels to stream is added */
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue);
+		/** @brief Stops the loader thread and releases all resources, textures still being streamed keep the levels that are resident */
+		void destroy();
+
+		/**
+		* @brief Creates the image for a texture and starts streaming its mip levels
+		* @param format Format of the source's data
+		* @param onUpdated Called from update() each time the texture's view has been replaced
+		* @param samplerCreateInfo Optional sampler parameters, defaults to repeating trilinear filtering. The sampler is acquired from the device's sampler cache.
+		* @return The created resources, owned by the caller. The image has to be released with remove() before it's destroyed, the sampler is released to the device's sampler cache.
+		*/
+		Texture add(std::unique_ptr<Source> source, VkFormat format, VkImageUsageFlags imageUsageFlags, UpdateCallback onUpdated, const VkSamplerCreateInfo* samplerCreateInfo = nullptr);
+		/** @brief Stops streaming an image, waits for copies to it still in flight */
+		void remove(VkImage image);
+
+		/**
+		* @brief Copies the levels read by the loader thread to their images and replaces the views of textures that got new levels
+		* @note Call once per frame from the thread that owns the queue
+		* @return True if views have been replaced (and command buffers referencing them need to be rebuilt)
+		*/
+		bool update();
+		/** @brief Blocks until all textures have been streamed completely */
+		void flush();
+
+		/** @brief Number of textures with levels still to be streamed */
+		uint32_t getPendingCount();
+		bool isCreated() const { return device != nullptr; }
+	private:
+		struct StreamedTexture {
+			std::unique_ptr<Source> source;
+			VkImage image = VK_NULL_HANDLE;
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkImageView view = VK_NULL_HANDLE;
+			uint32_t mipLevels = 0;
+			// Lowest level with valid data, the view starts at this level
+			uint32_t residentLevel = 0;
+			// Levels below this one still have to be read by the loader thread
+			uint32_t nextLevel = 0;
+			bool prepared = false;
+			bool failed = false;
+			bool cancelled = false;
+			bool dirty = false;
+			UpdateCallback onUpdated;
+		};
+		// A level read by the loader thread, copied to the image in chunks of rows
+		struct PendingLevel {
+			std::shared_ptr<StreamedTexture> texture;
+			uint32_t level = 0;
+			std::vector<uint8_t> data;
+			VkDeviceSize rowPitch = 0;
+			uint32_t rows = 0;
+			uint32_t copiedRows = 0;
+		};
+		struct StagingSlot {
+			vks::Buffer buffer;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			bool submitted = false;
+			// Levels whose last rows are copied by this slot
+			std::vector<std::pair<std::shared_ptr<StreamedTexture>, uint32_t>> completedLevels;
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::vector<std::unique_ptr<StagingSlot>> stagingSlots;
+		uint32_t nextSlot = 0;
+		// Views replaced in the last update (and their images), destroyed in the next one
+		std::vector<std::pair<VkImage, VkImageView>> retiredViews;
+
+		std::vector<std::shared_ptr<StreamedTexture>> textures;
+		std::deque<PendingLevel> pendingLevels;
+		VkDeviceSize pendingBytes = 0;
+		std::thread loaderThread;
+		std::mutex mutex;
+		std::condition_variable loaderCondition;
+		bool stopLoader = false;
+
+		void startLoader();
+		void loaderLoop();
+		std::shared_ptr<StreamedTexture> getNextLoadJob(uint32_t& level);
+		void uploadImmediately(StreamedTexture& texture, uint32_t firstLevel);
+		bool retireSlot(StagingSlot& slot, bool wait);
+		VkImageView createView(StreamedTexture& texture, uint32_t baseLevel);
+		void recordLevelBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t level, VkImageLayout oldLayout, VkImageLayout newLayout);
+		static uint32_t getLevelDimension(uint32_t dimension, uint32_t level);
+	};
+}
@@ -8,6 +8,13 @@
 
 #include "VulkanTools.h"
 
+#include <cstdio>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
 const std::string getAssetPath()
@@ -394,6 +401,37 @@ namespace vks
 			return !f.fail();
 		}
 
+		bool createDirectory(const std::string &path)
+		{
+			// Create all parent directories, existing ones are ignored
+			for (size_t i = 1; i <= path.size(); i++) {
+				if ((i == path.size()) || (path[i] == '/') || (path[i] == '\\')) {
+					const std::string directory = path.substr(0, i);
+#if defined(_WIN32)
+					_mkdir(directory.c_str());
+#else
+					mkdir(directory.c_str(), 0755);
+#endif
+				}
+			}
+			std::ofstream test(path + "/.write_test");
+			const bool writable = test.is_open();
+			test.close();
+			std::remove((path + "/.write_test").c_str());
+			return writable;
+		}
+
+		uint64_t hash(const void *data, size_t size, uint64_t seed)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			uint64_t result = seed;
+			for (size_t i = 0; i < size; i++) {
+				result ^= bytes[i];
+				result *= 1099511628211ull;
+			}
+			return result;
+		}
+
 		uint32_t alignedSize(uint32_t value, uint32_t alignment)
         {
 	        return (value + alignment - 1) & ~(alignment - 1);
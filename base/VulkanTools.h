@@ -128,6 +128,16 @@ namespace vks
 
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
+		/** @brief Creates a directory including all of its parents, returns true if the directory is writable */
+		bool createDirectory(const std::string &path);
+
+		/** @brief 64 bit FNV-1a hash, chain calls by passing the previous result as the seed */
+		uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+		template<typename T>
+		uint64_t hashValue(uint64_t seed, const T &value)
+		{
+			return hash(&value, sizeof(T), seed);
+		}
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
 	}
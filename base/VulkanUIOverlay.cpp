@@ -8,6 +8,7 @@
 */
 
 #include "VulkanUIOverlay.h"
+#include "cpuprofiler.hpp"
 
 namespace vks 
 {
@@ -313,6 +314,7 @@ namespace vks
 	/** Update vertex and index buffer containing the imGui elements when required */
 	bool UIOverlay::update()
 	{
+		VKS_PROFILE_ZONE("UIOverlay::update");
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		bool updateCmdBuffers = false;
 
@@ -7,14 +7,13 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-
 #include "VulkanglTFModel.h"
+#include "cpuprofiler.hpp"
+#include "stb_image.h"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutBindless = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
 
@@ -33,6 +32,30 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
 }
 
+/*
+	Used if textures are streamed or compressed, images are only decoded once they're needed (if at all)
+*/
+bool loadImageDataFuncDeferred(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+{
+	if (image->uri.find_last_of(".") != std::string::npos) {
+		if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
+			return true;
+		}
+	}
+
+	// Images small enough to be packed into texture arrays (userData points to the model's packing size) are decoded right away, as packing needs their pixels
+	const uint32_t texturePackingSize = userData ? *static_cast<const uint32_t*>(userData) : 0;
+	int width, height, components;
+	if ((texturePackingSize > 0) && stbi_info_from_memory(bytes, size, &width, &height, &components) && ((uint32_t)width <= texturePackingSize) && ((uint32_t)height <= texturePackingSize)) {
+		return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, nullptr);
+	}
+
+	// Keep the encoded file, as_is marks the image data as not decoded
+	image->image.assign(bytes, bytes + size);
+	image->as_is = true;
+	return true;
+}
+
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
 {
 	// This function will be used for samples that don't require images to be loaded
@@ -40,6 +63,82 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 }
 
 
+/*
+	glTF texture sampler
+*/
+
+void vkglTF::TextureSampler::fromglTfSampler(const tinygltf::Sampler& gltfSampler)
+{
+	auto getFilter = [](int filter) {
+		switch (filter) {
+		case TINYGLTF_TEXTURE_FILTER_NEAREST:
+		case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST:
+		case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR:
+			return VK_FILTER_NEAREST;
+		default:
+			return VK_FILTER_LINEAR;
+		}
+	};
+	auto getAddressMode = [](int wrap) {
+		switch (wrap) {
+		case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:
+			return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT:
+			return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		default:
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+	};
+	magFilter = getFilter(gltfSampler.magFilter);
+	minFilter = getFilter(gltfSampler.minFilter);
+	// Mip maps are always generated, so filters without a mip map mode still use them
+	const bool nearestMip = (gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST) || (gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST);
+	mipmapMode = nearestMip ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	addressModeU = getAddressMode(gltfSampler.wrapS);
+	addressModeV = getAddressMode(gltfSampler.wrapT);
+	addressModeW = addressModeV;
+}
+
+VkSamplerCreateInfo vkglTF::TextureSampler::getCreateInfo(const vks::VulkanDevice* device) const
+{
+	VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+	samplerInfo.magFilter = magFilter;
+	samplerInfo.minFilter = minFilter;
+	samplerInfo.mipmapMode = mipmapMode;
+	samplerInfo.addressModeU = addressModeU;
+	samplerInfo.addressModeV = addressModeV;
+	samplerInfo.addressModeW = addressModeW;
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	// Anisotropic filtering is only used if the feature has been enabled for the device
+	samplerInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+	samplerInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? std::min(8.0f, device->properties.limits.maxSamplerAnisotropy) : 1.0f;
+	return samplerInfo;
+}
+
+bool vkglTF::TextureSampler::operator==(const TextureSampler& other) const
+{
+	return (magFilter == other.magFilter) && (minFilter == other.minFilter) && (mipmapMode == other.mipmapMode)
+		&& (addressModeU == other.addressModeU) && (addressModeV == other.addressModeV) && (addressModeW == other.addressModeW);
+}
+
+/*
+	glTF texture array
+*/
+
+void vkglTF::TextureArray::destroy()
+{
+	if (device)
+	{
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		vkDestroyImage(device->logicalDevice, image, nullptr);
+		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->samplerCache.release(sampler);
+	}
+}
+
 /*
 	glTF texture loading class
 */
@@ -55,14 +154,26 @@ void vkglTF::Texture::destroy()
 {
 	if (device)
 	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		if (streamer) {
+			streamer->remove(image);
+			streamer = nullptr;
+		}
+		if (residency) {
+			residency->remove(residencyHandle);
+			residency = nullptr;
+		} else if (textureArray) {
+			// Image and memory are owned by the texture array
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		} else {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
+		device->samplerCache.release(sampler);
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue, const vks::MipGenerator* mipGenerator, vks::MipGenerator::Content content)
 {
 	this->device = device;
 
@@ -112,8 +223,18 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		if (mipGenerator || ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)) {
+			// Generate the mip chain on the CPU and upload all levels with a single copy, also used if the format can't be blitted
+			const vks::MipGenerator defaultMipGenerator;
+			std::vector<std::vector<uint8_t>> levels;
+			(mipGenerator ? *mipGenerator : defaultMipGenerator).generate(buffer, width, height, content, levels);
+			if (deleteBuffer) {
+				delete[] buffer;
+			}
+			fromLevels(levels, width, height, format, device, copyQueue);
+			return;
+		}
 
 		VkMemoryAllocateInfo memAllocInfo{};
 		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -313,8 +434,10 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
 		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+		format = vks::TextureStreamer::getKTXFormat(ktxTexture);
+		if (format == VK_FORMAT_UNDEFINED) {
+			format = VK_FORMAT_R8G8B8A8_UNORM;
+		}
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
@@ -400,21 +523,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		ktxTexture_Destroy(ktxTexture);
 	}
 
-	VkSamplerCreateInfo samplerInfo{};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	samplerInfo.maxAnisotropy = 1.0;
-	samplerInfo.anisotropyEnable = VK_FALSE;
-	samplerInfo.maxLod = (float)mipLevels;
-	samplerInfo.maxAnisotropy = 8.0f;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
+	sampler = device->samplerCache.acquire(textureSampler.getCreateInfo(device));
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -431,17 +540,226 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	descriptor.imageLayout = imageLayout;
 }
 
+void vkglTF::Texture::fromglTfImageStreamed(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureStreamer& streamer, vks::MipGenerator::Content content, std::function<void()> onUpdated)
+{
+	bool isKtx = false;
+	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
+		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
+			isKtx = true;
+		}
+	}
+
+	std::unique_ptr<vks::TextureStreamer::Source> source;
+	if (isKtx) {
+		source = vks::TextureStreamer::createKTXSource(path + "/" + gltfimage.uri);
+	} else if (gltfimage.as_is) {
+		source = vks::TextureStreamer::createEncodedImageSource(std::move(gltfimage.image), content);
+		if (!source) {
+			vks::tools::exitFatal("Could not decode image " + gltfimage.uri, -1);
+		}
+	}
+	if (!source) {
+		// Images that have already been decoded and KTX files that can't be streamed are loaded as usual
+		fromglTfImage(gltfimage, path, device, copyQueue);
+		return;
+	}
+
+	this->device = device;
+	const VkFormat format = (source->format != VK_FORMAT_UNDEFINED) ? source->format : VK_FORMAT_R8G8B8A8_UNORM;
+	const VkSamplerCreateInfo samplerCI = textureSampler.getCreateInfo(device);
+	vks::TextureStreamer::Texture streamedTexture = streamer.add(std::move(source), format, VK_IMAGE_USAGE_SAMPLED_BIT, [this, onUpdated](VkImageView newView) {
+		view = newView;
+		updateDescriptor();
+		if (onUpdated) {
+			onUpdated();
+		}
+	}, &samplerCI);
+	image = streamedTexture.image;
+	deviceMemory = streamedTexture.deviceMemory;
+	view = streamedTexture.view;
+	sampler = streamedTexture.sampler;
+	width = streamedTexture.width;
+	height = streamedTexture.height;
+	mipLevels = streamedTexture.mipLevels;
+	layerCount = 1;
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	this->streamer = &streamer;
+	updateDescriptor();
+}
+
+void vkglTF::Texture::fromglTfImageResident(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureResidencyManager& residency, vks::MipGenerator::Content content, std::function<void()> onUpdated)
+{
+	bool isKtx = false;
+	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
+		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
+			isKtx = true;
+		}
+	}
+
+	std::unique_ptr<vks::TextureStreamer::Source> source;
+	if (isKtx) {
+		source = vks::TextureStreamer::createKTXSource(path + "/" + gltfimage.uri);
+	} else if (gltfimage.as_is) {
+		// Dropped levels are restored from the decoded levels kept by the source
+		source = vks::TextureStreamer::createEncodedImageSource(std::move(gltfimage.image), content, true);
+		if (!source) {
+			vks::tools::exitFatal("Could not decode image " + gltfimage.uri, -1);
+		}
+	}
+	if (!source) {
+		// Images that have already been decoded and KTX files that can't be read level by level stay fully resident
+		fromglTfImage(gltfimage, path, device, copyQueue);
+		return;
+	}
+
+	this->device = device;
+	const VkFormat format = (source->format != VK_FORMAT_UNDEFINED) ? source->format : VK_FORMAT_R8G8B8A8_UNORM;
+	const VkSamplerCreateInfo samplerCI = textureSampler.getCreateInfo(device);
+	vks::TextureResidencyManager::Texture residentTexture = residency.add(std::move(source), format, [this, onUpdated](VkImageView newView) {
+		view = newView;
+		updateDescriptor();
+		if (onUpdated) {
+			onUpdated();
+		}
+	}, &samplerCI);
+	image = VK_NULL_HANDLE;
+	deviceMemory = VK_NULL_HANDLE;
+	view = residentTexture.view;
+	sampler = residentTexture.sampler;
+	width = residentTexture.width;
+	height = residentTexture.height;
+	mipLevels = residentTexture.mipLevels;
+	layerCount = 1;
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	this->residency = &residency;
+	residencyHandle = residentTexture.handle;
+	updateDescriptor();
+}
+
+void vkglTF::Texture::fromglTfImageCompressed(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureCompressor& compressor, vks::TextureCompressor::Usage usage)
+{
+	vks::TextureCompressor::Image compressedImage;
+	if (!gltfimage.as_is || !compressor.compressEncodedImage(gltfimage.image, usage, compressedImage)) {
+		if (gltfimage.as_is) {
+			// No matching compressed format is supported, so decode the image and upload it as usual
+			int w, h, components;
+			stbi_uc* pixels = stbi_load_from_memory(gltfimage.image.data(), (int)gltfimage.image.size(), &w, &h, &components, 4);
+			if (!pixels) {
+				vks::tools::exitFatal("Could not decode image " + gltfimage.uri, -1);
+			}
+			gltfimage.image.assign(pixels, pixels + (size_t)w * h * 4);
+			gltfimage.width = w;
+			gltfimage.height = h;
+			gltfimage.component = 4;
+			gltfimage.as_is = false;
+			stbi_image_free(pixels);
+		}
+		fromglTfImage(gltfimage, path, device, copyQueue);
+		return;
+	}
+
+	fromLevels(compressedImage.levels, compressedImage.width, compressedImage.height, compressedImage.format, device, copyQueue);
+}
+
+void vkglTF::Texture::fromLevels(const std::vector<std::vector<uint8_t>>& levels, uint32_t width, uint32_t height, VkFormat format, vks::VulkanDevice* device, VkQueue copyQueue)
+{
+	this->device = device;
+	this->width = width;
+	this->height = height;
+	mipLevels = static_cast<uint32_t>(levels.size());
+	layerCount = 1;
+
+	VkDeviceSize stagingSize = 0;
+	for (const std::vector<uint8_t>& level : levels) {
+		stagingSize += level.size();
+	}
+	vks::Buffer stagingBuffer;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, stagingSize));
+	VK_CHECK_RESULT(stagingBuffer.map());
+
+	std::vector<VkBufferImageCopy> bufferCopyRegions;
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		memcpy((uint8_t*)stagingBuffer.mapped + offset, levels[i].data(), levels[i].size());
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = i;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = std::max(1u, width >> i);
+		bufferCopyRegion.imageExtent.height = std::max(1u, height >> i);
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = offset;
+		bufferCopyRegions.push_back(bufferCopyRegion);
+		offset += levels[i].size();
+	}
+	stagingBuffer.unmap();
+
+	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = mipLevels;
+	subresourceRange.layerCount = 1;
+
+	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+	device->flushCommandBuffer(copyCmd, copyQueue);
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	stagingBuffer.destroy();
+
+	sampler = device->samplerCache.acquire(textureSampler.getCreateInfo(device));
+
+	VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = subresourceRange;
+	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+
+	updateDescriptor();
+}
+
 /*
 	glTF material
 */
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+void vkglTF::Material::createDescriptorSet(vks::DescriptorAllocator& descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
 {
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+	descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
+	descriptorSetBindingFlags = descriptorBindingFlags;
+	updateDescriptorSet();
+}
+
+bool vkglTF::Material::usesTexture(const vkglTF::Texture* texture) const
+{
+	return baseColorTexture == texture || metallicRoughnessTexture == texture || normalTexture == texture || occlusionTexture == texture || emissiveTexture == texture || specularGlossinessTexture == texture || diffuseTexture == texture;
+}
+
+void vkglTF::Material::updateDescriptorSet()
+{
+	const uint32_t descriptorBindingFlags = descriptorSetBindingFlags;
 	std::vector<VkDescriptorImageInfo> imageDescriptors{};
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
 	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -748,7 +1066,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.maxAnisotropy = 1.0f;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &emptyTexture.sampler));
+	emptyTexture.sampler = device->samplerCache.acquire(samplerCreateInfo);
 
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -775,21 +1093,24 @@ vkglTF::Model::~Model()
 	for (auto texture : textures) {
 		texture.destroy();
 	}
+	for (auto& textureArray : textureArrays) {
+		textureArray.destroy();
+	}
 	for (auto node : nodes) {
 		delete node;
 	}
     for (auto skin : skins) {
         delete skin;
     }
-	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
-		descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	// Layouts are owned by the device's layout cache
+	descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	descriptorSetLayoutImage = VK_NULL_HANDLE;
+	descriptorSetLayoutBindless = VK_NULL_HANDLE;
+	descriptorAllocator.destroy();
+	if (bindless.descriptorPool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(device->logicalDevice, bindless.descriptorPool, nullptr);
 	}
-	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
-		descriptorSetLayoutImage = VK_NULL_HANDLE;
-	}
-	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	bindless.materialBuffer.destroy();
 	emptyTexture.destroy();
 }
 
@@ -1028,15 +1349,249 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
+	VKS_PROFILE_ZONE("vkglTF::Model::loadImages");
+	// The compressed format of an image and how its mip levels are filtered depend on how the materials use it
+	std::vector<vks::TextureCompressor::Usage> imageUsages(gltfModel.images.size(), vks::TextureCompressor::Usage::Color);
+	// Streamed and resident textures are only packed if they have been decoded while loading (see loadImageDataFuncDeferred)
+	const bool packImagesEnabled = (texturePackingSize > 0) && !textureCompressor;
+	if (textureCompressor || mipGenerator || packImagesEnabled) {
+		auto setUsage = [&](tinygltf::ParameterMap& parameters, const std::string& name, vks::TextureCompressor::Usage usage) {
+			if (parameters.find(name) != parameters.end()) {
+				const int source = gltfModel.textures[parameters[name].TextureIndex()].source;
+				if ((source >= 0) && (source < (int)imageUsages.size())) {
+					imageUsages[source] = usage;
+				}
+			}
+		};
+		for (tinygltf::Material& mat : gltfModel.materials) {
+			setUsage(mat.values, "metallicRoughnessTexture", vks::TextureCompressor::Usage::Data);
+			setUsage(mat.additionalValues, "occlusionTexture", vks::TextureCompressor::Usage::Data);
+			setUsage(mat.additionalValues, "normalTexture", vks::TextureCompressor::Usage::Normal);
+		}
+	}
+
+	// Streamed textures are referenced by their update callbacks, so their storage must not move
+	textures.resize(gltfModel.images.size());
+	// Samplers belong to glTF textures, an image referenced by multiple textures uses the sampler of the first one
+	std::vector<bool> hasSampler(gltfModel.images.size(), false);
+	for (tinygltf::Texture& gltfTexture : gltfModel.textures) {
+		if ((gltfTexture.source >= 0) && (gltfTexture.source < (int)textures.size()) && (gltfTexture.sampler >= 0) && !hasSampler[gltfTexture.source]) {
+			textures[gltfTexture.source].textureSampler.fromglTfSampler(gltfModel.samplers[gltfTexture.sampler]);
+			hasSampler[gltfTexture.source] = true;
+		}
+	}
+	if (packImagesEnabled) {
+		packImages(gltfModel, transferQueue, imageUsages);
+	}
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		vkglTF::Texture* texture = &textures[i];
+		if (texture->textureArray) {
+			continue;
+		}
+		if (textureResidency && textureResidency->isCreated()) {
+			texture->fromglTfImageResident(gltfModel.images[i], path, device, transferQueue, *textureResidency, vks::TextureCompressor::getMipContent(imageUsages[i]), [this, texture]() { updateTextureDescriptors(texture); });
+		} else if (textureStreamer && textureStreamer->isCreated()) {
+			texture->fromglTfImageStreamed(gltfModel.images[i], path, device, transferQueue, *textureStreamer, vks::TextureCompressor::getMipContent(imageUsages[i]), [this, texture]() { updateTextureDescriptors(texture); });
+		} else if (textureCompressor) {
+			texture->fromglTfImageCompressed(gltfModel.images[i], path, device, transferQueue, *textureCompressor, imageUsages[i]);
+		} else {
+			texture->fromglTfImage(gltfModel.images[i], path, device, transferQueue, mipGenerator, vks::TextureCompressor::getMipContent(imageUsages[i]));
+		}
 	}
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
 }
 
+void vkglTF::Model::packImages(tinygltf::Model& gltfModel, VkQueue transferQueue, const std::vector<vks::TextureCompressor::Usage>& imageUsages)
+{
+	VKS_PROFILE_ZONE("vkglTF::Model::packImages");
+	// Decoded images (KTX files are loaded as they are) are grouped by size and sampler, as all layers of an array share both
+	struct Group {
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint32_t> images;
+	};
+	std::vector<Group> groups;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(gltfModel.images.size()); i++) {
+		const tinygltf::Image& gltfImage = gltfModel.images[i];
+		if (gltfImage.as_is || gltfImage.image.empty() || (gltfImage.bits != 8) || ((gltfImage.component != 3) && (gltfImage.component != 4))) {
+			continue;
+		}
+		const uint32_t width = static_cast<uint32_t>(gltfImage.width);
+		const uint32_t height = static_cast<uint32_t>(gltfImage.height);
+		if ((width > texturePackingSize) || (height > texturePackingSize)) {
+			continue;
+		}
+		auto group = std::find_if(groups.begin(), groups.end(), [&](const Group& other) {
+			return (other.width == width) && (other.height == height) && (textures[other.images[0]].textureSampler == textures[i].textureSampler);
+		});
+		if (group == groups.end()) {
+			groups.push_back({ width, height, { i } });
+		} else {
+			group->images.push_back(i);
+		}
+	}
+
+	// Groups larger than the layer limit are split, single images aren't worth an array
+	const uint32_t maxLayers = device->properties.limits.maxImageArrayLayers;
+	std::vector<Group> arrays;
+	for (const Group& group : groups) {
+		for (size_t first = 0; first < group.images.size(); first += maxLayers) {
+			const size_t last = std::min(group.images.size(), first + maxLayers);
+			if (last - first > 1) {
+				arrays.push_back({ group.width, group.height, std::vector<uint32_t>(group.images.begin() + first, group.images.begin() + last) });
+			}
+		}
+	}
+	// Packed textures point into the list, so it must not grow after this
+	textureArrays.reserve(textureArrays.size() + arrays.size());
+
+	const vks::MipGenerator defaultMipGenerator;
+	const vks::MipGenerator& generator = mipGenerator ? *mipGenerator : defaultMipGenerator;
+	for (const Group& group : arrays) {
+		textureArrays.emplace_back();
+		TextureArray& textureArray = textureArrays.back();
+		textureArray.device = device;
+		textureArray.width = group.width;
+		textureArray.height = group.height;
+		textureArray.mipLevels = vks::MipGenerator::getMipLevelCount(group.width, group.height);
+		textureArray.layerCount = static_cast<uint32_t>(group.images.size());
+
+		// Mip chains are generated on the CPU, so all layers are uploaded with a single copy
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize stagingSize = 0;
+		std::vector<std::vector<std::vector<uint8_t>>> layers(group.images.size());
+		for (uint32_t layer = 0; layer < textureArray.layerCount; layer++) {
+			const uint32_t imageIndex = group.images[layer];
+			tinygltf::Image& gltfImage = gltfModel.images[imageIndex];
+			std::vector<uint8_t> rgba;
+			if (gltfImage.component == 3) {
+				rgba.resize(group.width * group.height * 4);
+				for (size_t j = 0; j < group.width * group.height; j++) {
+					rgba[j * 4 + 0] = gltfImage.image[j * 3 + 0];
+					rgba[j * 4 + 1] = gltfImage.image[j * 3 + 1];
+					rgba[j * 4 + 2] = gltfImage.image[j * 3 + 2];
+					rgba[j * 4 + 3] = 255;
+				}
+			}
+			generator.generate(rgba.empty() ? gltfImage.image.data() : rgba.data(), group.width, group.height, vks::TextureCompressor::getMipContent(imageUsages[imageIndex]), layers[layer]);
+			for (uint32_t level = 0; level < textureArray.mipLevels; level++) {
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(1u, group.width >> level);
+				bufferCopyRegion.imageExtent.height = std::max(1u, group.height >> level);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = stagingSize;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+				stagingSize += layers[layer][level].size();
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, stagingSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		for (uint32_t layer = 0; layer < textureArray.layerCount; layer++) {
+			for (uint32_t level = 0; level < textureArray.mipLevels; level++) {
+				const VkBufferImageCopy& bufferCopyRegion = bufferCopyRegions[layer * textureArray.mipLevels + level];
+				memcpy((uint8_t*)stagingBuffer.mapped + bufferCopyRegion.bufferOffset, layers[layer][level].data(), layers[layer][level].size());
+			}
+		}
+		stagingBuffer.unmap();
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = textureArray.format;
+		imageCreateInfo.mipLevels = textureArray.mipLevels;
+		imageCreateInfo.arrayLayers = textureArray.layerCount;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { group.width, group.height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &textureArray.image));
+
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, textureArray.image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &textureArray.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, textureArray.image, textureArray.deviceMemory, 0));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = textureArray.mipLevels;
+		subresourceRange.layerCount = textureArray.layerCount;
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, textureArray.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, textureArray.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, textureArray.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		device->flushCommandBuffer(copyCmd, transferQueue);
+		stagingBuffer.destroy();
+
+		const TextureSampler& textureSampler = textures[group.images[0]].textureSampler;
+		textureArray.sampler = device->samplerCache.acquire(textureSampler.getCreateInfo(device));
+
+		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+		viewInfo.image = textureArray.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = textureArray.format;
+		viewInfo.subresourceRange = subresourceRange;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &textureArray.view));
+
+		textureArray.descriptor.sampler = textureArray.sampler;
+		textureArray.descriptor.imageView = textureArray.view;
+		textureArray.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// Textures keep working as regular 2D textures with a view of their layer
+		for (uint32_t layer = 0; layer < textureArray.layerCount; layer++) {
+			Texture& texture = textures[group.images[layer]];
+			texture.device = device;
+			texture.textureArray = &textureArray;
+			texture.arrayLayer = layer;
+			texture.width = group.width;
+			texture.height = group.height;
+			texture.mipLevels = textureArray.mipLevels;
+			texture.layerCount = 1;
+			texture.image = textureArray.image;
+			texture.deviceMemory = VK_NULL_HANDLE;
+			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			texture.sampler = device->samplerCache.acquire(textureSampler.getCreateInfo(device));
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.subresourceRange.baseArrayLayer = layer;
+			viewInfo.subresourceRange.layerCount = 1;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &texture.view));
+			texture.updateDescriptor();
+		}
+	}
+}
+
+void vkglTF::Model::updateTextureDescriptors(const vkglTF::Texture* texture)
+{
+	if (bindless.descriptorSet != VK_NULL_HANDLE) {
+		// Packed textures are referenced through their array's view, which doesn't change
+		if (texture->textureArray) {
+			return;
+		}
+		VkDescriptorImageInfo descriptor = texture->descriptor;
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &descriptor);
+		writeDescriptorSet.dstArrayElement = static_cast<uint32_t>(getBindlessTextureIndex(texture));
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		return;
+	}
+	for (auto& material : materials) {
+		if (material.descriptorSet != VK_NULL_HANDLE && material.usesTexture(texture)) {
+			material.updateDescriptorSet();
+		}
+	}
+}
+
 void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Material &mat : gltfModel.materials) {
@@ -1081,10 +1636,12 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
 		}
 
+		material.index = static_cast<uint32_t>(materials.size());
 		materials.push_back(material);
 	}
 	// Push a default material at the end of the list for meshes with no material assigned
 	materials.emplace_back(device, &emptyTexture);
+	materials.back().index = static_cast<uint32_t>(materials.size() - 1);
 }
 
 void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
@@ -1203,10 +1760,14 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
 {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadFromFile");
+	loadingFlags = fileLoadingFlags;
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
 		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+	} else if ((textureResidency && textureResidency->isCreated()) || (textureStreamer && textureStreamer->isCreated()) || textureCompressor) {
+		gltfContext.SetImageLoader(loadImageDataFuncDeferred, textureCompressor ? nullptr : &texturePackingSize);
 	} else {
 		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
 	}
@@ -1369,38 +1930,11 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	getSceneDimensions();
 
 	// Setup descriptors
-	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
-	for (auto node : linearNodes) {
-		if (node->mesh) {
-			uboCount++;
-		}
-	}
-	for (auto material : materials) {
-		if (material.baseColorTexture != nullptr) {
-			imageCount++;
-		}
-	}
-	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
-	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-        if (descriptorBindingFlags & DescriptorBindingFlags::ImagePbr) {
-            poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount * 2 });
-        }
-	}
-	VkDescriptorPoolCreateInfo descriptorPoolCI{};
-	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+	// Sets are allocated from a growable pool chain, so no upfront counting of nodes and materials is required
+	descriptorAllocator.create(device->logicalDevice, {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f }
+	}, 64, &device->descriptorLayoutCache);
 
 	// Descriptors for per-node uniform buffers
 	{
@@ -1409,17 +1943,22 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			};
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
+			descriptorSetLayoutUbo = device->descriptorLayoutCache.getLayout(setLayoutBindings);
 		}
 		for (auto node : nodes) {
 			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
 		}
 	}
 
+	if (bindlessMaterials && !isBindlessSupported(device)) {
+		std::cerr << "Bindless materials require the descriptor indexing features runtimeDescriptorArray, descriptorBindingVariableDescriptorCount and shaderSampledImageArrayNonUniformIndexing, using a descriptor set per material instead\n";
+		bindlessMaterials = false;
+	}
+	if (bindlessMaterials) {
+		prepareBindlessDescriptors();
+		return;
+	}
+
 	// Descriptors for per-material images
 	{
 		// Layout is global, so only create if it hasn't already been created before
@@ -1439,15 +1978,11 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
                 // metallicRoughness map, binding = 3
                 setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
             }
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
+			descriptorSetLayoutImage = device->descriptorLayoutCache.getLayout(setLayoutBindings);
 		}
 		for (auto& material : materials) {
 			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+				material.createDescriptorSet(descriptorAllocator, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
 			}
 		}
 	}
@@ -1470,18 +2005,13 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
         }
         
 		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
 			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
+			if (!skipMaterial(material, renderFlags)) {
+				if (bindless.descriptorSet != VK_NULL_HANDLE) {
+					// The bindless set has been bound by draw(), the material index is passed as the first instance
+					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, material.index);
+					continue;
+				}
 				if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
@@ -1502,11 +2032,227 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
+	if ((bindless.descriptorSet != VK_NULL_HANDLE) && (renderFlags & RenderFlags::BindImages)) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bindless.descriptorSet, 0, nullptr);
+	}
 	for (auto& node : nodes) {
 		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
 	}
 }
 
+bool vkglTF::Model::skipMaterial(const vkglTF::Material& material, uint32_t renderFlags) const
+{
+	bool skip = false;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+	}
+	return skip;
+}
+
+bool vkglTF::Model::isBindlessSupported(const vks::VulkanDevice* device)
+{
+	const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features = device->enabledDescriptorIndexingFeatures;
+	return features.runtimeDescriptorArray && features.descriptorBindingVariableDescriptorCount && features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+bool vkglTF::Model::getDrawCommands(std::vector<VkDrawIndexedIndirectCommand>& drawCommands, uint32_t renderFlags)
+{
+	// Without this feature the first instance of indirect draws has to be zero, so the material index can't be passed
+	if (!device->enabledFeatures.drawIndirectFirstInstance) {
+		return false;
+	}
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (Primitive* primitive : node->mesh->primitives) {
+			if (!skipMaterial(primitive->material, renderFlags)) {
+				VkDrawIndexedIndirectCommand drawCommand{};
+				drawCommand.indexCount = primitive->indexCount;
+				drawCommand.instanceCount = 1;
+				drawCommand.firstIndex = primitive->firstIndex;
+				drawCommand.vertexOffset = 0;
+				drawCommand.firstInstance = primitive->material.index;
+				drawCommands.push_back(drawCommand);
+			}
+		}
+	}
+	return true;
+}
+
+void vkglTF::Model::touchTextures(const glm::mat4& viewProjection, const glm::vec2& viewportSize)
+{
+	const bool preTransform = loadingFlags & FileLoadingFlags::PreTransformVertices;
+	const glm::mat4 flipY = (loadingFlags & FileLoadingFlags::FlipY) ? glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)) : glm::mat4(1.0f);
+	const float fullScreenSize = std::max(viewportSize.x, viewportSize.y);
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		// Primitive bounds are stored in the node's space, pre-transformed vertices have been flipped after applying the node's matrix
+		const glm::mat4 nodeMatrix = node->getMatrix();
+		const glm::mat4 mvp = viewProjection * (preTransform ? flipY * nodeMatrix : nodeMatrix * flipY);
+		for (Primitive* primitive : node->mesh->primitives) {
+			// Project the corners of the primitive's bounding box to estimate the number of pixels it covers
+			glm::vec2 screenMin(FLT_MAX);
+			glm::vec2 screenMax(-FLT_MAX);
+			// Bits are set for each clip plane all corners are outside of
+			uint32_t outside = 0x3F;
+			bool crossesNearPlane = false;
+			for (uint32_t i = 0; i < 8; i++) {
+				const glm::vec3 corner((i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x, (i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y, (i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+				const glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+				uint32_t cornerOutside = 0;
+				cornerOutside |= (clip.x < -clip.w) ? 0x01 : 0;
+				cornerOutside |= (clip.x > clip.w) ? 0x02 : 0;
+				cornerOutside |= (clip.y < -clip.w) ? 0x04 : 0;
+				cornerOutside |= (clip.y > clip.w) ? 0x08 : 0;
+				cornerOutside |= (clip.z < 0.0f) ? 0x10 : 0;
+				cornerOutside |= (clip.z > clip.w) ? 0x20 : 0;
+				outside &= cornerOutside;
+				if (clip.w <= 0.0f) {
+					crossesNearPlane = true;
+					continue;
+				}
+				screenMin = glm::min(screenMin, glm::vec2(clip) / clip.w);
+				screenMax = glm::max(screenMax, glm::vec2(clip) / clip.w);
+			}
+			if (outside != 0) {
+				continue;
+			}
+			// Primitives the camera is inside of (or close to) are assumed to cover the whole screen
+			float screenSize = fullScreenSize;
+			if (!crossesNearPlane) {
+				const glm::vec2 extent = (glm::clamp(screenMax, -1.0f, 1.0f) - glm::clamp(screenMin, -1.0f, 1.0f)) * 0.5f * viewportSize;
+				screenSize = std::max(extent.x, extent.y);
+			}
+			const Material& material = primitive->material;
+			for (const Texture* texture : { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture, material.emissiveTexture, material.specularGlossinessTexture, material.diffuseTexture }) {
+				if (texture && texture->residency) {
+					texture->residency->touch(texture->residencyHandle, vks::TextureResidencyManager::getScreenSizeLevel(texture->width, texture->height, screenSize));
+				}
+			}
+		}
+	}
+}
+
+int32_t vkglTF::Model::getBindlessTextureIndex(const vkglTF::Texture* texture) const
+{
+	// The model's textures are followed by the empty texture and the views of the texture arrays
+	if (texture == nullptr) {
+		return -1;
+	}
+	if (texture == &emptyTexture) {
+		return static_cast<int32_t>(textures.size());
+	}
+	if (texture->textureArray) {
+		return static_cast<int32_t>(textures.size() + 1 + (texture->textureArray - textureArrays.data()));
+	}
+	return static_cast<int32_t>(texture - textures.data());
+}
+
+int32_t vkglTF::Model::getBindlessTextureLayer(const vkglTF::Texture* texture) const
+{
+	if ((texture == nullptr) || (texture->textureArray == nullptr)) {
+		return -1;
+	}
+	return static_cast<int32_t>(texture->arrayLayer);
+}
+
+void vkglTF::Model::updateMaterialBuffer()
+{
+	assert(bindless.materialBuffer.mapped);
+	Material::ShaderData* shaderData = static_cast<Material::ShaderData*>(bindless.materialBuffer.mapped);
+	for (const Material& material : materials) {
+		Material::ShaderData& data = shaderData[material.index];
+		data.baseColorFactor = material.baseColorFactor;
+		data.metallicFactor = material.metallicFactor;
+		data.roughnessFactor = material.roughnessFactor;
+		data.alphaCutoff = material.alphaCutoff;
+		data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		data.baseColorTextureIndex = getBindlessTextureIndex(material.baseColorTexture);
+		data.metallicRoughnessTextureIndex = getBindlessTextureIndex(material.metallicRoughnessTexture);
+		data.normalTextureIndex = getBindlessTextureIndex(material.normalTexture);
+		data.occlusionTextureIndex = getBindlessTextureIndex(material.occlusionTexture);
+		data.emissiveTextureIndex = getBindlessTextureIndex(material.emissiveTexture);
+		data.specularGlossinessTextureIndex = getBindlessTextureIndex(material.specularGlossinessTexture);
+		data.diffuseTextureIndex = getBindlessTextureIndex(material.diffuseTexture);
+		data.baseColorTextureLayer = getBindlessTextureLayer(material.baseColorTexture);
+		data.metallicRoughnessTextureLayer = getBindlessTextureLayer(material.metallicRoughnessTexture);
+		data.normalTextureLayer = getBindlessTextureLayer(material.normalTexture);
+		data.occlusionTextureLayer = getBindlessTextureLayer(material.occlusionTexture);
+		data.emissiveTextureLayer = getBindlessTextureLayer(material.emissiveTexture);
+		data.specularGlossinessTextureLayer = getBindlessTextureLayer(material.specularGlossinessTexture);
+		data.diffuseTextureLayer = getBindlessTextureLayer(material.diffuseTexture);
+		data.padding[0] = data.padding[1] = 0;
+	}
+}
+
+void vkglTF::Model::prepareBindlessDescriptors()
+{
+	// All textures of the model including the empty texture are put into one array, followed by the views of the texture arrays (shaders alias the binding with an array of 2D array samplers to sample these)
+	const uint32_t textureCount = static_cast<uint32_t>(textures.size() + 1 + textureArrays.size());
+	// Layout is global, so only create if it hasn't already been created before, the texture array is sized per set up to this limit
+	const uint32_t maxTextureCount = std::min(4096u, std::min(device->properties.limits.maxPerStageDescriptorSamplers, device->properties.limits.maxPerStageDescriptorSampledImages));
+	if (textureCount > maxTextureCount) {
+		vks::tools::exitFatal("Model uses " + std::to_string(textureCount) + " textures, the bindless texture array is limited to " + std::to_string(maxTextureCount), -1);
+	}
+	if (descriptorSetLayoutBindless == VK_NULL_HANDLE) {
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, maxTextureCount),
+		};
+		// The texture array has to be the binding with the highest number to be variably sized
+		const std::vector<VkDescriptorBindingFlags> bindingFlags = { 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT };
+		descriptorSetLayoutBindless = device->descriptorLayoutCache.getLayout(setLayoutBindings, 0, bindingFlags);
+	}
+
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&bindless.materialBuffer,
+		sizeof(Material::ShaderData) * materials.size()));
+	VK_CHECK_RESULT(bindless.materialBuffer.map());
+	updateMaterialBuffer();
+
+	// A single set is allocated for the whole model, so it gets a pool of its own
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &bindless.descriptorPool));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &textureCount;
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(bindless.descriptorPool, &descriptorSetLayoutBindless, 1);
+	allocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &bindless.descriptorSet));
+
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	textureDescriptors.reserve(textureCount);
+	for (const Texture& texture : textures) {
+		textureDescriptors.push_back(texture.descriptor);
+	}
+	textureDescriptors.push_back(emptyTexture.descriptor);
+	for (const TextureArray& textureArray : textureArrays) {
+		textureDescriptors.push_back(textureArray.descriptor);
+	}
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bindless.materialBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, textureDescriptors.data(), textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -1627,12 +2373,7 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 
 void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
 	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+		node->mesh->uniformBuffer.descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 
 		VkWriteDescriptorSet writeDescriptorSet{};
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -15,6 +15,10 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanTextureStreamer.h"
+#include "VulkanTextureResidency.h"
+#include "VulkanTextureCompressor.h"
+#include "VulkanMipGenerator.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -45,6 +49,8 @@ namespace vkglTF
 
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+	/** @brief Layout of the bindless descriptor set: binding 0 is the material storage buffer, binding 1 a variable sized array of all textures */
+	extern VkDescriptorSetLayout descriptorSetLayoutBindless;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
 
@@ -53,6 +59,43 @@ namespace vkglTF
 	/*
 		glTF texture loading class
 	*/
+	/*
+		glTF texture sampler
+	*/
+	struct TextureSampler {
+		VkFilter magFilter = VK_FILTER_LINEAR;
+		VkFilter minFilter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		/** @brief Converts the filter and wrap modes of a glTF sampler, undefined filters default to trilinear filtering */
+		void fromglTfSampler(const tinygltf::Sampler& gltfSampler);
+		/** @brief Sampler parameters for the device's sampler cache, the level-of-detail is limited by the texture's view so samplers are shared between textures */
+		VkSamplerCreateInfo getCreateInfo(const vks::VulkanDevice* device) const;
+		bool operator==(const TextureSampler& other) const;
+	};
+
+	/*
+		glTF texture array
+	*/
+	/** @brief Image whose layers hold small images of the same size and sampler, see Model::texturePackingSize */
+	struct TextureArray {
+		vks::VulkanDevice* device = nullptr;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+		/** @brief View of all layers (VK_IMAGE_VIEW_TYPE_2D_ARRAY), textures packed into the array use views of their layer */
+		VkImageView view = VK_NULL_HANDLE;
+		/** @brief Acquired from the device's sampler cache */
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		uint32_t width, height;
+		uint32_t mipLevels;
+		uint32_t layerCount;
+		VkDescriptorImageInfo descriptor;
+		void destroy();
+	};
+
 	struct Texture {
 		vks::VulkanDevice* device = nullptr;
 		VkImage image;
@@ -63,10 +106,30 @@ namespace vkglTF
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
+		/** @brief Acquired from the device's sampler cache */
 		VkSampler sampler;
+		/** @brief Filter and wrap modes of the sampler, set from the glTF sampler referencing the image before it's loaded */
+		vkglTF::TextureSampler textureSampler;
+		/** @brief Set if the texture's mip levels are being streamed, the view is replaced as levels arrive */
+		vks::TextureStreamer* streamer = nullptr;
+		/** @brief Set if the texture's mip levels are managed by a residency manager, the image and view are owned by the manager */
+		vks::TextureResidencyManager* residency = nullptr;
+		vks::TextureResidencyManager::Handle residencyHandle = vks::TextureResidencyManager::invalidHandle;
+		/** @brief Set if the image has been packed into a layer of a texture array, the image and memory are owned by the array and the view only covers that layer */
+		vkglTF::TextureArray* textureArray = nullptr;
+		uint32_t arrayLayer = 0;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		/** @brief Mip levels of images that aren't KTX files are blitted on the GPU, or generated with the mip generator (if set or the format can't be blitted) treating the texels as content */
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, const vks::MipGenerator* mipGenerator = nullptr, vks::MipGenerator::Content content = vks::MipGenerator::Content::SRGB);
+		/** @brief Streams the image's mip levels, images still encoded (as_is) are decoded on the streamer's loader thread */
+		void fromglTfImageStreamed(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureStreamer& streamer, vks::MipGenerator::Content content, std::function<void()> onUpdated);
+		/** @brief Adds the image to a residency manager, which drops and restores its largest mip levels depending on usage and the memory budget */
+		void fromglTfImageResident(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureResidencyManager& residency, vks::MipGenerator::Content content, std::function<void()> onUpdated);
+		/** @brief Block compresses images still encoded (as_is) including all mip levels, or loads the result from the compressor's cache */
+		void fromglTfImageCompressed(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureCompressor& compressor, vks::TextureCompressor::Usage usage);
+		/** @brief Creates the texture from all of its mip levels with a single staging buffer copy */
+		void fromLevels(const std::vector<std::vector<uint8_t>>& levels, uint32_t width, uint32_t height, VkFormat format, vks::VulkanDevice* device, VkQueue copyQueue);
 	};
 
 	/*
@@ -92,9 +155,43 @@ namespace vkglTF
         vkglTF::Texture* emptyTexture = nullptr;
 
         VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Images bound by the descriptor set
+		uint32_t descriptorSetBindingFlags = 0;
+		/** @brief Index of the material in the model's material list and the bindless material buffer */
+		uint32_t index = 0;
+
+		/**
+		* @brief Material as stored in the bindless material buffer (std430), texture indices refer to the bindless texture array and are -1 if not set
+		* @note Textures packed into a texture array refer to the array's view (VK_IMAGE_VIEW_TYPE_2D_ARRAY) and have to be sampled at their layer, the layer is -1 for all other textures
+		*/
+		struct ShaderData {
+			glm::vec4 baseColorFactor;
+			float metallicFactor;
+			float roughnessFactor;
+			float alphaCutoff;
+			uint32_t alphaMode;
+			int32_t baseColorTextureIndex;
+			int32_t metallicRoughnessTextureIndex;
+			int32_t normalTextureIndex;
+			int32_t occlusionTextureIndex;
+			int32_t emissiveTextureIndex;
+			int32_t specularGlossinessTextureIndex;
+			int32_t diffuseTextureIndex;
+			int32_t baseColorTextureLayer;
+			int32_t metallicRoughnessTextureLayer;
+			int32_t normalTextureLayer;
+			int32_t occlusionTextureLayer;
+			int32_t emissiveTextureLayer;
+			int32_t specularGlossinessTextureLayer;
+			int32_t diffuseTextureLayer;
+			int32_t padding[2];
+		};
 
 		Material(vks::VulkanDevice* device, vkglTF::Texture* emptyTex) : device(device), emptyTexture(emptyTex) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		void createDescriptorSet(vks::DescriptorAllocator& descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		/** @brief Writes the current descriptors of the material's textures to its descriptor set */
+		void updateDescriptorSet();
+		bool usesTexture(const vkglTF::Texture* texture) const;
 	};
 
 	/*
@@ -255,9 +352,47 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		void updateTextureDescriptors(const vkglTF::Texture* texture);
+		bool skipMaterial(const vkglTF::Material& material, uint32_t renderFlags) const;
+		int32_t getBindlessTextureIndex(const vkglTF::Texture* texture) const;
+		int32_t getBindlessTextureLayer(const vkglTF::Texture* texture) const;
+		void prepareBindlessDescriptors();
+		void packImages(tinygltf::Model& gltfModel, VkQueue transferQueue, const std::vector<vks::TextureCompressor::Usage>& imageUsages);
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		/** @brief If set before loading, images are streamed with this streamer and material descriptor sets are updated as mip levels arrive */
+		vks::TextureStreamer* textureStreamer = nullptr;
+		/** @brief If set before loading, images are added to this residency manager and material descriptor sets are updated when their images are replaced (takes precedence over the streamer) */
+		vks::TextureResidencyManager* textureResidency = nullptr;
+		/** @brief If set before loading, images that aren't KTX files are compressed to BCn formats selected by how the materials use them (ignored for streamed textures) */
+		vks::TextureCompressor* textureCompressor = nullptr;
+		/** @brief If set before loading, the mip levels of images that aren't KTX files are generated on the CPU with this generator instead of blits (ignored for streamed and compressed textures) */
+		vks::MipGenerator* mipGenerator = nullptr;
+		/**
+		* @brief If set before loading, images that aren't KTX files and are no larger than this size are packed into texture arrays, one layer per image (ignored for compressed textures)
+		* @note Images are grouped by size and sampler, groups with a single image are loaded as usual. Packing into layers instead of an atlas keeps the UVs, wrap modes and mip chains of the images intact.
+		* With streamed or resident textures, images that fit are decoded while loading and packed, stay fully resident and aren't managed by the streamer or residency manager, larger images are streamed or made resident as usual.
+		* Each packed texture still gets a view of its layer, so materials and shaders are unchanged. Renderers can sample the array view of textureArrays with the texture's arrayLayer instead, to share descriptors between materials.
+		* With bindless materials, the array views are added to the bindless texture array once per array and the material buffer refers to them with the texture's layer.
+		* Descriptors and views are only saved if TextureArray::descriptor or bindless materials are used. Per-material descriptor sets still use a 2D view, a sampler from the cache and a descriptor write for each packed texture.
+		*/
+		uint32_t texturePackingSize = 0;
+		/** @brief Allocates the per-node and per-material descriptor sets, pools grow with the number of sets required */
+		vks::DescriptorAllocator descriptorAllocator;
+		/**
+		* @brief If set before loading, all textures are put into one descriptor array and all materials into a storage buffer, instead of creating a descriptor set per material
+		* @note The bindless set (see descriptorSetLayoutBindless) is bound once by draw(), the material index of each primitive is passed as its first instance (gl_InstanceIndex), which also works for indirect draws.
+		* Requires the descriptor indexing features runtimeDescriptorArray, descriptorBindingVariableDescriptorCount and shaderSampledImageArrayNonUniformIndexing to be enabled, if they aren't, loading falls back to per-material descriptor sets and clears this flag.
+		*/
+		bool bindlessMaterials = false;
+		/** @brief Returns true if the descriptor indexing features required for bindless materials have been enabled on the device */
+		static bool isBindlessSupported(const vks::VulkanDevice* device);
+		struct Bindless {
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			/** @brief Material::ShaderData of all materials, indexed by Material::index */
+			vks::Buffer materialBuffer;
+		} bindless;
 
 		struct Vertices {
 			int count;
@@ -276,6 +411,8 @@ namespace vkglTF
 		std::vector<Skin*> skins;
 
 		std::vector<Texture> textures;
+		/** @brief Texture arrays the textures have been packed into (see texturePackingSize) */
+		std::vector<TextureArray> textureArrays;
 		std::vector<Material> materials;
 		std::vector<Animation> animations;
 
@@ -290,6 +427,8 @@ namespace vkglTF
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
+		/** @brief Flags the model has been loaded with (see FileLoadingFlags) */
+		uint32_t loadingFlags = FileLoadingFlags::None;
 
 		Model() {};
 		~Model();
@@ -302,6 +441,21 @@ namespace vkglTF
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/**
+		* @brief Appends an indexed indirect draw command for every primitive passing the render flags, the first instance is set to the primitive's material index
+		* @note Node transforms aren't part of the commands, so this is meant for models loaded with PreTransformVertices
+		* @return False if the device's drawIndirectFirstInstance feature isn't enabled, no commands are added in that case and the model has to be drawn with draw()
+		*/
+		bool getDrawCommands(std::vector<VkDrawIndexedIndirectCommand>& drawCommands, uint32_t renderFlags = 0);
+		/** @brief Writes the current material parameters to the bindless material buffer */
+		void updateMaterialBuffer();
+		/**
+		* @brief Marks the textures of visible primitives that have been added to the residency manager as used in the current frame
+		* @param viewProjection Combined projection and view matrix (times the model matrix) the model is rendered with
+		* @param viewportSize Size of the viewport in pixels
+		* @note The mip level a texture is sampled at is estimated from the projected bounds of the primitives using it, so this assumes that texture coordinates span each primitive once
+		*/
+		void touchTextures(const glm::mat4& viewProjection, const glm::vec2& viewportSize);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
@@ -7,34 +7,397 @@
 */
 
 #include <vector>
+#include <array>
 #include <string>
 #include <algorithm>
 #include <limits>
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <cmath>
+#include <sstream>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
 
 namespace vks
 {
 	class Benchmark {
+	public:
+		/** @brief Distribution of a series of timings in milliseconds */
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double mean = 0.0;
+			double stddev = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+		};
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		typedef std::chrono::high_resolution_clock Clock;
+
+		// Number of frames that can be timed at the same time, the timestamps of a frame are read back this many frames later so reading them doesn't stall the GPU
+		static const uint32_t timestampFrames = 3;
+		// GPU timestamps written at the start and end of a frame
+		struct TimestampFrame {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			VkCommandBuffer startCommandBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer endCommandBuffer = VK_NULL_HANDLE;
+			// Signaled once the end timestamp has been written
+			VkFence fence = VK_NULL_HANDLE;
+			bool pending = false;
+			// Index of the frame in gpuTimes, negative for frames outside of the benchmark phase
+			int64_t sampleIndex = -1;
+		};
+		struct {
+			VkDevice device = VK_NULL_HANDLE;
+			VkQueue queue = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::array<TimestampFrame, timestampFrames> frames;
+			uint32_t currentFrame = 0;
+			uint64_t validBitsMask = 0;
+			float timestampPeriod = 1.0f;
+		} gpu;
+		bool measuring = false;
+		// Only set during the benchmark phase (not during warm up)
+		bool sampling = false;
+		bool frameStarted = false;
+		bool frameEnded = false;
+		Clock::time_point tFrameStart;
+		double cpuTime = 0.0;
+
+		void prepareGpuTimestamps(vks::VulkanDevice* vulkanDevice, VkQueue queue)
+		{
+			const uint32_t queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+			const uint32_t validBits = vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+			if ((validBits == 0) || (vulkanDevice->properties.limits.timestampPeriod == 0.0f)) {
+				std::cout << "GPU timestamps not supported by the graphics queue, GPU times won't be reported" << "\n";
+				return;
+			}
+			gpu.device = vulkanDevice->logicalDevice;
+			gpu.queue = queue;
+			gpu.validBitsMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+			gpu.timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+
+			// The timestamps are written by separate submissions around the example's own submissions
+			// A timestamp waits for all previously submitted commands to reach the given stage, so this measures the whole frame without having to touch the example's command buffers
+			// Note that the start timestamp doesn't wait for the swap chain image, so waiting for presentation (e.g. with v-sync) is part of the GPU time
+			// The command buffers are recorded once, each set of them is only submitted again after the GPU has finished with it
+			gpu.commandPool = vulkanDevice->createCommandPool(queueFamilyIndex, 0);
+			for (auto& frame : gpu.frames) {
+				VkQueryPoolCreateInfo queryPoolCI{};
+				queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolCI.queryCount = 2;
+				VK_CHECK_RESULT(vkCreateQueryPool(gpu.device, &queryPoolCI, nullptr, &frame.queryPool));
+				frame.startCommandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, gpu.commandPool, true);
+				vkCmdResetQueryPool(frame.startCommandBuffer, frame.queryPool, 0, 2);
+				vkCmdWriteTimestamp(frame.startCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, 0);
+				VK_CHECK_RESULT(vkEndCommandBuffer(frame.startCommandBuffer));
+				frame.endCommandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, gpu.commandPool, true);
+				vkCmdWriteTimestamp(frame.endCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, 1);
+				VK_CHECK_RESULT(vkEndCommandBuffer(frame.endCommandBuffer));
+				VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo();
+				VK_CHECK_RESULT(vkCreateFence(gpu.device, &fenceCI, nullptr, &frame.fence));
+			}
+			gpu.currentFrame = 0;
+		}
+
+		void destroyGpuTimestamps()
+		{
+			if (gpu.device == VK_NULL_HANDLE) {
+				return;
+			}
+			vkQueueWaitIdle(gpu.queue);
+			vkDestroyCommandPool(gpu.device, gpu.commandPool, nullptr);
+			for (auto& frame : gpu.frames) {
+				vkDestroyQueryPool(gpu.device, frame.queryPool, nullptr);
+				vkDestroyFence(gpu.device, frame.fence, nullptr);
+				frame = TimestampFrame();
+			}
+			gpu.device = VK_NULL_HANDLE;
+		}
+
+		void submitTimestamp(VkCommandBuffer commandBuffer, VkFence fence)
+		{
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = (commandBuffer != VK_NULL_HANDLE) ? 1 : 0;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(gpu.queue, 1, &submitInfo, fence));
+		}
+
+		// Stores the GPU time (in ms) of a timed frame once its timestamps have been written, only waits for the GPU if requested
+		void resolveTimestamps(TimestampFrame& frame, bool wait)
+		{
+			if (!frame.pending) {
+				return;
+			}
+			if (wait) {
+				VK_CHECK_RESULT(vkWaitForFences(gpu.device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+			} else if (vkGetFenceStatus(gpu.device, frame.fence) != VK_SUCCESS) {
+				return;
+			}
+			frame.pending = false;
+			if (frame.sampleIndex < 0) {
+				return;
+			}
+			// The fence has been signaled, so the results are available without waiting
+			uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(gpu.device, frame.queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				return;
+			}
+			const uint64_t delta = ((timestamps[1] & gpu.validBitsMask) - (timestamps[0] & gpu.validBitsMask)) & gpu.validBitsMask;
+			if (gpuTimes.size() <= (size_t)frame.sampleIndex) {
+				gpuTimes.resize(frame.sampleIndex + 1, -1.0);
+			}
+			gpuTimes[frame.sampleIndex] = (double)delta * gpu.timestampPeriod / 1000000.0;
+		}
+
+		// Reads back the timestamps of all frames the GPU has finished with
+		void pollTimestamps(bool wait)
+		{
+			if (gpu.device == VK_NULL_HANDLE) {
+				return;
+			}
+			for (auto& frame : gpu.frames) {
+				resolveTimestamps(frame, wait);
+			}
+		}
+
+		// Frames that acquired an image but didn't submit any work are not timed, the fence is still signaled so the timestamps can be reused
+		void abandonFrame()
+		{
+			if ((gpu.device == VK_NULL_HANDLE) || !frameStarted || frameEnded) {
+				return;
+			}
+			TimestampFrame& frame = gpu.frames[gpu.currentFrame];
+			frame.sampleIndex = -1;
+			submitTimestamp(VK_NULL_HANDLE, frame.fence);
+			gpu.currentFrame = (gpu.currentFrame + 1) % timestampFrames;
+		}
+
+		void printStatistics(const std::string& label, const std::vector<double>& samples)
+		{
+			if (samples.empty()) {
+				return;
+			}
+			Statistics stats = computeStatistics(samples);
+			std::cout << label << ": avg " << stats.mean << " ms, stddev " << stats.stddev << ", min " << stats.min << ", max " << stats.max;
+			std::cout << ", p50 " << stats.p50 << ", p95 " << stats.p95 << ", p99 " << stats.p99 << ", p99.9 " << stats.p999 << "\n";
+		}
+
+		static std::string escapeJson(const std::string& str)
+		{
+			std::string result;
+			for (char c : str) {
+				switch (c) {
+				case '"': result += "\\\""; break;
+				case '\\': result += "\\\\"; break;
+				case '\n': result += "\\n"; break;
+				case '\r': result += "\\r"; break;
+				case '\t': result += "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						std::stringstream ss;
+						ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c;
+						result += ss.str();
+					} else {
+						result += c;
+					}
+				}
+			}
+			return result;
+		}
+
+		static void writeJsonStatistics(std::ostream& out, const std::string& name, const std::vector<double>& samples)
+		{
+			out << "\t\"" << name << "\": ";
+			if (samples.empty()) {
+				out << "null";
+				return;
+			}
+			Statistics stats = computeStatistics(samples);
+			out << "{ \"min\": " << stats.min << ", \"max\": " << stats.max << ", \"mean\": " << stats.mean << ", \"stddev\": " << stats.stddev;
+			out << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"p99.9\": " << stats.p999 << " }";
+		}
+
+		static void writeJsonArray(std::ostream& out, const std::string& name, const std::vector<double>& samples)
+		{
+			out << "\t\"" << name << "\": [";
+			for (size_t i = 0; i < samples.size(); i++) {
+				out << (i > 0 ? ", " : "") << samples[i];
+			}
+			out << "]";
+		}
+
+		void saveJson(std::ofstream& result)
+		{
+			result << "{\n";
+			result << "\t\"example\": \"" << escapeJson(exampleName) << "\",\n";
+			result << "\t\"commandLine\": [";
+			for (size_t i = 0; i < commandLine.size(); i++) {
+				result << (i > 0 ? ", " : "") << "\"" << escapeJson(commandLine[i]) << "\"";
+			}
+			result << "],\n";
+			result << "\t\"device\": \"" << escapeJson(deviceProps.deviceName) << "\",\n";
+			result << "\t\"vendorID\": " << deviceProps.vendorID << ",\n";
+			result << "\t\"deviceID\": " << deviceProps.deviceID << ",\n";
+			result << "\t\"driverVersion\": " << deviceProps.driverVersion << ",\n";
+			result << "\t\"apiVersion\": \"" << VK_VERSION_MAJOR(deviceProps.apiVersion) << "." << VK_VERSION_MINOR(deviceProps.apiVersion) << "." << VK_VERSION_PATCH(deviceProps.apiVersion) << "\",\n";
+			result << "\t\"warmup\": " << warmup << ",\n";
+			result << "\t\"duration\": " << duration << ",\n";
+			result << "\t\"frames\": " << frameCount << ",\n";
+			result << "\t\"runtime\": " << runtime << ",\n";
+			result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+			writeJsonStatistics(result, "frameTime", frameTimes);
+			result << ",\n";
+			writeJsonStatistics(result, "cpuTime", cpuTimes);
+			result << ",\n";
+			writeJsonStatistics(result, "gpuTime", gpuTimes);
+			result << ",\n";
+			result << "\t\"gpuScopes\": {";
+			for (size_t i = 0; i < scopeTimes.size(); i++) {
+				result << (i > 0 ? "," : "") << "\n\t";
+				writeJsonStatistics(result, escapeJson(scopeTimes[i].first), scopeTimes[i].second);
+			}
+			result << (scopeTimes.empty() ? "}" : "\n\t}");
+			if (outputFrameTimes) {
+				result << ",\n";
+				writeJsonArray(result, "frameTimes", frameTimes);
+				result << ",\n";
+				writeJsonArray(result, "cpuTimes", cpuTimes);
+				result << ",\n";
+				writeJsonArray(result, "gpuTimes", gpuTimes);
+			}
+			result << "\n}\n";
+		}
+
+		void saveCsv(std::ofstream& result)
+		{
+			Statistics stats = computeStatistics(frameTimes);
+			result << "device,driverversion,duration (ms),frames,fps,avg (ms),stddev (ms),p50 (ms),p95 (ms),p99 (ms),p99.9 (ms)" << "\n";
+			result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0);
+			result << "," << stats.mean << "," << stats.stddev << "," << stats.p50 << "," << stats.p95 << "," << stats.p99 << "," << stats.p999 << "\n";
+
+			if (outputFrameTimes) {
+				result << "\n" << "frame,ms,cpu ms,gpu ms" << "\n";
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					result << i << "," << frameTimes[i] << "," << cpuTimes[i] << ",";
+					if (i < gpuTimes.size()) {
+						result << gpuTimes[i];
+					}
+					result << "\n";
+				}
+			}
+		}
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
 		int outputFrames = -1; // -1 means no frames limit
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
+		/** @brief Total time of each frame (wall time of the render function) */
 		std::vector<double> frameTimes;
+		/** @brief CPU time of each frame from acquiring the swap chain image to presenting it (updates, recording and submission) */
+		std::vector<double> cpuTimes;
+		/** @brief GPU time of each frame measured with timestamp queries, empty if the device doesn't support timestamps */
+		std::vector<double> gpuTimes;
+		/** @brief GPU times of named scopes (see vks::GpuProfiler) in the order they were first reported */
+		std::vector<std::pair<std::string, std::vector<double>>> scopeTimes;
+		/** @brief Results are written as JSON if the file name ends with .json, as CSV otherwise */
 		std::string filename = "";
+		/** @brief Name of the example and the command line it was started with, written to the JSON results */
+		std::string exampleName = "";
+		std::vector<std::string> commandLine;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
-		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
+		/** @brief Computes min, max, mean, standard deviation and percentiles (nearest rank) of a series of samples */
+		static Statistics computeStatistics(std::vector<double> samples)
+		{
+			Statistics stats;
+			if (samples.empty()) {
+				return stats;
+			}
+			std::sort(samples.begin(), samples.end());
+			const size_t count = samples.size();
+			auto percentile = [&](double p) {
+				size_t rank = (size_t)std::ceil(p / 100.0 * (double)count);
+				return samples[std::min(std::max(rank, (size_t)1), count) - 1];
+			};
+			stats.min = samples.front();
+			stats.max = samples.back();
+			stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / (double)count;
+			double variance = 0.0;
+			for (double sample : samples) {
+				variance += (sample - stats.mean) * (sample - stats.mean);
+			}
+			stats.stddev = std::sqrt(variance / (double)count);
+			stats.p50 = percentile(50.0);
+			stats.p95 = percentile(95.0);
+			stats.p99 = percentile(99.0);
+			stats.p999 = percentile(99.9);
+			return stats;
+		}
+
+		/** @brief Adds the GPU time of a named scope for the current frame, ignored outside of the benchmark phase */
+		void addScopeTime(const std::string& name, double time)
+		{
+			if (!sampling) {
+				return;
+			}
+			auto it = std::find_if(scopeTimes.begin(), scopeTimes.end(), [&name](const std::pair<std::string, std::vector<double>>& scope) { return scope.first == name; });
+			if (it == scopeTimes.end()) {
+				scopeTimes.push_back({ name, {} });
+				it = scopeTimes.end() - 1;
+			}
+			it->second.push_back(time);
+		}
+
+		/** @brief Called once the swap chain image of a frame has been acquired, writes the frame start timestamp */
+		void frameStart()
+		{
+			if (!measuring) {
+				return;
+			}
+			frameStarted = true;
+			tFrameStart = Clock::now();
+			if (gpu.device != VK_NULL_HANDLE) {
+				// The timestamps of this slot were written several frames ago, so this usually doesn't wait
+				TimestampFrame& frame = gpu.frames[gpu.currentFrame];
+				resolveTimestamps(frame, true);
+				VK_CHECK_RESULT(vkResetFences(gpu.device, 1, &frame.fence));
+				frame.pending = true;
+				submitTimestamp(frame.startCommandBuffer, VK_NULL_HANDLE);
+			}
+		}
+
+		/** @brief Called after the example submitted its work for a frame, right before presenting, writes the frame end timestamp */
+		void frameEnd()
+		{
+			if (!measuring || !frameStarted) {
+				return;
+			}
+			frameEnded = true;
+			cpuTime = std::chrono::duration<double, std::milli>(Clock::now() - tFrameStart).count();
+			if (gpu.device != VK_NULL_HANDLE) {
+				TimestampFrame& frame = gpu.frames[gpu.currentFrame];
+				// Frames are added to the results after the render function returns, so this frame's index is the current number of frames
+				frame.sampleIndex = sampling ? (int64_t)frameTimes.size() : -1;
+				submitTimestamp(frame.endCommandBuffer, frame.fence);
+				gpu.currentFrame = (gpu.currentFrame + 1) % timestampFrames;
+			}
+		}
+
+		void run(std::function<void()> renderFunc, vks::VulkanDevice* vulkanDevice, VkQueue queue) {
 			active = true;
-			this->deviceProps = deviceProps;
+			this->deviceProps = vulkanDevice->properties;
 #if defined(_WIN32)
 			AttachConsole(ATTACH_PARENT_PROCESS);
 			freopen_s(&stream, "CONOUT$", "w+", stdout);
@@ -42,33 +405,59 @@ namespace vks
 #endif
 			std::cout << std::fixed << std::setprecision(3);
 
+			prepareGpuTimestamps(vulkanDevice, queue);
+			measuring = true;
+
 			// Warm up phase to get more stable frame rates
 			{
 				double tMeasured = 0.0;
 				while (tMeasured < (warmup * 1000)) {
-					auto tStart = std::chrono::high_resolution_clock::now();
+					auto tStart = Clock::now();
+					frameStarted = frameEnded = false;
 					renderFunc();
-					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					abandonFrame();
+					pollTimestamps(false);
+					auto tDiff = std::chrono::duration<double, std::milli>(Clock::now() - tStart).count();
 					tMeasured += tDiff;
 				};
 			}
 
 			// Benchmark phase
 			{
+				sampling = true;
 				while (runtime < (duration * 1000.0)) {
-					auto tStart = std::chrono::high_resolution_clock::now();
+					auto tStart = Clock::now();
+					frameStarted = frameEnded = false;
 					renderFunc();
-					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					auto tDiff = std::chrono::duration<double, std::milli>(Clock::now() - tStart).count();
+					abandonFrame();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					cpuTimes.push_back(frameEnded ? cpuTime : tDiff);
+					// GPU times of earlier frames that have finished in the meantime, this doesn't wait for the GPU
+					pollTimestamps(false);
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				measuring = false;
+				sampling = false;
+				pollTimestamps(true);
+				destroyGpuTimestamps();
+				// Per frame GPU times can only be matched to frames if every frame was timed
+				if ((gpuTimes.size() != frameTimes.size()) || (std::find_if(gpuTimes.begin(), gpuTimes.end(), [](double time) { return time < 0.0; }) != gpuTimes.end())) {
+					gpuTimes.clear();
+				}
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				printStatistics("frame  ", frameTimes);
+				printStatistics("cpu    ", cpuTimes);
+				printStatistics("gpu    ", gpuTimes);
+				for (auto& scope : scopeTimes) {
+					printStatistics("  " + scope.first, scope.second);
+				}
 			}
 		}
 
@@ -77,21 +466,11 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
-
-				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
-					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
-					std::cout << "\n";
+				const std::string jsonExtension = ".json";
+				if ((filename.size() >= jsonExtension.size()) && (filename.compare(filename.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0)) {
+					saveJson(result);
+				} else {
+					saveCsv(result);
 				}
 
 				result.flush();
@@ -101,4 +480,4 @@ namespace vks
 			}
 		}
 	};
-}
\ No newline at end of file
+}
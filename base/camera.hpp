@@ -11,6 +11,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
 
 class Camera
 {
@@ -238,4 +242,90 @@ public:
 		return retVal;
 	}
 
-};
\ No newline at end of file
+};
+
+/*
+	Records the camera state of every frame so the exact same camera movement can be played back (e.g. for benchmarks)
+*/
+class CameraPath
+{
+private:
+	struct Frame
+	{
+		glm::vec3 position;
+		glm::vec3 rotation;
+		uint32_t keys;
+	};
+	std::vector<Frame> frames;
+	size_t playbackFrame = 0;
+public:
+	bool empty() const
+	{
+		return frames.empty();
+	}
+
+	size_t size() const
+	{
+		return frames.size();
+	}
+
+	// Appends the current state of the camera
+	void record(const Camera& camera)
+	{
+		const uint32_t keys = (camera.keys.left ? 1 : 0) | (camera.keys.right ? 2 : 0) | (camera.keys.up ? 4 : 0) | (camera.keys.down ? 8 : 0);
+		frames.push_back({ camera.position, camera.rotation, keys });
+	}
+
+	// Applies the next recorded state to the camera, starts over once the end of the path has been reached
+	void playback(Camera& camera)
+	{
+		if (frames.empty()) {
+			return;
+		}
+		const Frame& frame = frames[playbackFrame];
+		playbackFrame = (playbackFrame + 1) % frames.size();
+		// Key state is only stored for reference, movement is already contained in the recorded position
+		camera.keys.left = camera.keys.right = camera.keys.up = camera.keys.down = false;
+		camera.position = frame.position;
+		camera.setRotation(frame.rotation);
+	}
+
+	bool save(const std::string& filename) const
+	{
+		std::ofstream file(filename, std::ios::out);
+		if (!file.is_open()) {
+			return false;
+		}
+		file.precision(9);
+		file << "# camera path: position.xyz rotation.xyz keys" << "\n";
+		for (auto& frame : frames) {
+			file << frame.position.x << " " << frame.position.y << " " << frame.position.z << " ";
+			file << frame.rotation.x << " " << frame.rotation.y << " " << frame.rotation.z << " " << frame.keys << "\n";
+		}
+		return true;
+	}
+
+	bool load(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::in);
+		if (!file.is_open()) {
+			return false;
+		}
+		frames.clear();
+		playbackFrame = 0;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || (line[0] == '#')) {
+				continue;
+			}
+			std::istringstream stream(line);
+			Frame frame{};
+			stream >> frame.position.x >> frame.position.y >> frame.position.z >> frame.rotation.x >> frame.rotation.y >> frame.rotation.z >> frame.keys;
+			if (stream.fail()) {
+				return false;
+			}
+			frames.push_back(frame);
+		}
+		return true;
+	}
+};
@@ -0,0 +1,177 @@
+/*
+* CPU profiler
+*
+* Records named zones per thread and writes them in the Chrome tracing format (chrome://tracing, Perfetto)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#define VKS_PROFILE_CONCAT_INNER(a, b) a ## b
+#define VKS_PROFILE_CONCAT(a, b) VKS_PROFILE_CONCAT_INNER(a, b)
+/** @brief Profiles the enclosing scope under the given name, which must be a string literal (or otherwise outlive the profiler) */
+#define VKS_PROFILE_ZONE(name) vks::CpuProfiler::Zone VKS_PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+namespace vks
+{
+	/**
+	* @brief Collects CPU zones of all threads with very low overhead
+	* @note Each thread writes to its own fixed size ring buffer, so recording never locks or allocates, only the most recent zones of a thread are kept once its buffer is full
+	*/
+	class CpuProfiler
+	{
+	public:
+		/** @brief Records the time between its construction and destruction if the profiler is enabled */
+		class Zone
+		{
+		private:
+			const char* name;
+			int64_t start;
+		public:
+			Zone(const char* name) : name(name), start(-1)
+			{
+				if (CpuProfiler::get().enabled.load(std::memory_order_relaxed)) {
+					start = CpuProfiler::now();
+				}
+			}
+			~Zone()
+			{
+				if (start >= 0) {
+					CpuProfiler::get().record(name, start, CpuProfiler::now());
+				}
+			}
+		};
+
+		/** @brief Number of zones each thread keeps */
+		static const uint32_t ZonesPerThread = 1 << 16;
+
+		/** @brief Returns the profiler shared by all threads of the process */
+		static CpuProfiler& get()
+		{
+			static CpuProfiler profiler;
+			return profiler;
+		}
+
+		/** @brief Starts or stops recording zones, recording is disabled by default */
+		void setEnabled(bool enable)
+		{
+			enabled.store(enable, std::memory_order_relaxed);
+		}
+
+		bool isEnabled() const
+		{
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Names the calling thread in the trace */
+		void setThreadName(const std::string& name)
+		{
+			ThreadBuffer& buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(mutex);
+			buffer.name = name;
+		}
+
+		/**
+		* @brief Writes all recorded zones in the Chrome trace event format
+		* @note Zones still being recorded by other threads while writing may be missing or incomplete, so this is best called once work has finished (e.g. at shutdown)
+		*/
+		bool writeChromeTrace(const std::string& filename)
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			file << std::fixed << std::setprecision(3);
+			file << "{\"traceEvents\":[\n";
+			bool first = true;
+			for (auto& buffer : threadBuffers) {
+				if (!buffer->name.empty()) {
+					file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+					first = false;
+				}
+				const uint64_t count = buffer->count.load(std::memory_order_acquire);
+				const uint64_t begin = (count > ZonesPerThread) ? count - ZonesPerThread : 0;
+				for (uint64_t i = begin; i < count; i++) {
+					const ZoneRecord& zone = buffer->zones[i % ZonesPerThread];
+					file << (first ? "" : ",\n") << "{\"name\":\"" << escape(zone.name) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->id;
+					file << ",\"ts\":" << (double)zone.start / 1000.0 << ",\"dur\":" << (double)(zone.end - zone.start) / 1000.0 << "}";
+					first = false;
+				}
+			}
+			file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+			return true;
+		}
+
+	private:
+		struct ZoneRecord {
+			const char* name;
+			int64_t start;
+			int64_t end;
+		};
+		struct ThreadBuffer {
+			uint32_t id = 0;
+			std::string name;
+			std::vector<ZoneRecord> zones;
+			std::atomic<uint64_t> count{ 0 };
+		};
+
+		std::atomic<bool> enabled{ false };
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		std::mutex mutex;
+		// Buffers are owned by the profiler so zones of threads that already exited are kept
+		std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+		// Nanoseconds since the profiler was created
+		static int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - get().epoch).count();
+		}
+
+		ThreadBuffer& threadBuffer()
+		{
+			static thread_local ThreadBuffer* buffer = nullptr;
+			if (!buffer) {
+				std::unique_ptr<ThreadBuffer> newBuffer(new ThreadBuffer());
+				newBuffer->zones.resize(ZonesPerThread);
+				std::lock_guard<std::mutex> lock(mutex);
+				newBuffer->id = static_cast<uint32_t>(threadBuffers.size());
+				buffer = newBuffer.get();
+				threadBuffers.push_back(std::move(newBuffer));
+			}
+			return *buffer;
+		}
+
+		void record(const char* name, int64_t start, int64_t end)
+		{
+			ThreadBuffer& buffer = threadBuffer();
+			const uint64_t index = buffer.count.load(std::memory_order_relaxed);
+			buffer.zones[index % ZonesPerThread] = { name, start, end };
+			buffer.count.store(index + 1, std::memory_order_release);
+		}
+
+		static std::string escape(const std::string& str)
+		{
+			std::string result;
+			for (char c : str) {
+				if ((c == '"') || (c == '\\')) {
+					result += '\\';
+				}
+				result += ((unsigned char)c < 0x20) ? ' ' : c;
+			}
+			return result;
+		}
+	};
+}
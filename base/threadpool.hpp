@@ -1,121 +1,553 @@
 /*
-* Basic C++11 based thread pool with per-thread job queues
+* Work stealing thread pool (job system)
+*
+* Every participating thread (the thread that created the pool and all workers) owns a lock-free
+* Chase-Lev deque. Jobs are pushed to and popped from the bottom of the owner's deque, idle threads
+* steal from the top of other deques. Job storage comes from fixed per-thread rings, so scheduling
+* a job does not allocate. Jobs can have a parent, which is only considered finished once all of
+* its children have finished, so dependencies can be expressed by waiting on the parent.
+* Threads outside of the pool submit through a locked injection queue, which also takes the jobs
+* of threads whose deque is full.
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
+#include <deque>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <string>
 
-// make_unique is not available in C++11
-// Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
-template<typename T, typename ...Args>
-std::unique_ptr<T> make_unique(Args&& ...args)
-{
-	return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
-}
+#include "cpuprofiler.hpp"
 
 namespace vks
 {
-	class Thread
+	/**
+	* @brief A unit of work with inline storage for the callable
+	* @note Callables must fit into Job::StorageSize bytes, larger state should be captured by reference
+	*/
+	struct Job
+	{
+		static const size_t StorageSize = 80;
+
+		void (*function)(Job*) = nullptr;
+		void (*destructor)(Job*) = nullptr;
+		Job* parent = nullptr;
+		// Number of jobs (this one and all of its children) that still need to finish
+		std::atomic<int32_t> unfinishedJobs;
+		typename std::aligned_storage<StorageSize, 16>::type storage;
+
+		Job() : unfinishedJobs(0) {}
+
+		template<typename T>
+		T* data() { return reinterpret_cast<T*>(&storage); }
+
+		bool finished() const { return unfinishedJobs.load(std::memory_order_acquire) <= 0; }
+	};
+
+	/**
+	* @brief Lock-free work stealing deque (Chase and Lev, with the memory ordering from Le et al. 2013)
+	* @note push and pop may only be called by the owning thread, steal may be called by any thread
+	*/
+	class JobDeque
 	{
 	private:
-		bool destroying = false;
-		std::thread worker;
-		std::queue<std::function<void()>> jobQueue;
-		std::mutex queueMutex;
-		std::condition_variable condition;
+		std::unique_ptr<std::atomic<Job*>[]> buffer;
+		int64_t mask;
+		std::atomic<int64_t> top;
+		std::atomic<int64_t> bottom;
+	public:
+		explicit JobDeque(uint32_t capacity) : buffer(new std::atomic<Job*>[capacity]), mask(capacity - 1), top(0), bottom(0)
+		{
+			// Capacity must be a power of two
+			assert((capacity & (capacity - 1)) == 0);
+		}
 
-		// Loop through all remaining jobs
-		void queueLoop()
+		/** @brief Returns false if the deque is full, the job has to be queued elsewhere then */
+		bool push(Job* job)
 		{
-			while (true)
-			{
-				std::function<void()> job;
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			if (b - t > mask) {
+				return false;
+			}
+			buffer[b & mask].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Job* pop()
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				// Deque was already empty
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last item, race against concurrent steals
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return nullptr;
+			}
+			Job* job = buffer[t & mask].load(std::memory_order_relaxed);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				// Lost the race against another thief or the owner
+				return nullptr;
+			}
+			return job;
+		}
+	};
+
+	class ThreadPool
+	{
+	private:
+		// Max. number of jobs a single thread can have in flight (must be a power of two)
+		static const uint32_t MaxJobsPerThread = 4096;
+
+		struct ThreadQueue
+		{
+			JobDeque deque;
+			std::unique_ptr<Job[]> jobs;
+			uint32_t allocatedJobs = 0;
+			ThreadQueue() : deque(MaxJobsPerThread), jobs(new Job[MaxJobsPerThread]) {}
+		};
+
+		std::vector<std::unique_ptr<ThreadQueue>> queues;
+		std::vector<std::thread> workers;
+		// Jobs of threads outside of the pool and jobs that didn't fit into a full deque
+		std::mutex injectionMutex;
+		std::deque<Job*> injectedJobs;
+		std::atomic<int32_t> injectedJobCount;
+		// Job storage for threads outside of the pool, guarded by injectionMutex
+		std::unique_ptr<Job[]> externalJobs;
+		uint32_t allocatedExternalJobs = 0;
+		// Number of jobs that have been pushed but not yet been picked up
+		std::atomic<int32_t> queuedJobs;
+		// Number of jobs that have been scheduled but not yet finished
+		std::atomic<int32_t> pendingJobs;
+		std::atomic<int32_t> sleepingWorkers;
+		std::atomic<bool> destroying;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		// A thread can take part in several pools, so its index is stored per pool. Pools are identified by a unique id instead of their address, which may be reused by a later pool.
+		struct ThreadContext
+		{
+			uint64_t poolId;
+			uint32_t index;
+		};
+		const uint64_t poolId;
+
+		static std::vector<ThreadContext>& contexts()
+		{
+			static thread_local std::vector<ThreadContext> threadContexts;
+			return threadContexts;
+		}
+
+		static uint64_t createPoolId()
+		{
+			static std::atomic<uint64_t> nextPoolId(1);
+			return nextPoolId.fetch_add(1);
+		}
+
+		void setThreadContext(uint32_t index)
+		{
+			for (auto& context : contexts()) {
+				if (context.poolId == poolId) {
+					context.index = index;
+					return;
+				}
+			}
+			contexts().push_back({ poolId, index });
+		}
+
+		void clearThreadContext()
+		{
+			auto& threadContexts = contexts();
+			threadContexts.erase(std::remove_if(threadContexts.begin(), threadContexts.end(), [this](const ThreadContext& context) { return context.poolId == poolId; }), threadContexts.end());
+		}
+
+		// Returns null for threads outside of the pool
+		ThreadQueue* localQueue()
+		{
+			const uint32_t index = getThreadIndex();
+			return (index != ExternalThread) ? queues[index].get() : nullptr;
+		}
+
+		void inject(Job* job)
+		{
+			std::lock_guard<std::mutex> lock(injectionMutex);
+			injectedJobs.push_back(job);
+			injectedJobCount.fetch_add(1, std::memory_order_release);
+		}
+
+		Job* takeInjectedJob()
+		{
+			if (injectedJobCount.load(std::memory_order_acquire) <= 0) {
+				return nullptr;
+			}
+			std::lock_guard<std::mutex> lock(injectionMutex);
+			if (injectedJobs.empty()) {
+				return nullptr;
+			}
+			Job* job = injectedJobs.front();
+			injectedJobs.pop_front();
+			injectedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+
+		template<typename F>
+		static void invoke(Job* job)
+		{
+			(*job->data<F>())(job);
+		}
+
+		template<typename F>
+		static void destroyCallable(Job* job)
+		{
+			job->data<F>()->~F();
+		}
+
+		// Detects callables that take the job they are run from as an argument
+		template<typename F>
+		struct AcceptsJob
+		{
+			template<typename U> static auto test(int) -> decltype(std::declval<U&>()(std::declval<Job*>()), std::true_type());
+			template<typename U> static std::false_type test(...);
+			static const bool value = decltype(test<F>(0))::value;
+		};
+
+		// Wraps callables taking no arguments so they can be invoked like ones taking the job
+		template<typename F>
+		struct PlainCallable
+		{
+			F function;
+			void operator()(Job*) { function(); }
+		};
+
+		Job* allocateJob()
+		{
+			ThreadQueue* queue = localQueue();
+			if (queue) {
+				Job* job = &queue->jobs[queue->allocatedJobs++ & (MaxJobsPerThread - 1)];
+				// The ring wrapped around onto a job that is still running, help out until it's done
+				while (!job->finished()) {
+					if (!runPendingJob()) {
+						std::this_thread::yield();
+					}
+				}
+				return job;
+			}
+			// External threads share one ring, a slot is claimed under the lock so concurrent submitters never get the same job
+			while (true) {
 				{
-					std::unique_lock<std::mutex> lock(queueMutex);
-					condition.wait(lock, [this] { return !jobQueue.empty() || destroying; });
-					if (destroying)
-					{
-						break;
+					std::lock_guard<std::mutex> lock(injectionMutex);
+					Job* job = &externalJobs[allocatedExternalJobs & (MaxJobsPerThread - 1)];
+					if (job->finished()) {
+						allocatedExternalJobs++;
+						job->unfinishedJobs.store(1, std::memory_order_relaxed);
+						return job;
 					}
-					job = jobQueue.front();
 				}
+				if (!runPendingJob()) {
+					std::this_thread::yield();
+				}
+			}
+		}
 
-				job();
+		Job* getJob()
+		{
+			ThreadQueue* queue = localQueue();
+			Job* job = queue ? queue->deque.pop() : nullptr;
+			if (job) {
+				return job;
+			}
+			job = takeInjectedJob();
+			if (job) {
+				return job;
+			}
+			// No local work, try to steal from another thread starting with a neighbour
+			const uint32_t count = static_cast<uint32_t>(queues.size());
+			const uint32_t start = queue ? getThreadIndex() : 0;
+			for (uint32_t i = queue ? 1 : 0; i < count; i++) {
+				job = queues[(start + i) % count]->deque.steal();
+				if (job) {
+					return job;
+				}
+			}
+			return nullptr;
+		}
 
-				{
-					std::lock_guard<std::mutex> lock(queueMutex);
-					jobQueue.pop();
-					condition.notify_one();
+		void finish(Job* job)
+		{
+			// Read the parent first, a finished job's slot may be reused by its owner at any time
+			Job* parent = job->parent;
+			const int32_t unfinished = job->unfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+			if (unfinished == 0) {
+				if (parent) {
+					finish(parent);
 				}
+				pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
 			}
 		}
 
-	public:
-		Thread()
+		void execute(Job* job)
 		{
-			worker = std::thread(&Thread::queueLoop, this);
+			queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			{
+				VKS_PROFILE_ZONE("job");
+				job->function(job);
+			}
+			if (job->destructor) {
+				job->destructor(job);
+				job->destructor = nullptr;
+			}
+			finish(job);
 		}
 
-		~Thread()
+		void workerLoop(uint32_t index)
 		{
-			if (worker.joinable())
+			setThreadContext(index);
+			// Naming a thread creates its zone buffer, so workers are only named if the profiler is recording
+			if (CpuProfiler::get().isEnabled()) {
+				CpuProfiler::get().setThreadName("worker " + std::to_string(index));
+			}
+			uint32_t idleSpins = 0;
+			while (!destroying.load(std::memory_order_acquire)) {
+				if (runPendingJob()) {
+					idleSpins = 0;
+					continue;
+				}
+				// Spin for a short while before going to sleep to keep latency low during bursts
+				if (++idleSpins < 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1);
+				sleepCondition.wait(lock, [this] { return (queuedJobs.load() > 0) || destroying.load(); });
+				sleepingWorkers.fetch_sub(1);
+				idleSpins = 0;
+			}
+		}
+
+		void stopWorkers()
+		{
+			wait();
 			{
-				wait();
-				queueMutex.lock();
+				std::lock_guard<std::mutex> lock(sleepMutex);
 				destroying = true;
-				condition.notify_one();
-				queueMutex.unlock();
+				sleepCondition.notify_all();
+			}
+			for (auto& worker : workers) {
 				worker.join();
 			}
+			workers.clear();
+			queues.clear();
+			destroying = false;
 		}
 
-		// Add a new job to the thread's queue
-		void addJob(std::function<void()> function)
+	public:
+		/** @brief Thread index of threads that don't belong to the pool */
+		static const uint32_t ExternalThread = ~0u;
+
+		ThreadPool() : injectedJobCount(0), externalJobs(new Job[MaxJobsPerThread]), queuedJobs(0), pendingJobs(0), sleepingWorkers(0), destroying(false), poolId(createPoolId()) {}
+
+		~ThreadPool()
 		{
-			std::lock_guard<std::mutex> lock(queueMutex);
-			jobQueue.push(std::move(function));
-			condition.notify_one();
+			stopWorkers();
+			clearThreadContext();
 		}
 
-		// Wait until all work items have been finished
-		void wait()
+		/** @brief Sets the number of threads executing jobs, including the calling thread which helps out while waiting */
+		void setThreadCount(uint32_t count)
 		{
-			std::unique_lock<std::mutex> lock(queueMutex);
-			condition.wait(lock, [this]() { return jobQueue.empty(); });
+			assert(count > 0);
+			stopWorkers();
+			// The calling thread owns queue 0
+			setThreadContext(0);
+			for (uint32_t i = 0; i < count; i++) {
+				queues.push_back(std::unique_ptr<ThreadQueue>(new ThreadQueue()));
+			}
+			for (uint32_t i = 1; i < count; i++) {
+				workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+			}
 		}
-	};
-	
-	class ThreadPool
-	{
-	public:
-		std::vector<std::unique_ptr<Thread>> threads;
 
-		// Sets the number of threads to be allocated in this pool
-		void setThreadCount(uint32_t count)
+		/** @brief Returns the number of threads executing jobs */
+		uint32_t getThreadCount() const
 		{
-			threads.clear();
-			for (auto i = 0; i < count; i++)
-			{
-				threads.push_back(make_unique<Thread>());
+			return static_cast<uint32_t>(queues.size());
+		}
+
+		/** @brief Returns the index of the calling thread within this pool (0 for the thread that created it), ExternalThread for threads that don't belong to the pool */
+		uint32_t getThreadIndex() const
+		{
+			for (const auto& context : contexts()) {
+				if (context.poolId == poolId) {
+					return context.index;
+				}
+			}
+			return ExternalThread;
+		}
+
+		/**
+		* @brief Creates a job for the given callable without scheduling it
+		* @param function Callable invoked as function() or function(Job*)
+		* @param parent Optional parent job that won't finish before this job has finished
+		*/
+		template<typename F>
+		typename std::enable_if<AcceptsJob<F>::value, Job*>::type createJob(F function, Job* parent = nullptr)
+		{
+			static_assert(sizeof(F) <= Job::StorageSize, "Job callable is too large, capture by reference instead");
+			static_assert(std::alignment_of<F>::value <= 16, "Job callable alignment is too large");
+			Job* job = allocateJob();
+			new (&job->storage) F(std::move(function));
+			job->function = &ThreadPool::invoke<F>;
+			job->destructor = std::is_trivially_destructible<F>::value ? nullptr : &ThreadPool::destroyCallable<F>;
+			job->parent = parent;
+			job->unfinishedJobs.store(1, std::memory_order_relaxed);
+			if (parent) {
+				parent->unfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+			}
+			pendingJobs.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+
+		template<typename F>
+		typename std::enable_if<!AcceptsJob<F>::value, Job*>::type createJob(F function, Job* parent = nullptr)
+		{
+			return createJob(PlainCallable<F>{ std::move(function) }, parent);
+		}
+
+		/** @brief Pushes a previously created job to the calling thread's queue, or to the injection queue for threads outside of the pool */
+		void run(Job* job)
+		{
+			// Count first, so sleeping workers can't miss the job
+			queuedJobs.fetch_add(1);
+			ThreadQueue* queue = localQueue();
+			if (!queue || !queue->deque.push(job)) {
+				inject(job);
+			}
+			if (sleepingWorkers.load() > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_all();
+			}
+		}
+
+		/** @brief Creates and runs a job in one step */
+		template<typename F>
+		Job* schedule(F function, Job* parent = nullptr)
+		{
+			Job* job = createJob(std::move(function), parent);
+			run(job);
+			return job;
+		}
+
+		/** @brief Executes a single pending job on the calling thread, returns false if no work was available */
+		bool runPendingJob()
+		{
+			Job* job = getJob();
+			if (job) {
+				execute(job);
+				return true;
+			}
+			return false;
+		}
+
+		/** @brief Waits until the given job (including all of its children) has finished, executing other jobs meanwhile */
+		void wait(const Job* job)
+		{
+			while (!job->finished()) {
+				if (!runPendingJob()) {
+					std::this_thread::yield();
+				}
 			}
 		}
 
-		// Wait until all threads have finished their work items
+		/** @brief Waits until all scheduled jobs have finished */
 		void wait()
 		{
-			for (auto &thread : threads)
-			{
-				thread->wait();
+			while (pendingJobs.load(std::memory_order_acquire) > 0) {
+				if (!runPendingJob()) {
+					std::this_thread::yield();
+				}
 			}
 		}
+
+		/**
+		* @brief Calls function(begin, end) for sub ranges of [0, count) distributed over all threads and waits for completion
+		* @param minGrain Smallest range size a job is split into, the actual grain adapts to the thread count so that each thread gets several ranges to balance uneven costs
+		*/
+		template<typename F>
+		void parallelFor(uint32_t count, const F& function, uint32_t minGrain = 1)
+		{
+			if (count == 0) {
+				return;
+			}
+			const uint32_t splitsPerThread = 4;
+			const uint32_t grain = std::max(std::max(minGrain, 1u), count / (getThreadCount() * splitsPerThread));
+			if ((count <= grain) || (getThreadCount() == 1)) {
+				function(0u, count);
+				return;
+			}
+			ParallelForRange<F> range = { this, &function, 0, count, grain };
+			Job* root = schedule(range);
+			wait(root);
+		}
+
+	private:
+		// Recursively splits its range in halves, pushing the upper half as a child job that can be stolen
+		template<typename F>
+		struct ParallelForRange
+		{
+			ThreadPool* pool;
+			const F* function;
+			uint32_t begin;
+			uint32_t end;
+			uint32_t grain;
+			void operator()(Job* job)
+			{
+				while (end - begin > grain) {
+					const uint32_t mid = begin + (end - begin) / 2;
+					ParallelForRange upper = { pool, function, mid, end, grain };
+					pool->schedule(upper, job);
+					end = mid;
+				}
+				(*function)(begin, end);
+			}
+		};
 	};
 
 }
@@ -0,0 +1,17 @@
+/*
+* Implementation of the header only tinyglTF (https://github.com/syoyo/tinygltf) and stb_image libraries
+*
+* Both are used by the base library and by samples loading glTF files on their own, so they must only be implemented in this file
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
+#define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+#endif
+#include "tiny_gltf.h"
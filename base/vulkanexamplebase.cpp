@@ -145,6 +145,7 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 
 void VulkanExampleBase::renderFrame()
 {
+	VKS_PROFILE_ZONE("renderFrame");
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -201,6 +202,7 @@ void VulkanExampleBase::createPipelineCache()
 
 void VulkanExampleBase::prepare()
 {
+	VKS_PROFILE_ZONE("VulkanExampleBase::prepare");
 	if (vulkanDevice->enableDebugMarkers) {
 		vks::debugmarker::setup(device);
 	}
@@ -213,6 +215,16 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	gpuProfiler.create(vulkanDevice);
+	frameCapture.create(vulkanDevice, queue);
+	textureStreamer.create(vulkanDevice, queue);
+	textureResidency.create(vulkanDevice, queue, instance);
+	if (!captureSequenceDir.empty()) {
+		frameCapture.startSequence(captureSequenceDir, captureFormat);
+	}
+	if (benchmark.active) {
+		gpuProfiler.onResolved = [this](const std::string& name, double time) { benchmark.addScopeTime(name, time); };
+	}
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
@@ -226,6 +238,15 @@ void VulkanExampleBase::prepare()
 	}
 }
 
+void VulkanExampleBase::prepareParallelRecording(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	threadPool.setThreadCount(threadCount);
+	parallelRecorder.create(device, swapChain.queueNodeIndex, &threadPool);
+}
+
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
 {
 	VkPipelineShaderStageCreateInfo shaderStage = {};
@@ -244,6 +265,7 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 
 void VulkanExampleBase::nextFrame()
 {
+	VKS_PROFILE_ZONE("nextFrame");
 	auto tStart = std::chrono::high_resolution_clock::now();
 	if (viewUpdated)
 	{
@@ -251,7 +273,16 @@ void VulkanExampleBase::nextFrame()
 		viewChanged();
 	}
 
-	render();
+	// Views of streamed textures are replaced as mip levels arrive (and those of resident textures as levels are dropped or restored), which invalidates command buffers using them
+	const bool texturesUpdated = textureStreamer.update();
+	if ((textureResidency.update() || texturesUpdated) && prepared) {
+		buildCommandBuffers();
+	}
+
+	{
+		VKS_PROFILE_ZONE("render");
+		render();
+	}
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
@@ -260,21 +291,7 @@ void VulkanExampleBase::nextFrame()
 #else
 	auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 #endif
-	frameTimer = (float)tDiff / 1000.0f;
-	camera.update(frameTimer);
-	if (camera.moving())
-	{
-		viewUpdated = true;
-	}
-	// Convert to clamped timer value
-	if (!paused)
-	{
-		timer += timerSpeed * frameTimer;
-		if (timer > 1.0)
-		{
-			timer -= 1.0f;
-		}
-	}
+	advanceSimulation((float)tDiff / 1000.0f);
 	float fpsTimer = (float)(std::chrono::duration<double, std::milli>(tEnd - lastTimestamp).count());
 	if (fpsTimer > 1000.0f)
 	{
@@ -294,19 +311,104 @@ void VulkanExampleBase::nextFrame()
 	updateOverlay();
 }
 
+void VulkanExampleBase::advanceSimulation(float deltaTime)
+{
+	// A fixed time step makes animations and camera movement independent of the measured frame times
+	frameTimer = (fixedTimeStep > 0.0f) ? fixedTimeStep : deltaTime;
+	if (cameraPlayback)
+	{
+		cameraPath.playback(camera);
+		viewUpdated = true;
+	}
+	else
+	{
+		camera.update(frameTimer);
+		if (camera.moving())
+		{
+			viewUpdated = true;
+		}
+		if (!cameraRecordFile.empty())
+		{
+			cameraPath.record(camera);
+		}
+	}
+	// Convert to clamped timer value
+	if (!paused)
+	{
+		timer += timerSpeed * frameTimer;
+		if (timer > 1.0)
+		{
+			timer -= 1.0f;
+		}
+	}
+}
+
+void VulkanExampleBase::prepareBenchmark()
+{
+	// Benchmark frames don't run the regular frame loop that updates streamed textures, so streaming is completed before timing starts
+	if (textureStreamer.getPendingCount() > 0) {
+		textureStreamer.flush();
+		// Releases the views replaced by the last update of the flush, the command buffers still referencing them are rebuilt
+		textureStreamer.update();
+		buildCommandBuffers();
+	}
+	// Resident textures only get the levels requested by rendered frames, so frames are rendered untimed until the residency manager stops replacing views (and has released the replaced ones)
+	if (textureResidency.getResidentSize() > 0) {
+		const uint32_t maxSettleFrames = 256;
+		uint32_t unchangedUpdates = 0;
+		for (uint32_t i = 0; (i < maxSettleFrames) && (unchangedUpdates < textureResidency.settings.retireDelay); i++) {
+			render();
+			if (textureResidency.update()) {
+				buildCommandBuffers();
+				unchangedUpdates = 0;
+			} else {
+				unchangedUpdates++;
+			}
+		}
+	}
+}
+
+void VulkanExampleBase::benchmarkFrame()
+{
+	if (viewUpdated)
+	{
+		viewUpdated = false;
+		viewChanged();
+	}
+	render();
+	// Simulation time is only advanced in benchmark mode if it's deterministic, otherwise all frames render the same state
+	if ((fixedTimeStep > 0.0f) || cameraPlayback)
+	{
+		advanceSimulation(fixedTimeStep);
+	}
+}
+
 void VulkanExampleBase::renderLoop()
 {
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.exampleName = name;
+		benchmark.commandLine.assign(args.begin(), args.end());
+		prepareBenchmark();
+		benchmark.run([=] { benchmarkFrame(); }, vulkanDevice, queue);
 		vkDeviceWaitIdle(device);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
 		return;
 	}
+	// Offscreen mode runs the regular frame loop (including simulation time) for a fixed number of frames without a window
+	if (settings.offscreen) {
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+		tPrevEnd = lastTimestamp;
+		for (uint32_t i = 0; (i < offscreenFrames) && prepared; i++) {
+			nextFrame();
+		}
+		vkDeviceWaitIdle(device);
+		return;
+	}
 #endif
 
 	destWidth = width;
@@ -666,6 +768,7 @@ void VulkanExampleBase::renderLoop()
 
 void VulkanExampleBase::updateOverlay()
 {
+	VKS_PROFILE_ZONE("updateOverlay");
 	if (!settings.overlay)
 		return;
 
@@ -695,6 +798,13 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
 	ImGui::PopItemWidth();
+	if (!gpuProfiler.getTimings().empty()) {
+		if (UIOverlay.header("GPU timings")) {
+			for (auto& timing : gpuProfiler.getTimings()) {
+				UIOverlay.text("%*s%s: %.3f ms", timing.depth * 2, "", timing.name.c_str(), timing.average);
+			}
+		}
+	}
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
 #endif
@@ -729,6 +839,7 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_PROFILE_ZONE("prepareFrame");
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
@@ -742,11 +853,24 @@ void VulkanExampleBase::prepareFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	benchmark.frameStart();
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VKS_PROFILE_ZONE("submitFrame");
+	benchmark.frameEnd();
+	gpuProfiler.submitted(currentBuffer);
+	VkSemaphore presentWaitSemaphore = semaphores.renderComplete;
+	if (!captureFilename.empty() || frameCapture.isCapturingSequence()) {
+		// The copy is chained between rendering and presentation and read back asynchronously
+		VkSemaphore captureSemaphore = frameCapture.capture(swapChain.images[currentBuffer], swapChain.colorFormat, { width, height }, semaphores.renderComplete, captureFilename);
+		if (captureSemaphore != VK_NULL_HANDLE) {
+			presentWaitSemaphore = captureSemaphore;
+		}
+		captureFilename.clear();
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, presentWaitSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -758,6 +882,7 @@ void VulkanExampleBase::submitFrame()
 		VK_CHECK_RESULT(result);
 	}
 	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	gpuProfiler.resolve();
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -792,9 +917,20 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode");
 	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
 	commandLineParser.add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
-	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
+	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results (.json for JSON output)");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("fixedtimestep", { "-fts", "--fixedtimestep" }, 1, "Advance simulation time by a fixed number of milliseconds per frame");
+	commandLineParser.add("camerarecord", { "--camerarecord" }, 1, "Record the camera path to the given file");
+	commandLineParser.add("cameraplayback", { "--cameraplayback" }, 1, "Play back a recorded camera path (implies a fixed time step)");
+	commandLineParser.add("trace", { "--trace" }, 1, "Write CPU profiling zones to the given file in Chrome trace format on exit");
+#if !(defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
+	commandLineParser.add("offscreen", { "--offscreen" }, 0, "Render to offscreen images instead of a window");
+	commandLineParser.add("offscreenframes", { "--offscreenframes" }, 1, "Number of frames to render in offscreen mode");
+	commandLineParser.add("offscreendump", { "--offscreendump" }, 1, "Write the images rendered in offscreen mode to the given directory");
+#endif
+	commandLineParser.add("capturesequence", { "--capturesequence" }, 1, "Capture every presented frame to the given directory");
+	commandLineParser.add("captureformat", { "--captureformat" }, 1, "File format for captured image sequences (png, qoi, ppm or raw)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -829,6 +965,44 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 			shaderDir = value;
 		}
 	}
+	if (commandLineParser.isSet("fixedtimestep")) {
+		fixedTimeStep = commandLineParser.getValueAsFloat("fixedtimestep", 0.0f) / 1000.0f;
+	}
+	if (commandLineParser.isSet("camerarecord")) {
+		cameraRecordFile = commandLineParser.getValueAsString("camerarecord", cameraRecordFile);
+	}
+	if (commandLineParser.isSet("cameraplayback")) {
+		std::string cameraPathFile = commandLineParser.getValueAsString("cameraplayback", "");
+		if (!cameraPath.load(cameraPathFile) || cameraPath.empty()) {
+			std::cerr << "Could not load camera path \"" << cameraPathFile << "\"\n";
+		} else {
+			cameraPlayback = true;
+			// Playback replays one recorded state per frame, so simulation time also has to advance per frame
+			if (fixedTimeStep <= 0.0f) {
+				fixedTimeStep = 1.0f / 60.0f;
+			}
+		}
+	}
+	if (commandLineParser.isSet("trace")) {
+		traceFile = commandLineParser.getValueAsString("trace", traceFile);
+		vks::CpuProfiler::get().setThreadName("main");
+		vks::CpuProfiler::get().setEnabled(true);
+	}
+	if (commandLineParser.isSet("offscreen")) {
+		settings.offscreen = true;
+	}
+	if (commandLineParser.isSet("offscreenframes")) {
+		offscreenFrames = commandLineParser.getValueAsInt("offscreenframes", offscreenFrames);
+	}
+	if (commandLineParser.isSet("offscreendump")) {
+		captureSequenceDir = commandLineParser.getValueAsString("offscreendump", captureSequenceDir);
+	}
+	if (commandLineParser.isSet("capturesequence")) {
+		captureSequenceDir = commandLineParser.getValueAsString("capturesequence", captureSequenceDir);
+	}
+	if (commandLineParser.isSet("captureformat")) {
+		captureFormat = commandLineParser.getValueAsString("captureformat", captureFormat);
+	}
 	if (commandLineParser.isSet("benchmark")) {
 		benchmark.active = true;
 		vks::tools::errorModeSilent = true;
@@ -856,9 +1030,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.offscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.offscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -873,8 +1051,26 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (!cameraRecordFile.empty()) {
+		if (cameraPath.save(cameraRecordFile)) {
+			std::cout << "Camera path with " << cameraPath.size() << " frames written to \"" << cameraRecordFile << "\"\n";
+		} else {
+			std::cerr << "Could not write camera path \"" << cameraRecordFile << "\"\n";
+		}
+	}
+	if (!traceFile.empty()) {
+		vks::CpuProfiler::get().setEnabled(false);
+		if (!vks::CpuProfiler::get().writeChromeTrace(traceFile)) {
+			std::cerr << "Could not write trace file \"" << traceFile << "\"\n";
+		}
+	}
 	// Clean up Vulkan resources
+	frameCapture.destroy();
+	textureStreamer.destroy();
+	textureResidency.destroy();
 	swapChain.cleanup();
+	parallelRecorder.destroy();
+	gpuProfiler.destroy();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -923,6 +1119,8 @@ VulkanExampleBase::~VulkanExampleBase()
 #if defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
+	if (settings.offscreen)
+		return;
 	if (event_buffer)
 		event_buffer->Release(event_buffer);
 	if (surface)
@@ -934,6 +1132,8 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (settings.offscreen)
+		return;
 	xdg_toplevel_destroy(xdg_toplevel);
 	xdg_surface_destroy(xdg_surface);
 	wl_surface_destroy(surface);
@@ -950,6 +1150,8 @@ VulkanExampleBase::~VulkanExampleBase()
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
+	if (settings.offscreen)
+		return;
 	xcb_destroy_window(connection, window);
 	xcb_disconnect(connection);
 #endif
@@ -957,6 +1159,7 @@ VulkanExampleBase::~VulkanExampleBase()
 
 bool VulkanExampleBase::initVulkan()
 {
+	VKS_PROFILE_ZONE("VulkanExampleBase::initVulkan");
 	VkResult err;
 
 	// Vulkan instance
@@ -1111,6 +1314,9 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.offscreen) {
+		return nullptr;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -1871,7 +2077,10 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.exampleName = name;
+		benchmark.commandLine.assign(args.begin(), args.end());
+		prepareBenchmark();
+		benchmark.run([=] { benchmarkFrame(); }, vulkanDevice, queue);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -1911,6 +2120,11 @@ IDirectFBSurface *VulkanExampleBase::setupWindow()
 	DFBResult ret;
 	int posx = 0, posy = 0;
 
+	if (settings.offscreen)
+	{
+		return nullptr;
+	}
+
 	ret = DirectFBInit(NULL, NULL);
 	if (ret)
 	{
@@ -2412,6 +2626,10 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen)
+	{
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2438,6 +2656,11 @@ xcb_window_t VulkanExampleBase::setupWindow()
 {
 	uint32_t value_mask, value_list[32];
 
+	if (settings.offscreen)
+	{
+		return 0;
+	}
+
 	window = xcb_generate_id(connection);
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -2918,6 +3141,11 @@ void VulkanExampleBase::windowResized() {}
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.offscreen)
+	{
+		swapChain.initOffscreen();
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -2940,6 +3168,11 @@ void VulkanExampleBase::setupSwapChain()
 	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
 }
 
+void VulkanExampleBase::captureFrame(const std::string& filename)
+{
+	captureFilename = filename;
+}
+
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
 
 #if defined(_WIN32)
@@ -68,10 +68,16 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanParallelCommandRecorder.h"
+#include "VulkanGpuProfiler.h"
+#include "VulkanFrameCapture.h"
+#include "VulkanTextureStreamer.h"
+#include "VulkanTextureResidency.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "cpuprofiler.hpp"
 
 class VulkanExampleBase
 {
@@ -83,6 +89,9 @@ private:
 	void windowResize();
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
+	void advanceSimulation(float deltaTime);
+	void prepareBenchmark();
+	void benchmarkFrame();
 	void updateOverlay();
 	void createPipelineCache();
 	void createCommandPool();
@@ -155,6 +164,22 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Thread pool shared by the example, has no worker threads until prepareParallelRecording() or setThreadCount() is called */
+	vks::ThreadPool threadPool;
+	/** @brief Records render pass contents into secondary command buffers across all threads of the thread pool */
+	vks::ParallelCommandRecorder parallelRecorder;
+	/** @brief Starts the thread pool workers (one per hardware thread if threadCount is 0) and prepares the parallel command recorder */
+	void prepareParallelRecording(uint32_t threadCount = 0);
+	/** @brief Measures named GPU scopes (see vks::GpuProfiler::Scope), use the draw command buffer index as the frame index */
+	vks::GpuProfiler gpuProfiler;
+	/** @brief Asynchronous readback of presented frames for screenshots and image sequences (--capturesequence) */
+	vks::FrameCapture frameCapture;
+	/** @brief Streams the mip levels of textures loaded with loadFromFileStreamed (or of glTF models with textureStreamer set), command buffers are rebuilt each time textures got new levels */
+	vks::TextureStreamer textureStreamer;
+	/** @brief Keeps the textures of glTF models with textureResidency set within a memory budget, command buffers are rebuilt each time images got replaced */
+	vks::TextureResidencyManager textureResidency;
+	/** @brief Captures the next presented frame to the given file, the format is chosen by the extension (.png, .qoi, .ppm or raw RGBA), writing happens on worker threads */
+	void captureFrame(const std::string& filename);
 public:
 	bool prepared = false;
 	bool resized = false;
@@ -169,6 +194,21 @@ public:
 	float frameTimer = 1.0f;
 
 	vks::Benchmark benchmark;
+	/** @brief Simulation time (timer, frameTimer, camera movement) advances by this many seconds per frame if > 0 (--fixedtimestep) */
+	float fixedTimeStep = 0.0f;
+	/** @brief Per frame camera states, recorded with --camerarecord and played back with --cameraplayback */
+	CameraPath cameraPath;
+	std::string cameraRecordFile;
+	bool cameraPlayback = false;
+	/** @brief CPU profiling zones are written to this file in Chrome trace format on exit if set (--trace) */
+	std::string traceFile;
+	/** @brief Number of frames rendered in offscreen mode */
+	uint32_t offscreenFrames = 1;
+	/** @brief File the next presented frame is captured to (see captureFrame) */
+	std::string captureFilename;
+	/** @brief Every presented frame is captured to this directory if set (--capturesequence, --offscreendump), using the file extension in captureFormat (--captureformat) */
+	std::string captureSequenceDir;
+	std::string captureFormat = "qoi";
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
@@ -183,6 +223,8 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Render to plain images instead of a window's swap chain (--offscreen) */
+		bool offscreen = false;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -26,6 +26,7 @@ EXAMPLES = [
 	"dynamicuniformbuffer",
 	"gears",
 	"geometryshader",
+	"gltfbindless",
 	"gltfloading",
 	"gltfscenerendering",
 	"gltfskinning",
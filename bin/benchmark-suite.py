@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# Runs all examples and homework in benchmark mode, aggregates the JSON results and compares them against a baseline
+#
+# Examples are run with --offscreen, so no window system is required and regular builds can be used (e.g. on a CI runner using a software driver like lavapipe)
+#
+# Usage:
+#   benchmark-suite.py --bindir <dir with example binaries> [--output suite.json] [--baseline baseline.json]
+#                      [--threshold frameTime.mean=10] [--threshold frameTime.p99=20] [--frames 300] [--width 1280 --height 720]
+#                      [--icd /path/to/lvp_icd.x86_64.json] [--filter <substring>] [--update-baseline]
+#                      [--timestep 16.667] [--camerapath <dir with camera paths recorded using --camerarecord>] [--window]
+#
+# The exit code is non-zero if an example that succeeded in the baseline fails or if a metric regressed beyond its threshold
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+
+SOURCE_DIR = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+# Headless samples don't use the example base class and don't support benchmark mode
+SKIPPED = ["computeheadless", "renderheadless"]
+
+# Relative regression thresholds in percent, a result is a regression if it's slower than the baseline by more than the threshold
+DEFAULT_THRESHOLDS = {
+	"frameTime.mean": 10.0,
+	"frameTime.p99": 20.0,
+	"gpuTime.mean": 10.0,
+}
+
+def read_cmake_list(filename, variable):
+	# Reads the entries of a set(<variable> ...) block from a CMakeLists.txt
+	with open(filename, "r") as file:
+		content = file.read()
+	match = re.search(r"set\(\s*%s\s+([^)]*)\)" % variable, content)
+	if not match:
+		return []
+	return [entry for entry in match.group(1).split() if not entry.startswith("#")]
+
+def get_examples():
+	examples = read_cmake_list(os.path.join(SOURCE_DIR, "examples", "CMakeLists.txt"), "EXAMPLES")
+	examples += read_cmake_list(os.path.join(SOURCE_DIR, "homework", "CMakeLists.txt"), "HOMEWORKS")
+	return [example for example in examples if example not in SKIPPED]
+
+def get_metric(result, metric):
+	# Metrics are given as <statistics>.<value>, e.g. frameTime.p99
+	group, _, value = metric.partition(".")
+	statistics = result.get(group)
+	if not isinstance(statistics, dict):
+		return None
+	return statistics.get(value)
+
+def run_example(example, args, env):
+	binary = os.path.join(args.bindir, example + (".exe" if platform.system() == "Windows" else ""))
+	if not os.path.exists(binary):
+		return "missing", None
+	result_file = os.path.join(args.resultdir, example + ".json")
+	if os.path.exists(result_file):
+		os.remove(result_file)
+	command = [binary, "-b", "-bw", str(args.warmup), "-br", str(args.maxduration), "-bfs", str(args.frames), "-w", str(args.width), "-h", str(args.height), "-bf", result_file]
+	# Simulation time advances by a fixed step per frame, so every run renders the same frame sequence
+	command += ["-fts", str(args.timestep)]
+	# Render to offscreen images instead of a window, so the suite runs without a window system or a headless build
+	if not args.window:
+		command += ["--offscreen"]
+	if args.camerapath:
+		camera_path = os.path.join(args.camerapath, example + ".txt")
+		if os.path.exists(camera_path):
+			command += ["--cameraplayback", camera_path]
+	command += args.extra_args
+	try:
+		code = subprocess.call(command, cwd=args.bindir, env=env, timeout=args.timeout, stdout=subprocess.DEVNULL if not args.verbose else None)
+	except subprocess.TimeoutExpired:
+		return "timeout", None
+	if code != 0 or not os.path.exists(result_file):
+		return "failed (exit code %d)" % code, None
+	with open(result_file, "r") as file:
+		return "ok", json.load(file)
+
+def compare(results, baseline, thresholds):
+	regressions = []
+	for example, entry in sorted(baseline.get("results", {}).items()):
+		if entry.get("status") != "ok":
+			continue
+		current = results.get(example)
+		if current is None:
+			continue
+		if current["status"] != "ok":
+			regressions.append("%s: %s (succeeded in baseline)" % (example, current["status"]))
+			continue
+		for metric, threshold in sorted(thresholds.items()):
+			base_value = get_metric(entry["result"], metric)
+			value = get_metric(current["result"], metric)
+			if base_value is None or value is None or base_value <= 0.0:
+				continue
+			change = (value - base_value) / base_value * 100.0
+			line = "%s: %s %.3f ms -> %.3f ms (%+.1f%%, threshold %.1f%%)" % (example, metric, base_value, value, change, threshold)
+			if change > threshold:
+				regressions.append(line)
+			elif change < -threshold:
+				print("Improvement: " + line)
+	return regressions
+
+def main():
+	parser = argparse.ArgumentParser(description="Run all examples in benchmark mode and compare the results with a baseline")
+	parser.add_argument("--bindir", required=True, help="Directory containing the example binaries")
+	parser.add_argument("--output", default="benchmark-suite.json", help="Aggregated results file")
+	parser.add_argument("--resultdir", default=None, help="Directory for the per-example results (defaults to a directory next to the output file)")
+	parser.add_argument("--baseline", default=None, help="Baseline results to compare against")
+	parser.add_argument("--update-baseline", action="store_true", help="Write the results to the baseline file instead of comparing")
+	parser.add_argument("--threshold", action="append", default=[], metavar="METRIC=PERCENT", help="Regression threshold, e.g. frameTime.p99=20 (can be given multiple times)")
+	parser.add_argument("--frames", type=int, default=300, help="Number of frames rendered per example")
+	parser.add_argument("--warmup", type=int, default=1, help="Warm up time in seconds")
+	parser.add_argument("--maxduration", type=int, default=120, help="Upper limit for the benchmark duration of a single example in seconds")
+	parser.add_argument("--timeout", type=int, default=600, help="Time in seconds after which an example is aborted")
+	parser.add_argument("--timestep", type=float, default=16.667, help="Fixed simulation time step per frame in milliseconds")
+	parser.add_argument("--camerapath", default=None, help="Directory with recorded camera paths (<example>.txt) that are played back if present")
+	parser.add_argument("--width", type=int, default=1280)
+	parser.add_argument("--height", type=int, default=720)
+	parser.add_argument("--icd", default=None, help="Vulkan driver manifest to use, e.g. the one of lavapipe for CPU only runners")
+	parser.add_argument("--filter", default=None, help="Only run examples whose name contains this string")
+	parser.add_argument("--extra-args", default="", help="Additional arguments passed to every example")
+	parser.add_argument("--window", action="store_true", help="Render to a window instead of offscreen images (includes presentation in the measurements)")
+	parser.add_argument("--verbose", action="store_true", help="Show the output of the examples")
+	args = parser.parse_args()
+
+	args.bindir = os.path.abspath(args.bindir)
+	args.extra_args = args.extra_args.split()
+	if args.resultdir is None:
+		args.resultdir = os.path.splitext(os.path.abspath(args.output))[0]
+	os.makedirs(args.resultdir, exist_ok=True)
+
+	thresholds = dict(DEFAULT_THRESHOLDS)
+	for threshold in args.threshold:
+		metric, _, value = threshold.partition("=")
+		thresholds[metric] = float(value)
+
+	env = dict(os.environ)
+	if args.icd:
+		env["VK_ICD_FILENAMES"] = args.icd
+		env["VK_DRIVER_FILES"] = args.icd
+
+	examples = get_examples()
+	if args.filter:
+		examples = [example for example in examples if args.filter in example]
+
+	results = {}
+	for index, example in enumerate(examples):
+		print("---- (%d/%d) Running %s in benchmark mode ----" % (index + 1, len(examples), example))
+		status, result = run_example(example, args, env)
+		results[example] = { "status": status, "result": result }
+		if status == "ok":
+			print("%.3f ms avg, %.3f ms p99" % (get_metric(result, "frameTime.mean"), get_metric(result, "frameTime.p99")))
+		else:
+			print(status)
+
+	suite = {
+		"frames": args.frames,
+		"width": args.width,
+		"height": args.height,
+		"timestep": args.timestep,
+		"results": results,
+	}
+	with open(args.output, "w") as file:
+		json.dump(suite, file, indent=1)
+	print("Results written to %s" % args.output)
+
+	failed = [example for example, entry in results.items() if entry["status"] != "ok"]
+	if failed:
+		print("Examples not run successfully: %s" % ", ".join(sorted(failed)))
+
+	if args.baseline and args.update_baseline:
+		with open(args.baseline, "w") as file:
+			json.dump(suite, file, indent=1)
+		print("Baseline written to %s" % args.baseline)
+	elif args.baseline:
+		with open(args.baseline, "r") as file:
+			baseline = json.load(file)
+		regressions = compare(results, baseline, thresholds)
+		if regressions:
+			print("Regressions compared to %s:" % args.baseline)
+			for regression in regressions:
+				print("  " + regression)
+			return 1
+		print("No regressions compared to %s" % args.baseline)
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main())
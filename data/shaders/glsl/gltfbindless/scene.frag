@@ -0,0 +1,74 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Matches vkglTF::Material::ShaderData
+struct Material {
+	vec4 baseColorFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+	int baseColorTextureIndex;
+	int metallicRoughnessTextureIndex;
+	int normalTextureIndex;
+	int occlusionTextureIndex;
+	int emissiveTextureIndex;
+	int specularGlossinessTextureIndex;
+	int diffuseTextureIndex;
+	int baseColorTextureLayer;
+	int metallicRoughnessTextureLayer;
+	int normalTextureLayer;
+	int occlusionTextureLayer;
+	int emissiveTextureLayer;
+	int specularGlossinessTextureLayer;
+	int diffuseTextureLayer;
+	int padding[2];
+};
+
+layout (set = 1, binding = 0) readonly buffer Materials {
+	Material materials[];
+};
+// Textures packed into texture arrays are referenced by the array's view, so the binding is aliased
+layout (set = 1, binding = 1) uniform sampler2D textures[];
+layout (set = 1, binding = 1) uniform sampler2DArray textureArrays[];
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inViewVec;
+layout (location = 3) in vec3 inLightVec;
+layout (location = 4) flat in int inMaterialIndex;
+
+layout (location = 0) out vec4 outFragColor;
+
+const uint ALPHAMODE_MASK = 1;
+
+void main() 
+{
+	Material material = materials[inMaterialIndex];
+
+	vec4 color = material.baseColorFactor;
+	if (material.baseColorTextureIndex >= 0) {
+		// Neighbouring fragments may belong to different draws, so the index isn't dynamically uniform
+		if (material.baseColorTextureLayer >= 0) {
+			color *= texture(textureArrays[nonuniformEXT(material.baseColorTextureIndex)], vec3(inUV, float(material.baseColorTextureLayer)));
+		} else {
+			color *= texture(textures[nonuniformEXT(material.baseColorTextureIndex)], inUV);
+		}
+	}
+
+	if (material.alphaMode == ALPHAMODE_MASK) {
+		if (color.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+
+	const float ambient = 0.15;
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), ambient).rrr;
+	float specular = pow(max(dot(R, V), 0.0), 32.0) * 0.25;
+	outFragColor = vec4(diffuse * color.rgb + specular, color.a);
+}
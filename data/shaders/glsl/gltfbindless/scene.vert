@@ -0,0 +1,30 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+
+layout (set = 0, binding = 0) uniform UBOScene 
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+	vec4 viewPos;
+} uboScene;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+layout (location = 4) flat out int outMaterialIndex;
+
+void main() 
+{
+	outNormal = inNormal;
+	outUV = inUV;
+	// The material index is passed as the first instance of each draw
+	outMaterialIndex = gl_InstanceIndex;
+	gl_Position = uboScene.projection * uboScene.view * vec4(inPos.xyz, 1.0);
+	outLightVec = uboScene.lightPos.xyz - inPos;
+	outViewVec = uboScene.viewPos.xyz - inPos;
+}
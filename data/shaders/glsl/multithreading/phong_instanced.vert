@@ -0,0 +1,44 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+struct ObjectData
+{
+	mat4 mvp;
+	vec4 color;
+};
+
+// Per-object data is indexed by the instance index (first instance of the draw)
+layout (std430, binding = 0) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+
+void main() 
+{
+	ObjectData object = objects[gl_InstanceIndex];
+
+	if ( (inColor.r == 1.0) && (inColor.g == 0.0) && (inColor.b == 0.0))
+	{	
+		outColor = object.color.rgb;
+	}
+	else
+	{
+		outColor = inColor;
+	}
+	
+	gl_Position = object.mvp * vec4(inPos.xyz, 1.0);
+	
+	vec4 pos = object.mvp * vec4(inPos, 1.0);
+	outNormal = mat3(object.mvp) * inNormal;
+	vec3 lPos = vec3(0.0);
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;
+}
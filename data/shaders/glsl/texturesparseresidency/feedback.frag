@@ -0,0 +1,47 @@
+#version 450
+
+#extension GL_ARB_sparse_texture2 : enable
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 viewPos;
+	float lodBias;
+	float feedbackLodBias;
+	uvec2 pageExtent;
+	uint mipTailStart;
+} ubo;
+
+layout (binding = 1) uniform sampler2D samplerColor;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in float inLodBias;
+
+layout (location = 0) out uint outRequest;
+
+void main() 
+{
+	// The feedback target is smaller than the framebuffer, so the derivatives are larger than in the main pass
+	float lod = textureQueryLod(samplerColor, inUV).y + inLodBias + ubo.feedbackLodBias;
+	// Sampler uses nearest mip filtering
+	uint level = uint(clamp(floor(lod + 0.5), 0.0, float(textureQueryLevels(samplerColor) - 1)));
+
+	// Levels in the mip tail are always resident
+	if (level >= ubo.mipTailStart)
+	{
+		outRequest = ~0u;
+		return;
+	}
+
+	uvec2 levelSize = uvec2(textureSize(samplerColor, int(level)));
+	uvec2 texel = min(uvec2(clamp(inUV, 0.0, 1.0) * vec2(levelSize)), levelSize - 1u);
+	uvec2 page = texel / ubo.pageExtent;
+
+	// Flag pages the sparse residency code reports as not backed by memory
+	vec4 color;
+	int residencyCode = sparseTextureLodARB(samplerColor, inUV, float(level), color);
+	uint missing = sparseTexelsResidentARB(residencyCode) ? 0u : 1u;
+
+	outRequest = (missing << 31) | (level << 24) | (page.y << 12) | page.x;
+}
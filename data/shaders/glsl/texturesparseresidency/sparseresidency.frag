@@ -17,15 +17,14 @@ void main()
 	// Get residency code for current texel
 	int residencyCode = sparseTextureARB(samplerColor, inUV, color, inLodBias);
 
-	// Fetch sparse until we get a valid texel
-	/*
-	float minLod = 1.0;
-	while (!sparseTexelsResidentARB(residencyCode)) 
+	// Fall back to coarser levels until we get a resident texel, the mip tail is always resident
+	float minLod = floor(textureQueryLod(samplerColor, inUV).x + inLodBias) + 1.0;
+	float maxLod = float(textureQueryLevels(samplerColor) - 1);
+	while (!sparseTexelsResidentARB(residencyCode) && (minLod <= maxLod)) 
 	{
-		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color);
-		minLod += 1.0f;
+		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color, inLodBias);
+		minLod += 1.0;
 	}
-	*/
 
 	// Check if texel is resident
 	bool texelResident = sparseTexelsResidentARB(residencyCode);
@@ -0,0 +1,75 @@
+// Copyright 2020 Google LLC
+// Non-uniform access is enabled at compile time via SPV_EXT_descriptor_indexing (see compile.py)
+
+// Matches vkglTF::Material::ShaderData
+struct Material
+{
+	float4 baseColorFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+	int baseColorTextureIndex;
+	int metallicRoughnessTextureIndex;
+	int normalTextureIndex;
+	int occlusionTextureIndex;
+	int emissiveTextureIndex;
+	int specularGlossinessTextureIndex;
+	int diffuseTextureIndex;
+	int baseColorTextureLayer;
+	int metallicRoughnessTextureLayer;
+	int normalTextureLayer;
+	int occlusionTextureLayer;
+	int emissiveTextureLayer;
+	int specularGlossinessTextureLayer;
+	int diffuseTextureLayer;
+	int padding[2];
+};
+
+StructuredBuffer<Material> materials : register(t0, space1);
+// Textures packed into texture arrays are referenced by the array's view, so the binding is aliased
+// Images and samplers of the combined image samplers are accessed separately with the same index
+[[vk::binding(1, 1)]] Texture2D textures[];
+[[vk::binding(1, 1)]] Texture2DArray textureArrays[];
+[[vk::binding(1, 1)]] SamplerState samplers[];
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+[[vk::location(4)]] nointerpolation int MaterialIndex : TEXCOORD3;
+};
+
+#define ALPHAMODE_MASK 1
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	Material material = materials[input.MaterialIndex];
+
+	float4 color = material.baseColorFactor;
+	if (material.baseColorTextureIndex >= 0) {
+		// Neighbouring fragments may belong to different draws, so the index isn't dynamically uniform
+		if (material.baseColorTextureLayer >= 0) {
+			color *= textureArrays[NonUniformResourceIndex(material.baseColorTextureIndex)].Sample(samplers[NonUniformResourceIndex(material.baseColorTextureIndex)], float3(input.UV, float(material.baseColorTextureLayer)));
+		} else {
+			color *= textures[NonUniformResourceIndex(material.baseColorTextureIndex)].Sample(samplers[NonUniformResourceIndex(material.baseColorTextureIndex)], input.UV);
+		}
+	}
+
+	if (material.alphaMode == ALPHAMODE_MASK) {
+		if (color.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+
+	const float ambient = 0.15;
+	float3 N = normalize(input.Normal);
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = reflect(-L, N);
+	float3 diffuse = max(dot(N, L), ambient).rrr;
+	float specular = pow(max(dot(R, V), 0.0), 32.0) * 0.25;
+	return float4(diffuse * color.rgb + specular, color.a);
+}
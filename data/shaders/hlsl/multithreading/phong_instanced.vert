@@ -0,0 +1,50 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+uint InstanceIndex : SV_InstanceID;
+};
+
+struct ObjectData
+{
+	float4x4 mvp;
+	float4 color;
+};
+// Per-object data is indexed by the instance index (first instance of the draw)
+StructuredBuffer<ObjectData> objects : register(t0);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	ObjectData object = objects[input.InstanceIndex];
+
+	if ( (input.Color.r == 1.0) && (input.Color.g == 0.0) && (input.Color.b == 0.0))
+	{
+		output.Color = object.color.rgb;
+	}
+	else
+	{
+		output.Color = input.Color;
+	}
+
+	output.Pos = mul(object.mvp, float4(input.Pos.xyz, 1.0));
+
+	float4 pos = mul(object.mvp, float4(input.Pos, 1.0));
+	output.Normal = mul((float3x3)object.mvp, input.Normal);
+	float3 lPos = float3(0.0, 0.0, 0.0);
+	output.LightVec = lPos - pos.xyz;
+	output.ViewVec = -pos.xyz;
+	return output;
+}
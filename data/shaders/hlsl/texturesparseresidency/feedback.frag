@@ -0,0 +1,52 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 viewPos;
+	float lodBias;
+	float feedbackLodBias;
+	uint2 pageExtent;
+	uint mipTailStart;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+
+struct VSOutput
+{
+[[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float LodBias : TEXCOORD3;
+};
+
+uint main(VSOutput input) : SV_TARGET
+{
+	uint width, height, levels;
+	textureColor.GetDimensions(0, width, height, levels);
+
+	// The feedback target is smaller than the framebuffer, so the derivatives are larger than in the main pass
+	float lod = textureColor.CalculateLevelOfDetailUnclamped(samplerColor, input.UV) + input.LodBias + ubo.feedbackLodBias;
+	// Sampler uses nearest mip filtering
+	uint level = uint(clamp(floor(lod + 0.5), 0.0, float(levels - 1)));
+
+	// Levels in the mip tail are always resident
+	if (level >= ubo.mipTailStart)
+	{
+		return ~0u;
+	}
+
+	uint2 levelSize;
+	textureColor.GetDimensions(level, levelSize.x, levelSize.y, levels);
+	uint2 texel = min(uint2(saturate(input.UV) * float2(levelSize)), levelSize - 1);
+	uint2 page = texel / ubo.pageExtent;
+
+	// Flag pages the sparse residency code reports as not backed by memory
+	uint status;
+	textureColor.SampleLevel(samplerColor, input.UV, float(level), 0, status);
+	uint missing = CheckAccessFullyMapped(status) ? 0 : 1;
+
+	return (missing << 31) | (level << 24) | (page.y << 12) | page.x;
+}
@@ -18,12 +18,14 @@ float4 main(VSOutput input) : SV_TARGET
 
 	// Fetch sparse until we get a valid texel
 	uint status;
+	uint width, height, levels;
+	textureColor.GetDimensions(0, width, height, levels);
 	float minLod = input.LodBias;
 	do
 	{
 		color = textureColor.SampleLevel(samplerColor, input.UV, minLod, 0, status);
 		minLod += 1.0f;
-	} while(!CheckAccessFullyMapped(status));
+	} while(!CheckAccessFullyMapped(status) && (minLod <= float(levels - 1)));
 
 	float3 N = normalize(input.Normal);
 
@@ -22,7 +22,10 @@
 #include <assert.h>
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <chrono>
 
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 #define VK_ENABLE_BETA_EXTENSIONS
@@ -37,8 +40,6 @@ android_app* androidapp;
 
 #define DEBUG (!NDEBUG)
 
-#define BUFFER_ELEMENTS 32
-
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 #define LOG(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vulkanExample", __VA_ARGS__))
 #else
@@ -77,8 +78,40 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline pipeline;
-	VkShaderModule shaderModule;
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties deviceProperties;
+
+	/*
+		Kernel interface: binding 0 is a storage buffer of 32 bit values, specialization constant 0 receives the element count
+		and the workgroup size is passed via the specialization constant used for local_size_x_id (if the kernel has one)
+	*/
+	std::vector<uint32_t> kernelCode;
+	std::string entryPoint = "main";
+	uint32_t elementCountConstantId = 0;
+	uint32_t workgroupSizeConstantId = 1;
+	// Additional specialization constants given on the command line (id, value)
+	std::vector<std::pair<uint32_t, uint32_t>> specializationConstants;
+	// Reflected from the kernel
+	bool kernelHasWorkgroupSizeConstant = false;
+	uint32_t kernelLocalSize = 1;
+
+	// Timestamps: upload start/end, dispatch start/end, readback start/end
+	static const uint32_t timestampCount = 6;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	uint64_t timestampMask = 0;
+
+	uint32_t iterations = 10;
+
+	// Results of a single sweep configuration, times in milliseconds (negative if not available)
+	struct Result {
+		uint32_t elements;
+		uint32_t workgroupSize;
+		uint32_t workgroupCount;
+		double uploadTime = -1.0;
+		double dispatchTime = -1.0;
+		double readbackTime = -1.0;
+		double cpuTime = 0.0;
+	};
 
 	VkDebugReportCallbackEXT debugReportCallback{};
 
@@ -232,7 +265,6 @@ public:
 		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
 		physicalDevice = physicalDevices[0];
 
-		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 		LOG("GPU: %s\n", deviceProperties.deviceName);
 
@@ -294,82 +326,64 @@ public:
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 
 		/*
-			Prepare storage buffers
+			Load the kernel and prepare resources shared by all sweep configurations
 		*/
-		std::vector<uint32_t> computeInput(BUFFER_ELEMENTS);
-		std::vector<uint32_t> computeOutput(BUFFER_ELEMENTS);
-
-		// Fill input data
-		uint32_t n = 0;
-		std::generate(computeInput.begin(), computeInput.end(), [&n] { return n++; });
-
-		const VkDeviceSize bufferSize = BUFFER_ELEMENTS * sizeof(uint32_t);
-
-		VkBuffer deviceBuffer, hostBuffer;
-		VkDeviceMemory deviceMemory, hostMemory;
+		std::string shaderDir = "glsl";
+		if (commandLineParser.isSet("shaders")) {
+			shaderDir = commandLineParser.getValueAsString("shaders", "glsl");
+		}
+		std::string kernelFile = getAssetPath() + "shaders/" + shaderDir + "/computeheadless/headless.comp.spv";
+		if (commandLineParser.isSet("kernel")) {
+			kernelFile = commandLineParser.getValueAsString("kernel", kernelFile);
+		}
+		if (commandLineParser.isSet("entry")) {
+			entryPoint = commandLineParser.getValueAsString("entry", entryPoint);
+		}
+		if (commandLineParser.isSet("workgroupid")) {
+			workgroupSizeConstantId = commandLineParser.getValueAsInt("workgroupid", workgroupSizeConstantId);
+		}
+		if (commandLineParser.isSet("iterations")) {
+			iterations = std::max(commandLineParser.getValueAsInt("iterations", iterations), 1);
+		}
+		if (commandLineParser.isSet("spec")) {
+			// Comma separated list of id=value pairs, values containing a dot are passed as 32 bit floats
+			std::stringstream stream(commandLineParser.getValueAsString("spec", ""));
+			std::string entry;
+			while (std::getline(stream, entry, ',')) {
+				const size_t separator = entry.find('=');
+				if (separator == std::string::npos) {
+					continue;
+				}
+				const uint32_t id = (uint32_t)std::stoul(entry.substr(0, separator));
+				const std::string value = entry.substr(separator + 1);
+				uint32_t data;
+				if (value.find('.') != std::string::npos) {
+					const float floatValue = std::stof(value);
+					memcpy(&data, &floatValue, sizeof(data));
+				} else {
+					data = (uint32_t)std::stoul(value, nullptr, 0);
+				}
+				specializationConstants.push_back({ id, data });
+			}
+		}
 
-		// Copy input data to VRAM using a staging buffer
-		{
-			createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&hostBuffer,
-				&hostMemory,
-				bufferSize,
-				computeInput.data());
-
-			// Flush writes to host visible buffer
-			void* mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkFlushMappedMemoryRanges(device, 1, &mappedRange);
-			vkUnmapMemory(device, hostMemory);
-
-			createBuffer(
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&deviceBuffer,
-				&deviceMemory,
-				bufferSize);
-
-			// Copy to staging buffer
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(copyCmd, hostBuffer, deviceBuffer, 1, &copyRegion);
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &copyCmd;
-			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			vkDestroyFence(device, fence, nullptr);
-			vkFreeCommandBuffers(device, commandPool, 1, &copyCmd);
+		kernelCode = readSpirv(kernelFile);
+		if (kernelCode.empty()) {
+			LOG("Could not load kernel %s\n", kernelFile.c_str());
+			exit(-1);
 		}
+		reflectKernel();
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = kernelCode.size() * sizeof(uint32_t);
+		moduleCreateInfo.pCode = kernelCode.data();
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule));
+		LOG("Kernel: %s (%s)\n", kernelFile.c_str(), kernelHasWorkgroupSizeConstant ? "workgroup size from specialization constant" : ("fixed workgroup size " + std::to_string(kernelLocalSize)).c_str());
 
-		/*
-			Prepare compute pipeline
-		*/
 		{
 			std::vector<VkDescriptorPoolSize> poolSizes = {
 				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
 			};
-
 			VkDescriptorPoolCreateInfo descriptorPoolInfo =
 				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
 			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -385,178 +399,389 @@ public:
 				vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
-			VkDescriptorSetAllocateInfo allocInfo =
-				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-			VkDescriptorBufferInfo bufferDescriptor = { deviceBuffer, 0, VK_WHOLE_SIZE };
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor),
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
-
 			VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 			pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 			VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 
-			// Create pipeline
-			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			// Create a command buffer for compute operations
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
 
-			// Pass SSBO size via specialization constant
-			struct SpecializationData {
-				uint32_t BUFFER_ELEMENT_COUNT = BUFFER_ELEMENTS;
-			} specializationData;
-			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(SpecializationData), &specializationData);
+			// Fence for compute CB sync
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+		}
 
-			std::string shaderDir = "glsl";
-			if (commandLineParser.isSet("shaders")) {
-				shaderDir = commandLineParser.getValueAsString("shaders", "glsl");
+		// Timestamps are only used if the queue supports them, otherwise only CPU times are reported
+		const uint32_t timestampValidBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+		if ((timestampValidBits > 0) && (deviceProperties.limits.timestampPeriod > 0.0f)) {
+			timestampMask = (timestampValidBits >= 64) ? ~0ull : ((1ull << timestampValidBits) - 1);
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = timestampCount;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool));
+		} else {
+			LOG("Queue does not support timestamps, only CPU times are reported\n");
+		}
+
+		// Sweep over all combinations of the given buffer and workgroup sizes
+		std::vector<uint32_t> bufferSizes = parseSizeList(commandLineParser.isSet("sizes") ? commandLineParser.getValueAsString("sizes", "") : "32");
+		std::vector<uint32_t> workgroupSizes = parseSizeList(commandLineParser.isSet("workgroups") ? commandLineParser.getValueAsString("workgroups", "") : "1");
+		if (bufferSizes.empty() || workgroupSizes.empty()) {
+			LOG("No buffer or workgroup sizes given\n");
+			return;
+		}
+		if (!kernelHasWorkgroupSizeConstant && (workgroupSizes.size() > 1)) {
+			LOG("Kernel has no specialization constant %u for the workgroup size, workgroup sizes are ignored\n", workgroupSizeConstantId);
+		}
+		run(bufferSizes, workgroupSizes, commandLineParser.isSet("csv") ? commandLineParser.getValueAsString("csv", "") : "");
+	}
+
+	// Parses a comma separated list of sizes, "k" and "m" suffixes multiply by 1024 and 1024*1024
+	static std::vector<uint32_t> parseSizeList(const std::string& list)
+	{
+		std::vector<uint32_t> sizes;
+		std::stringstream stream(list);
+		std::string entry;
+		while (std::getline(stream, entry, ',')) {
+			if (entry.empty()) {
+				continue;
+			}
+			uint64_t multiplier = 1;
+			const char suffix = (char)tolower(entry.back());
+			if (suffix == 'k') {
+				multiplier = 1024;
+				entry.pop_back();
+			} else if (suffix == 'm') {
+				multiplier = 1024 * 1024;
+				entry.pop_back();
+			}
+			const uint64_t size = std::stoull(entry) * multiplier;
+			if ((size > 0) && (size <= UINT32_MAX)) {
+				sizes.push_back((uint32_t)size);
 			}
-			const std::string shadersPath = getAssetPath() + "shaders/"+shaderDir+"/computeheadless/";
+		}
+		return sizes;
+	}
 
-			VkPipelineShaderStageCreateInfo shaderStage = {};
-			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	std::vector<uint32_t> readSpirv(const std::string& filename)
+	{
+		std::vector<uint32_t> code;
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-			shaderStage.module = vks::tools::loadShader(androidapp->activity->assetManager, (shadersPath + "headless.comp.spv").c_str(), device);
+		AAsset* asset = AAssetManager_open(androidapp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return code;
+		}
+		code.resize(AAsset_getLength(asset) / sizeof(uint32_t));
+		AAsset_read(asset, code.data(), code.size() * sizeof(uint32_t));
+		AAsset_close(asset);
 #else
-			shaderStage.module = vks::tools::loadShader((shadersPath + "headless.comp.spv").c_str(), device);
+		std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+		if (!is.is_open()) {
+			return code;
+		}
+		const size_t size = is.tellg();
+		is.seekg(0, std::ios::beg);
+		code.resize(size / sizeof(uint32_t));
+		is.read((char*)code.data(), code.size() * sizeof(uint32_t));
 #endif
-			shaderStage.pName = "main";
-			shaderStage.pSpecializationInfo = &specializationInfo;
-			shaderModule = shaderStage.module;
+		return code;
+	}
 
-			assert(shaderStage.module != VK_NULL_HANDLE);
-			computePipelineCreateInfo.stage = shaderStage;
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+	/*
+		Minimal SPIR-V reflection: checks if the workgroup size can be specialized and gets the fixed local size otherwise
+	*/
+	void reflectKernel()
+	{
+		const uint32_t opExecutionMode = 16;
+		const uint32_t opDecorate = 71;
+		const uint32_t executionModeLocalSize = 17;
+		const uint32_t decorationSpecId = 1;
+		// Instructions start after the five word header
+		size_t offset = 5;
+		while (offset < kernelCode.size()) {
+			const uint32_t opcode = kernelCode[offset] & 0xFFFF;
+			const uint32_t wordCount = kernelCode[offset] >> 16;
+			if ((wordCount == 0) || (offset + wordCount > kernelCode.size())) {
+				break;
+			}
+			if ((opcode == opExecutionMode) && (wordCount >= 4) && (kernelCode[offset + 2] == executionModeLocalSize)) {
+				kernelLocalSize = kernelCode[offset + 3];
+			}
+			if ((opcode == opDecorate) && (wordCount >= 4) && (kernelCode[offset + 2] == decorationSpecId) && (kernelCode[offset + 3] == workgroupSizeConstantId)) {
+				kernelHasWorkgroupSizeConstant = true;
+			}
+			offset += wordCount;
+		}
+	}
 
-			// Create a command buffer for compute operations
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+	/*
+		Uploads, processes and reads back a buffer with the given number of elements and measures each step with timestamps
+	*/
+	Result runConfiguration(uint32_t elements, uint32_t workgroupSize, bool printValues)
+	{
+		Result result;
+		result.elements = elements;
+		result.workgroupSize = kernelHasWorkgroupSizeConstant ? workgroupSize : kernelLocalSize;
+		result.workgroupCount = (elements + result.workgroupSize - 1) / result.workgroupSize;
 
-			// Fence for compute CB sync
-			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+		const VkDeviceSize bufferSize = (VkDeviceSize)elements * sizeof(uint32_t);
+
+		VkBuffer deviceBuffer, hostBuffer;
+		VkDeviceMemory deviceMemory, hostMemory;
+		createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			&hostBuffer,
+			&hostMemory,
+			bufferSize);
+		createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&deviceBuffer,
+			&deviceMemory,
+			bufferSize);
+
+		// Fill input data, values are kept small so the cost per element of the default kernel doesn't depend on the buffer size
+		uint32_t* mapped;
+		VK_CHECK_RESULT(vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+		for (uint32_t i = 0; i < elements; i++) {
+			mapped[i] = i % 32;
 		}
+		if (printValues) {
+			LOG("Compute input:\n");
+			for (uint32_t i = 0; i < elements; i++) {
+				LOG("%d \t", mapped[i]);
+			}
+			std::cout << std::endl;
+		}
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = hostMemory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+		VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device, 1, &mappedRange));
+
+		VK_CHECK_RESULT(vkResetDescriptorPool(device, descriptorPool, 0));
+		VkDescriptorSetAllocateInfo allocInfo =
+			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorBufferInfo bufferDescriptor = { deviceBuffer, 0, VK_WHOLE_SIZE };
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		// Pass the element count, workgroup size and user constants via specialization constants
+		std::vector<std::pair<uint32_t, uint32_t>> constants = { { elementCountConstantId, elements } };
+		if (kernelHasWorkgroupSizeConstant) {
+			constants.push_back({ workgroupSizeConstantId, workgroupSize });
+		}
+		for (auto& constant : specializationConstants) {
+			auto it = std::find_if(constants.begin(), constants.end(), [&constant](const std::pair<uint32_t, uint32_t>& c) { return c.first == constant.first; });
+			if (it != constants.end()) {
+				it->second = constant.second;
+			} else {
+				constants.push_back(constant);
+			}
+		}
+		std::vector<VkSpecializationMapEntry> specializationMapEntries;
+		std::vector<uint32_t> specializationData;
+		for (auto& constant : constants) {
+			specializationMapEntries.push_back(vks::initializers::specializationMapEntry(constant.first, static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t)), sizeof(uint32_t)));
+			specializationData.push_back(constant.second);
+		}
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), specializationData.size() * sizeof(uint32_t), specializationData.data());
+
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = shaderModule;
+		shaderStage.pName = entryPoint.c_str();
+		shaderStage.pSpecializationInfo = &specializationInfo;
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VkPipeline pipeline;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
 
 		/*
 			Command buffer creation (for compute work submission)
 		*/
-		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-
-			vkCmdDispatch(commandBuffer, BUFFER_ELEMENTS, 1, 1);
-
-			// Barrier to ensure that shader writes are finished before buffer is read back from GPU
-			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			// Read back to host visible buffer
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(commandBuffer, deviceBuffer, hostBuffer, 1, &copyRegion);
-
-			// Barrier to ensure that buffer copy is finished before host reading from it
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-			bufferBarrier.buffer = hostBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
-
-			// Submit compute work
-			vkResetFences(device, 1, &fence);
-			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-			computeSubmitInfo.commandBufferCount = 1;
-			computeSubmitInfo.pCommandBuffers = &commandBuffer;
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			// Make device writes visible to the host
-			void *mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			// Copy to output
-			memcpy(computeOutput.data(), mapped, bufferSize);
-			vkUnmapMemory(device, hostMemory);
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, timestampCount);
 		}
 
-		vkQueueWaitIdle(queue);
-
-		// Output buffer contents
-		LOG("Compute input:\n");
-		for (auto v : computeInput) {
-			LOG("%d \t", v);
+		// Upload
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = bufferSize;
+		// Start timestamps are written at the stage of the measured work, at the top of the pipe they could be written before the preceding work has finished
+		writeTimestamp(VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+		vkCmdCopyBuffer(commandBuffer, hostBuffer, deviceBuffer, 1, &copyRegion);
+		writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+		// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = deviceBuffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		// Dispatch, repeated to average out the timestamp resolution, each dispatch works on the previous one's result
+		// A printed run only does a single dispatch so the output matches the input
+		const uint32_t dispatchCount = printValues ? 1 : iterations;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		writeTimestamp(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 2);
+		for (uint32_t i = 0; i < dispatchCount; i++) {
+			if (i > 0) {
+				bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			}
+			vkCmdDispatch(commandBuffer, result.workgroupCount, 1, 1);
+		}
+		writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 3);
+
+		// Barrier to ensure that shader writes are finished before buffer is read back from GPU
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		// Read back to host visible buffer
+		writeTimestamp(VK_PIPELINE_STAGE_TRANSFER_BIT, 4);
+		vkCmdCopyBuffer(commandBuffer, deviceBuffer, hostBuffer, 1, &copyRegion);
+		writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 5);
+
+		// Barrier to ensure that buffer copy is finished before host reading from it
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = hostBuffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		// Submit compute work
+		auto tStart = std::chrono::high_resolution_clock::now();
+		vkResetFences(device, 1, &fence);
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, fence));
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+		result.cpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		if (queryPool != VK_NULL_HANDLE) {
+			uint64_t timestamps[timestampCount];
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, timestampCount, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			auto toMilliseconds = [&](uint32_t start, uint32_t end) {
+				return (double)((timestamps[end] - timestamps[start]) & timestampMask) * deviceProperties.limits.timestampPeriod / 1000000.0;
+			};
+			result.uploadTime = toMilliseconds(0, 1);
+			result.dispatchTime = toMilliseconds(2, 3) / (double)dispatchCount;
+			result.readbackTime = toMilliseconds(4, 5);
 		}
-		std::cout << std::endl;
 
-		LOG("Compute output:\n");
-		for (auto v : computeOutput) {
-			LOG("%d \t", v);
+		// Make device writes visible to the host
+		VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+		if (printValues) {
+			LOG("Compute output:\n");
+			for (uint32_t i = 0; i < elements; i++) {
+				LOG("%d \t", mapped[i]);
+			}
+			std::cout << std::endl;
 		}
-		std::cout << std::endl;
+		vkUnmapMemory(device, hostMemory);
 
 		// Clean up
+		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyBuffer(device, deviceBuffer, nullptr);
 		vkFreeMemory(device, deviceMemory, nullptr);
 		vkDestroyBuffer(device, hostBuffer, nullptr);
 		vkFreeMemory(device, hostMemory, nullptr);
+
+		return result;
+	}
+
+	void writeTimestamp(VkPipelineStageFlagBits stage, uint32_t query)
+	{
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, stage, queryPool, query);
+		}
+	}
+
+	/*
+		Runs all combinations of buffer and workgroup sizes and prints the results as a table
+	*/
+	void run(const std::vector<uint32_t>& bufferSizes, const std::vector<uint32_t>& workgroupSizes, const std::string& csvFile)
+	{
+		std::vector<Result> results;
+		// The values of a single small run are printed like the original example did
+		const bool printValues = (bufferSizes.size() == 1) && (workgroupSizes.size() == 1) && (bufferSizes[0] <= 64);
+		for (auto elements : bufferSizes) {
+			if ((VkDeviceSize)elements * sizeof(uint32_t) > deviceProperties.limits.maxStorageBufferRange) {
+				LOG("Skipping %u elements, exceeds the max. storage buffer range\n", elements);
+				continue;
+			}
+			for (auto workgroupSize : workgroupSizes) {
+				const uint32_t localSize = kernelHasWorkgroupSizeConstant ? workgroupSize : kernelLocalSize;
+				if ((localSize > deviceProperties.limits.maxComputeWorkGroupSize[0]) || (localSize > deviceProperties.limits.maxComputeWorkGroupInvocations)) {
+					LOG("Skipping workgroup size %u, exceeds the device limits\n", localSize);
+					continue;
+				}
+				if ((elements + localSize - 1) / localSize > deviceProperties.limits.maxComputeWorkGroupCount[0]) {
+					LOG("Skipping %u elements with workgroup size %u, exceeds the max. workgroup count\n", elements, localSize);
+					continue;
+				}
+				results.push_back(runConfiguration(elements, workgroupSize, printValues));
+				// A fixed workgroup size makes the sweep over workgroup sizes pointless
+				if (!kernelHasWorkgroupSizeConstant) {
+					break;
+				}
+			}
+		}
+
+		auto bandwidth = [](uint32_t elements, double time) {
+			return (time > 0.0) ? (double)elements * sizeof(uint32_t) / (time / 1000.0) / 1.0e9 : -1.0;
+		};
+		auto format = [](double value, const char* fmt) {
+			char buffer[32];
+			if (value < 0.0) {
+				return std::string("n/a");
+			}
+			snprintf(buffer, sizeof(buffer), fmt, value);
+			return std::string(buffer);
+		};
+
+		LOG("\n%12s %8s %10s %12s %12s %14s %14s %12s\n", "elements", "wg size", "groups", "upload GB/s", "dispatch ms", "Gelements/s", "readback GB/s", "total ms");
+		for (auto& result : results) {
+			const double elementRate = (result.dispatchTime > 0.0) ? (double)result.elements / (result.dispatchTime / 1000.0) / 1.0e9 : -1.0;
+			LOG("%12u %8u %10u %12s %12s %14s %14s %12s\n", result.elements, result.workgroupSize, result.workgroupCount,
+				format(bandwidth(result.elements, result.uploadTime), "%.3f").c_str(),
+				format(result.dispatchTime, "%.4f").c_str(),
+				format(elementRate, "%.3f").c_str(),
+				format(bandwidth(result.elements, result.readbackTime), "%.3f").c_str(),
+				format(result.cpuTime, "%.3f").c_str());
+		}
+
+		if (!csvFile.empty()) {
+			std::ofstream file(csvFile);
+			if (!file.is_open()) {
+				LOG("Could not write %s\n", csvFile.c_str());
+				return;
+			}
+			file << "device,elements,workgroupSize,workgroupCount,uploadMs,dispatchMs,readbackMs,uploadGBs,readbackGBs,totalMs\n";
+			for (auto& result : results) {
+				file << deviceProperties.deviceName << "," << result.elements << "," << result.workgroupSize << "," << result.workgroupCount << ",";
+				file << result.uploadTime << "," << result.dispatchTime << "," << result.readbackTime << ",";
+				file << bandwidth(result.elements, result.uploadTime) << "," << bandwidth(result.elements, result.readbackTime) << "," << result.cpuTime << "\n";
+			}
+			LOG("Results written to %s\n", csvFile.c_str());
+		}
 	}
 
 	~VulkanExample()
@@ -564,7 +789,9 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
 		vkDestroyPipelineCache(device, pipelineCache, nullptr);
 		vkDestroyFence(device, fence, nullptr);
 		vkDestroyCommandPool(device, commandPool, nullptr);
@@ -607,6 +834,14 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("kernel", { "-k", "--kernel" }, 1, "SPIR-V compute kernel to run (binding 0 = storage buffer, constant 0 = element count)");
+	commandLineParser.add("entry", { "--entry" }, 1, "Entry point of the kernel (default main)");
+	commandLineParser.add("spec", { "--spec" }, 1, "Additional specialization constants as id=value list, e.g. 2=4,3=0.5");
+	commandLineParser.add("sizes", { "--sizes" }, 1, "Buffer sizes in elements to sweep, e.g. 1k,64k,16m (default 32)");
+	commandLineParser.add("workgroups", { "--workgroups" }, 1, "Workgroup sizes to sweep, e.g. 32,64,256 (default 1)");
+	commandLineParser.add("workgroupid", { "--workgroupid" }, 1, "Specialization constant id used for local_size_x_id (default 1)");
+	commandLineParser.add("iterations", { "--iterations" }, 1, "Number of dispatches per configuration (default 10)");
+	commandLineParser.add("csv", { "--csv" }, 1, "Write the results to a CSV file");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
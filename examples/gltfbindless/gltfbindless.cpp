@@ -0,0 +1,352 @@
+/*
+* Vulkan Example - Bindless glTF materials
+*
+* Renders a glTF scene with all textures in one descriptor array and all material parameters in a storage buffer (see vkglTF::Model::bindlessMaterials)
+* The descriptor set is bound once for the whole scene, and as the material index is passed as the first instance of each draw, all primitives can be drawn with indirect draws
+* Textures are kept within a memory budget by the texture residency manager, which drops the largest mip levels of textures when over budget and restores them as they are used again
+*
+* Relevant code parts are marked with [POI]
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec4 lightPos = glm::vec4(0.0f, 2.5f, 0.0f, 1.0f);
+		glm::vec4 viewPos;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	// [POI] Indexed indirect draw commands for all primitives of the scene
+	vks::Buffer indirectCommandsBuffer;
+	uint32_t indirectDrawCount = 0;
+	// Set if the draw commands could be generated, otherwise the scene is drawn with one draw call per primitive
+	bool indirectDraws = false;
+	// Set if all draw commands can be issued with a single draw call
+	bool multiDrawIndirect = false;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT physicalDeviceDescriptorIndexingFeatures{};
+
+	// Memory budget for the scene's textures in MB, 0 derives the budget from the device local heap
+	int32_t textureBudget = 0;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "glTF bindless materials";
+		camera.type = Camera::CameraType::firstperson;
+		camera.flipY = true;
+		camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+		camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		camera.setRotationSpeed(0.25f);
+
+		// [POI] Enable required extensions
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+#if defined(VK_USE_PLATFORM_MACOS_MVK)
+		// SRS - on macOS set environment variable to configure MoltenVK for using Metal argument buffers (needed for descriptor indexing)
+		setenv("MVK_CONFIG_USE_METAL_ARGUMENT_BUFFERS", "1", 1);
+#endif
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			uniformBuffer.destroy();
+			indirectCommandsBuffer.destroy();
+		}
+	}
+
+	// Enable physical device features required for this example
+	virtual void getEnabledFeatures()
+	{
+		if (deviceFeatures.samplerAnisotropy) {
+			enabledFeatures.samplerAnisotropy = VK_TRUE;
+		}
+		// [POI] Passing the material index as the first instance of indirect draws requires this feature, without it the scene is drawn with regular draws
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		// [POI] Without multi draw indirect, each indirect draw command has to be issued with a draw call of its own
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+
+		// [POI] Check support for the descriptor indexing features used by the bindless materials
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedDescriptorIndexingFeatures{};
+		supportedDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		deviceFeatures2.pNext = &supportedDescriptorIndexingFeatures;
+		PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		vkGetPhysicalDeviceFeatures2KHR(physicalDevice, &deviceFeatures2);
+		if (!supportedDescriptorIndexingFeatures.runtimeDescriptorArray || !supportedDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount || !supportedDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing) {
+			vks::tools::exitFatal("Selected GPU does not support the descriptor indexing features required for bindless materials!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+
+		// [POI] Enable required extension features
+		physicalDeviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		physicalDeviceDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		physicalDeviceDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		physicalDeviceDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+
+		deviceCreatepNextChain = &physicalDeviceDescriptorIndexingFeatures;
+	}
+
+	void buildCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			if (indirectDraws) {
+				// [POI] The bindless set with all materials and textures is bound once for the whole scene
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &scene.bindless.descriptorSet, 0, nullptr);
+				scene.bindBuffers(drawCmdBuffers[i]);
+				if (multiDrawIndirect) {
+					// [POI] All primitives are drawn with a single call
+					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, indirectDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+				} else {
+					// [POI] Without multi draw indirect, each command is issued separately
+					for (uint32_t j = 0; j < indirectDrawCount; j++) {
+						vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+					}
+				}
+			} else {
+				// [POI] Fallback if indirect draws can't pass the material index, the model binds the bindless set and draws each primitive with its material index as the first instance
+				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout, 1);
+			}
+
+			drawUI(drawCmdBuffers[i]);
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
+
+	void loadAssets()
+	{
+		// [POI] Load all textures into a single descriptor array and all materials into a storage buffer
+		scene.bindlessMaterials = true;
+		// [POI] Add the images to the residency manager, only their mip tails are uploaded at load time and the other levels follow as the textures are used
+		scene.textureResidency = &textureResidency;
+		// [POI] Small images are packed into texture arrays instead, each array takes a single slot of the bindless texture array and materials select the image with its layer
+		scene.texturePackingSize = 512;
+		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices);
+		if (!scene.bindlessMaterials) {
+			vks::tools::exitFatal("Could not load the scene with bindless materials!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+	}
+
+	// [POI] Store the draw commands of all primitives in a device local indirect buffer
+	void prepareIndirectCommands()
+	{
+		std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+		indirectDraws = scene.getDrawCommands(drawCommands);
+		if (!indirectDraws) {
+			std::cout << "drawIndirectFirstInstance is not supported, drawing with one draw call per primitive\n";
+			return;
+		}
+		indirectDrawCount = static_cast<uint32_t>(drawCommands.size());
+		multiDrawIndirect = vulkanDevice->enabledFeatures.multiDrawIndirect && (indirectDrawCount <= deviceProperties.limits.maxDrawIndirectCount);
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+			drawCommands.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&indirectCommandsBuffer,
+			stagingBuffer.size));
+		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+		stagingBuffer.destroy();
+	}
+
+	void setupDescriptors()
+	{
+		// Pool
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		// Layout
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		// Set
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		// [POI] Layout uses set 0 for the scene uniform buffer and set 1 for the bindless materials and textures (taken from the glTF model)
+		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayout, vkglTF::descriptorSetLayoutBindless };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		// Double sided materials aren't handled separately, so culling is disabled for all primitives
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
+
+		// [POI] Alpha masking is done in the fragment shader based on the material's alpha mode, so a single pipeline is used for all materials
+		shaderStages[0] = loadShader(getShadersPath() + "gltfbindless/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "gltfbindless/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	// Prepare and initialize uniform buffer containing shader uniforms
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(uniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.viewPos = camera.viewPos;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(uniformData));
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VulkanExampleBase::submitFrame();
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareIndirectCommands();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		buildCommandBuffers();
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		// [POI] Report the textures of visible primitives as used, with the level estimated from the size of the primitives on screen
+		// Textures of primitives outside of the view aren't touched, so the residency manager drops their levels first once the budget is exceeded
+		scene.touchTextures(camera.matrices.perspective * camera.matrices.view, glm::vec2(static_cast<float>(width), static_cast<float>(height)));
+		draw();
+		if (camera.updated) {
+			updateUniformBuffers();
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Statistics")) {
+			overlay->text("Materials: %d", static_cast<int32_t>(scene.materials.size()));
+			overlay->text("Textures: %d", static_cast<int32_t>(scene.textures.size()));
+			const int32_t packedTextures = static_cast<int32_t>(std::count_if(scene.textures.begin(), scene.textures.end(), [](const vkglTF::Texture& texture) { return texture.textureArray != nullptr; }));
+			overlay->text("Packed textures: %d (%d arrays)", packedTextures, static_cast<int32_t>(scene.textureArrays.size()));
+			if (indirectDraws) {
+				overlay->text("Indirect draws: %d", indirectDrawCount);
+				overlay->text("Draw calls: %d", multiDrawIndirect ? 1 : indirectDrawCount);
+			} else {
+				overlay->text("Indirect draws not supported");
+			}
+		}
+		if (overlay->header("Texture residency")) {
+			overlay->text("Resident: %.1f MB", static_cast<float>(textureResidency.getResidentSize()) / (1024.0f * 1024.0f));
+			overlay->text("Budget: %.1f MB", static_cast<float>(textureResidency.getBudget()) / (1024.0f * 1024.0f));
+			// [POI] Lowering the budget drops the largest mip levels of the least recently used textures
+			if (overlay->sliderInt("Budget (MB, 0 = auto)", &textureBudget, 0, 1024)) {
+				textureResidency.settings.budget = static_cast<VkDeviceSize>(textureBudget) * 1024 * 1024;
+			}
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -31,7 +31,7 @@ VulkanglTFScene::~VulkanglTFScene()
 	for (Image image : images) {
 		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
+		vulkanDevice->samplerCache.release(image.texture.sampler);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
 	for (Material material : materials) {
@@ -360,6 +360,8 @@ void VulkanExample::loadglTFFile(std::string filename)
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
+	// Images are loaded from KTX files by the sample, so tinyglTF doesn't need to decode them
+	gltfContext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) { return true; }, nullptr);
 	bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
 
 	// Pass some Vulkan resources required for setup and rendering to the glTF model loading class
@@ -48,7 +48,7 @@ VulkanglTFModel::~VulkanglTFModel()
 	{
 		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
+		vulkanDevice->samplerCache.release(image.texture.sampler);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
 	for (Skin skin : skins)
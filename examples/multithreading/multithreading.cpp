@@ -19,6 +19,8 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayStarSphere = true;
+	// Reuse object secondary command buffers across frames and only re-record them if visibility changes
+	bool cacheCommandBuffers = false;
 
 	struct {
 		vkglTF::Model ufo;
@@ -33,22 +35,21 @@ public:
 
 	struct {
 		VkPipeline phong;
+		VkPipeline phongInstanced;
 		VkPipeline starsphere;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
+	// Pipeline layout for the cached object command buffers, which read per-object data from a storage buffer instead of push constants
+	VkPipelineLayout pipelineLayoutInstanced;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorSet descriptorSet;
 
 	VkCommandBuffer primaryCommandBuffer;
 
-	// Secondary scene command buffers used to store backdrop and user interface
-	struct SecondaryCommandBuffers {
-		VkCommandBuffer background;
-		VkCommandBuffer ui;
-	} secondaryCommandBuffers;
-
 	// Number of animated objects to be renderer
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	uint32_t numObjects = 512;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
@@ -73,18 +74,33 @@ public:
 		bool visible = true;
 	};
 
-	struct ThreadData {
-		VkCommandPool commandPool;
-		// One command buffer per render object
-		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objects;
+	// One push constant block per render object
+	std::vector<ThreadPushConstantBlock> pushConstBlock;
+
+	// Per-object data read by the instanced pipeline, indexed by the first instance of a draw
+	struct ObjectInstanceData {
+		glm::mat4 mvp;
+		glm::vec4 color;
 	};
-	std::vector<ThreadData> threadData;
+	// Persistently mapped storage buffer with one ObjectInstanceData entry per object
+	vks::Buffer objectBuffer;
 
-	vks::ThreadPool threadPool;
+	// A contiguous range of objects recorded into a secondary command buffer that is reused across frames
+	// Each range has its own command pool, so ranges can be re-recorded by any thread of the pool
+	struct CachedRange {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		uint32_t begin;
+		uint32_t end;
+		bool dirty = true;
+	};
+	std::vector<CachedRange> cachedRanges;
+	// Visibility of each object at the time its range was last recorded
+	std::vector<uint8_t> recordedVisibility;
+	// Number of ranges that had to be re-recorded in the last frame
+	uint32_t rerecordedRanges = 0;
 
 	// Fence to wait for all command buffers to finish before
 	// presenting to the swap chain
@@ -111,8 +127,6 @@ public:
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -121,14 +135,17 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.phong, nullptr);
+		vkDestroyPipeline(device, pipelines.phongInstanced, nullptr);
 		vkDestroyPipeline(device, pipelines.starsphere, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayoutInstanced, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
-			vkDestroyCommandPool(device, thread.commandPool, nullptr);
+		for (auto& range : cachedRanges) {
+			vkDestroyCommandPool(device, range.commandPool, nullptr);
 		}
+		objectBuffer.destroy();
 
 		vkDestroyFence(device, renderFence, nullptr);
 	}
@@ -152,61 +169,86 @@ public:
 				1);
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &primaryCommandBuffer));
 
-		// Create additional secondary CBs for background and ui
-		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
+		// Per-thread command pools for the secondary command buffers are managed by the base class
+		prepareParallelRecording(numThreads);
+
+		objects.resize(numObjects);
+		pushConstBlock.resize(numObjects);
 
-		threadData.resize(numThreads);
+		for (uint32_t i = 0; i < numObjects; i++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objects[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
 
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
+			objects[i].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			objects[i].deltaT = rnd(1.0f);
+			objects[i].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objects[i].rotationSpeed = (2.0f + rnd(4.0f)) * objects[i].rotationDir;
+			objects[i].scale = 0.75f + rnd(0.5f);
 
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
+			pushConstBlock[i].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+		}
+
+		prepareCachedCommandBuffers();
+	}
+
+	// Creates the per-object storage buffer and the cached secondary command buffers
+	void prepareCachedCommandBuffers()
+	{
+		// Host visible and coherent, so the objects can be written from all threads without explicit flushes
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&objectBuffer,
+			numObjects * sizeof(ObjectInstanceData)));
+		VK_CHECK_RESULT(objectBuffer.map());
+		ObjectInstanceData* instanceData = (ObjectInstanceData*)objectBuffer.mapped;
+		for (uint32_t i = 0; i < numObjects; i++) {
+			instanceData[i].color = glm::vec4(pushConstBlock[i].color, 1.0f);
+		}
 
-			// Create one command pool for each thread
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &objectBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		// Use a few ranges per thread so re-recording after visibility changes is balanced across the pool
+		const uint32_t rangeCount = std::min(numObjects, threadPool.getThreadCount() * 4);
+		cachedRanges.resize(rangeCount);
+		for (uint32_t i = 0; i < rangeCount; i++) {
+			CachedRange& range = cachedRanges[i];
+			range.begin = numObjects * i / rangeCount;
+			range.end = numObjects * (i + 1) / rangeCount;
+			range.dirty = true;
 			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
 			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
-
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
-			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(
-					thread->commandPool,
-					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
-
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
-			}
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &range.commandPool));
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(range.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &range.commandBuffer));
 		}
+		recordedVisibility.assign(numObjects, 0);
+	}
 
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Animates a single object and updates its visibility and model view projection matrix
+	void updateObject(uint32_t objectIndex)
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		ObjectData *objectData = &objects[objectIndex];
 
 		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
 		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
@@ -216,22 +258,6 @@ public:
 			return;
 		}
 
-		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
-
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
-
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
-
 		// Update
 		if (!paused) {
 			objectData->rotation.y += 2.5f * objectData->rotationSpeed * frameTimer;
@@ -250,7 +276,18 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		pushConstBlock[objectIndex].mvp = matrices.projection * matrices.view * objectData->model;
+	}
+
+	// Updates and draws a single object, skipping objects outside of the view frustum
+	void threadRenderCode(VkCommandBuffer cmdBuffer, uint32_t objectIndex)
+	{
+		updateObject(objectIndex);
+
+		if (!objects[objectIndex].visible)
+		{
+			return;
+		}
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -260,80 +297,85 @@ public:
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			&pushConstBlock[objectIndex]);
 
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
-
-		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
-	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Records the visible objects of a cached range, consecutive visible objects are drawn with a single instanced draw
+	void recordCachedRange(CachedRange& range)
 	{
-		// Secondary command buffer for the sky sphere
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo(renderPass, 0);
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-
-		/*
-			Background
-		*/
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.background, &commandBufferBeginInfo));
-
-		vkCmdSetViewport(secondaryCommandBuffers.background, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.background, 0, 1, &scissor);
-
-		vkCmdBindPipeline(secondaryCommandBuffers.background, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
-
-		glm::mat4 mvp = matrices.projection * matrices.view;
-		mvp[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-		mvp = glm::scale(mvp, glm::vec3(2.0f));
-
-		vkCmdPushConstants(
-			secondaryCommandBuffers.background,
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(mvp),
-			&mvp);
-
-		models.starSphere.draw(secondaryCommandBuffers.background);
-		
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.background));
-
-		/*
-			User interface
+		VK_CHECK_RESULT(vkResetCommandPool(device, range.commandPool, 0));
+		VkCommandBuffer cmdBuffer = range.commandBuffer;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
-			With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the primary command buffer's content has to be defined
-			by secondary command buffers, which also applies to the UI overlay command buffer
-		*/
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.ui, &commandBufferBeginInfo));
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongInstanced);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayoutInstanced, 0, 1, &descriptorSet, 0, nullptr);
 
-		vkCmdSetViewport(secondaryCommandBuffers.ui, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.ui, 0, 1, &scissor);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-		vkCmdBindPipeline(secondaryCommandBuffers.ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
+		uint32_t i = range.begin;
+		while (i < range.end) {
+			if (!objects[i].visible) {
+				recordedVisibility[i] = 0;
+				i++;
+				continue;
+			}
+			const uint32_t firstInstance = i;
+			while ((i < range.end) && objects[i].visible) {
+				recordedVisibility[i] = 1;
+				i++;
+			}
+			vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, i - firstInstance, 0, 0, firstInstance);
+		}
 
-		drawUI(secondaryCommandBuffers.ui);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		range.dirty = false;
+	}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.ui));
+	// Updates the objects in the persistently mapped storage buffer and re-records only the ranges whose visibility has changed
+	void updateCachedCommandBuffers()
+	{
+		ObjectInstanceData* instanceData = (ObjectInstanceData*)objectBuffer.mapped;
+		std::atomic<uint32_t> rerecorded(0);
+		threadPool.parallelFor(static_cast<uint32_t>(cachedRanges.size()), [&](uint32_t firstRange, uint32_t lastRange) {
+			for (uint32_t r = firstRange; r < lastRange; r++) {
+				CachedRange& range = cachedRanges[r];
+				for (uint32_t i = range.begin; i < range.end; i++) {
+					updateObject(i);
+					if (objects[i].visible) {
+						instanceData[i].mvp = pushConstBlock[i].mvp;
+					}
+					if (objects[i].visible != (recordedVisibility[i] != 0)) {
+						range.dirty = true;
+					}
+				}
+				if (range.dirty) {
+					recordCachedRange(range);
+					rerecorded++;
+				}
+			}
+		});
+		rerecordedRanges = rerecorded;
 	}
 
-	// Updates the secondary command buffers using a thread pool
-	// and puts them into the primary command buffer that's
-	// lat submitted to the queue for rendering
+	// Records the scene into secondary command buffers on all threads of the
+	// base class thread pool and puts them into the primary command buffer
+	// that's later submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
 	{
-		// Contains the list of secondary command buffers to be submitted
-		std::vector<VkCommandBuffer> commandBuffers;
-
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -350,59 +392,75 @@ public:
 		renderPassBeginInfo.pClearValues = clearValues;
 		renderPassBeginInfo.framebuffer = frameBuffer;
 
-		// Set target frame buffer
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+
+		// There is only a single primary command buffer, which is no longer in use once the render fence has been signaled
+		parallelRecorder.beginFrame(0);
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(primaryCommandBuffer, &cmdBufInfo));
 
 		// The primary command buffer does not contain any rendering commands
 		// These are stored (and retrieved) from the secondary command buffers
-		vkCmdBeginRenderPass(primaryCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		parallelRecorder.beginRenderPass(primaryCommandBuffer, renderPassBeginInfo);
 
-		// Inheritance info for the secondary command buffers
-		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
-		inheritanceInfo.renderPass = renderPass;
-		// Secondary command buffer also use the currently active framebuffer
-		inheritanceInfo.framebuffer = frameBuffer;
+		// Background
+		if (displayStarSphere) {
+			parallelRecorder.recordSecondary([&](VkCommandBuffer cmdBuffer) {
+				vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		// Update secondary sene command buffers
-		updateSecondaryCommandBuffers(inheritanceInfo);
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
 
-		if (displayStarSphere) {
-			commandBuffers.push_back(secondaryCommandBuffers.background);
+				glm::mat4 mvp = matrices.projection * matrices.view;
+				mvp[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				mvp = glm::scale(mvp, glm::vec3(2.0f));
+
+				vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvp), &mvp);
+
+				models.starSphere.draw(cmdBuffer);
+			});
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
+		if (cacheCommandBuffers) {
+			// Command buffers only need to be re-recorded if the visibility of an object changed,
+			// all other per-frame changes are written to the object storage buffer
+			updateCachedCommandBuffers();
+			for (auto& range : cachedRanges) {
+				parallelRecorder.executeSecondary(range.commandBuffer);
 			}
-		}
+		} else {
+			// The object list is split into ranges that are recorded into secondary command buffers by all threads
+			parallelRecorder.recordParallel(numObjects, [&](VkCommandBuffer cmdBuffer, uint32_t begin, uint32_t end) {
+				vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		threadPool.wait();
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
 
-		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
+				VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+				for (uint32_t i = begin; i < end; i++) {
+					threadRenderCode(cmdBuffer, i);
 				}
-			}
+			});
 		}
 
-		// Render ui last
+		/*
+			User interface
+
+			With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the primary command buffer's content has to be defined
+			by secondary command buffers, which also applies to the UI overlay command buffer
+		*/
 		if (UIOverlay.visible) {
-			commandBuffers.push_back(secondaryCommandBuffers.ui);
+			parallelRecorder.recordSecondary([&](VkCommandBuffer cmdBuffer) {
+				drawUI(cmdBuffer);
+			});
 		}
 
-		// Execute render commands from the secondary command buffer
-		vkCmdExecuteCommands(primaryCommandBuffer, commandBuffers.size(), commandBuffers.data());
-
-		vkCmdEndRenderPass(primaryCommandBuffer);
+		// Executes the secondary command buffers in recording order
+		parallelRecorder.endRenderPass();
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(primaryCommandBuffer));
 	}
@@ -431,6 +489,10 @@ public:
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Layout for the cached command buffers, all per-object data is read from the storage buffer
+		VkPipelineLayoutCreateInfo pipelineLayoutInstancedCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInstancedCI, nullptr, &pipelineLayoutInstanced));
 	}
 
 	void preparePipelines()
@@ -463,6 +525,12 @@ public:
 		shaderStages[1] = loadShader(getShadersPath() + "multithreading/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
 
+		// Object rendering pipeline for cached command buffers
+		pipelineCI.layout = pipelineLayoutInstanced;
+		shaderStages[0] = loadShader(getShadersPath() + "multithreading/phong_instanced.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongInstanced));
+		pipelineCI.layout = pipelineLayout;
+
 		// Star sphere rendering pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		depthStencilState.depthWriteEnable = VK_FALSE;
@@ -507,6 +575,7 @@ public:
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		vkCreateFence(device, &fenceCreateInfo, nullptr, &renderFence);
 		loadAssets();
+		setupDescriptors();
 		setupPipelineLayout();
 		preparePipelines();
 		prepareMultiThreadedRenderer();
@@ -530,13 +599,25 @@ public:
 		updateMatrices();
 	}
 
+	virtual void windowResized()
+	{
+		// Viewport and scissor are baked into the cached command buffers
+		for (auto& range : cachedRanges) {
+			range.dirty = true;
+		}
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			if (cacheCommandBuffers) {
+				overlay->text("Re-recorded ranges: %d / %d", rerecordedRanges, (uint32_t)cachedRanges.size());
+			}
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			overlay->checkBox("Cache command buffers", &cacheCommandBuffers);
 		}
 
 	}
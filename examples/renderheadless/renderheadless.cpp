@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Minimal headless rendering example
 *
+* Renders a batch of camera parameter sets with multiple frames in flight, the rendered images are read back while the GPU renders the next frames and written to disk on worker threads
+*
 * Copyright (C) 2017-2022 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -23,7 +25,13 @@
 #include <vector>
 #include <array>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -36,6 +44,7 @@
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
 #include "CommandLineParser.hpp"
+#include "threadpool.hpp"
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 android_app* androidapp;
@@ -77,7 +86,6 @@ public:
 	VkPipelineCache pipelineCache;
 	VkQueue queue;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
@@ -91,10 +99,40 @@ public:
 		VkImageView view;
 	};
 	int32_t width, height;
-	VkFramebuffer framebuffer;
-	FrameBufferAttachment colorAttachment, depthAttachment;
+	VkFormat colorFormat, depthFormat;
 	VkRenderPass renderPass;
 
+	// Resources of a single frame in flight
+	struct Frame {
+		enum State : uint32_t { Idle, Rendering, Writing };
+		FrameBufferAttachment colorAttachment, depthAttachment;
+		VkFramebuffer framebuffer;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		// Persistently mapped host buffer the color attachment is copied to
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackMemory;
+		void* mapped;
+		// Index of the parameter set rendered by this frame
+		uint32_t parameterIndex = 0;
+		std::atomic<uint32_t> state{ Idle };
+	};
+	std::vector<std::unique_ptr<Frame>> frames;
+	uint32_t framesInFlight = 3;
+	bool readbackCoherent = true;
+
+	// Camera parameters for a single image
+	struct RenderParameters {
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::vec3 rotation = glm::vec3(0.0f);
+		float fov = 60.0f;
+	};
+	std::vector<RenderParameters> renderParameters;
+	std::string outputDir = ".";
+
+	vks::ThreadPool threadPool;
+	std::atomic<uint32_t> filesWritten{ 0 };
+
 	VkDebugReportCallbackEXT debugReportCallback{};
 
 	uint32_t getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties) {
@@ -158,6 +196,34 @@ public:
 	{
 		LOG("Running headless rendering example\n");
 
+		/*
+			Batch settings
+		*/
+		uint32_t frameCount = 1;
+		if (commandLineParser.isSet("frames")) {
+			frameCount = std::max(commandLineParser.getValueAsInt("frames", 1), 1);
+		}
+		if (commandLineParser.isSet("inflight")) {
+			framesInFlight = std::max(commandLineParser.getValueAsInt("inflight", 3), 1);
+		}
+		if (commandLineParser.isSet("output")) {
+			outputDir = commandLineParser.getValueAsString("output", outputDir);
+		}
+		if (commandLineParser.isSet("parameters")) {
+			const std::string parameterFile = commandLineParser.getValueAsString("parameters", "");
+			if (!loadParameters(parameterFile)) {
+				LOG("Could not load parameters from %s\n", parameterFile.c_str());
+			}
+		}
+		if (renderParameters.empty()) {
+			// Without a parameter file the camera rolls around the view axis once over all frames
+			for (uint32_t i = 0; i < frameCount; i++) {
+				RenderParameters parameters;
+				parameters.rotation.z = 360.0f * (float)i / (float)frameCount;
+				renderParameters.push_back(parameters);
+			}
+		}
+
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 		LOG("loading vulkan lib");
 		vks::android::loadVulkanLibrary();
@@ -409,79 +475,12 @@ public:
 		}
 
 		/*
-			Create framebuffer attachments
+			Create the render pass and per frame resources
 		*/
 		width = 1024;
 		height = 1024;
-		VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		VkFormat depthFormat;
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
 		vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
-		{
-			// Color attachment
-			VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-			image.imageType = VK_IMAGE_TYPE_2D;
-			image.format = colorFormat;
-			image.extent.width = width;
-			image.extent.height = height;
-			image.extent.depth = 1;
-			image.mipLevels = 1;
-			image.arrayLayers = 1;
-			image.samples = VK_SAMPLE_COUNT_1_BIT;
-			image.tiling = VK_IMAGE_TILING_OPTIMAL;
-			image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &colorAttachment.image));
-			vkGetImageMemoryRequirements(device, colorAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &colorAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, colorAttachment.image, colorAttachment.memory, 0));
-
-			VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			colorImageView.format = colorFormat;
-			colorImageView.subresourceRange = {};
-			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			colorImageView.subresourceRange.baseMipLevel = 0;
-			colorImageView.subresourceRange.levelCount = 1;
-			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
-			colorImageView.image = colorAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &colorAttachment.view));
-
-			// Depth stencil attachment
-			image.format = depthFormat;
-			image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &depthAttachment.image));
-			vkGetImageMemoryRequirements(device, depthAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, depthAttachment.image, depthAttachment.memory, 0));
-
-			VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-			depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			depthStencilView.format = depthFormat;
-			depthStencilView.flags = 0;
-			depthStencilView.subresourceRange = {};
-			depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
-				depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-			depthStencilView.subresourceRange.baseMipLevel = 0;
-			depthStencilView.subresourceRange.levelCount = 1;
-			depthStencilView.subresourceRange.baseArrayLayer = 0;
-			depthStencilView.subresourceRange.layerCount = 1;
-			depthStencilView.image = depthAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &depthAttachment.view));
-		}
-
-		/*
-			Create renderpass
-		*/
 		{
 			std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
 			// Color attachment
@@ -523,12 +522,13 @@ public:
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+			// The color attachment is copied to the readback buffer in the same command buffer right after the render pass
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 			// Create the actual renderpass
@@ -541,10 +541,32 @@ public:
 			renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 			renderPassInfo.pDependencies = dependencies.data();
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+		}
+
+		// Prefer cached host memory for the readback buffers, reading from uncached memory is slow
+		VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+		VkMemoryPropertyFlags readbackMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
+			if (deviceMemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) {
+				readbackMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+				break;
+			}
+		}
+		readbackCoherent = (readbackMemoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		// Each frame in flight has its own attachments, command buffer and readback buffer, so the GPU can render a frame while previous ones are read back and written
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			std::unique_ptr<Frame> frame(new Frame());
+			createAttachment(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, frame->colorAttachment);
+			VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+				depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspect, frame->depthAttachment);
 
 			VkImageView attachments[2];
-			attachments[0] = colorAttachment.view;
-			attachments[1] = depthAttachment.view;
+			attachments[0] = frame->colorAttachment.view;
+			attachments[1] = frame->depthAttachment.view;
 
 			VkFramebufferCreateInfo framebufferCreateInfo = vks::initializers::framebufferCreateInfo();
 			framebufferCreateInfo.renderPass = renderPass;
@@ -553,7 +575,16 @@ public:
 			framebufferCreateInfo.width = width;
 			framebufferCreateInfo.height = height;
 			framebufferCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer));
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frame->framebuffer));
+
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame->commandBuffer));
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &frame->fence));
+
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryFlags, &frame->readbackBuffer, &frame->readbackMemory, (VkDeviceSize)width * height * 4);
+			VK_CHECK_RESULT(vkMapMemory(device, frame->readbackMemory, 0, VK_WHOLE_SIZE, 0, &frame->mapped));
+			frames.push_back(std::move(frame));
 		}
 
 		/*
@@ -666,234 +697,294 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 		}
 
-		/*
-			Command buffer creation
-		*/
-		{
-			VkCommandBuffer commandBuffer;
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
-
-			VkCommandBufferBeginInfo cmdBufInfo =
-				vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			VkClearValue clearValues[2];
-			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = framebuffer;
-
-			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {};
-			viewport.height = (float)height;
-			viewport.width = (float)width;
-			viewport.minDepth = (float)0.0f;
-			viewport.maxDepth = (float)1.0f;
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-			// Update dynamic scissor state
-			VkRect2D scissor = {};
-			scissor.extent.width = width;
-			scissor.extent.height = height;
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-			// Render scene
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-			std::vector<glm::vec3> pos = {
-				glm::vec3(-1.5f, 0.0f, -4.0f),
-				glm::vec3( 0.0f, 0.0f, -2.5f),
-				glm::vec3( 1.5f, 0.0f, -4.0f),
-			};
+		// Files are written on worker threads, the main thread only records and submits
+		threadPool.setThreadCount(std::max(2u, std::thread::hardware_concurrency()));
+	}
 
-			for (auto v : pos) {
-				glm::mat4 mvpMatrix = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f) * glm::translate(glm::mat4(1.0f), v);
-				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
-				vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
-			}
+	/*
+		Create an image, its memory and view for use as a framebuffer attachment
+	*/
+	void createAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, FrameBufferAttachment& attachment)
+	{
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = format;
+		image.extent.width = width;
+		image.extent.height = height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = usage;
 
-			vkCmdEndRenderPass(commandBuffer);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment.image));
+		vkGetImageMemoryRequirements(device, attachment.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment.image, attachment.memory, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = format;
+		imageView.subresourceRange = {};
+		imageView.subresourceRange.aspectMask = aspectMask;
+		imageView.subresourceRange.baseMipLevel = 0;
+		imageView.subresourceRange.levelCount = 1;
+		imageView.subresourceRange.baseArrayLayer = 0;
+		imageView.subresourceRange.layerCount = 1;
+		imageView.image = attachment.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment.view));
+	}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	/*
+		Record the commands for rendering a parameter set and copying the result to the frame's readback buffer
+	*/
+	void buildCommandBuffer(Frame& frame, const RenderParameters& parameters)
+	{
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frame.framebuffer;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = {};
+		viewport.height = (float)height;
+		viewport.width = (float)width;
+		viewport.minDepth = (float)0.0f;
+		viewport.maxDepth = (float)1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		// Update dynamic scissor state
+		VkRect2D scissor = {};
+		scissor.extent.width = width;
+		scissor.extent.height = height;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		// Render scene
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		std::vector<glm::vec3> pos = {
+			glm::vec3(-1.5f, 0.0f, -4.0f),
+			glm::vec3( 0.0f, 0.0f, -2.5f),
+			glm::vec3( 1.5f, 0.0f, -4.0f),
+		};
 
-			submitWork(commandBuffer, queue);
+		glm::mat4 viewMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(parameters.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		viewMatrix = glm::rotate(viewMatrix, glm::radians(parameters.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		viewMatrix = glm::rotate(viewMatrix, glm::radians(parameters.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		viewMatrix = glm::translate(viewMatrix, parameters.position);
+		const glm::mat4 projectionMatrix = glm::perspective(glm::radians(parameters.fov), (float)width / (float)height, 0.1f, 256.0f);
 
-			vkDeviceWaitIdle(device);
+		for (auto v : pos) {
+			glm::mat4 mvpMatrix = projectionMatrix * viewMatrix * glm::translate(glm::mat4(1.0f), v);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
+			vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
 		}
 
-		/*
-			Copy framebuffer image to host visible image
-		*/
-		const char* imagedata;
-		{
-			// Create the linear tiled destination image to copy to and to read the memory from
-			VkImageCreateInfo imgCreateInfo(vks::initializers::imageCreateInfo());
-			imgCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imgCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-			imgCreateInfo.extent.width = width;
-			imgCreateInfo.extent.height = height;
-			imgCreateInfo.extent.depth = 1;
-			imgCreateInfo.arrayLayers = 1;
-			imgCreateInfo.mipLevels = 1;
-			imgCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imgCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imgCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imgCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-			// Create the image
-			VkImage dstImage;
-			VK_CHECK_RESULT(vkCreateImage(device, &imgCreateInfo, nullptr, &dstImage));
-			// Create memory to back up the image
-			VkMemoryRequirements memRequirements;
-			VkMemoryAllocateInfo memAllocInfo(vks::initializers::memoryAllocateInfo());
-			VkDeviceMemory dstImageMemory;
-			vkGetImageMemoryRequirements(device, dstImage, &memRequirements);
-			memAllocInfo.allocationSize = memRequirements.size;
-			// Memory must be host visible to copy from
-			memAllocInfo.memoryTypeIndex = getMemoryTypeIndex(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dstImageMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, dstImage, dstImageMemory, 0));
-
-			// Do the actual blit from the offscreen image to our host visible destination image
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			// Transition destination image to transfer destination layout
-			vks::tools::insertImageMemoryBarrier(
-				copyCmd,
-				dstImage,
-				0,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-			// colorAttachment.image is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
-
-			VkImageCopy imageCopyRegion{};
-			imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.srcSubresource.layerCount = 1;
-			imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.dstSubresource.layerCount = 1;
-			imageCopyRegion.extent.width = width;
-			imageCopyRegion.extent.height = height;
-			imageCopyRegion.extent.depth = 1;
-
-			vkCmdCopyImage(
-				copyCmd,
-				colorAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageCopyRegion);
-
-			// Transition destination image to general layout, which is the required layout for mapping the image memory later on
-			vks::tools::insertImageMemoryBarrier(
-				copyCmd,
-				dstImage,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_MEMORY_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_GENERAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			submitWork(copyCmd, queue);
-
-			// Get layout of the image (including row pitch)
-			VkImageSubresource subResource{};
-			subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			VkSubresourceLayout subResourceLayout;
-
-			vkGetImageSubresourceLayout(device, dstImage, &subResource, &subResourceLayout);
-
-			// Map image memory so we can start copying from it
-			vkMapMemory(device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&imagedata);
-			imagedata += subResourceLayout.offset;
-
-		/*
-			Save host visible framebuffer image to disk (ppm format)
-		*/
+		vkCmdEndRenderPass(commandBuffer);
+
+		// The render pass leaves the color attachment in transfer source layout, so it can be copied to the readback buffer directly
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent.width = width;
+		copyRegion.imageExtent.height = height;
+		copyRegion.imageExtent.depth = 1;
+		vkCmdCopyImageToBuffer(commandBuffer, frame.colorAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = frame.readbackBuffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
+	std::string getFilename(uint32_t index)
+	{
 #if defined (VK_USE_PLATFORM_ANDROID_KHR)
-			const char* filename = strcat(getenv("EXTERNAL_STORAGE"), "/headless.ppm");
+		const std::string directory = getenv("EXTERNAL_STORAGE");
 #else
-			const char* filename = "headless.ppm";
+		const std::string directory = outputDir;
 #endif
-			std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-			// ppm header
-			file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-			// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-			// Check if source is BGR and needs swizzle
-			std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-			const bool colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
-
-			// ppm binary pixel data
-			for (int32_t y = 0; y < height; y++) {
-				unsigned int *row = (unsigned int*)imagedata;
-				for (int32_t x = 0; x < width; x++) {
-					if (colorSwizzle) {
-						file.write((char*)row + 2, 1);
-						file.write((char*)row + 1, 1);
-						file.write((char*)row, 1);
-					}
-					else {
-						file.write((char*)row, 3);
-					}
-					row++;
+		// A single frame keeps the file name of the original example
+		if (renderParameters.size() == 1) {
+			return directory + "/headless.ppm";
+		}
+		char filename[32];
+		snprintf(filename, sizeof(filename), "/headless%06u.ppm", index);
+		return directory + filename;
+	}
+
+	/*
+		Converts the frame's readback buffer and writes it to disk (ppm format), runs on a worker thread
+	*/
+	void writeFrame(Frame& frame)
+	{
+		if (!readbackCoherent) {
+			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+			mappedRange.memory = frame.readbackMemory;
+			mappedRange.size = VK_WHOLE_SIZE;
+			VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+		}
+		const std::string filename = getFilename(frame.parameterIndex);
+		const std::string header = "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+		std::vector<char> fileData(header.size() + (size_t)width * height * 3);
+		memcpy(fileData.data(), header.data(), header.size());
+		// The color attachment is RGBA, so only alpha needs to be dropped
+		const char* src = (const char*)frame.mapped;
+		char* dst = fileData.data() + header.size();
+		for (size_t i = 0; i < (size_t)width * height; i++) {
+			dst[i * 3 + 0] = src[i * 4 + 0];
+			dst[i * 3 + 1] = src[i * 4 + 1];
+			dst[i * 3 + 2] = src[i * 4 + 2];
+		}
+		// The readback buffer can be reused as soon as its content has been converted
+		frame.state.store(Frame::Idle, std::memory_order_release);
+
+		std::ofstream file(filename, std::ios::out | std::ios::binary);
+		if (!file.is_open()) {
+			LOG("Could not write %s\n", filename.c_str());
+			return;
+		}
+		file.write(fileData.data(), fileData.size());
+		filesWritten++;
+	}
+
+	/*
+		Hands frames whose rendering has finished over to the worker threads
+	*/
+	void processFinishedFrames(bool wait)
+	{
+		for (auto& frame : frames) {
+			if (frame->state.load(std::memory_order_acquire) != Frame::Rendering) {
+				continue;
+			}
+			if (wait) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame->fence, VK_TRUE, UINT64_MAX));
+			} else if (vkGetFenceStatus(device, frame->fence) != VK_SUCCESS) {
+				continue;
+			}
+			frame->state.store(Frame::Writing, std::memory_order_release);
+			Frame* framePtr = frame.get();
+			threadPool.schedule([this, framePtr] { writeFrame(*framePtr); });
+		}
+	}
+
+	/*
+		Renders all parameter sets with up to framesInFlight frames being rendered, read back and written at the same time
+	*/
+	void renderBatch()
+	{
+		LOG("Rendering %u frame(s) at %dx%d with %u frames in flight\n", (uint32_t)renderParameters.size(), width, height, framesInFlight);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(renderParameters.size()); i++) {
+			Frame& frame = *frames[i % framesInFlight];
+			// Wait until the previous content of this frame has been rendered and converted
+			if (frame.state.load(std::memory_order_acquire) == Frame::Rendering) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+				processFinishedFrames(false);
+			}
+			while (frame.state.load(std::memory_order_acquire) != Frame::Idle) {
+				if (!threadPool.runPendingJob()) {
+					std::this_thread::yield();
 				}
-				imagedata += subResourceLayout.rowPitch;
 			}
-			file.close();
 
-			LOG("Framebuffer image saved to %s\n", filename);
+			frame.parameterIndex = i;
+			buildCommandBuffer(frame, renderParameters[i]);
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
+			VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+			frame.state.store(Frame::Rendering, std::memory_order_release);
 
-			// Clean up resources
-			vkUnmapMemory(device, dstImageMemory);
-			vkFreeMemory(device, dstImageMemory, nullptr);
-			vkDestroyImage(device, dstImage, nullptr);
+			processFinishedFrames(false);
 		}
+		processFinishedFrames(true);
+		threadPool.wait();
+		auto tEnd = std::chrono::high_resolution_clock::now();
 
-		vkQueueWaitIdle(queue);
+		const double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+		LOG("Wrote %u image(s) to %s in %.3f s (%.1f frames per second)\n", filesWritten.load(), renderParameters.size() == 1 ? getFilename(0).c_str() : outputDir.c_str(), seconds, seconds > 0.0 ? (double)renderParameters.size() / seconds : 0.0);
+	}
+
+	/*
+		Reads one parameter set per line: position (x y z), rotation in degrees (x y z) and vertical field of view in degrees
+		Empty lines and lines starting with # are ignored
+	*/
+	bool loadParameters(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || (line[0] == '#')) {
+				continue;
+			}
+			std::istringstream stream(line);
+			RenderParameters parameters;
+			if (stream >> parameters.position.x >> parameters.position.y >> parameters.position.z >> parameters.rotation.x >> parameters.rotation.y >> parameters.rotation.z) {
+				if (!(stream >> parameters.fov)) {
+					parameters.fov = 60.0f;
+				}
+				renderParameters.push_back(parameters);
+			}
+		}
+		return true;
 	}
 
 	~VulkanExample()
 	{
+		vkDeviceWaitIdle(device);
+		threadPool.wait();
 		vkDestroyBuffer(device, vertexBuffer, nullptr);
 		vkFreeMemory(device, vertexMemory, nullptr);
 		vkDestroyBuffer(device, indexBuffer, nullptr);
 		vkFreeMemory(device, indexMemory, nullptr);
-		vkDestroyImageView(device, colorAttachment.view, nullptr);
-		vkDestroyImage(device, colorAttachment.image, nullptr);
-		vkFreeMemory(device, colorAttachment.memory, nullptr);
-		vkDestroyImageView(device, depthAttachment.view, nullptr);
-		vkDestroyImage(device, depthAttachment.image, nullptr);
-		vkFreeMemory(device, depthAttachment.memory, nullptr);
+		for (auto& frame : frames) {
+			vkDestroyFramebuffer(device, frame->framebuffer, nullptr);
+			for (auto attachment : { &frame->colorAttachment, &frame->depthAttachment }) {
+				vkDestroyImageView(device, attachment->view, nullptr);
+				vkDestroyImage(device, attachment->image, nullptr);
+				vkFreeMemory(device, attachment->memory, nullptr);
+			}
+			vkDestroyFence(device, frame->fence, nullptr);
+			vkUnmapMemory(device, frame->readbackMemory);
+			vkDestroyBuffer(device, frame->readbackBuffer, nullptr);
+			vkFreeMemory(device, frame->readbackMemory, nullptr);
+		}
 		vkDestroyRenderPass(device, renderPass, nullptr);
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -921,6 +1012,7 @@ public:
 void handleAppCommand(android_app * app, int32_t cmd) {
 	if (cmd == APP_CMD_INIT_WINDOW) {
 		VulkanExample *vulkanExample = new VulkanExample();
+		vulkanExample->renderBatch();
 		delete(vulkanExample);
 		ANativeActivity_finish(app->activity);
 	}
@@ -943,6 +1035,10 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("frames", { "-n", "--frames" }, 1, "Number of frames to render if no parameter file is given");
+	commandLineParser.add("parameters", { "-p", "--parameters" }, 1, "File with one set of camera parameters per line (position xyz, rotation xyz in degrees, optional fov)");
+	commandLineParser.add("inflight", { "--inflight" }, 1, "Number of frames rendered and read back at the same time");
+	commandLineParser.add("output", { "-o", "--output" }, 1, "Directory the rendered images are written to");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
@@ -950,6 +1046,7 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}	
 	VulkanExample *vulkanExample = new VulkanExample();
+	vulkanExample->renderBatch();
 	std::cout << "Finished. Press enter to terminate...";
 	std::cin.get();
 	delete(vulkanExample);
@@ -352,6 +352,7 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
 
 			/*
 				Generate depth map cascades
@@ -360,6 +361,7 @@ public:
 				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
 			*/
 			{
+				vks::GpuProfiler::Scope scope(gpuProfiler, drawCmdBuffers[i], "shadow cascades");
 				VkClearValue clearValues[1];
 				clearValues[0].depthStencil = { 1.0f, 0 };
 
@@ -398,6 +400,7 @@ public:
 			*/
 
 			{
+				vks::GpuProfiler::Scope scope(gpuProfiler, drawCmdBuffers[i], "scene");
 				VkClearValue clearValues[2];
 				clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
@@ -239,8 +239,8 @@ public:
 
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
 
-		// Setup a mirroring sampler for the height map
-		vkDestroySampler(device, textures.heightMap.sampler, nullptr);
+		// Setup a mirroring sampler for the height map, samplers are shared through the device's sampler cache
+		vulkanDevice->samplerCache.release(textures.heightMap.sampler);
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
@@ -251,11 +251,11 @@ public:
 		samplerInfo.minLod = 0.0f;
 		samplerInfo.maxLod = (float)textures.heightMap.mipLevels;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &textures.heightMap.sampler));
+		textures.heightMap.sampler = vulkanDevice->samplerCache.acquire(samplerInfo);
 		textures.heightMap.descriptor.sampler = textures.heightMap.sampler;
 
 		// Setup a repeating sampler for the terrain texture layers
-		vkDestroySampler(device, textures.terrainArray.sampler, nullptr);
+		vulkanDevice->samplerCache.release(textures.terrainArray.sampler);
 		samplerInfo = vks::initializers::samplerCreateInfo();
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
@@ -272,7 +272,7 @@ public:
 			samplerInfo.maxAnisotropy = 4.0f;
 			samplerInfo.anisotropyEnable = VK_TRUE;
 		}
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &textures.terrainArray.sampler));
+		textures.terrainArray.sampler = vulkanDevice->samplerCache.acquire(samplerInfo);
 		textures.terrainArray.descriptor.sampler = textures.terrainArray.sampler;
 	}
 
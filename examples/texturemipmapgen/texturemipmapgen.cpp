@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMipGenerator.h"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -28,6 +29,11 @@ public:
 	std::vector<std::string> samplerNames{ "No mip maps" , "Mip maps (bilinear)" , "Mip maps (anisotropic)" };
 	std::vector<VkSampler> samplers;
 
+	// The mip chain is either blitted on the GPU or generated on the CPU and uploaded with the base level
+	std::vector<std::string> mipGenerationNames{ "GPU blits", "CPU box filter", "CPU Kaiser filter" };
+	int32_t mipGenerationMode = 0;
+	vks::MipGenerator mipGenerator{ &threadPool };
+
 	vkglTF::Model model;
 
 	vks::Buffer uniformBufferVS;
@@ -80,36 +86,14 @@ public:
 
 	void loadTexture(std::string filename, VkFormat format, bool forceLinearTiling)
 	{
-		ktxResult result;
-		ktxTexture* ktxTexture;
-
-#if defined(__ANDROID__)
-		// Textures are stored inside the apk on Android (compressed)
-		// So they need to be loaded via the asset manager
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-
-		ktx_uint8_t *textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
+		// Only the first level is stored in the file, it's mapped and copied straight into the staging buffer
+		vks::KTXFile ktxFile;
+		if (!ktxFile.open(filename)) {
 			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
-		assert(result == KTX_SUCCESS);
 
-		texture.width = ktxTexture->baseWidth;
-		texture.height = ktxTexture->baseHeight;
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetImageSize(ktxTexture, 0);
+		texture.width = ktxFile.texture->baseWidth;
+		texture.height = ktxFile.texture->baseHeight;
 
 		// calculate num of mip maps
 		// numLevels = 1 + floor(log2(max(w, h, d)))
@@ -119,9 +103,34 @@ public:
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-		// Mip-chain generation requires support for blit source and destination
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		// Mip-chain generation with blits requires support for blit source and destination, otherwise the mip chain is generated on the CPU
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		if ((mipGenerationMode == 0) && ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures)) {
+			generateMipChainBlit(ktxFile, format);
+		} else {
+			mipGenerator.settings.filter = (mipGenerationMode == 2) ? vks::MipGenerator::Filter::Kaiser : vks::MipGenerator::Filter::Box;
+			generateMipChainCPU(ktxFile, format);
+		}
+		ktxFile.close();
+		createSamplers();
+
+		// Create image view
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.image = texture.image;
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view.subresourceRange.baseMipLevel = 0;
+		view.subresourceRange.baseArrayLayer = 0;
+		view.subresourceRange.layerCount = 1;
+		view.subresourceRange.levelCount = texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+	}
+
+	// Uploads the first mip level and generates the remaining ones by blitting from the previous level
+	void generateMipChainBlit(const vks::KTXFile& ktxFile, VkFormat format)
+	{
+		const ktx_size_t ktxTextureSize = ktxFile.getImageSize(0);
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
@@ -145,7 +154,7 @@ public:
 		// Copy texture data into staging buffer
 		uint8_t *data;
 		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
+		memcpy(data, ktxFile.getImageData(0), ktxTextureSize);
 		vkUnmapMemory(device, stagingMemory);
 
 		// Create optimal tiled target image
@@ -215,7 +224,6 @@ public:
 		// Clean up staging resources
 		vkFreeMemory(device, stagingMemory, nullptr);
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		ktxTexture_Destroy(ktxTexture);
 
 		// Generate the mip chain
 		// ---------------------------------------------------------------
@@ -301,8 +309,97 @@ public:
 
 		vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
 		// ---------------------------------------------------------------
+	}
+
+	// Generates the mip chain on the CPU and uploads all levels with a single copy, doesn't require blit support and avoids the GPU work
+	void generateMipChainCPU(const vks::KTXFile& ktxFile, VkFormat format)
+	{
+		// The texture stores colors, so these are filtered in linear space
+		std::vector<std::vector<uint8_t>> levels;
+		mipGenerator.generate(ktxFile.getImageData(0), texture.width, texture.height, vks::MipGenerator::Content::SRGB, levels);
+
+		VkDeviceSize stagingSize = 0;
+		for (const std::vector<uint8_t>& level : levels) {
+			stagingSize += level.size();
+		}
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, stagingSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < texture.mipLevels; i++) {
+			memcpy((uint8_t*)stagingBuffer.mapped + offset, levels[i].data(), levels[i].size());
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, texture.width >> i);
+			bufferCopyRegion.imageExtent.height = std::max(1u, texture.height >> i);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			offset += levels[i].size();
+		}
+		stagingBuffer.unmap();
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = texture.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = texture.mipLevels;
+		subresourceRange.layerCount = 1;
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::insertImageMemoryBarrier(
+			copyCmd,
+			texture.image,
+			0,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::insertImageMemoryBarrier(
+			copyCmd,
+			texture.image,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+	}
 
-		// Create samplers
+	void createSamplers()
+	{
+		for (auto sampler : samplers)
+		{
+			vkDestroySampler(device, sampler, nullptr);
+		}
 		samplers.resize(3);
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_LINEAR;
@@ -333,18 +430,6 @@ public:
 			sampler.anisotropyEnable = VK_TRUE;
 		}
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = texture.image;
-		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.format = format;
-		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		view.subresourceRange.baseMipLevel = 0;
-		view.subresourceRange.baseArrayLayer = 0;
-		view.subresourceRange.layerCount = 1;
-		view.subresourceRange.levelCount = texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -460,7 +545,11 @@ public:
 	{
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout,1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		updateDescriptorSet();
+	}
 
+	void updateDescriptorSet()
+	{
 		VkDescriptorImageInfo textureDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 
@@ -543,9 +632,21 @@ public:
 		uniformBufferVS.unmap();
 	}
 
+	// Recreates the texture with the selected mip generation mode
+	void reloadTexture()
+	{
+		vkDeviceWaitIdle(device);
+		destroyTextureImage(texture);
+		loadTexture(getAssetPath() + "textures/metalplate_nomips_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, false);
+		updateDescriptorSet();
+		buildCommandBuffers();
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		// Rows of the mip levels generated on the CPU are filtered in parallel
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -576,6 +677,9 @@ public:
 			if (overlay->comboBox("Sampler type", &uboVS.samplerIndex, samplerNames)) {
 				updateUniformBuffers();
 			}
+			if (overlay->comboBox("Mip generation", &mipGenerationMode, mipGenerationNames)) {
+				reloadTexture();
+			}
 		}
 	}
 };
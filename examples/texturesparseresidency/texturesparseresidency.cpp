@@ -12,6 +12,199 @@
 
 #include "texturesparseresidency.h"
 
+/*
+	Page memory pool
+	Sub-allocates sparse pages from large memory blocks with a free list
+ */
+
+void PageMemoryPool::create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, uint32_t pagesPerBlock)
+{
+	this->device = device;
+	this->memoryTypeIndex = memoryTypeIndex;
+	this->pageSize = pageSize;
+	this->pagesPerBlock = pagesPerBlock;
+}
+
+PageMemoryPool::Allocation PageMemoryPool::allocate()
+{
+	if (freeList.empty())
+	{
+		// Sparse memory binds need offsets aligned to the page size, which is also the size of a page
+		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+		allocInfo.allocationSize = pageSize * pagesPerBlock;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+		VkDeviceMemory memory;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
+		const uint32_t block = static_cast<uint32_t>(blocks.size());
+		blocks.push_back(memory);
+		// Pages are handed out from the start of the block
+		for (uint32_t i = pagesPerBlock; i > 0; i--)
+		{
+			Allocation allocation;
+			allocation.memory = memory;
+			allocation.offset = (i - 1) * pageSize;
+			allocation.block = block;
+			freeList.push_back(allocation);
+		}
+	}
+	Allocation allocation = freeList.back();
+	freeList.pop_back();
+	return allocation;
+}
+
+void PageMemoryPool::free(const Allocation& allocation)
+{
+	if (allocation.memory != VK_NULL_HANDLE)
+	{
+		freeList.push_back(allocation);
+	}
+}
+
+uint32_t PageMemoryPool::getUsedPageCount() const
+{
+	return static_cast<uint32_t>(blocks.size()) * pagesPerBlock - static_cast<uint32_t>(freeList.size());
+}
+
+void PageMemoryPool::destroy()
+{
+	for (auto memory : blocks)
+	{
+		vkFreeMemory(device, memory, nullptr);
+	}
+	blocks.clear();
+	freeList.clear();
+}
+
+/*
+	Tiled texture file
+	Stores all mip levels of a texture as fixed size tiles matching the sparse page size
+ */
+
+bool TiledTextureFile::open(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tileWidth, uint32_t tileHeight)
+{
+	if (file.is_open()) {
+		file.close();
+	}
+	file.open(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+	const bool valid = file.good() && (memcmp(header.magic, "VTEX", 4) == 0) && (header.version == 1) && (header.width == width) && (header.height == height)
+		&& (header.mipLevels == mipLevels) && (header.tileWidth == tileWidth) && (header.tileHeight == tileHeight);
+	if (!valid) {
+		file.close();
+		return false;
+	}
+	levelOffsets.resize(mipLevels);
+	uint64_t offset = sizeof(Header);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		levelOffsets[i] = offset;
+		offset += static_cast<uint64_t>(getTileCountX(i)) * getTileCountY(i) * tileWidth * tileHeight * 4;
+	}
+	// Files that haven't been written completely (e.g. generation was interrupted) are rejected
+	file.seekg(0, std::ios::end);
+	if (!file.good() || (static_cast<uint64_t>(file.tellg()) < offset)) {
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+bool TiledTextureFile::isOpen() const
+{
+	return file.is_open();
+}
+
+uint32_t TiledTextureFile::getTileCountX(uint32_t mipLevel) const
+{
+	const uint32_t width = std::max(header.width >> mipLevel, 1u);
+	return (width + header.tileWidth - 1) / header.tileWidth;
+}
+
+uint32_t TiledTextureFile::getTileCountY(uint32_t mipLevel) const
+{
+	const uint32_t height = std::max(header.height >> mipLevel, 1u);
+	return (height + header.tileHeight - 1) / header.tileHeight;
+}
+
+void TiledTextureFile::readTile(uint32_t mipLevel, uint32_t tileX, uint32_t tileY, uint8_t* data)
+{
+	assert(file.is_open() && (mipLevel < header.mipLevels));
+	const uint64_t tileSize = static_cast<uint64_t>(header.tileWidth) * header.tileHeight * 4;
+	file.seekg(levelOffsets[mipLevel] + (static_cast<uint64_t>(tileY) * getTileCountX(mipLevel) + tileX) * tileSize);
+	file.read(reinterpret_cast<char*>(data), tileSize);
+}
+
+bool TiledTextureFile::generate(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tileWidth, uint32_t tileHeight)
+{
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cout << "Error: Could not write tiled texture file \"" << filename << "\"" << std::endl;
+		return false;
+	}
+	Header header{};
+	memcpy(header.magic, "VTEX", 4);
+	header.version = 1;
+	header.width = width;
+	header.height = height;
+	header.mipLevels = mipLevels;
+	header.tileWidth = tileWidth;
+	header.tileHeight = tileHeight;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	// Every level is generated from the same pattern instead of being downsampled, tinted so the level that's sampled can be told apart
+	const glm::vec3 tints[] = {
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 0.6f, 0.6f), glm::vec3(0.6f, 1.0f, 0.6f), glm::vec3(0.6f, 0.6f, 1.0f),
+		glm::vec3(1.0f, 1.0f, 0.6f), glm::vec3(1.0f, 0.6f, 1.0f), glm::vec3(0.6f, 1.0f, 1.0f)
+	};
+	std::vector<uint8_t> tile(tileWidth * tileHeight * 4);
+	for (uint32_t level = 0; (level < mipLevels) && file.good(); level++) {
+		const uint32_t levelWidth = std::max(width >> level, 1u);
+		const uint32_t levelHeight = std::max(height >> level, 1u);
+		const uint32_t tilesX = (levelWidth + tileWidth - 1) / tileWidth;
+		const uint32_t tilesY = (levelHeight + tileHeight - 1) / tileHeight;
+		const glm::vec3 tint = tints[level % (sizeof(tints) / sizeof(tints[0]))];
+		for (uint32_t tileY = 0; tileY < tilesY; tileY++) {
+			for (uint32_t tileX = 0; tileX < tilesX; tileX++) {
+				std::fill(tile.begin(), tile.end(), 0);
+				for (uint32_t y = 0; y < tileHeight; y++) {
+					for (uint32_t x = 0; x < tileWidth; x++) {
+						const uint32_t px = tileX * tileWidth + x;
+						const uint32_t py = tileY * tileHeight + y;
+						if ((px >= levelWidth) || (py >= levelHeight)) {
+							continue;
+						}
+						const float u = (px + 0.5f) / levelWidth;
+						const float v = (py + 0.5f) / levelHeight;
+						const bool checker = ((static_cast<uint32_t>(u * 32.0f) + static_cast<uint32_t>(v * 32.0f)) % 2) == 0;
+						glm::vec3 color = glm::vec3(u, v, 1.0f - u * 0.5f) * (checker ? 1.0f : 0.7f);
+						// Page borders
+						if ((x == 0) || (y == 0)) {
+							color = glm::vec3(0.1f);
+						}
+						color *= tint;
+						uint8_t* texel = &tile[(y * tileWidth + x) * 4];
+						texel[0] = static_cast<uint8_t>(color.r * 255.0f);
+						texel[1] = static_cast<uint8_t>(color.g * 255.0f);
+						texel[2] = static_cast<uint8_t>(color.b * 255.0f);
+						texel[3] = 255;
+					}
+				}
+				file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+			}
+		}
+	}
+	file.close();
+	if (file.fail()) {
+		// Don't leave a partial file behind (e.g. if the disk is full)
+		std::cout << "Error: Could not write tiled texture file \"" << filename << "\"" << std::endl;
+		std::remove(filename.c_str());
+		return false;
+	}
+	return true;
+}
+
 /*
 	Virtual texture page 
 	Contains all functions and objects for a single page of a virtual texture
@@ -21,6 +214,7 @@ VirtualTexturePage::VirtualTexturePage()
 {
 	// Pages are initially not backed up by memory (non-resident)
 	imageMemoryBind.memory = VK_NULL_HANDLE;
+	lastUsed = 0;
 }
 
 bool VirtualTexturePage::resident()
@@ -28,8 +222,8 @@ bool VirtualTexturePage::resident()
 	return (imageMemoryBind.memory != VK_NULL_HANDLE);
 }
 
-// Allocate Vulkan memory for the virtual page
-bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
+// Take a range of the pool's memory for the virtual page
+bool VirtualTexturePage::allocate(PageMemoryPool& memoryPool)
 {
 	if (imageMemoryBind.memory != VK_NULL_HANDLE)
 	{
@@ -38,10 +232,7 @@ bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
 
 	imageMemoryBind = {};
 
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = size;
-	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemoryBind.memory));
+	allocation = memoryPool.allocate();
 
 	VkImageSubresource subResource{};
 	subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -52,20 +243,19 @@ bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
 	imageMemoryBind.subresource = subResource;
 	imageMemoryBind.extent = extent;
 	imageMemoryBind.offset = offset;
+	imageMemoryBind.memory = allocation.memory;
+	imageMemoryBind.memoryOffset = allocation.offset;
 	return true;
 }
 
-// Release Vulkan memory allocated for this page
-bool VirtualTexturePage::release(VkDevice device)
+// Release the memory range used by this page
+PageMemoryPool::Allocation VirtualTexturePage::release()
 {
-	del= false;
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		vkFreeMemory(device, imageMemoryBind.memory, nullptr);
-		imageMemoryBind.memory = VK_NULL_HANDLE;
-		return true;
-	}
-	return false;
+	PageMemoryPool::Allocation released = allocation;
+	allocation = {};
+	imageMemoryBind.memory = VK_NULL_HANDLE;
+	imageMemoryBind.memoryOffset = 0;
+	return released;
 }
 
 /*
@@ -85,30 +275,57 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 	newPage.imageMemoryBind = {};
 	newPage.imageMemoryBind.offset = offset;
 	newPage.imageMemoryBind.extent = extent;
-	newPage.del = false;
 	pages.push_back(newPage);
 	return &pages.back();
 }
 
-// Call before sparse binding to update memory bind list etc.
-void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del)
+VirtualTexturePage* VirtualTexture::getPage(uint32_t mipLevel, uint32_t pageX, uint32_t pageY)
 {
-	// Update list of memory-backed sparse image memory binds
-	//sparseImageMemoryBinds.resize(pages.size());
-	sparseImageMemoryBinds.clear();
-	for (auto page : bindingChangedPages)
+	if (mipLevel >= mipPageLayouts.size())
 	{
-		sparseImageMemoryBinds.push_back(page.imageMemoryBind);
-		if (del)
-		{
-			sparseImageMemoryBinds[sparseImageMemoryBinds.size() - 1].memory = VK_NULL_HANDLE;
-		}
+		return nullptr;
+	}
+	const MipPageLayout& layout = mipPageLayouts[mipLevel];
+	if ((pageX >= layout.pagesX) || (pageY >= layout.pagesY))
+	{
+		return nullptr;
+	}
+	return &pages[layout.firstPage + pageY * layout.pagesX + pageX];
+}
+
+bool VirtualTexture::bindPage(VirtualTexturePage& page)
+{
+	if (!page.allocate(memoryPool))
+	{
+		return false;
+	}
+	sparseImageMemoryBinds.push_back(page.imageMemoryBind);
+	pendingUploads.push_back(page.index);
+	return true;
+}
+
+bool VirtualTexture::unbindPage(VirtualTexturePage& page)
+{
+	if (!page.resident())
+	{
+		return false;
 	}
+	// Binding without memory removes the backing
+	VkSparseImageMemoryBind imageMemoryBind = page.imageMemoryBind;
+	imageMemoryBind.memory = VK_NULL_HANDLE;
+	imageMemoryBind.memoryOffset = 0;
+	sparseImageMemoryBinds.push_back(imageMemoryBind);
+	pendingFrees.push_back(page.release());
+	// A page bound and unbound again before the next sparse bind doesn't need its content
+	pendingUploads.erase(std::remove(pendingUploads.begin(), pendingUploads.end(), page.index), pendingUploads.end());
+	return true;
+}
+
+// Call before sparse binding to update memory bind list etc.
+void VirtualTexture::updateSparseBindInfo(bool bindMipTail)
+{
 	// Update sparse bind info
 	bindSparseInfo = vks::initializers::bindSparseInfo();
-	// todo: Semaphore for queue submission
-	// bindSparseInfo.signalSemaphoreCount = 1;
-	// bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
 
 	// Image memory binds
 	imageMemoryBindInfo = {};
@@ -120,7 +337,7 @@ void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindi
 
 	// Opaque image memory binds for the mip tail
 	opaqueMemoryBindInfo.image = image;
-	opaqueMemoryBindInfo.bindCount = static_cast<uint32_t>(opaqueMemoryBinds.size());
+	opaqueMemoryBindInfo.bindCount = bindMipTail ? static_cast<uint32_t>(opaqueMemoryBinds.size()) : 0;
 	opaqueMemoryBindInfo.pBinds = opaqueMemoryBinds.data();
 	bindSparseInfo.imageOpaqueBindCount = (opaqueMemoryBindInfo.bindCount > 0) ? 1 : 0;
 	bindSparseInfo.pImageOpaqueBinds = &opaqueMemoryBindInfo;
@@ -129,10 +346,8 @@ void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindi
 // Release all Vulkan resources
 void VirtualTexture::destroy()
 {
-	for (auto page : pages)
-	{
-		page.release(device);
-	}
+	// Page memory is owned by the pool
+	memoryPool.destroy();
 	for (auto bind : opaqueMemoryBinds)
 	{
 		vkFreeMemory(device, bind.memory, nullptr);
@@ -162,6 +377,9 @@ VulkanExample::~VulkanExample()
 	// Note : Inherited destructor cleans up resources stored in base class
 	destroyTextureImage(texture);
 	vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
+	destroyFeedbackTarget();
+	vkDestroyRenderPass(device, feedbackPass.renderPass, nullptr);
+	vkDestroyPipeline(device, feedbackPass.pipeline, nullptr);
 	vkDestroyPipeline(device, pipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -315,6 +533,8 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	// Calculate number of required sparse memory bindings by alignment
 	assert((sparseImageMemoryReqs.size % sparseImageMemoryReqs.alignment) == 0);
 	texture.memoryTypeIndex = vulkanDevice->getMemoryType(sparseImageMemoryReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// Pages are sub-allocated from blocks of 256 pages (16 MB with the common page size of 64 KB)
+	texture.memoryPool.create(device, texture.memoryTypeIndex, sparseImageMemoryReqs.alignment, 256);
 
 	// Get sparse bindings
 	uint32_t sparseBindsCount = static_cast<uint32_t>(sparseImageMemoryReqs.size / sparseImageMemoryReqs.alignment);
@@ -352,6 +572,15 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 			lastBlockExtent.y = (extent.height % imageGranularity.height) ? extent.height % imageGranularity.height : imageGranularity.height;
 			lastBlockExtent.z = (extent.depth % imageGranularity.depth) ? extent.depth % imageGranularity.depth : imageGranularity.depth;
 
+			if (layer == 0)
+			{
+				VirtualTexture::MipPageLayout layout;
+				layout.firstPage = static_cast<uint32_t>(texture.pages.size());
+				layout.pagesX = sparseBindCounts.x;
+				layout.pagesY = sparseBindCounts.y;
+				texture.mipPageLayouts.push_back(layout);
+			}
+
 			// @todo: Comment
 			uint32_t index = 0;
 			for (uint32_t z = 0; z < sparseBindCounts.z; z++)
@@ -432,8 +661,8 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &bindSparseSemaphore));
 
-	// Prepare bind sparse info for reuse in queue submission
-	texture.updateSparseBindInfo(texture.pages);
+	// Bind the mip tail, pages are bound as they are filled
+	texture.updateSparseBindInfo(true);
 
 	// Bind to queue
 	// todo: in draw?
@@ -494,6 +723,19 @@ void VulkanExample::buildCommandBuffers()
 	clearValues[0].color = defaultClearColor;
 	clearValues[1].depthStencil = { 1.0f, 0 };
 
+	// The feedback target is cleared to "no request"
+	VkClearValue feedbackClearValues[2];
+	feedbackClearValues[0].color.uint32[0] = ~0u;
+	feedbackClearValues[1].depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo feedbackPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	feedbackPassBeginInfo.renderPass = feedbackPass.renderPass;
+	feedbackPassBeginInfo.framebuffer = feedbackPass.frameBuffer;
+	feedbackPassBeginInfo.renderArea.extent.width = feedbackPass.width;
+	feedbackPassBeginInfo.renderArea.extent.height = feedbackPass.height;
+	feedbackPassBeginInfo.clearValueCount = 2;
+	feedbackPassBeginInfo.pClearValues = feedbackClearValues;
+
 	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 	renderPassBeginInfo.renderPass = renderPass;
 	renderPassBeginInfo.renderArea.offset.x = 0;
@@ -509,6 +751,45 @@ void VulkanExample::buildCommandBuffers()
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+		/*
+			Feedback pass: Render the scene at a lower resolution, writing the page each pixel samples from, and copy it to the host
+		*/
+		{
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &feedbackPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)feedbackPass.width, (float)feedbackPass.height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(feedbackPass.width, feedbackPass.height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, feedbackPass.pipeline);
+			plane.draw(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+			// The render pass transitions the target to transfer source
+			VkBufferImageCopy copyRegion{};
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageExtent = { feedbackPass.width, feedbackPass.height, 1 };
+			vkCmdCopyImageToBuffer(drawCmdBuffers[i], feedbackPass.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, feedbackPass.readbackBuffer.buffer, 1, &copyRegion);
+
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = feedbackPass.readbackBuffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		}
+
+		/*
+			Scene rendering
+		*/
+
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -532,6 +813,9 @@ void VulkanExample::buildCommandBuffers()
 void VulkanExample::draw()
 {
 	VulkanExampleBase::prepareFrame();
+	if (!texture.sparseImageMemoryBinds.empty() || !texture.pendingUploads.empty()) {
+		flushPageUpdates();
+	}
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -566,10 +850,10 @@ void VulkanExample::setupDescriptorSetLayout()
 {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
 	{
-		// Binding 0 : Vertex shader uniform buffer
+		// Binding 0 : Vertex shader uniform buffer, also read by the feedback fragment shader
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			VK_SHADER_STAGE_VERTEX_BIT,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0),
 		// Binding 1 : Fragment shader image sampler
 		vks::initializers::descriptorSetLayoutBinding(
@@ -650,6 +934,11 @@ void VulkanExample::preparePipelines()
 	shaderStages[0] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+
+	// Feedback pass writing the requested pages to an integer target
+	pipelineCI.renderPass = feedbackPass.renderPass;
+	shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/feedback.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &feedbackPass.pipeline));
 }
 
 // Prepare and initialize uniform buffer containing shader uniforms
@@ -688,6 +977,14 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
 	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	prepareTiledTexture();
+	loadMipTail();
+	// Feedback is rendered at a lower resolution, which selects coarser mip levels than the scene
+	uboVS.feedbackLodBias = -log2((float)FeedbackPass::downscale);
+	uboVS.pageExtent = glm::uvec2(texture.sparseImageMemoryRequirements.formatProperties.imageGranularity.width, texture.sparseImageMemoryRequirements.formatProperties.imageGranularity.height);
+	uboVS.mipTailStart = texture.mipTailStart;
+	updateUniformBuffers();
+	prepareFeedbackTarget();
 	setupDescriptorSetLayout();
 	preparePipelines();
 	setupDescriptorPool();
@@ -701,6 +998,10 @@ void VulkanExample::render()
 	if (!prepared)
 		return;
 	draw();
+	// The queue is idle after the frame has been submitted, so the feedback of this frame can be read
+	if (streaming.enabled) {
+		processFeedback(static_cast<const uint32_t*>(feedbackPass.readbackBuffer.mapped), feedbackPass.width * feedbackPass.height);
+	}
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
@@ -711,6 +1012,322 @@ void VulkanExample::viewChanged()
 	updateUniformBuffers();
 }
 
+void VulkanExample::windowResized()
+{
+	// The feedback target depends on the framebuffer size
+	destroyFeedbackTarget();
+	prepareFeedbackTarget();
+	buildCommandBuffers();
+}
+
+void VulkanExample::prepareFeedbackTarget()
+{
+	feedbackPass.width = std::max(width / FeedbackPass::downscale, 1u);
+	feedbackPass.height = std::max(height / FeedbackPass::downscale, 1u);
+
+	const VkFormat colorFormat = VK_FORMAT_R32_UINT;
+
+	// Render pass is independent of the size and only created once
+	if (feedbackPass.renderPass == VK_NULL_HANDLE) {
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		// Color attachment is copied to the host after the pass
+		attachments[0].format = colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		// Depth attachment
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		// Use subpass dependencies for layout transitions
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		// The copy of the previous frame has to finish before the target is written again
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		// The copy to the readback buffer reads the written target
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &feedbackPass.renderPass));
+	}
+
+	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+
+	// Color attachment
+	VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = colorFormat;
+	image.extent = { feedbackPass.width, feedbackPass.height, 1 };
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &feedbackPass.color.image));
+	vkGetImageMemoryRequirements(device, feedbackPass.color.image, &memReqs);
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &feedbackPass.color.memory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, feedbackPass.color.image, feedbackPass.color.memory, 0));
+
+	VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
+	colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	colorImageView.format = colorFormat;
+	colorImageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	colorImageView.image = feedbackPass.color.image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &feedbackPass.color.view));
+
+	// Depth attachment
+	image.format = depthFormat;
+	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &feedbackPass.depth.image));
+	vkGetImageMemoryRequirements(device, feedbackPass.depth.image, &memReqs);
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &feedbackPass.depth.memory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, feedbackPass.depth.image, feedbackPass.depth.memory, 0));
+
+	VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
+	depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	depthStencilView.format = depthFormat;
+	depthStencilView.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+		depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+	depthStencilView.image = feedbackPass.depth.image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &feedbackPass.depth.view));
+
+	VkImageView attachments[2] = { feedbackPass.color.view, feedbackPass.depth.view };
+	VkFramebufferCreateInfo frameBufferCI = vks::initializers::framebufferCreateInfo();
+	frameBufferCI.renderPass = feedbackPass.renderPass;
+	frameBufferCI.attachmentCount = 2;
+	frameBufferCI.pAttachments = attachments;
+	frameBufferCI.width = feedbackPass.width;
+	frameBufferCI.height = feedbackPass.height;
+	frameBufferCI.layers = 1;
+	VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCI, nullptr, &feedbackPass.frameBuffer));
+
+	// Host visible buffer the feedback target is copied to, stays mapped
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&feedbackPass.readbackBuffer,
+		feedbackPass.width * feedbackPass.height * sizeof(uint32_t)));
+	VK_CHECK_RESULT(feedbackPass.readbackBuffer.map());
+	// Nothing has been requested before the first frame
+	memset(feedbackPass.readbackBuffer.mapped, 0xff, feedbackPass.width * feedbackPass.height * sizeof(uint32_t));
+}
+
+void VulkanExample::destroyFeedbackTarget()
+{
+	vkDestroyFramebuffer(device, feedbackPass.frameBuffer, nullptr);
+	vkDestroyImageView(device, feedbackPass.color.view, nullptr);
+	vkDestroyImage(device, feedbackPass.color.image, nullptr);
+	vkFreeMemory(device, feedbackPass.color.memory, nullptr);
+	vkDestroyImageView(device, feedbackPass.depth.view, nullptr);
+	vkDestroyImage(device, feedbackPass.depth.image, nullptr);
+	vkFreeMemory(device, feedbackPass.depth.memory, nullptr);
+	feedbackPass.readbackBuffer.destroy();
+}
+
+// Turns the page requests read back from the feedback pass into page loads and evictions
+void VulkanExample::processFeedback(const uint32_t* requests, uint32_t count)
+{
+	// Reduce the requests to unique pages
+	std::vector<uint32_t> pageRequests(requests, requests + count);
+	std::sort(pageRequests.begin(), pageRequests.end());
+	pageRequests.erase(std::unique(pageRequests.begin(), pageRequests.end()), pageRequests.end());
+	// Cleared pixels and levels in the mip tail
+	if (!pageRequests.empty() && (pageRequests.back() == ~0u)) {
+		pageRequests.pop_back();
+	}
+	// Pixels the shader found non-resident set the upper bit, the residency on the CPU side is used for scheduling as it includes pages bound since the feedback was written
+	streaming.missingPages = static_cast<uint32_t>(std::count_if(pageRequests.begin(), pageRequests.end(), [](uint32_t request) { return (request & 0x80000000) != 0; }));
+	for (auto& request : pageRequests) {
+		request &= 0x7fffffff;
+	}
+	std::sort(pageRequests.begin(), pageRequests.end());
+	pageRequests.erase(std::unique(pageRequests.begin(), pageRequests.end()), pageRequests.end());
+	streaming.requestedPages = static_cast<uint32_t>(pageRequests.size());
+
+	streaming.frameIndex++;
+	std::vector<VirtualTexturePage*> loads;
+	for (auto request : pageRequests) {
+		const uint32_t mipLevel = (request >> 24) & 0x7f;
+		const uint32_t pageX = request & 0xfff;
+		const uint32_t pageY = (request >> 12) & 0xfff;
+		VirtualTexturePage* page = texture.getPage(mipLevel, pageX, pageY);
+		if (!page) {
+			continue;
+		}
+		// The coarser pages covering the requested page are what the shader falls back to until it has been loaded
+		for (uint32_t level = mipLevel; level < texture.mipTailStart; level++) {
+			VirtualTexturePage* coverPage = texture.getPage(level, pageX >> (level - mipLevel), pageY >> (level - mipLevel));
+			if (!coverPage || (coverPage->lastUsed == streaming.frameIndex)) {
+				break;
+			}
+			coverPage->lastUsed = streaming.frameIndex;
+			if (!coverPage->resident()) {
+				loads.push_back(coverPage);
+			}
+		}
+	}
+
+	// Coarse pages first, so everything visible gets some content as soon as possible
+	std::sort(loads.begin(), loads.end(), [](const VirtualTexturePage* a, const VirtualTexturePage* b) {
+		return (a->mipLevel != b->mipLevel) ? (a->mipLevel > b->mipLevel) : (a->index < b->index);
+	});
+	if (loads.size() > static_cast<size_t>(streaming.pagesPerFrame)) {
+		loads.resize(streaming.pagesPerFrame);
+	}
+
+	// Evict the least recently used pages not needed in this frame if the loads exceed the limit, finer pages first if used at the same time
+	uint32_t residentPages = 0;
+	std::vector<VirtualTexturePage*> evictable;
+	for (auto& page : texture.pages) {
+		if (page.resident()) {
+			residentPages++;
+			if (page.lastUsed != streaming.frameIndex) {
+				evictable.push_back(&page);
+			}
+		}
+	}
+	if (residentPages + loads.size() > streaming.maxResidentPages) {
+		std::sort(evictable.begin(), evictable.end(), [](const VirtualTexturePage* a, const VirtualTexturePage* b) {
+			return (a->lastUsed != b->lastUsed) ? (a->lastUsed < b->lastUsed) : (a->mipLevel < b->mipLevel);
+		});
+		for (auto page : evictable) {
+			if (residentPages + loads.size() <= streaming.maxResidentPages) {
+				break;
+			}
+			texture.unbindPage(*page);
+			residentPages--;
+		}
+		// Pages visible in this frame are never evicted, so not everything may fit
+		const uint32_t freePages = (streaming.maxResidentPages > residentPages) ? streaming.maxResidentPages - residentPages : 0;
+		if (loads.size() > freePages) {
+			loads.resize(freePages);
+		}
+	}
+
+	// Binding changes and uploads are applied with the next frame
+	for (auto page : loads) {
+		texture.bindPage(*page);
+	}
+	streaming.loadedPages = static_cast<uint32_t>(loads.size());
+}
+
+// Opens the tiled file the pages are streamed from, it's generated if missing
+void VulkanExample::prepareTiledTexture()
+{
+	const std::string filename = "texturesparseresidency.vtex";
+	const VkExtent3D tileExtent = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	if (!tiledTexture.open(filename, texture.width, texture.height, texture.mipLevels, tileExtent.width, tileExtent.height)) {
+		std::cout << "Generating tiled texture file \"" << filename << "\"" << std::endl;
+		if (!TiledTextureFile::generate(filename, texture.width, texture.height, texture.mipLevels, tileExtent.width, tileExtent.height) || !tiledTexture.open(filename, texture.width, texture.height, texture.mipLevels, tileExtent.width, tileExtent.height)) {
+			std::cout << "Error: Could not open tiled texture file, pages are filled with random colors" << std::endl;
+		}
+	}
+}
+
+// Uploads the levels of the (always resident) mip tail from the tiled file
+void VulkanExample::loadMipTail()
+{
+	if (!tiledTexture.isOpen()) {
+		fillMipTail();
+		return;
+	}
+	if (texture.mipTailStart >= texture.mipLevels) {
+		return;
+	}
+
+	const uint32_t tileWidth = tiledTexture.header.tileWidth;
+	const uint32_t tileHeight = tiledTexture.header.tileHeight;
+	const VkDeviceSize tileSize = tileWidth * tileHeight * 4;
+	VkDeviceSize bufferSize = 0;
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		bufferSize += tiledTexture.getTileCountX(i) * tiledTexture.getTileCountY(i) * tileSize;
+	}
+
+	vks::Buffer imageBuffer;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&imageBuffer,
+		bufferSize));
+	imageBuffer.map();
+
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize offset = 0;
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		const uint32_t width = std::max(texture.width >> i, 1u);
+		const uint32_t height = std::max(texture.height >> i, 1u);
+		for (uint32_t y = 0; y < tiledTexture.getTileCountY(i); y++) {
+			for (uint32_t x = 0; x < tiledTexture.getTileCountX(i); x++) {
+				tiledTexture.readTile(i, x, y, (uint8_t*)imageBuffer.mapped + offset);
+				VkBufferImageCopy region{};
+				region.bufferOffset = offset;
+				region.bufferRowLength = tileWidth;
+				region.bufferImageHeight = tileHeight;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.layerCount = 1;
+				region.imageSubresource.mipLevel = i;
+				region.imageOffset = { static_cast<int32_t>(x * tileWidth), static_cast<int32_t>(y * tileHeight), 0 };
+				region.imageExtent = { std::min(tileWidth, width - x * tileWidth), std::min(tileHeight, height - y * tileHeight), 1 };
+				regions.push_back(region);
+				offset += tileSize;
+			}
+		}
+	}
+
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+
+	imageBuffer.destroy();
+}
+
 // Fills a buffer with random colors
 void VulkanExample::randomPattern(uint8_t* buffer, uint32_t width, uint32_t height)
 {
@@ -733,10 +1350,15 @@ void VulkanExample::randomPattern(uint8_t* buffer, uint32_t width, uint32_t heig
 	}
 }
 
-void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
+void VulkanExample::uploadContent(const std::vector<uint32_t>& pageIndices, VkImage image)
 {
-	// Generate some random image data and upload as a buffer
-	const size_t bufferSize = 4 * page.extent.width * page.extent.height;
+	// Read the pages from the tiled file (or generate some random image data if there is none) and upload them with a single buffer
+	// Tiles are padded to the page size, so pages at the border of a level are copied with the tile's row length
+	const bool fromFile = tiledTexture.isOpen();
+	VkDeviceSize bufferSize = 0;
+	for (auto index : pageIndices) {
+		bufferSize += fromFile ? 4 * tiledTexture.header.tileWidth * tiledTexture.header.tileHeight : 4 * texture.pages[index].extent.width * texture.pages[index].extent.height;
+	}
 
 	vks::Buffer imageBuffer;
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -746,55 +1368,94 @@ void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
 		bufferSize));
 	imageBuffer.map();
 
-	uint8_t* data = (uint8_t*)imageBuffer.mapped;
-	randomPattern(data, page.extent.height, page.extent.width);
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize offset = 0;
+	for (auto index : pageIndices) {
+		const VirtualTexturePage& page = texture.pages[index];
+		VkBufferImageCopy region{};
+		if (fromFile) {
+			tiledTexture.readTile(page.mipLevel, page.offset.x / tiledTexture.header.tileWidth, page.offset.y / tiledTexture.header.tileHeight, (uint8_t*)imageBuffer.mapped + offset);
+			region.bufferRowLength = tiledTexture.header.tileWidth;
+			region.bufferImageHeight = tiledTexture.header.tileHeight;
+		}
+		else {
+			randomPattern((uint8_t*)imageBuffer.mapped + offset, page.extent.width, page.extent.height);
+		}
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageSubresource.mipLevel = page.mipLevel;
+		region.imageOffset = page.offset;
+		region.imageExtent = page.extent;
+		regions.push_back(region);
+		offset += fromFile ? 4 * tiledTexture.header.tileWidth * tiledTexture.header.tileHeight : 4 * page.extent.width * page.extent.height;
+	}
 
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-	VkBufferImageCopy region{};
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = page.mipLevel;
-	region.imageOffset = page.offset;
-	region.imageExtent = page.extent;
-	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+	VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+
+	// The copies must not start before the pages have been bound
+	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo copySubmitInfo = vks::initializers::submitInfo();
+	copySubmitInfo.commandBufferCount = 1;
+	copySubmitInfo.pCommandBuffers = &copyCmd;
+	copySubmitInfo.waitSemaphoreCount = 1;
+	copySubmitInfo.pWaitSemaphores = &bindSparseSemaphore;
+	copySubmitInfo.pWaitDstStageMask = &waitStageMask;
+	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+	VkFence fence;
+	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &copySubmitInfo, fence));
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+	vkDestroyFence(device, fence, nullptr);
+	vkFreeCommandBuffers(device, vulkanDevice->commandPool, 1, &copyCmd);
 
 	imageBuffer.destroy();
 }
 
-void VulkanExample::fillRandomPages()
+// Applies all page binding changes made since the last frame with a single sparse bind and uploads the content of the newly bound pages
+void VulkanExample::flushPageUpdates()
 {
-	vkDeviceWaitIdle(device);
+	// Pages unbound now may still be sampled by frames in flight
+	vkQueueWaitIdle(queue);
+	// Memory of pages unbound by the last sparse bind is no longer in use and can be handed out again
+	for (auto& allocation : texture.retiredAllocations) {
+		texture.memoryPool.free(allocation);
+	}
+	texture.retiredAllocations.swap(texture.pendingFrees);
+	texture.pendingFrees.clear();
+
+	texture.updateSparseBindInfo();
+	// Uploads wait for the bind, pages that are only unbound read as zero whether the bind has finished or not
+	const bool uploadsPending = !texture.pendingUploads.empty();
+	texture.bindSparseInfo.signalSemaphoreCount = uploadsPending ? 1 : 0;
+	texture.bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+	texture.sparseImageMemoryBinds.clear();
+
+	if (uploadsPending) {
+		uploadContent(texture.pendingUploads, texture.image);
+		texture.pendingUploads.clear();
+	}
+}
 
+void VulkanExample::fillRandomPages()
+{
 	std::default_random_engine rndEngine(std::random_device{}());
 	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
 
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
+	// Binding changes are applied with the next frame
 	for (auto& page : texture.pages) {
 		if (rndDist(rndEngine) < 0.5f) {
 			continue;
 		}
-		if (page.allocate(device, texture.memoryTypeIndex))
-		{
-			bindingChangedPages.push_back(page);
+		if (!texture.bindPage(page)) {
+			// Already resident pages get new content
+			texture.pendingUploads.push_back(page.index);
 		}
-		updatedPages.push_back(page);
-	}
-
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-
-	for (auto &page: updatedPages) {
-		uploadContent(page, texture.image);
 	}
 }
 
@@ -862,38 +1523,16 @@ void VulkanExample::fillMipTail()
 
 void VulkanExample::flushRandomPages()
 {
-	vkDeviceWaitIdle(device);
-
 	std::default_random_engine rndEngine(std::random_device{}());
 	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
 
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
+	// Binding changes are applied with the next frame, the memory of the pages is returned to the pool after that
 	for (auto& page : texture.pages)
 	{
 		if (rndDist(rndEngine) < 0.5f) {
 			continue;
 		}
-		if (page.imageMemoryBind.memory != VK_NULL_HANDLE){
-			page.del = true;
-			bindingChangedPages.push_back(page);
-		}
-	}
-
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages, true);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-	for (auto& page : texture.pages)
-	{
-		if (page.del)
-		{
-			page.release(device);
-		}
+		texture.unbindPage(page);
 	}
 }
 
@@ -903,14 +1542,20 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		if (overlay->sliderFloat("LOD bias", &uboVS.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
+		overlay->checkBox("Feedback streaming", &streaming.enabled);
+		if (streaming.enabled) {
+			overlay->sliderInt("Pages per frame", &streaming.pagesPerFrame, 1, 256);
 		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
-		}
-		if (overlay->button("Fill mip tail")) {
-			fillMipTail();
+		else {
+			if (overlay->button("Fill random pages")) {
+				fillRandomPages();
+			}
+			if (overlay->button("Flush random pages")) {
+				flushRandomPages();
+			}
+			if (overlay->button("Fill mip tail")) {
+				fillMipTail();
+			}
 		}
 	}
 	if (overlay->header("Statistics")) {
@@ -918,6 +1563,11 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
 		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
+		overlay->text("Memory blocks: %d (%d pages in use)", static_cast<uint32_t>(texture.memoryPool.blocks.size()), texture.memoryPool.getUsedPageCount());
+		if (streaming.enabled) {
+			overlay->text("Requested pages: %d (%d missing)", streaming.requestedPages, streaming.missingPages);
+			overlay->text("Loaded pages: %d", streaming.loadedPages);
+		}
 	}
 
 }
@@ -15,6 +15,59 @@
 
 #define ENABLE_VALIDATION false
 
+// Texture stored as fixed size tiles for all mip levels, so single pages can be read without decoding the whole image
+// Layout: header, followed by the tiles of all mip levels (largest first) in row major order, tiles at the right and bottom border are padded
+struct TiledTextureFile
+{
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t tileWidth;
+		uint32_t tileHeight;
+	} header{};
+
+	std::ifstream file;
+	std::vector<uint64_t> levelOffsets;									// File offset of the first tile of each mip level
+
+	// Opens a file, fails if it doesn't exist or doesn't match the requested dimensions
+	bool open(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tileWidth, uint32_t tileHeight);
+	bool isOpen() const;
+	uint32_t getTileCountX(uint32_t mipLevel) const;
+	uint32_t getTileCountY(uint32_t mipLevel) const;
+	// Reads a single tile with RGBA8 texels and a row length of tileWidth
+	void readTile(uint32_t mipLevel, uint32_t tileX, uint32_t tileY, uint8_t* data);
+	// Writes a procedural texture (gradient with a checker pattern, tile borders and a tint per mip level) to disk, returns false if the file couldn't be written completely
+	static bool generate(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tileWidth, uint32_t tileHeight);
+};
+
+// Pool of page sized memory ranges carved out of large device memory blocks
+// Pages are bound at an offset into a block instead of allocating memory for each of them, so page churn doesn't cause allocations
+struct PageMemoryPool
+{
+	struct Allocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		uint32_t block = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t memoryTypeIndex = 0;
+	VkDeviceSize pageSize = 0;											// Size (and alignment) of a sparse page
+	uint32_t pagesPerBlock = 0;
+	std::vector<VkDeviceMemory> blocks;
+	std::vector<Allocation> freeList;									// Unused pages of all blocks
+
+	void create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, uint32_t pagesPerBlock);
+	// Takes a page from the free list, a new block is allocated if all pages are in use
+	Allocation allocate();
+	void free(const Allocation& allocation);
+	uint32_t getUsedPageCount() const;
+	void destroy();
+};
+
 // Virtual texture page as a part of the partially resident texture
 // Contains memory bindings, offsets and status information
 struct VirtualTexturePage
@@ -22,16 +75,18 @@ struct VirtualTexturePage
 	VkOffset3D offset;
 	VkExtent3D extent;
 	VkSparseImageMemoryBind imageMemoryBind;							// Sparse image memory bind for this page
+	PageMemoryPool::Allocation allocation;								// Range of the pool's memory backing this page
 	VkDeviceSize size;													// Page (memory) size in bytes
 	uint32_t mipLevel;													// Mip level that this page belongs to
 	uint32_t layer;														// Array layer that this page belongs to
 	uint32_t index;
-    bool del;
+	uint32_t lastUsed;													// Last feedback frame that requested this page (or one of its finer pages)
 
 	VirtualTexturePage();
 	bool resident();
-	bool allocate(VkDevice device, uint32_t memoryTypeIndex);
-	bool release(VkDevice device);
+	bool allocate(PageMemoryPool& memoryPool);
+	// Returns the page's memory range, which must not be handed out again until the page has been unbound
+	PageMemoryPool::Allocation release();
 };
 
 // Virtual texture object containing all pages
@@ -41,7 +96,11 @@ struct VirtualTexture
 	VkImage image;														// Texture image handle
 	VkBindSparseInfo bindSparseInfo;									// Sparse queue binding information
 	std::vector<VirtualTexturePage> pages;								// Contains all virtual pages of the texture
-	std::vector<VkSparseImageMemoryBind> sparseImageMemoryBinds;		// Sparse image memory bindings of all memory-backed virtual tables
+	PageMemoryPool memoryPool;											// Memory backing the resident pages
+	std::vector<VkSparseImageMemoryBind> sparseImageMemoryBinds;		// Binding changes of pages since the last sparse bind, bound in one batch per frame
+	std::vector<uint32_t> pendingUploads;								// Pages bound since the last sparse bind whose content has to be uploaded
+	std::vector<PageMemoryPool::Allocation> pendingFrees;				// Memory of pages unbound by the next sparse bind
+	std::vector<PageMemoryPool::Allocation> retiredAllocations;			// Memory of pages unbound by the last sparse bind, returned to the pool once the queue is idle
 	std::vector<VkSparseMemoryBind>	opaqueMemoryBinds;					// Sparse opaque memory bindings for the mip tail (if present)
 	VkSparseImageMemoryBindInfo imageMemoryBindInfo;					// Sparse image memory bind info
 	VkSparseImageOpaqueMemoryBindInfo opaqueMemoryBindInfo;				// Sparse image opaque memory bind info (mip tail)
@@ -51,6 +110,14 @@ struct VirtualTexture
 
 	VkSparseImageMemoryBind mipTailimageMemoryBind{};
 
+	// Location of the pages of a mip level in the page list
+	struct MipPageLayout {
+		uint32_t firstPage;
+		uint32_t pagesX;
+		uint32_t pagesY;
+	};
+	std::vector<MipPageLayout> mipPageLayouts;							// Page layout of all mip levels outside of the mip tail (first layer)
+
 	// @todo: comment
 	struct MipTailInfo {
 		bool singleMipTail;
@@ -58,7 +125,14 @@ struct VirtualTexture
 	} mipTailInfo;
 
 	VirtualTexturePage *addPage(VkOffset3D offset, VkExtent3D extent, const VkDeviceSize size, const uint32_t mipLevel, uint32_t layer);
-	void updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del = false);
+	// Returns the page of the first layer at the given page coordinates of a mip level, or null if the level is part of the mip tail
+	VirtualTexturePage* getPage(uint32_t mipLevel, uint32_t pageX, uint32_t pageY);
+	// Backs a page with memory from the pool, the binding is queued for the next sparse bind
+	bool bindPage(VirtualTexturePage& page);
+	// Removes the memory backing of a page, the binding is queued for the next sparse bind
+	bool unbindPage(VirtualTexturePage& page);
+	// Prepares the bind info for the queued binding changes (and the mip tail if requested)
+	void updateSparseBindInfo(bool bindMipTail = false);
 	// @todo: replace with dtor?
 	void destroy();
 };
@@ -86,6 +160,9 @@ public:
 		glm::mat4 model;
 		glm::vec4 viewPos;
 		float lodBias = 0.0f;
+		float feedbackLodBias = 0.0f;
+		glm::uvec2 pageExtent;
+		uint32_t mipTailStart;
 	} uboVS;
 	vks::Buffer uniformBufferVS;
 
@@ -97,6 +174,36 @@ public:
 	//todo: comment
 	VkSemaphore bindSparseSemaphore = VK_NULL_HANDLE;
 
+	// Low resolution pass writing the mip level and page each pixel samples from, read back to decide which pages to stream in
+	struct FeedbackPass {
+		// Feedback target is this many times smaller than the framebuffer in each dimension
+		static const uint32_t downscale = 8;
+		uint32_t width, height;
+		struct FrameBufferAttachment {
+			VkImage image;
+			VkDeviceMemory memory;
+			VkImageView view;
+		} color, depth;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Host visible copy of the feedback target, the queue is idle after each frame so a single buffer is enough
+		vks::Buffer readbackBuffer;
+	} feedbackPass;
+
+	// Streams pages from the tiled texture file based on the feedback
+	struct Streaming {
+		bool enabled = true;
+		int32_t pagesPerFrame = 32;
+		// Pages are evicted least recently used first once this limit is reached
+		uint32_t maxResidentPages = 512;
+		uint32_t frameIndex = 0;
+		uint32_t requestedPages = 0;
+		uint32_t missingPages = 0;
+		uint32_t loadedPages = 0;
+	} streaming;
+	TiledTextureFile tiledTexture;
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
@@ -117,7 +224,14 @@ public:
 	void prepare();
 	virtual void render();
 	virtual void viewChanged();
-	void uploadContent(VirtualTexturePage page, VkImage image);
+	virtual void windowResized();
+	void prepareFeedbackTarget();
+	void destroyFeedbackTarget();
+	void processFeedback(const uint32_t* requests, uint32_t count);
+	void prepareTiledTexture();
+	void loadMipTail();
+	void uploadContent(const std::vector<uint32_t>& pageIndices, VkImage image);
+	void flushPageUpdates();
 	void fillRandomPages();
 	void fillMipTail();
 	void flushRandomPages();
@@ -116,6 +116,8 @@ void VulkanExample::buildCommandBuffers()
 void VulkanExample::loadAssets()
 {
 	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
+	// Sponza has a lot of large textures, stream them so the first frame isn't delayed by decoding and uploading all of them
+	scene.textureStreamer = &textureStreamer;
 	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices);
 }
 
@@ -168,7 +168,7 @@ VulkanExample::~VulkanExample()
 	for (Image image : scene.images) {
 		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
+		vulkanDevice->samplerCache.release(image.texture.sampler);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
 }
@@ -251,6 +251,8 @@ void VulkanExample::loadglTFFile(std::string filename)
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
+	// Images are loaded from KTX files by the sample, so tinyglTF doesn't need to decode them
+	gltfContext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) { return true; }, nullptr);
 	bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
 
 	size_t pos = filename.find_last_of('/');